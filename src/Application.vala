@@ -29,7 +29,13 @@ public class MyApp : Gtk.Application
     {
         Backend.Interface i = new Backend.Interface(on_swiped, on_pinched);
         var devices = i.get_available_devices();
-        stdout.printf("%s", devices[0].path);
+        if (devices.length > 0)
+        {
+            stdout.printf("%s", devices[0].path);
+            i.set_active_device(devices[0]);
+        }
+        /* Gestures are delivered on the main loop, no threads involved */
+        i.attach();
 
         var app = new MyApp ();
         return app.run (args);
@@ -1,6 +1,6 @@
 namespace Backend
 {
-    [CCode (cname = "_KinesixdDevice")]
+    [CCode (cname = "struct _KinesixdDevice", free_function = "kinesixd_device_free", cheader_filename = "kinesixd_device.h")]
     [Compact]
     public class Device 
     {
@@ -11,15 +11,17 @@ namespace Backend
             return get_path();
         }}
 
-        [CCode (cname = "kinesixd_device_new")]
-        public extern Device(string path, string name, uint product_id, uint vendor_id);
+        [CCode (cname = "kinesixd_device_get_seat")]
+        private extern unowned string get_seat();
 
-        [CCode (cname = "kinesixd_device_free")]
-        private extern void free();
+        public unowned string seat { get {
+            return get_seat();
+        }}
 
-        ~Device() { free(); }
+        [CCode (cname = "kinesixd_device_new")]
+        public extern Device(string path, string name, uint product_id, uint vendor_id);
 
         [CCode (cname = "kinesixd_device_equals")]
         public extern bool equals(Device other);
     }
-}
\ No newline at end of file
+}
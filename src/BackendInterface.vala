@@ -1,9 +1,10 @@
 namespace Backend
 {
-    [CCode (cname = "_KinesixDaemon")]
+    [CCode (cname = "struct _KinesixDaemon", free_function = "kinesixd_daemon_free", cheader_filename = "kinesixd_daemon.h")]
     [Compact]
     public class Interface
     {
+        [CCode (cname = "enum SwipeDirection", cprefix = "")]
         public enum SwipeDirection
         {
             SWIPE_UP,
@@ -12,6 +13,7 @@ namespace Backend
             SWIPE_RIGHT
         }
 
+        [CCode (cname = "enum PinchType", cprefix = "")]
         public enum PinchType
         {
             PINCH_IN,
@@ -24,15 +26,36 @@ namespace Backend
         [CCode (cname = "PinchCallback")]
         public extern delegate void Pinched(PinchType type, int finger_count);
 
+        /* The C side takes a single user_data for both, so both callbacks must share a target */
         [CCode (cname = "kinesixd_daemon_new")]
         public extern Interface(Swiped swipe_cb, Pinched pinch_cb);
 
-        [CCode (cname = "kinesixd_daemon_free")]
-        private extern void free();
+        [CCode (cname = "kinesixd_daemon_get_valid_device_list", array_length_pos = 0.1, array_null_terminated = false)]
+        public extern unowned Device[] get_available_devices();
 
-        ~Interface() { free(); }
+        [CCode (cname = "kinesixd_daemon_get_active_device")]
+        public extern unowned Device? get_active_device();
 
-        [CCode (cname = "kinesixd_daemon_get_valid_device_list")]
-        public extern Device []get_available_devices();
+        [CCode (cname = "kinesixd_daemon_set_active_device")]
+        public extern void set_active_device(Device device);
+
+        [CCode (cname = "kinesixd_daemon_get_fd")]
+        public extern int get_fd();
+
+        [CCode (cname = "kinesixd_daemon_dispatch")]
+        public extern void dispatch();
+
+        /* Services the daemon from context (the default one if null) instead of a thread of its own,
+         * gesture callbacks then fire on whichever thread iterates that context */
+        public uint attach(GLib.MainContext? context = null)
+        {
+            var source = new GLib.IOSource(new GLib.IOChannel.unix_new(get_fd()), GLib.IOCondition.IN);
+            source.set_callback(() => {
+                dispatch();
+                return GLib.Source.CONTINUE;
+            });
+
+            return source.attach(context);
+        }
     }
-}
\ No newline at end of file
+}
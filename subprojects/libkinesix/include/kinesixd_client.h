@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <dbus/dbus.h>
+
+#include "kinesixd_daemon.h"
+#include "kinesixd_device.h"
+#include "kinesixd_global.h"
+#include "kinesixd_kinetics.h"
+
+/* Same bits the daemon's Subscribe method takes */
+enum ClientGestureMask
+{
+    CLIENT_GESTURE_MASK_SWIPE = 1 << 0,
+    CLIENT_GESTURE_MASK_PINCH = 1 << 1,
+    CLIENT_GESTURE_MASK_ALL   = CLIENT_GESTURE_MASK_SWIPE | CLIENT_GESTURE_MASK_PINCH,
+    /* Also deliver every update of the subscribed kinds through batch_cb */
+    CLIENT_GESTURE_MASK_BATCH = 1 << 2
+};
+
+typedef struct _KinesixdClient * KinesixdClient;
+
+typedef void (*ClientSwipedCallback)(KinesixdClient client, int direction, int finger_count, void *user_data);
+typedef void (*ClientPinchCallback)(KinesixdClient client, int pinch_type, int finger_count, void *user_data);
+/* Arrives right before the Swiped callback of the same swipe */
+typedef void (*ClientFlingCallback)(KinesixdClient client,
+                                    int direction,
+                                    int finger_count,
+                                    const struct KinesixdFling *fling,
+                                    void *user_data);
+typedef void (*ClientSequenceCallback)(KinesixdClient client, const char *name, void *user_data);
+/* samples only lives for the duration of the call. A long batch may arrive over several calls */
+typedef void (*ClientBatchCallback)(KinesixdClient client,
+                                    const struct KinesixdGestureSample *samples,
+                                    int sample_count,
+                                    void *user_data);
+/* Fired once the initial state arrived and whenever the cached state changes afterwards */
+typedef void (*ClientStateCallback)(KinesixdClient client, void *user_data);
+/* error is 0 on success, otherwise the DBus error name */
+typedef void (*ClientResultCallback)(KinesixdClient client, const char *error, void *user_data);
+
+struct KinesixdClientCallbacks
+{
+    ClientSwipedCallback swiped_cb;
+    ClientPinchCallback pinch_cb;
+    ClientStateCallback ready_cb;
+    ClientStateCallback devices_changed_cb;
+    ClientStateCallback active_device_changed_cb;
+    ClientFlingCallback fling_cb;
+    ClientSequenceCallback sequence_cb;
+    ClientBatchCallback batch_cb;
+};
+
+/* The connection has to be dispatched by the caller (dbus_connection_setup_with_g_main, a
+ * dbus_connection_read_write_dispatch loop, ...), every callback runs from that dispatch.
+ * Nothing blocks: the match rule, Subscribe and the initial property fetch are all sent at once */
+KinesixdClient kinesixd_client_new(DBusConnection *connection,
+                                   unsigned int gesture_mask,
+                                   const struct KinesixdClientCallbacks *callbacks,
+                                   void *user_data);
+void kinesixd_client_free(KinesixdClient client);
+int kinesixd_client_is_ready(const KinesixdClient client);
+
+/* Cached copies owned by the client, valid until the next devices_changed_cb / active_device_changed_cb */
+KinesixdDevice *kinesixd_client_get_devices(const KinesixdClient client, int *out_length);
+KinesixdDevice kinesixd_client_get_active_device(const KinesixdClient client);
+double kinesixd_client_get_gesture_delta(const KinesixdClient client);
+
+void kinesixd_client_set_active_device(KinesixdClient client, KinesixdDevice device);
+void kinesixd_client_subscribe(KinesixdClient client,
+                               unsigned int gesture_mask,
+                               ClientResultCallback callback,
+                               void *user_data);
+void kinesixd_client_unsubscribe(KinesixdClient client,
+                                 ClientResultCallback callback,
+                                 void *user_data);
+void kinesixd_client_set_log_level(KinesixdClient client,
+                                   const char *level,
+                                   ClientResultCallback callback,
+                                   void *user_data);
+
+#endif // CLIENT_H
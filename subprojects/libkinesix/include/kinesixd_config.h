@@ -0,0 +1,73 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <limits.h>
+
+#include "kinesixd_sequence.h"
+
+#define CONFIG_DEFAULT_PATH "/etc/kinesixd.conf"
+#define CONFIG_MAX_INPUT_WORKERS 16
+#define CONFIG_MAX_BATCH_WINDOW_MS 1000
+
+enum ConfigGesture
+{
+    CONFIG_GESTURE_SWIPE = 1 << 0,
+    CONFIG_GESTURE_PINCH = 1 << 1,
+    CONFIG_GESTURE_ALL   = CONFIG_GESTURE_SWIPE | CONFIG_GESTURE_PINCH
+};
+
+enum ConfigBus
+{
+    CONFIG_BUS_SESSION,
+    CONFIG_BUS_SYSTEM
+};
+
+enum ConfigBackend
+{
+    CONFIG_BACKEND_LIBINPUT,
+    /* Reads ABS_MT_* straight from the device node, see kinesixd_mt_recognizer.h */
+    CONFIG_BACKEND_EVDEV
+};
+
+/* Plain values only, a config is copied around whole so a reload can never be observed half applied */
+struct KinesixdConfig
+{
+    double gesture_delta;
+    unsigned int enabled_gestures;
+    enum ConfigBus bus;
+    enum ConfigBackend backend;
+    /* Release the device while no client is subscribed, off unless every client calls Subscribe */
+    int suspend_when_idle;
+    /* Threads every valid device is spread over, 0 to only read the active device on the event thread */
+    int input_workers;
+    /* How long GestureBatch collects samples before sending them */
+    int batch_window_ms;
+    char devices_path[PATH_MAX];
+    struct KinesixdSequence sequences[SEQUENCE_MAX_COUNT];
+    int sequence_count;
+};
+
+void kinesixd_config_init(struct KinesixdConfig *config);
+/* The defaults with the file applied on top. Leaves config untouched unless the whole file parses */
+int kinesixd_config_load(const char *file_path, struct KinesixdConfig *config);
+
+#endif // CONFIG_H
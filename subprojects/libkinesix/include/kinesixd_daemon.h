@@ -21,6 +21,7 @@
 #define GESTURE_DAEMON_H
 
 #include <kinesixd_device.h>
+#include <kinesixd_kinetics.h>
 
 enum SwipeDirection
 {
@@ -38,21 +39,96 @@ enum PinchType
 
 #define UNKNOWN_GESTURE -1
 
+enum GestureSampleType
+{
+    GESTURE_SAMPLE_SWIPE,
+    GESTURE_SAMPLE_PINCH
+};
+
+enum GestureSamplePhase
+{
+    GESTURE_SAMPLE_BEGIN,
+    GESTURE_SAMPLE_UPDATE,
+    GESTURE_SAMPLE_END,
+    GESTURE_SAMPLE_CANCEL
+};
+
+/* One step of a touchpad gesture as libinput reported it, before any classification. dx and dy are
+ * unaccelerated, scale is relative to where the pinch began */
+struct KinesixdGestureSample
+{
+    int type;
+    int phase;
+    int finger_count;
+    double dx;
+    double dy;
+    double scale;
+    uint64_t time_usec;
+};
+
 typedef struct _KinesixDaemon *KinesixDaemon;
 
 typedef void (*SwipedCallback)(int direction, int finger_count, void *user_data);
 typedef void (*PinchCallback)(int pinch_type, int finger_count, void *user_data);
+/* Fired right before the SwipedCallback of the same swipe */
+typedef void (*FlingCallback)(int direction, int finger_count, const struct KinesixdFling *fling, void *user_data);
+/* Fired after the callback of the gesture that completed a configured sequence */
+typedef void (*SequenceCallback)(const char *name, void *user_data);
+/* Fired for every touchpad gesture event. Unlike the others it runs on the input worker that read
+ * the event when input_workers is set, so it has to be safe to call from several threads */
+typedef void (*SampleCallback)(const struct KinesixdGestureSample *sample, void *user_data);
+
+/* Runs on the thread dispatching events once the command was applied */
+typedef void (*CommandCallback)(KinesixDaemon daemon, int success, void *user_data);
 
 struct KinesixDaemonCallbacks
 {
     SwipedCallback swiped_cb;
     PinchCallback  pinch_cb;
+    FlingCallback  fling_cb;
+    SequenceCallback sequence_cb;
+    SampleCallback sample_cb;
 };
 
 KinesixDaemon kinesixd_daemon_new(SwipedCallback swipe_cb, void *swipe_cb_target, PinchCallback pinch_cb, void *pinch_cb_target);
+/* config_path is read at startup and watched for changes, 0 keeps the built-in defaults */
+KinesixDaemon kinesixd_daemon_new_with_config(const char *config_path,
+                                              SwipedCallback swipe_cb,
+                                              void *swipe_cb_target,
+                                              PinchCallback pinch_cb,
+                                              void *pinch_cb_target);
 void kinesixd_daemon_free(KinesixDaemon daemon);
+/* Shares the user_data given to kinesixd_daemon_new */
+void kinesixd_daemon_set_fling_callback(KinesixDaemon daemon, FlingCallback fling_cb);
+void kinesixd_daemon_set_sequence_callback(KinesixDaemon daemon, SequenceCallback sequence_cb);
+void kinesixd_daemon_set_sample_callback(KinesixDaemon daemon, SampleCallback sample_cb);
 KinesixdDevice *kinesixd_daemon_get_valid_device_list(const KinesixDaemon daemon, int *out_length);
+unsigned int kinesixd_daemon_get_device_list_generation(const KinesixDaemon daemon);
+KinesixdDevice kinesixd_daemon_get_active_device(const KinesixDaemon daemon);
+/* The device behind the gesture or sample being reported, only meaningful inside a callback. With
+ * input_workers several devices are read at once, so this is not necessarily the active one */
+KinesixdDevice kinesixd_daemon_get_gesture_source(const KinesixDaemon daemon);
+double kinesixd_daemon_get_gesture_delta(const KinesixDaemon daemon);
+/* Follows batch_window_ms in the config, safe from any thread */
+unsigned int kinesixd_daemon_get_batch_window_ms(const KinesixDaemon daemon);
+/* Both only queue the switch, the device is opened by the thread dispatching events. The callback
+ * gets success 0 for a device that is not valid or could not be opened */
 void kinesixd_daemon_set_active_device(KinesixDaemon daemon, KinesixdDevice device);
+void kinesixd_daemon_set_active_device_async(KinesixDaemon daemon,
+                                             KinesixdDevice device,
+                                             CommandCallback callback,
+                                             void *user_data);
+/* Tells the daemon whether anybody is listening. Input is suspended, and the device released,
+ * while idle unless suspend_when_idle is turned off in the config */
+void kinesixd_daemon_set_idle_async(KinesixDaemon daemon,
+                                    int idle,
+                                    CommandCallback callback,
+                                    void *user_data);
+int kinesixd_daemon_is_suspended(const KinesixDaemon daemon);
+/* Either let the daemon run its own thread with start_polling, or wait for get_fd to become readable
+ * and call dispatch from your own loop. Callbacks fire on whichever thread runs dispatch */
+int kinesixd_daemon_get_fd(const KinesixDaemon daemon);
+void kinesixd_daemon_dispatch(KinesixDaemon daemon);
 void kinesixd_daemon_start_polling(KinesixDaemon daemon);
 void kinesixd_daemon_stop_polling(KinesixDaemon daemon);
 
@@ -26,9 +26,10 @@
 
 typedef struct _KinesixdDBusAdaptor * KinesixdDBusAdaptor;
 
-KinesixdDBusAdaptor kinesixd_dbus_adaptor_new(DBusBusType type);
+KinesixdDBusAdaptor kinesixd_dbus_adaptor_new(DBusBusType type, const char *config_path);
 void kinesixd_dbus_adaptor_free(KinesixdDBusAdaptor dbus_adaptor);
 void kinesixd_dbus_adaptor_start_listenting(KinesixdDBusAdaptor dbus_adaptor);
 void kinesixd_dbus_adaptor_stop_listenting(KinesixdDBusAdaptor dbus_adaptor);
+int kinesixd_dbus_adaptor_get_idle_time(KinesixdDBusAdaptor dbus_adaptor);
 
 #endif // GESTUREDAEMONDBUSADAPTOR_H
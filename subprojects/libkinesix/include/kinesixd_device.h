@@ -33,8 +33,11 @@ KinesixdDevice kinesixd_device_new(const char *path,
 void kinesixd_device_free(KinesixdDevice device);
 int kinesixd_device_equals(KinesixdDevice device1, KinesixdDevice device2);
 const char *kinesixd_device_get_path(KinesixdDevice device);
+const char *kinesixd_device_get_seat(KinesixdDevice device);
 int kinesixd_device_list_get_length(KinesixdDevice *device_list);
 int kinesixd_device_list_contains(KinesixdDevice *device_list, KinesixdDevice device);
+KinesixdDevice kinesixd_device_list_find_by_id(KinesixdDevice *device_list, int id);
+KinesixdDevice kinesixd_device_list_find_by_path(KinesixdDevice *device_list, const char *path);
 void kinesixd_device_list_free(KinesixdDevice *device_list);
 
 #endif // DEVICE_H
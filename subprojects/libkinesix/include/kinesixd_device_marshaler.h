@@ -27,6 +27,9 @@
 
 int kinesixd_device_marshaler_append_device(const KinesixdDevice device, DBusMessageIter *dbus_iter);
 KinesixdDevice kinesixd_device_marshaler_device_from_dbus_argument(DBusMessageIter *dbus_iter);
+/* Resolves the device by id against device_list without allocating. The path has to match too,
+ * a reference to a device that was since replaced is refused */
+KinesixdDevice kinesixd_device_marshaler_find_device(DBusMessageIter *dbus_iter, KinesixdDevice *device_list);
 int kinesixd_device_marshaler_append_device_list(const KinesixdDevice *const device_list, DBusMessageIter *dbus_iter);
 
 #endif // DEVICEMARSHALER_H
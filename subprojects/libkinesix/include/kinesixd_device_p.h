@@ -29,6 +29,7 @@ struct _KinesixdDevice
     int id;
     char *path;
     char *name;
+    char *seat;
     uint32_t product_id;
     uint32_t vendor_id;
 };
@@ -38,5 +39,12 @@ struct _KinesixdDevice *device_priv_new_with_id(int id,
                                         const char *name,
                                         uint32_t product_id,
                                         uint32_t vendor_id);
+/* For devices described by someone else, e.g. received over DBus, the node may not be visible here */
+struct _KinesixdDevice *device_priv_new_unchecked(int id,
+                                          const char *path,
+                                          const char *name,
+                                          uint32_t product_id,
+                                          uint32_t vendor_id);
+void device_priv_set_seat(struct _KinesixdDevice *device, const char *seat);
 
 #endif // DEVICE_P_H
@@ -0,0 +1,107 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The last FLIGHT_RECORDER_CAPACITY steps of gesture handling, kept in a shared file mapping so they
+ * are still there after a crash. Writers, the event thread and any input workers, claim slots with a
+ * single atomic add, so recording never takes a lock. Readers check every slot's sequence number
+ * around copying it out */
+
+#define FLIGHT_RECORDER_CAPACITY    1024
+#define FLIGHT_RECORDER_MAGIC       "KXFLIGHT"
+#define FLIGHT_RECORDER_VERSION     1
+
+typedef enum
+{
+    /* A libinput gesture or touch event, type is the libinput event type */
+    FLIGHT_RECORD_EVENT = 1,
+    /* What a finished gesture was classified as. Here and below type is a StatisticsGesture */
+    FLIGHT_RECORD_DECISION,
+    /* Whether the classified gesture was handed to the callbacks */
+    FLIGHT_RECORD_CALLBACK,
+    /* Whether the DBus signal for it could be queued, type is a StatisticsGesture */
+    FLIGHT_RECORD_SIGNAL
+} FlightRecordKind;
+
+typedef enum
+{
+    FLIGHT_RECORD_CANCELLED     = 1 << 0,
+    /* Turned off in the config when the gesture began */
+    FLIGHT_RECORD_DISABLED      = 1 << 1,
+    FLIGHT_RECORD_FAILED        = 1 << 2,
+    FLIGHT_RECORD_TOUCHSCREEN   = 1 << 3
+} FlightRecordFlags;
+
+struct KinesixdFlightRecord
+{
+    /* 0 while the slot is being written, readers skip it */
+    uint64_t sequence;
+    uint64_t time_usec;
+    uint16_t kind;
+    int16_t type;
+    /* The slot for touch events */
+    int16_t finger_count;
+    /* Direction or pinch type, UNKNOWN_GESTURE if there is none */
+    int16_t result;
+    uint32_t flags;
+    /* Unaccelerated deltas for swipes, scale and angle delta for pinches, position for touches */
+    float x;
+    float y;
+    uint32_t reserved;
+};
+
+/* Start of the mapping, the ring follows */
+struct KinesixdFlightRecorderHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t record_size;
+    int32_t process_id;
+    /* Sequence number the next record gets, records before it are complete */
+    uint64_t head;
+};
+
+typedef void (*FlightRecordCallback)(const struct KinesixdFlightRecord *record, void *user_data);
+
+/* An existing recording at the same path is kept next to it with a .previous suffix */
+int kinesixd_flight_recorder_open(const char *file_path);
+void kinesixd_flight_recorder_close(void);
+void kinesixd_flight_recorder_record(FlightRecordKind kind,
+                                     uint64_t time_usec,
+                                     int type,
+                                     int finger_count,
+                                     int result,
+                                     unsigned int flags,
+                                     double x,
+                                     double y);
+/* Oldest first. Safe from any thread, slots overwritten while walking are left out */
+int kinesixd_flight_recorder_foreach(FlightRecordCallback callback, void *user_data);
+/* Same for a file left behind by another process, live or not */
+int kinesixd_flight_recorder_read_file(const char *file_path, FlightRecordCallback callback, void *user_data);
+const char *kinesixd_flight_recorder_get_kind_name(FlightRecordKind kind);
+/* One line of text, for kinesixctl */
+void kinesixd_flight_recorder_describe(const struct KinesixdFlightRecord *record, char *buffer, size_t size);
+
+#endif // FLIGHT_RECORDER_H
@@ -24,75 +24,35 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define UNUSED(var) (void)var;
+#include "kinesixd_log.h"
 
-#define MAX_LOG_LEN     2048
+#define UNUSED(var) (void)var;
 
+/* Messages are formatted straight into a slot of the log ring and written out by a background
+   thread, so logging never blocks the input or DBus threads on stderr or the journal */
 #define LOG(...) \
-    do { \
-    char log[MAX_LOG_LEN]; \
-    snprintf(log, MAX_LOG_LEN - 1, __VA_ARGS__); \
-    fprintf(stderr, \
-            "kinesixd: INFO: %s: %s: %d: %s\n", \
-            __FILE__, \
-            __PRETTY_FUNCTION__, \
-            __LINE__, \
-            log); \
-    } while (0)
+    kinesixd_log_write(LOG_LEVEL_INFO, __FILE__, __PRETTY_FUNCTION__, __LINE__, __VA_ARGS__)
 
 #define LOG_INFO(message) LOG(message)
 
 #define LOG_WARN(...) \
-    do { \
-    char log[MAX_LOG_LEN]; \
-    snprintf(log, MAX_LOG_LEN - 1, __VA_ARGS__); \
-    fprintf(stderr, \
-            "kinesixd: WARNING: %s: %s: %d: %s\n", \
-            __FILE__, \
-            __PRETTY_FUNCTION__, \
-            __LINE__, \
-            log); \
-    } while (0)
+    kinesixd_log_write(LOG_LEVEL_WARNING, __FILE__, __PRETTY_FUNCTION__, __LINE__, __VA_ARGS__)
 
 #define LOG_ERROR(...) \
-    do { \
-    char log[MAX_LOG_LEN]; \
-    snprintf(log, MAX_LOG_LEN - 1, __VA_ARGS__); \
-    fprintf(stderr, \
-            "kinesixd: ERROR: %s: %s: %d: %s\n", \
-            __FILE__, \
-            __PRETTY_FUNCTION__, \
-            __LINE__, \
-            log); \
-    } while (0)
+    kinesixd_log_write(LOG_LEVEL_ERROR, __FILE__, __PRETTY_FUNCTION__, __LINE__, __VA_ARGS__)
 
 #define LOG_FATAL(...) \
     do { \
-    char log[MAX_LOG_LEN]; \
-    snprintf(log, MAX_LOG_LEN - 1, __VA_ARGS__); \
-    fprintf(stderr, \
-            "kinesixd: FATAL: %s: %s: %d: %s\n", \
-            __FILE__, \
-            __PRETTY_FUNCTION__, \
-            __LINE__, \
-            log); \
+    kinesixd_log_write(LOG_LEVEL_FATAL, __FILE__, __PRETTY_FUNCTION__, __LINE__, __VA_ARGS__); \
     exit(EXIT_FAILURE); \
     } while (0)
 
-#ifdef DEBUG_BUILD
+/* Always built in so SetLogLevel can turn it on, the level check keeps the arguments from being
+   evaluated and formatted while it is off */
 #define LOG_DEBUG(...) \
     do { \
-    char log[MAX_LOG_LEN]; \
-    snprintf(log, MAX_LOG_LEN - 1, __VA_ARGS__); \
-    fprintf(stderr, \
-            "kinesixd: DEBUG: %s: %s: %d: %s\n", \
-            __FILE__, \
-            __PRETTY_FUNCTION__, \
-            __LINE__, \
-            log); \
+    if (kinesixd_log_get_level() == LOG_LEVEL_DEBUG) \
+        kinesixd_log_write(LOG_LEVEL_DEBUG, __FILE__, __PRETTY_FUNCTION__, __LINE__, __VA_ARGS__); \
     } while (0)
-#else
-#define LOG_DEBUG(...)
-#endif
 
 #endif // GESTUREDAEMONGLOBAL_H
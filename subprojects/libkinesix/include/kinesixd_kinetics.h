@@ -0,0 +1,63 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef KINETICS_H
+#define KINETICS_H
+
+#include <stdint.h>
+
+#define KINETICS_WINDOW_SIZE 8
+
+/* What a client needs to continue a swipe with momentum. Distances are in the same 1000 dpi units
+ * as gesture_delta, velocities in those units per second */
+struct KinesixdFling
+{
+    double velocity_x;
+    double velocity_y;
+    double displacement_x;
+    double displacement_y;
+    uint64_t duration_usec;
+};
+
+/* Release velocity over the last few deltas. The window keeps running sums next to the samples,
+ * so every update is O(1) no matter how long the gesture runs */
+struct KinesixdKinetics
+{
+    uint64_t start_usec;
+    uint64_t last_usec;
+    double displacement_x;
+    double displacement_y;
+
+    double window_dx[KINETICS_WINDOW_SIZE];
+    double window_dy[KINETICS_WINDOW_SIZE];
+    uint64_t window_dt[KINETICS_WINDOW_SIZE];
+    double window_sum_dx;
+    double window_sum_dy;
+    uint64_t window_sum_dt;
+    int window_head;
+    int window_count;
+};
+
+void kinesixd_kinetics_begin(struct KinesixdKinetics *kinetics, uint64_t time_usec);
+void kinesixd_kinetics_update(struct KinesixdKinetics *kinetics, double dx, double dy, uint64_t time_usec);
+void kinesixd_kinetics_finish(const struct KinesixdKinetics *kinetics,
+                              uint64_t time_usec,
+                              struct KinesixdFling *fling_out);
+
+#endif // KINETICS_H
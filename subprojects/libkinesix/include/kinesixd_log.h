@@ -0,0 +1,50 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+typedef enum
+{
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_FATAL
+} LogLevel;
+
+typedef enum
+{
+    LOG_TARGET_AUTO = 0,
+    LOG_TARGET_STDERR,
+    LOG_TARGET_JOURNAL
+} LogTarget;
+
+int kinesixd_log_start(LogTarget target);
+void kinesixd_log_stop(void);
+void kinesixd_log_set_level(LogLevel level);
+LogLevel kinesixd_log_get_level(void);
+int kinesixd_log_level_from_string(const char *level_name, LogLevel *level_out);
+void kinesixd_log_write(LogLevel level,
+                        const char *file,
+                        const char *function,
+                        int line,
+                        const char *format, ...) __attribute__((format(printf, 5, 6)));
+
+#endif // LOG_H
@@ -0,0 +1,114 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef MT_RECOGNIZER_H
+#define MT_RECOGNIZER_H
+
+#include <stdint.h>
+
+#include <linux/input.h>
+
+#include "kinesixd_kinetics.h"
+
+#define MT_MAX_SLOTS 16
+
+/* Flags returned by kinesixd_mt_recognizer_feed */
+enum MtFrameResult
+{
+    MT_FRAME_GESTURE_ENDED = 1 << 0,
+    MT_FRAME_GESTURE_BEGAN = 1 << 1,
+    /* The report that closed a SYN_DROPPED, kinesixd_mt_recognizer_sync has to run before the next event */
+    MT_FRAME_SYNC_NEEDED   = 1 << 2
+};
+
+typedef enum
+{
+    MT_GESTURE_NONE,
+    MT_GESTURE_SWIPE,
+    MT_GESTURE_PINCH
+} MtGestureKind;
+
+struct KinesixdMtGesture
+{
+    MtGestureKind kind;
+    /* SwipeDirection or PinchType */
+    int result;
+    int finger_count;
+    uint64_t start_usec;
+    uint64_t time_usec;
+    /* Only meaningful for swipes */
+    struct KinesixdFling fling;
+};
+
+/* Swipe/pinch recognition from raw multitouch slots, fed either by ABS_MT_* events (protocol B)
+ * or by libinput touch events. Slot state is kept one array per axis so a frame only walks the
+ * columns it needs, and never more than slot_count entries */
+struct KinesixdMtRecognizer
+{
+    int32_t slot_tracking_id[MT_MAX_SLOTS];
+    double slot_x[MT_MAX_SLOTS];
+    double slot_y[MT_MAX_SLOTS];
+    int slot_count;
+    int current_slot;
+    /* Converts device units to the 1000 dpi units libinput reports unaccelerated deltas in */
+    double x_scale;
+    double y_scale;
+    /* Set by SYN_DROPPED, everything up to the next SYN_REPORT is garbage and nothing is read
+     * until the state was synced again */
+    int dropped;
+
+    int gesture_active;
+    /* Set once a gesture ended, no new one starts before every finger was lifted */
+    int wait_for_release;
+    int gesture_finger_count;
+    double last_centroid_x;
+    double last_centroid_y;
+    double start_spread;
+    double scale;
+    double x_max;
+    double y_max;
+    struct KinesixdKinetics kinetics;
+};
+
+/* Resolutions are in position units per mm */
+void kinesixd_mt_recognizer_init(struct KinesixdMtRecognizer *recognizer,
+                                 int slot_count,
+                                 double x_resolution,
+                                 double y_resolution);
+/* Reloads slot state from the device after a SYN_DROPPED, any ongoing gesture is dropped */
+void kinesixd_mt_recognizer_sync(struct KinesixdMtRecognizer *recognizer, int fd);
+int kinesixd_mt_recognizer_feed(struct KinesixdMtRecognizer *recognizer,
+                                const struct input_event *event,
+                                double gesture_delta,
+                                struct KinesixdMtGesture *gesture_out);
+
+/* Frame based interface for touch events that were already decoded, e.g. by libinput */
+void kinesixd_mt_recognizer_touch(struct KinesixdMtRecognizer *recognizer,
+                                  int slot,
+                                  int down,
+                                  double x,
+                                  double y);
+int kinesixd_mt_recognizer_frame(struct KinesixdMtRecognizer *recognizer,
+                                 double gesture_delta,
+                                 uint64_t time_usec,
+                                 struct KinesixdMtGesture *gesture_out);
+/* Lifts every finger without reporting whatever was in progress */
+void kinesixd_mt_recognizer_cancel(struct KinesixdMtRecognizer *recognizer);
+
+#endif // MT_RECOGNIZER_H
@@ -0,0 +1,60 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef PROBES_H
+#define PROBES_H
+
+/* Static tracepoints for bpftrace and friends, see tools/kinesixd-latency.bt
+ *
+ * kinesixd:dispatch()
+ * kinesixd:event_dequeue(event_type, event_time_usec)
+ * kinesixd:classify(gesture_type, result, finger_count, event_time_usec)
+ * kinesixd:callback(gesture_type, result, finger_count, event_time_usec)
+ * kinesixd:dbus_send(gesture_type, result, finger_count, event_time_usec)
+ * kinesixd:dbus_flush(gesture_type, result, finger_count, event_time_usec)
+ *
+ * gesture_type follows StatisticsGesture, event_time_usec is the CLOCK_MONOTONIC timestamp libinput
+ * gave the event, the time each probe fires is left to the tracer (nsecs in bpftrace). dbus_flush
+ * fires once whatever the socket accepted without blocking was written */
+
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+
+#define PROBE_DISPATCH() \
+    DTRACE_PROBE(kinesixd, dispatch)
+#define PROBE_EVENT_DEQUEUE(event_type, event_time_usec) \
+    DTRACE_PROBE2(kinesixd, event_dequeue, event_type, event_time_usec)
+#define PROBE_CLASSIFY(gesture_type, result, finger_count, event_time_usec) \
+    DTRACE_PROBE4(kinesixd, classify, gesture_type, result, finger_count, event_time_usec)
+#define PROBE_CALLBACK(gesture_type, result, finger_count, event_time_usec) \
+    DTRACE_PROBE4(kinesixd, callback, gesture_type, result, finger_count, event_time_usec)
+#define PROBE_DBUS_SEND(gesture_type, result, finger_count, event_time_usec) \
+    DTRACE_PROBE4(kinesixd, dbus_send, gesture_type, result, finger_count, event_time_usec)
+#define PROBE_DBUS_FLUSH(gesture_type, result, finger_count, event_time_usec) \
+    DTRACE_PROBE4(kinesixd, dbus_flush, gesture_type, result, finger_count, event_time_usec)
+#else
+#define PROBE_DISPATCH()
+#define PROBE_EVENT_DEQUEUE(event_type, event_time_usec)
+#define PROBE_CLASSIFY(gesture_type, result, finger_count, event_time_usec)
+#define PROBE_CALLBACK(gesture_type, result, finger_count, event_time_usec)
+#define PROBE_DBUS_SEND(gesture_type, result, finger_count, event_time_usec)
+#define PROBE_DBUS_FLUSH(gesture_type, result, finger_count, event_time_usec)
+#endif
+
+#endif // PROBES_H
@@ -0,0 +1,94 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <stdint.h>
+
+#define SEQUENCE_MAX_COUNT      32
+#define SEQUENCE_MAX_STEPS      8
+#define SEQUENCE_NAME_MAX       64
+/* Steps name 2 to 5 fingers, 5 also stands for anything above */
+#define SEQUENCE_MIN_FINGERS    2
+#define SEQUENCE_MAX_FINGERS    5
+
+enum SequenceGesture
+{
+    SEQUENCE_GESTURE_SWIPE,
+    SEQUENCE_GESTURE_PINCH
+};
+
+struct KinesixdSequenceStep
+{
+    enum SequenceGesture gesture;
+    /* SwipeDirection or PinchType */
+    int result;
+    /* 0 matches any */
+    int finger_count;
+    /* Longest pause since the previous gesture ended, 0 for no limit. Ignored on the first step */
+    unsigned int max_gap_ms;
+};
+
+struct KinesixdSequence
+{
+    char name[SEQUENCE_NAME_MAX];
+    int step_count;
+    struct KinesixdSequenceStep steps[SEQUENCE_MAX_STEPS];
+};
+
+/* All sequences compiled into one DFA. Its states are the sets of partially matched sequences,
+ * its input symbols every (gesture, result, finger count, gap class) combination, where the gap
+ * classes are the ranges between the distinct max_gap_ms values. Stepping it is a table lookup */
+struct KinesixdSequenceMatcher
+{
+    char names[SEQUENCE_MAX_COUNT][SEQUENCE_NAME_MAX];
+    unsigned int gap_thresholds_ms[SEQUENCE_MAX_COUNT * SEQUENCE_MAX_STEPS];
+    int gap_threshold_count;
+    int symbol_count;
+    int state_count;
+    uint16_t *transitions;
+    /* Longest sequence completed on entering each state, -1 for none */
+    int16_t *accepted;
+
+    int state;
+    uint64_t last_end_usec;
+};
+
+/* text is a comma separated list of steps, each "swipe <up|down|left|right>" or "pinch <in|out>",
+ * optionally followed by a finger count and "within <ms>" */
+int kinesixd_sequence_parse(const char *name, const char *text, struct KinesixdSequence *sequence_out);
+
+void kinesixd_sequence_matcher_init(struct KinesixdSequenceMatcher *matcher);
+void kinesixd_sequence_matcher_free(struct KinesixdSequenceMatcher *matcher);
+/* Keeps the previous tables unless the new ones could be built */
+int kinesixd_sequence_matcher_compile(struct KinesixdSequenceMatcher *matcher,
+                                      const struct KinesixdSequence *sequences,
+                                      int sequence_count);
+void kinesixd_sequence_matcher_reset(struct KinesixdSequenceMatcher *matcher);
+/* Feeds one completed gesture, returns the name of the sequence it completed or 0. Sequences may
+ * overlap, every gesture can both end one sequence and start the next */
+const char *kinesixd_sequence_matcher_step(struct KinesixdSequenceMatcher *matcher,
+                                           enum SequenceGesture gesture,
+                                           int result,
+                                           int finger_count,
+                                           uint64_t start_usec,
+                                           uint64_t end_usec);
+
+#endif // SEQUENCE_H
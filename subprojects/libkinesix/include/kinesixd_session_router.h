@@ -0,0 +1,74 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef SESSIONROUTER_H
+#define SESSIONROUTER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "kinesixd_global.h"
+
+enum GestureMask
+{
+    GESTURE_MASK_SWIPE = 1 << 0,
+    GESTURE_MASK_PINCH = 1 << 1,
+    GESTURE_MASK_ALL   = GESTURE_MASK_SWIPE | GESTURE_MASK_PINCH,
+    /* Not a kind of gesture but an opt in to GestureBatch, for the kinds subscribed to */
+    GESTURE_MASK_BATCH = 1 << 2
+};
+
+typedef struct _KinesixdSessionRouter * KinesixdSessionRouter;
+
+/* Returns the serial of the copy sent to destination, 0 if it could not be sent */
+typedef unsigned int (*RouteCallback)(const char *destination, void *user_data);
+typedef void (*SubscriberStatisticsCallback)(const char *bus_name,
+                                             uint64_t signals_routed,
+                                             uint64_t signals_rejected,
+                                             void *user_data);
+
+KinesixdSessionRouter kinesixd_session_router_new(int route_by_session);
+void kinesixd_session_router_free(KinesixdSessionRouter router);
+int kinesixd_session_router_subscribe(KinesixdSessionRouter router,
+                                      const char *bus_name,
+                                      pid_t pid,
+                                      unsigned int gesture_mask);
+int kinesixd_session_router_unsubscribe(KinesixdSessionRouter router, const char *bus_name);
+int kinesixd_session_router_set_session_policy(KinesixdSessionRouter router,
+                                               pid_t pid,
+                                               unsigned int gesture_mask);
+/* Whether the login session of pid is the active one on seat, always true when not routing by session */
+int kinesixd_session_router_session_is_active(KinesixdSessionRouter router, pid_t pid, const char *seat);
+int kinesixd_session_router_get_subscriber_count(KinesixdSessionRouter router);
+/* Subscribers with any of the bits in gesture_mask set */
+int kinesixd_session_router_count_subscribers(KinesixdSessionRouter router, unsigned int gesture_mask);
+void kinesixd_session_router_refresh(KinesixdSessionRouter router);
+int kinesixd_session_router_route(KinesixdSessionRouter router,
+                                  const char *seat,
+                                  unsigned int gesture,
+                                  RouteCallback callback,
+                                  void *user_data);
+/* The bus refused a routed copy, usually because its receiver stopped reading. Returns whether
+ * the serial belonged to one of the recent copies of a subscriber */
+int kinesixd_session_router_signal_rejected(KinesixdSessionRouter router, unsigned int serial);
+void kinesixd_session_router_foreach_subscriber(KinesixdSessionRouter router,
+                                                SubscriberStatisticsCallback callback,
+                                                void *user_data);
+
+#endif // SESSIONROUTER_H
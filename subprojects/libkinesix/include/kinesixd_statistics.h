@@ -0,0 +1,108 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <stdint.h>
+
+#include "kinesixd_global.h"
+
+/* Values below 2^3 get a bucket each, above that every power of two is split in 8 linear buckets */
+#define STATISTICS_HISTOGRAM_SUB_BUCKET_BITS    3
+#define STATISTICS_HISTOGRAM_MAX_EXPONENT       40
+#define STATISTICS_HISTOGRAM_BUCKET_COUNT       \
+    ((STATISTICS_HISTOGRAM_MAX_EXPONENT - STATISTICS_HISTOGRAM_SUB_BUCKET_BITS + 2) << STATISTICS_HISTOGRAM_SUB_BUCKET_BITS)
+#define STATISTICS_MAX_FINGER_COUNT             5
+
+typedef enum
+{
+    STATISTICS_EVENTS_READ = 0,
+    STATISTICS_GESTURES_CANCELLED,
+    STATISTICS_LOG_RECORDS_DROPPED,
+    /* Split by whether input was suspended at the time, see kinesixd_statistics_input_suspended */
+    STATISTICS_WAKEUPS_ACTIVE,
+    STATISTICS_WAKEUPS_SUSPENDED,
+    STATISTICS_ACTIVE_USEC,
+    STATISTICS_SUSPENDED_USEC,
+    STATISTICS_CPU_ACTIVE_USEC,
+    STATISTICS_CPU_SUSPENDED_USEC,
+    /* State changes folded into a later one while the outgoing queue was over its limit */
+    STATISTICS_SIGNALS_COALESCED,
+    /* Refused by the bus because the receiver fell too far behind */
+    STATISTICS_SIGNALS_REJECTED,
+    /* Gestures from input workers that found the merge queue full */
+    STATISTICS_GESTURES_MERGE_DROPPED,
+    /* Slow method calls turned away because every method worker was busy and the queue full */
+    STATISTICS_METHOD_CALLS_REJECTED,
+    /* GestureBatch signals dropped while the outgoing queue was over its limit */
+    STATISTICS_GESTURE_BATCHES_DROPPED,
+    STATISTICS_COUNTER_COUNT
+} StatisticsCounter;
+
+typedef enum
+{
+    STATISTICS_LIBINPUT_QUEUE_DEPTH = 0,
+    STATISTICS_SIGNAL_MUTEX_WAIT,
+    STATISTICS_EVENT_TO_CLASSIFIED,
+    STATISTICS_CLASSIFIED_TO_SENT,
+    STATISTICS_EVENT_TO_SENT,
+    STATISTICS_OUTGOING_BYTES,
+    /* How long a gesture from an input worker waited to be emitted in order */
+    STATISTICS_MERGE_WAIT,
+    /* How long a slow method call waited for a method worker */
+    STATISTICS_METHOD_QUEUE_WAIT,
+    STATISTICS_HISTOGRAM_COUNT
+} StatisticsHistogram;
+
+typedef enum
+{
+    STATISTICS_GESTURE_SWIPE = 0,
+    STATISTICS_GESTURE_PINCH,
+    STATISTICS_GESTURE_COUNT
+} StatisticsGesture;
+
+struct KinesixdHistogramSnapshot
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[STATISTICS_HISTOGRAM_BUCKET_COUNT];
+};
+
+uint64_t kinesixd_statistics_now_ns(void);
+void kinesixd_statistics_increment(StatisticsCounter counter);
+void kinesixd_statistics_record(StatisticsHistogram histogram, uint64_t value);
+void kinesixd_statistics_gesture_classified(uint64_t event_time_usec);
+void kinesixd_statistics_gesture_emitted(StatisticsGesture gesture, int finger_count);
+uint64_t kinesixd_statistics_get_current_event_time_usec(void);
+/* Every time one of the daemon's threads returns from waiting */
+void kinesixd_statistics_wakeup(void);
+/* Only ever called from the thread dispatching events */
+void kinesixd_statistics_input_suspended(int suspended);
+
+const char *kinesixd_statistics_get_counter_name(StatisticsCounter counter);
+uint64_t kinesixd_statistics_get_counter(StatisticsCounter counter);
+uint64_t kinesixd_statistics_get_gestures_emitted(StatisticsGesture gesture, int finger_count);
+const char *kinesixd_statistics_get_histogram_name(StatisticsHistogram histogram);
+void kinesixd_statistics_get_histogram(StatisticsHistogram histogram,
+                                       struct KinesixdHistogramSnapshot *snapshot_out);
+uint64_t kinesixd_statistics_get_bucket_upper_bound(int bucket);
+
+#endif // STATISTICS_H
@@ -0,0 +1,37 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+/* Begin/end spans per thread, written out as Chrome Trace Event JSON (chrome://tracing, Perfetto)
+ *
+ * Span names must be string literals, recording only stores the pointer and a timestamp in a buffer
+ * owned by the calling thread. Nothing is formatted until a buffer fills up or the timeline is stopped */
+
+int kinesixd_timeline_start(const char *file_path);
+/* Writes out and closes the capture, safe while instrumented threads are still running. Their buffers are
+ * kept for the next kinesixd_timeline_start() */
+void kinesixd_timeline_stop(void);
+int kinesixd_timeline_is_enabled(void);
+void kinesixd_timeline_set_thread_name(const char *thread_name);
+void kinesixd_timeline_begin(const char *span_name);
+void kinesixd_timeline_end(const char *span_name);
+
+#endif // TIMELINE_H
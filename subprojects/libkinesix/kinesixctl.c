@@ -0,0 +1,804 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+/* Live view of a running kinesixd, everything comes from its public DBus interface */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <dbus/dbus.h>
+
+#include "kinesixd_global.h"
+#include "kinesixd_flight_recorder.h"
+
+#define KINESIXCTL_MAX_COUNTERS     128
+#define KINESIXCTL_MAX_HISTOGRAMS   16
+/* Matches the daemon's layout, (40 - 3 + 2) << 3, with room to spare */
+#define KINESIXCTL_MAX_BUCKETS      512
+#define KINESIXCTL_NAME_SIZE        128
+
+static const char GESTURE_DAEMON_DBUS_NAME[]        = "org.kicsyromy.kinesixd";
+static const char GESTURE_DAEMON_OBJECT_PATH[]      = "/org/kicsyromy/kinesixd";
+static const char GESTURE_DAEMON_INTERFACE_NAME[]   = "org.kicsyromy.kinesixd";
+
+static const int CALL_TIMEOUT_MS                    = 2000;
+
+struct _Counter
+{
+    char name[KINESIXCTL_NAME_SIZE];
+    uint64_t value;
+};
+
+struct _Histogram
+{
+    char name[KINESIXCTL_NAME_SIZE];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    int bucket_count;
+    /* Only populated buckets, ordered by upper bound */
+    uint64_t bucket_bounds[KINESIXCTL_MAX_BUCKETS];
+    uint64_t bucket_counts[KINESIXCTL_MAX_BUCKETS];
+};
+
+struct _Statistics
+{
+    struct timespec taken_at;
+    int counter_count;
+    struct _Counter counters[KINESIXCTL_MAX_COUNTERS];
+    int histogram_count;
+    struct _Histogram histograms[KINESIXCTL_MAX_HISTOGRAMS];
+};
+
+static DBusMessage *kinesixctl_priv_call(DBusConnection *connection, DBusMessage *message);
+static DBusMessage *kinesixctl_priv_get_property(DBusConnection *connection, const char *property);
+static int kinesixctl_priv_get_statistics(DBusConnection *connection, struct _Statistics *statistics);
+static uint64_t kinesixctl_priv_counter(const struct _Statistics *statistics, const char *name);
+static const struct _Histogram *kinesixctl_priv_histogram(const struct _Statistics *statistics,
+                                                          const char *name);
+static void kinesixctl_priv_histogram_delta(const struct _Histogram *current,
+                                            const struct _Histogram *previous,
+                                            struct _Histogram *delta_out);
+static uint64_t kinesixctl_priv_percentile(const struct _Histogram *histogram, double percentile);
+static void kinesixctl_priv_format_value(const char *histogram_name, uint64_t value, char *buffer, size_t size);
+static void kinesixctl_priv_print_device(DBusMessageIter *dbus_struct, const char *indent);
+static int kinesixctl_priv_print_devices(DBusConnection *connection, const char *property);
+static void kinesixctl_priv_print_top(const struct _Statistics *current, const struct _Statistics *previous);
+static int kinesixctl_top(DBusConnection *connection, int interval, int iterations);
+static int kinesixctl_devices(DBusConnection *connection);
+static int kinesixctl_trace(DBusConnection *connection, const char *duration);
+static void kinesixctl_priv_print_flight_record(const struct KinesixdFlightRecord *record, void *user_data);
+static int kinesixctl_flight(DBusConnection *connection);
+
+static void print_usage(const char *program_name)
+{
+    fprintf(stdout,
+            "Usage: %s [OPTION...] COMMAND\n"
+            "  --session    Talk to the instance on the session bus (default)\n"
+            "  --system     Talk to the instance on the system bus\n"
+            "  -d, --delay=SECONDS\n"
+            "               Refresh interval of top (default 1)\n"
+            "  -n, --iterations=COUNT\n"
+            "               Exit top after COUNT refreshes (default 0, never)\n"
+            "  -h, --help   Show this help\n"
+            "\n"
+            "Commands:\n"
+            "  top          Gesture rate, latency percentiles, queue depths, devices and drops\n"
+            "  devices      Dump the devices the daemon considers valid\n"
+            "  trace MILLISECONDS\n"
+            "               Record a Chrome Trace Event timeline of the daemon's threads\n"
+            "  flight [PATH]\n"
+            "               Dump the most recent gesture events and what became of them. With PATH, read a\n"
+            "               recording left behind on disk instead, such as kinesixd-flight-recorder.previous\n"
+            "               in the runtime directory after a crash\n",
+            program_name);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option options[] =
+    {
+        { "session",    no_argument,       0, 'S' },
+        { "system",     no_argument,       0, 's' },
+        { "delay",      required_argument, 0, 'd' },
+        { "iterations", required_argument, 0, 'n' },
+        { "help",       no_argument,       0, 'h' },
+        { 0,            0,                 0, 0   }
+    };
+    DBusBusType bus_type = DBUS_BUS_SESSION;
+    DBusConnection *connection = 0;
+    DBusError error;
+    const char *command = 0;
+    int interval = 1;
+    int iterations = 0;
+    int option = 0;
+    int result = EXIT_FAILURE;
+
+    while ((option = getopt_long(argc, argv, "d:n:h", options, 0)) != -1)
+    {
+        switch (option)
+        {
+        case 'S':
+            bus_type = DBUS_BUS_SESSION;
+            break;
+        case 's':
+            bus_type = DBUS_BUS_SYSTEM;
+            break;
+        case 'd':
+            interval = atoi(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((optind >= argc) || (interval <= 0) || (iterations < 0))
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    command = argv[optind];
+
+    /* Reading a recording from disk works without a daemon, which is the point after a crash */
+    if ((strcmp(command, "flight") == 0) && (optind + 1 < argc))
+    {
+        kinesixctl_priv_print_flight_record(0, 0);
+        return kinesixd_flight_recorder_read_file(argv[optind + 1], &kinesixctl_priv_print_flight_record, 0) ?
+                    EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    dbus_error_init(&error);
+    connection = dbus_bus_get(bus_type, &error);
+    if (dbus_error_is_set(&error))
+    {
+        fprintf(stderr, "Could not connect to the %s bus. %s\n",
+                (bus_type == DBUS_BUS_SYSTEM) ? "system" : "session",
+                error.message);
+        dbus_error_free(&error);
+        return EXIT_FAILURE;
+    }
+
+    if (strcmp(command, "top") == 0)
+        result = kinesixctl_top(connection, interval, iterations);
+    else if (strcmp(command, "devices") == 0)
+        result = kinesixctl_devices(connection);
+    else if ((strcmp(command, "trace") == 0) && (optind + 1 < argc))
+        result = kinesixctl_trace(connection, argv[optind + 1]);
+    else if (strcmp(command, "flight") == 0)
+        result = kinesixctl_flight(connection);
+    else
+        print_usage(argv[0]);
+
+    dbus_connection_unref(connection);
+
+    return result;
+}
+
+static DBusMessage *kinesixctl_priv_call(DBusConnection *connection, DBusMessage *message)
+{
+    DBusMessage *reply = 0;
+    DBusError error;
+
+    if (!message)
+    {
+        fprintf(stderr, "Could not create DBus message. Not enough memory\n");
+        return 0;
+    }
+
+    dbus_error_init(&error);
+    reply = dbus_connection_send_with_reply_and_block(connection, message, CALL_TIMEOUT_MS, &error);
+    if (dbus_error_is_set(&error))
+    {
+        fprintf(stderr, "%s failed. %s\n", dbus_message_get_member(message), error.message);
+        dbus_error_free(&error);
+    }
+    dbus_message_unref(message);
+
+    return reply;
+}
+
+static DBusMessage *kinesixctl_priv_get_property(DBusConnection *connection, const char *property)
+{
+    DBusMessage *message = 0;
+    const char *interface = GESTURE_DAEMON_INTERFACE_NAME;
+
+    message = dbus_message_new_method_call(GESTURE_DAEMON_DBUS_NAME,
+                                           GESTURE_DAEMON_OBJECT_PATH,
+                                           DBUS_INTERFACE_PROPERTIES,
+                                           "Get");
+    if (message && !dbus_message_append_args(message,
+                                             DBUS_TYPE_STRING, &interface,
+                                             DBUS_TYPE_STRING, &property,
+                                             DBUS_TYPE_INVALID))
+    {
+        dbus_message_unref(message);
+        message = 0;
+    }
+
+    return kinesixctl_priv_call(connection, message);
+}
+
+static int kinesixctl_priv_get_statistics(DBusConnection *connection, struct _Statistics *statistics)
+{
+    DBusMessage *reply = 0;
+    DBusMessageIter reply_args;
+    DBusMessageIter dbus_dict;
+    DBusMessageIter dbus_entry;
+    DBusMessageIter dbus_struct;
+    DBusMessageIter dbus_buckets;
+    DBusMessageIter dbus_bucket;
+    struct _Counter *counter = 0;
+    struct _Histogram *histogram = 0;
+    const char *name = 0;
+
+    reply = kinesixctl_priv_call(connection,
+                                 dbus_message_new_method_call(GESTURE_DAEMON_DBUS_NAME,
+                                                              GESTURE_DAEMON_OBJECT_PATH,
+                                                              GESTURE_DAEMON_INTERFACE_NAME,
+                                                              "GetStatistics"));
+    if (!reply)
+        return 0;
+
+    if (!dbus_message_has_signature(reply, "a{st}a{s(ttta(tt))}"))
+    {
+        fprintf(stderr, "GetStatistics replied with unexpected signature %s\n", dbus_message_get_signature(reply));
+        dbus_message_unref(reply);
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &statistics->taken_at);
+    statistics->counter_count = 0;
+    statistics->histogram_count = 0;
+
+    /* The signature was checked above, so only the counts need bounding */
+    dbus_message_iter_init(reply, &reply_args);
+    dbus_message_iter_recurse(&reply_args, &dbus_dict);
+    while ((dbus_message_iter_get_arg_type(&dbus_dict) == DBUS_TYPE_DICT_ENTRY) &&
+           (statistics->counter_count < KINESIXCTL_MAX_COUNTERS))
+    {
+        counter = &statistics->counters[statistics->counter_count++];
+        dbus_message_iter_recurse(&dbus_dict, &dbus_entry);
+        dbus_message_iter_get_basic(&dbus_entry, &name);
+        snprintf(counter->name, sizeof(counter->name), "%s", name);
+        dbus_message_iter_next(&dbus_entry);
+        dbus_message_iter_get_basic(&dbus_entry, &counter->value);
+        dbus_message_iter_next(&dbus_dict);
+    }
+
+    dbus_message_iter_next(&reply_args);
+    dbus_message_iter_recurse(&reply_args, &dbus_dict);
+    while ((dbus_message_iter_get_arg_type(&dbus_dict) == DBUS_TYPE_DICT_ENTRY) &&
+           (statistics->histogram_count < KINESIXCTL_MAX_HISTOGRAMS))
+    {
+        histogram = &statistics->histograms[statistics->histogram_count++];
+        dbus_message_iter_recurse(&dbus_dict, &dbus_entry);
+        dbus_message_iter_get_basic(&dbus_entry, &name);
+        snprintf(histogram->name, sizeof(histogram->name), "%s", name);
+        dbus_message_iter_next(&dbus_entry);
+
+        dbus_message_iter_recurse(&dbus_entry, &dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &histogram->count);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &histogram->sum);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &histogram->max);
+        dbus_message_iter_next(&dbus_struct);
+
+        histogram->bucket_count = 0;
+        dbus_message_iter_recurse(&dbus_struct, &dbus_buckets);
+        while ((dbus_message_iter_get_arg_type(&dbus_buckets) == DBUS_TYPE_STRUCT) &&
+               (histogram->bucket_count < KINESIXCTL_MAX_BUCKETS))
+        {
+            dbus_message_iter_recurse(&dbus_buckets, &dbus_bucket);
+            dbus_message_iter_get_basic(&dbus_bucket, &histogram->bucket_bounds[histogram->bucket_count]);
+            dbus_message_iter_next(&dbus_bucket);
+            dbus_message_iter_get_basic(&dbus_bucket, &histogram->bucket_counts[histogram->bucket_count]);
+            ++histogram->bucket_count;
+            dbus_message_iter_next(&dbus_buckets);
+        }
+
+        dbus_message_iter_next(&dbus_dict);
+    }
+
+    dbus_message_unref(reply);
+
+    return 1;
+}
+
+static uint64_t kinesixctl_priv_counter(const struct _Statistics *statistics, const char *name)
+{
+    int i = 0;
+
+    for (i = 0; i < statistics->counter_count; ++i)
+    {
+        if (strcmp(statistics->counters[i].name, name) == 0)
+            return statistics->counters[i].value;
+    }
+
+    /* Counters that never moved are not sent at all */
+    return 0;
+}
+
+static const struct _Histogram *kinesixctl_priv_histogram(const struct _Statistics *statistics,
+                                                          const char *name)
+{
+    int i = 0;
+
+    for (i = 0; i < statistics->histogram_count; ++i)
+    {
+        if (strcmp(statistics->histograms[i].name, name) == 0)
+            return &statistics->histograms[i];
+    }
+
+    return 0;
+}
+
+static void kinesixctl_priv_histogram_delta(const struct _Histogram *current,
+                                            const struct _Histogram *previous,
+                                            struct _Histogram *delta_out)
+{
+    uint64_t previous_count = 0;
+    int i = 0;
+    int j = 0;
+
+    *delta_out = *current;
+    if (!previous)
+        return;
+
+    /* Histograms only ever grow and both bucket lists are ordered by bound, so one merge pass does */
+    delta_out->count = current->count - previous->count;
+    delta_out->sum = current->sum - previous->sum;
+    delta_out->bucket_count = 0;
+    for (i = 0; i < current->bucket_count; ++i)
+    {
+        while ((j < previous->bucket_count) && (previous->bucket_bounds[j] < current->bucket_bounds[i]))
+            ++j;
+
+        previous_count = ((j < previous->bucket_count) && (previous->bucket_bounds[j] == current->bucket_bounds[i])) ?
+                    previous->bucket_counts[j] : 0;
+        if (current->bucket_counts[i] == previous_count)
+            continue;
+
+        delta_out->bucket_bounds[delta_out->bucket_count] = current->bucket_bounds[i];
+        delta_out->bucket_counts[delta_out->bucket_count] = current->bucket_counts[i] - previous_count;
+        ++delta_out->bucket_count;
+    }
+}
+
+static uint64_t kinesixctl_priv_percentile(const struct _Histogram *histogram, double percentile)
+{
+    uint64_t total = 0;
+    uint64_t rank = 0;
+    uint64_t seen = 0;
+    int i = 0;
+
+    for (i = 0; i < histogram->bucket_count; ++i)
+        total += histogram->bucket_counts[i];
+    if (!total)
+        return 0;
+
+    /* Reported as the upper bound of the bucket the rank falls in, never better than reality */
+    rank = (uint64_t)(percentile * (double)total + 0.999999);
+    if (rank == 0)
+        rank = 1;
+    for (i = 0; i < histogram->bucket_count; ++i)
+    {
+        seen += histogram->bucket_counts[i];
+        if (seen >= rank)
+            return histogram->bucket_bounds[i];
+    }
+
+    return histogram->bucket_bounds[histogram->bucket_count - 1];
+}
+
+static void kinesixctl_priv_format_value(const char *histogram_name, uint64_t value, char *buffer, size_t size)
+{
+    size_t name_length = strlen(histogram_name);
+
+    /* The histogram name carries the unit, latencies are far easier to read in microseconds */
+    if ((name_length > 3) && (strcmp(histogram_name + name_length - 3, "_ns") == 0))
+        snprintf(buffer, size, "%.1fus", (double)value / 1000.0);
+    else
+        snprintf(buffer, size, "%llu", (unsigned long long)value);
+}
+
+static void kinesixctl_priv_print_device(DBusMessageIter *dbus_struct, const char *indent)
+{
+    DBusMessageIter dbus_fields;
+    dbus_int32_t id = 0;
+    const char *path = "";
+    const char *name = "";
+    dbus_uint32_t product_id = 0;
+    dbus_uint32_t vendor_id = 0;
+
+    dbus_message_iter_recurse(dbus_struct, &dbus_fields);
+    dbus_message_iter_get_basic(&dbus_fields, &id);
+    dbus_message_iter_next(&dbus_fields);
+    dbus_message_iter_get_basic(&dbus_fields, &path);
+    dbus_message_iter_next(&dbus_fields);
+    dbus_message_iter_get_basic(&dbus_fields, &name);
+    dbus_message_iter_next(&dbus_fields);
+    dbus_message_iter_get_basic(&dbus_fields, &product_id);
+    dbus_message_iter_next(&dbus_fields);
+    dbus_message_iter_get_basic(&dbus_fields, &vendor_id);
+
+    /* The daemon marshals "no device" as an all empty structure */
+    if (!*path)
+        fprintf(stdout, "%s(none)\n", indent);
+    else
+        fprintf(stdout, "%s%-4d %04x:%04x  %-20s %s\n", indent, id, vendor_id, product_id, path, name);
+}
+
+static int kinesixctl_priv_print_devices(DBusConnection *connection, const char *property)
+{
+    DBusMessage *reply = 0;
+    DBusMessageIter reply_args;
+    DBusMessageIter dbus_variant;
+    DBusMessageIter dbus_array;
+
+    if (!(reply = kinesixctl_priv_get_property(connection, property)))
+        return 0;
+
+    dbus_message_iter_init(reply, &reply_args);
+    if (dbus_message_iter_get_arg_type(&reply_args) != DBUS_TYPE_VARIANT)
+    {
+        dbus_message_unref(reply);
+        return 0;
+    }
+    dbus_message_iter_recurse(&reply_args, &dbus_variant);
+
+    if (dbus_message_iter_get_arg_type(&dbus_variant) == DBUS_TYPE_STRUCT)
+    {
+        kinesixctl_priv_print_device(&dbus_variant, "  ");
+    }
+    else if (dbus_message_iter_get_arg_type(&dbus_variant) == DBUS_TYPE_ARRAY)
+    {
+        dbus_message_iter_recurse(&dbus_variant, &dbus_array);
+        if (dbus_message_iter_get_arg_type(&dbus_array) != DBUS_TYPE_STRUCT)
+            fprintf(stdout, "  (none)\n");
+        for (; dbus_message_iter_get_arg_type(&dbus_array) == DBUS_TYPE_STRUCT; dbus_message_iter_next(&dbus_array))
+            kinesixctl_priv_print_device(&dbus_array, "  ");
+    }
+
+    dbus_message_unref(reply);
+
+    return 1;
+}
+
+static void kinesixctl_priv_print_top(const struct _Statistics *current, const struct _Statistics *previous)
+{
+    /* Counters that are lost work of some kind, shown as totals and per interval */
+    static const char *drop_counters[] =
+    {
+        "gestures_cancelled", "signals_coalesced", "signals_rejected", "log_records_dropped",
+        "gestures_merge_dropped", "method_calls_rejected", "gesture_batches_dropped"
+    };
+    struct _Histogram delta;
+    const struct _Histogram *histogram = 0;
+    const struct _Counter *counter = 0;
+    char p50[32];
+    char p90[32];
+    char p99[32];
+    char max[32];
+    double elapsed = 1.0;
+    uint64_t emitted = 0;
+    uint64_t emitted_before = 0;
+    uint64_t value = 0;
+    uint64_t value_before = 0;
+    int i = 0;
+
+    if (previous)
+    {
+        elapsed = (double)(current->taken_at.tv_sec - previous->taken_at.tv_sec) +
+                  (double)(current->taken_at.tv_nsec - previous->taken_at.tv_nsec) / 1e9;
+        if (elapsed <= 0.0)
+            elapsed = 1.0;
+    }
+
+    /* Clearing only makes sense on a terminal, piped output stays a plain log */
+    if (isatty(STDOUT_FILENO))
+        fputs("\033[H\033[2J", stdout);
+
+    fprintf(stdout, "Gestures\n");
+    for (i = 0; i < current->counter_count; ++i)
+    {
+        counter = &current->counters[i];
+        if (!strstr(counter->name, "_emitted_fingers_"))
+            continue;
+
+        value_before = previous ? kinesixctl_priv_counter(previous, counter->name) : counter->value;
+        emitted += counter->value;
+        emitted_before += value_before;
+        fprintf(stdout, "  %-28s %10llu  %8.2f/s\n",
+                counter->name,
+                (unsigned long long)counter->value,
+                (double)(counter->value - value_before) / elapsed);
+    }
+    fprintf(stdout, "  %-28s %10llu  %8.2f/s\n\n",
+            "total",
+            (unsigned long long)emitted,
+            (double)(emitted - emitted_before) / elapsed);
+
+    /* Percentiles cover the last interval only, max is since the daemon started */
+    fprintf(stdout, "%-28s %8s %12s %12s %12s %12s\n", "Stage", "samples", "p50", "p90", "p99", "max");
+    for (i = 0; i < current->histogram_count; ++i)
+    {
+        histogram = &current->histograms[i];
+        kinesixctl_priv_histogram_delta(histogram,
+                                        previous ? kinesixctl_priv_histogram(previous, histogram->name) : 0,
+                                        &delta);
+
+        kinesixctl_priv_format_value(histogram->name, histogram->max, max, sizeof(max));
+        if (!delta.count)
+        {
+            fprintf(stdout, "  %-26s %8s %12s %12s %12s %12s\n", histogram->name, "0", "-", "-", "-", max);
+            continue;
+        }
+
+        kinesixctl_priv_format_value(histogram->name, kinesixctl_priv_percentile(&delta, 0.50), p50, sizeof(p50));
+        kinesixctl_priv_format_value(histogram->name, kinesixctl_priv_percentile(&delta, 0.90), p90, sizeof(p90));
+        kinesixctl_priv_format_value(histogram->name, kinesixctl_priv_percentile(&delta, 0.99), p99, sizeof(p99));
+        fprintf(stdout, "  %-26s %8llu %12s %12s %12s %12s\n",
+                histogram->name, (unsigned long long)delta.count, p50, p90, p99, max);
+    }
+
+    fprintf(stdout, "\nDrops\n");
+    for (i = 0; i < (int)(sizeof(drop_counters) / sizeof(drop_counters[0])); ++i)
+    {
+        value = kinesixctl_priv_counter(current, drop_counters[i]);
+        value_before = previous ? kinesixctl_priv_counter(previous, drop_counters[i]) : value;
+        fprintf(stdout, "  %-28s %10llu  %+8lld\n",
+                drop_counters[i],
+                (unsigned long long)value,
+                (long long)(value - value_before));
+    }
+    /* Per subscriber counters arrive as name[bus name] */
+    for (i = 0; i < current->counter_count; ++i)
+    {
+        counter = &current->counters[i];
+        if (!strchr(counter->name, '['))
+            continue;
+
+        value_before = previous ? kinesixctl_priv_counter(previous, counter->name) : counter->value;
+        fprintf(stdout, "  %-28s %10llu  %+8lld\n",
+                counter->name,
+                (unsigned long long)counter->value,
+                (long long)(counter->value - value_before));
+    }
+}
+
+static int kinesixctl_top(DBusConnection *connection, int interval, int iterations)
+{
+    struct _Statistics *statistics[2] = { 0, 0 };
+    struct _Statistics *current = 0;
+    struct _Statistics *previous = 0;
+    int iteration = 0;
+    int result = EXIT_FAILURE;
+
+    /* Too big for the stack with all the buckets */
+    statistics[0] = (struct _Statistics *)malloc(sizeof(struct _Statistics));
+    statistics[1] = (struct _Statistics *)malloc(sizeof(struct _Statistics));
+    if (!statistics[0] || !statistics[1])
+        goto out;
+
+    for (iteration = 0; (iterations == 0) || (iteration < iterations); ++iteration)
+    {
+        current = statistics[iteration % 2];
+        if (!kinesixctl_priv_get_statistics(connection, current))
+            goto out;
+
+        kinesixctl_priv_print_top(current, previous);
+        fprintf(stdout, "\nActive device\n");
+        kinesixctl_priv_print_devices(connection, "ActiveDevice");
+        fflush(stdout);
+
+        previous = current;
+        if ((iterations == 0) || (iteration + 1 < iterations))
+            sleep((unsigned int)interval);
+    }
+    result = EXIT_SUCCESS;
+
+out:
+    free(statistics[0]);
+    free(statistics[1]);
+
+    return result;
+}
+
+static int kinesixctl_devices(DBusConnection *connection)
+{
+    DBusMessage *reply = 0;
+    DBusMessageIter reply_args;
+    DBusMessageIter dbus_array;
+
+    reply = kinesixctl_priv_call(connection,
+                                 dbus_message_new_method_call(GESTURE_DAEMON_DBUS_NAME,
+                                                              GESTURE_DAEMON_OBJECT_PATH,
+                                                              GESTURE_DAEMON_INTERFACE_NAME,
+                                                              "GetValidDeviceList"));
+    if (!reply)
+        return EXIT_FAILURE;
+
+    if (!dbus_message_has_signature(reply, "a(issuu)"))
+    {
+        fprintf(stderr, "GetValidDeviceList replied with unexpected signature %s\n",
+                dbus_message_get_signature(reply));
+        dbus_message_unref(reply);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stdout, "  %-4s %-9s  %-20s %s\n", "ID", "VID:PID", "PATH", "NAME");
+    dbus_message_iter_init(reply, &reply_args);
+    dbus_message_iter_recurse(&reply_args, &dbus_array);
+    for (; dbus_message_iter_get_arg_type(&dbus_array) == DBUS_TYPE_STRUCT; dbus_message_iter_next(&dbus_array))
+        kinesixctl_priv_print_device(&dbus_array, "  ");
+
+    dbus_message_unref(reply);
+
+    fprintf(stdout, "\nActive device\n");
+    kinesixctl_priv_print_devices(connection, "ActiveDevice");
+
+    return EXIT_SUCCESS;
+}
+
+static int kinesixctl_trace(DBusConnection *connection, const char *duration)
+{
+    DBusMessage *message = 0;
+    DBusMessage *reply = 0;
+    DBusError error;
+    dbus_uint32_t duration_ms = (dbus_uint32_t)strtoul(duration, 0, 10);
+    const char *path = 0;
+
+    message = dbus_message_new_method_call(GESTURE_DAEMON_DBUS_NAME,
+                                           GESTURE_DAEMON_OBJECT_PATH,
+                                           GESTURE_DAEMON_INTERFACE_NAME,
+                                           "CaptureTrace");
+    if (message && !dbus_message_append_args(message, DBUS_TYPE_UINT32, &duration_ms, DBUS_TYPE_INVALID))
+    {
+        dbus_message_unref(message);
+        message = 0;
+    }
+
+    if (!(reply = kinesixctl_priv_call(connection, message)))
+        return EXIT_FAILURE;
+
+    dbus_error_init(&error);
+    if (!dbus_message_get_args(reply, &error, DBUS_TYPE_STRING, &path, DBUS_TYPE_INVALID))
+    {
+        fprintf(stderr, "CaptureTrace replied with unexpected arguments. %s\n", error.message);
+        dbus_error_free(&error);
+        dbus_message_unref(reply);
+        return EXIT_FAILURE;
+    }
+
+    /* The daemon picks the path and writes it out itself once the duration is over */
+    fprintf(stdout, "Recording %u ms to %s\n", duration_ms, path);
+    dbus_message_unref(reply);
+
+    return EXIT_SUCCESS;
+}
+
+static void kinesixctl_priv_print_flight_record(const struct KinesixdFlightRecord *record, void *user_data)
+{
+    char description[160];
+
+    UNUSED(user_data)
+
+    /* Called without a record for the heading */
+    if (!record)
+    {
+        fprintf(stdout, "%10s %18s  %-9s %s\n", "SEQUENCE", "TIME", "KIND", "DETAILS");
+        return;
+    }
+
+    kinesixd_flight_recorder_describe(record, description, sizeof(description));
+    fprintf(stdout, "%10llu %11llu.%06llu  %-9s %s\n",
+            (unsigned long long)record->sequence,
+            (unsigned long long)(record->time_usec / 1000000),
+            (unsigned long long)(record->time_usec % 1000000),
+            kinesixd_flight_recorder_get_kind_name(record->kind),
+            description);
+}
+
+static int kinesixctl_flight(DBusConnection *connection)
+{
+    DBusMessage *reply = 0;
+    DBusMessageIter reply_args;
+    DBusMessageIter dbus_array;
+    DBusMessageIter dbus_struct;
+    struct KinesixdFlightRecord record;
+    dbus_uint64_t sequence = 0;
+    dbus_uint64_t time_usec = 0;
+    dbus_uint32_t kind = 0;
+    dbus_int32_t type = 0;
+    dbus_int32_t finger_count = 0;
+    dbus_int32_t result = 0;
+    dbus_uint32_t flags = 0;
+    double x = 0;
+    double y = 0;
+
+    reply = kinesixctl_priv_call(connection,
+                                 dbus_message_new_method_call(GESTURE_DAEMON_DBUS_NAME,
+                                                              GESTURE_DAEMON_OBJECT_PATH,
+                                                              GESTURE_DAEMON_INTERFACE_NAME,
+                                                              "GetFlightRecord"));
+    if (!reply)
+        return EXIT_FAILURE;
+
+    if (!dbus_message_has_signature(reply, "a(ttuiiiudd)"))
+    {
+        fprintf(stderr, "GetFlightRecord replied with unexpected signature %s\n", dbus_message_get_signature(reply));
+        dbus_message_unref(reply);
+        return EXIT_FAILURE;
+    }
+
+    kinesixctl_priv_print_flight_record(0, 0);
+    dbus_message_iter_init(reply, &reply_args);
+    dbus_message_iter_recurse(&reply_args, &dbus_array);
+    for (; dbus_message_iter_get_arg_type(&dbus_array) == DBUS_TYPE_STRUCT; dbus_message_iter_next(&dbus_array))
+    {
+        dbus_message_iter_recurse(&dbus_array, &dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &sequence);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &time_usec);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &kind);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &type);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &finger_count);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &result);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &flags);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &x);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &y);
+
+        memset(&record, 0, sizeof(record));
+        record.sequence = sequence;
+        record.time_usec = time_usec;
+        record.kind = (uint16_t)kind;
+        record.type = (int16_t)type;
+        record.finger_count = (int16_t)finger_count;
+        record.result = (int16_t)result;
+        record.flags = flags;
+        record.x = (float)x;
+        record.y = (float)y;
+        kinesixctl_priv_print_flight_record(&record, 0);
+    }
+
+    dbus_message_unref(reply);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,622 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_client.h"
+#include "kinesixd_device_marshaler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char GESTURE_DAEMON_DBUS_NAME[]        = "org.kicsyromy.kinesixd";
+static const char GESTURE_DAEMON_OBJECT_PATH[]      = "/org/kicsyromy/kinesixd";
+static const char GESTURE_DAEMON_INTERFACE_NAME[]   = "org.kicsyromy.kinesixd";
+
+/* One rule covers gestures and PropertiesChanged, following the daemon across restarts */
+static const char CLIENT_MATCH_RULE[] =
+        "type='signal',sender='org.kicsyromy.kinesixd',path='/org/kicsyromy/kinesixd'";
+
+/* Samples handed to batch_cb per call, larger batches are split */
+#define CLIENT_BATCH_CHUNK 64
+
+struct _ClientCall
+{
+    struct _ClientCall *next;
+    KinesixdClient client;
+    DBusPendingCall *pending;
+    ClientResultCallback callback;
+    void *user_data;
+};
+
+struct _KinesixdClient
+{
+    DBusConnection *connection;
+    struct KinesixdClientCallbacks callbacks;
+    void *user_data;
+    int ready;
+
+    KinesixdDevice *devices;
+    KinesixdDevice active_device;
+    double gesture_delta;
+
+    /* Outstanding calls, cancelled on free so no reply can reach a dead client */
+    struct _ClientCall *calls;
+};
+
+static void kinesixd_client_priv_add_match(KinesixdClient self, const char *method);
+static DBusMessage *kinesixd_client_priv_new_method_call(const char *interface, const char *method);
+static void kinesixd_client_priv_call(KinesixdClient self,
+                                      DBusMessage *message,
+                                      DBusPendingCallNotifyFunction notify,
+                                      ClientResultCallback callback,
+                                      void *user_data);
+static void kinesixd_client_priv_call_free(void *client_call);
+static DBusMessage *kinesixd_client_priv_take_reply(struct _ClientCall *call);
+static void kinesixd_client_priv_result_received(DBusPendingCall *pending, void *client_call);
+static void kinesixd_client_priv_properties_received(DBusPendingCall *pending, void *client_call);
+static void kinesixd_client_priv_read_devices(KinesixdClient self, DBusMessageIter *dbus_iter);
+static void kinesixd_client_priv_read_active_device(KinesixdClient self, DBusMessageIter *dbus_iter);
+static void kinesixd_client_priv_read_thresholds(KinesixdClient self, DBusMessageIter *dbus_iter);
+static void kinesixd_client_priv_read_properties(KinesixdClient self, DBusMessageIter *dbus_iter);
+static void kinesixd_client_priv_read_batch(KinesixdClient self, DBusMessageIter *dbus_iter);
+static DBusHandlerResult kinesixd_client_priv_filter(DBusConnection *connection,
+                                                     DBusMessage *message,
+                                                     void *kinesixd_client);
+
+KinesixdClient kinesixd_client_new(DBusConnection *connection,
+                                   unsigned int gesture_mask,
+                                   const struct KinesixdClientCallbacks *callbacks,
+                                   void *user_data)
+{
+    KinesixdClient self = (KinesixdClient)calloc(1, sizeof(struct _KinesixdClient));
+    DBusMessage *message = 0;
+    const char *interface = GESTURE_DAEMON_INTERFACE_NAME;
+
+    self->connection = dbus_connection_ref(connection);
+    if (callbacks)
+        self->callbacks = *callbacks;
+    self->user_data = user_data;
+
+    if (!dbus_connection_add_filter(connection, &kinesixd_client_priv_filter, self, 0))
+        LOG_ERROR("Could not install DBus filter. Not enough memory");
+
+    /* None of these wait for each other, startup costs a single round trip */
+    kinesixd_client_priv_add_match(self, "AddMatch");
+
+    if (gesture_mask)
+        kinesixd_client_subscribe(self, gesture_mask, 0, 0);
+
+    message = kinesixd_client_priv_new_method_call(DBUS_INTERFACE_PROPERTIES, "GetAll");
+    if (message && dbus_message_append_args(message, DBUS_TYPE_STRING, &interface, DBUS_TYPE_INVALID))
+        kinesixd_client_priv_call(self, message, &kinesixd_client_priv_properties_received, 0, 0);
+    if (message)
+        dbus_message_unref(message);
+
+    dbus_connection_flush(connection);
+
+    return self;
+}
+
+void kinesixd_client_free(KinesixdClient self)
+{
+    struct _ClientCall *call = 0;
+
+    while ((call = self->calls))
+    {
+        self->calls = call->next;
+        dbus_pending_call_cancel(call->pending);
+        dbus_pending_call_unref(call->pending);
+    }
+
+    dbus_connection_remove_filter(self->connection, &kinesixd_client_priv_filter, self);
+    kinesixd_client_priv_add_match(self, "RemoveMatch");
+    dbus_connection_flush(self->connection);
+    dbus_connection_unref(self->connection);
+
+    if (self->devices)
+        kinesixd_device_list_free(self->devices);
+    if (self->active_device)
+        kinesixd_device_free(self->active_device);
+
+    free(self);
+}
+
+int kinesixd_client_is_ready(const KinesixdClient self)
+{
+    return self->ready;
+}
+
+KinesixdDevice *kinesixd_client_get_devices(const KinesixdClient self, int *length)
+{
+    *length = self->devices ? kinesixd_device_list_get_length(self->devices) : 0;
+
+    return self->devices;
+}
+
+KinesixdDevice kinesixd_client_get_active_device(const KinesixdClient self)
+{
+    return self->active_device;
+}
+
+double kinesixd_client_get_gesture_delta(const KinesixdClient self)
+{
+    return self->gesture_delta;
+}
+
+void kinesixd_client_set_active_device(KinesixdClient self, KinesixdDevice device)
+{
+    DBusMessage *message = 0;
+    DBusMessageIter message_args;
+
+    /* The daemon replies once the device was opened, or with an error when it could not be. Nobody
+     * here waits for that, the ActiveDevice property reports the switch */
+    message = kinesixd_client_priv_new_method_call(GESTURE_DAEMON_INTERFACE_NAME, "SetActiveDevice");
+    if (!message)
+        return;
+
+    dbus_message_set_no_reply(message, TRUE);
+    dbus_message_iter_init_append(message, &message_args);
+    if (kinesixd_device_marshaler_append_device(device, &message_args) ||
+        !dbus_connection_send(self->connection, message, 0))
+    {
+        LOG_ERROR("Failed to call %s.SetActiveDevice. Probably out of memory.", GESTURE_DAEMON_INTERFACE_NAME);
+    }
+    else
+    {
+        dbus_connection_flush(self->connection);
+    }
+
+    dbus_message_unref(message);
+}
+
+void kinesixd_client_subscribe(KinesixdClient self,
+                               unsigned int gesture_mask,
+                               ClientResultCallback callback,
+                               void *user_data)
+{
+    DBusMessage *message = kinesixd_client_priv_new_method_call(GESTURE_DAEMON_INTERFACE_NAME, "Subscribe");
+    dbus_uint32_t mask = gesture_mask;
+
+    if (message && dbus_message_append_args(message, DBUS_TYPE_UINT32, &mask, DBUS_TYPE_INVALID))
+        kinesixd_client_priv_call(self, message, &kinesixd_client_priv_result_received, callback, user_data);
+    if (message)
+        dbus_message_unref(message);
+}
+
+void kinesixd_client_unsubscribe(KinesixdClient self,
+                                 ClientResultCallback callback,
+                                 void *user_data)
+{
+    DBusMessage *message = kinesixd_client_priv_new_method_call(GESTURE_DAEMON_INTERFACE_NAME, "Unsubscribe");
+
+    if (message)
+    {
+        kinesixd_client_priv_call(self, message, &kinesixd_client_priv_result_received, callback, user_data);
+        dbus_message_unref(message);
+    }
+}
+
+void kinesixd_client_set_log_level(KinesixdClient self,
+                                   const char *level,
+                                   ClientResultCallback callback,
+                                   void *user_data)
+{
+    DBusMessage *message = kinesixd_client_priv_new_method_call(GESTURE_DAEMON_INTERFACE_NAME, "SetLogLevel");
+
+    if (message && dbus_message_append_args(message, DBUS_TYPE_STRING, &level, DBUS_TYPE_INVALID))
+        kinesixd_client_priv_call(self, message, &kinesixd_client_priv_result_received, callback, user_data);
+    if (message)
+        dbus_message_unref(message);
+}
+
+static void kinesixd_client_priv_add_match(KinesixdClient self, const char *method)
+{
+    DBusMessage *message = 0;
+    const char *rule = CLIENT_MATCH_RULE;
+
+    /* dbus_bus_add_match blocks on the reply, which would be a round trip of its own */
+    message = dbus_message_new_method_call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS, method);
+    if (!message)
+        return;
+
+    dbus_message_set_no_reply(message, TRUE);
+    if (!dbus_message_append_args(message, DBUS_TYPE_STRING, &rule, DBUS_TYPE_INVALID) ||
+        !dbus_connection_send(self->connection, message, 0))
+    {
+        LOG_ERROR("Failed to call %s.%s. Probably out of memory.", DBUS_INTERFACE_DBUS, method);
+    }
+
+    dbus_message_unref(message);
+}
+
+static DBusMessage *kinesixd_client_priv_new_method_call(const char *interface, const char *method)
+{
+    DBusMessage *message = dbus_message_new_method_call(GESTURE_DAEMON_DBUS_NAME,
+                                                        GESTURE_DAEMON_OBJECT_PATH,
+                                                        interface,
+                                                        method);
+    if (!message)
+        LOG_ERROR("Could not create DBus message for %s.%s. Not enough memory", interface, method);
+
+    return message;
+}
+
+static void kinesixd_client_priv_call(KinesixdClient self,
+                                      DBusMessage *message,
+                                      DBusPendingCallNotifyFunction notify,
+                                      ClientResultCallback callback,
+                                      void *user_data)
+{
+    struct _ClientCall *call = 0;
+    DBusPendingCall *pending = 0;
+
+    if (!dbus_connection_send_with_reply(self->connection, message, &pending, DBUS_TIMEOUT_USE_DEFAULT) || !pending)
+    {
+        LOG_ERROR("Failed to call %s.%s. Probably out of memory.",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message));
+        if (callback)
+            callback(self, DBUS_ERROR_NO_MEMORY, user_data);
+        return;
+    }
+
+    call = (struct _ClientCall *)malloc(sizeof(struct _ClientCall));
+    call->client = self;
+    call->pending = pending;
+    call->callback = callback;
+    call->user_data = user_data;
+    call->next = self->calls;
+    self->calls = call;
+
+    dbus_pending_call_set_notify(pending, notify, call, &kinesixd_client_priv_call_free);
+    dbus_connection_flush(self->connection);
+}
+
+static void kinesixd_client_priv_call_free(void *client_call)
+{
+    free(client_call);
+}
+
+/* Unlinks the call from its client and hands over the reply */
+static DBusMessage *kinesixd_client_priv_take_reply(struct _ClientCall *call)
+{
+    struct _ClientCall **link = &call->client->calls;
+    DBusMessage *reply = dbus_pending_call_steal_reply(call->pending);
+
+    while (*link && (*link != call))
+        link = &(*link)->next;
+    if (*link)
+        *link = call->next;
+
+    dbus_pending_call_unref(call->pending);
+
+    return reply;
+}
+
+static void kinesixd_client_priv_result_received(DBusPendingCall *pending, void *client_call)
+{
+    struct _ClientCall *call = (struct _ClientCall *)client_call;
+    DBusMessage *reply = 0;
+    const char *error = 0;
+
+    UNUSED(pending)
+
+    reply = kinesixd_client_priv_take_reply(call);
+    if (!reply)
+        error = DBUS_ERROR_NO_REPLY;
+    else if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
+        error = dbus_message_get_error_name(reply);
+
+    if (error && !call->callback)
+        LOG_WARN("Call to %s failed. %s", GESTURE_DAEMON_DBUS_NAME, error);
+    if (call->callback)
+        call->callback(call->client, error, call->user_data);
+
+    if (reply)
+        dbus_message_unref(reply);
+}
+
+static void kinesixd_client_priv_properties_received(DBusPendingCall *pending, void *client_call)
+{
+    struct _ClientCall *call = (struct _ClientCall *)client_call;
+    KinesixdClient self = call->client;
+    DBusMessage *reply = 0;
+    DBusMessageIter reply_args;
+
+    UNUSED(pending)
+
+    reply = kinesixd_client_priv_take_reply(call);
+    if (!reply || (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR))
+    {
+        LOG_WARN("Could not fetch the state of %s. %s",
+                 GESTURE_DAEMON_DBUS_NAME,
+                 reply ? dbus_message_get_error_name(reply) : DBUS_ERROR_NO_REPLY);
+    }
+    else if (dbus_message_iter_init(reply, &reply_args))
+    {
+        kinesixd_client_priv_read_properties(self, &reply_args);
+    }
+
+    if (reply)
+        dbus_message_unref(reply);
+
+    self->ready = 1;
+    if (self->callbacks.ready_cb)
+        self->callbacks.ready_cb(self, self->user_data);
+}
+
+static void kinesixd_client_priv_read_devices(KinesixdClient self, DBusMessageIter *dbus_iter)
+{
+    DBusMessageIter dbus_array;
+    KinesixdDevice *devices = 0;
+    KinesixdDevice device = 0;
+    int device_count = 0;
+    int capacity = 0;
+
+    if (dbus_message_iter_get_arg_type(dbus_iter) != DBUS_TYPE_ARRAY)
+        return;
+
+    dbus_message_iter_recurse(dbus_iter, &dbus_array);
+    while (dbus_message_iter_get_arg_type(&dbus_array) == DBUS_TYPE_STRUCT)
+    {
+        if ((device = kinesixd_device_marshaler_device_from_dbus_argument(&dbus_array)))
+        {
+            if (device_count + 1 >= capacity)
+            {
+                capacity = capacity ? capacity * 2 : 8;
+                devices = (KinesixdDevice *)realloc(devices, capacity * sizeof(KinesixdDevice));
+            }
+            devices[device_count++] = device;
+        }
+        dbus_message_iter_next(&dbus_array);
+    }
+
+    if (!devices)
+        devices = (KinesixdDevice *)malloc(sizeof(KinesixdDevice));
+    devices[device_count] = 0;
+
+    if (self->devices)
+        kinesixd_device_list_free(self->devices);
+    self->devices = devices;
+}
+
+static void kinesixd_client_priv_read_active_device(KinesixdClient self, DBusMessageIter *dbus_iter)
+{
+    KinesixdDevice device = kinesixd_device_marshaler_device_from_dbus_argument(dbus_iter);
+
+    /* No active device is marshaled as an all empty structure */
+    if (device && (*kinesixd_device_get_path(device) == '\0'))
+    {
+        kinesixd_device_free(device);
+        device = 0;
+    }
+
+    if (self->active_device)
+        kinesixd_device_free(self->active_device);
+    self->active_device = device;
+}
+
+static void kinesixd_client_priv_read_thresholds(KinesixdClient self, DBusMessageIter *dbus_iter)
+{
+    DBusMessageIter dbus_dict;
+    DBusMessageIter dbus_entry;
+    const char *key = 0;
+
+    if (dbus_message_iter_get_arg_type(dbus_iter) != DBUS_TYPE_ARRAY)
+        return;
+
+    dbus_message_iter_recurse(dbus_iter, &dbus_dict);
+    while (dbus_message_iter_get_arg_type(&dbus_dict) == DBUS_TYPE_DICT_ENTRY)
+    {
+        dbus_message_iter_recurse(&dbus_dict, &dbus_entry);
+        dbus_message_iter_get_basic(&dbus_entry, &key);
+        if (dbus_message_iter_next(&dbus_entry) &&
+            (dbus_message_iter_get_arg_type(&dbus_entry) == DBUS_TYPE_DOUBLE) &&
+            (strcmp(key, "gesture_delta") == 0))
+        {
+            dbus_message_iter_get_basic(&dbus_entry, &self->gesture_delta);
+        }
+        dbus_message_iter_next(&dbus_dict);
+    }
+}
+
+/* Expects the signature to have been checked to be a(iiidddt) */
+static void kinesixd_client_priv_read_batch(KinesixdClient self, DBusMessageIter *dbus_iter)
+{
+    struct KinesixdGestureSample samples[CLIENT_BATCH_CHUNK];
+    DBusMessageIter dbus_array;
+    DBusMessageIter dbus_struct;
+    struct KinesixdGestureSample *sample = 0;
+    dbus_int32_t value = 0;
+    dbus_uint64_t time_usec = 0;
+    int sample_count = 0;
+
+    dbus_message_iter_recurse(dbus_iter, &dbus_array);
+    while (dbus_message_iter_get_arg_type(&dbus_array) == DBUS_TYPE_STRUCT)
+    {
+        sample = &samples[sample_count++];
+        dbus_message_iter_recurse(&dbus_array, &dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &value);
+        sample->type = value;
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &value);
+        sample->phase = value;
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &value);
+        sample->finger_count = value;
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &sample->dx);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &sample->dy);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &sample->scale);
+        dbus_message_iter_next(&dbus_struct);
+        dbus_message_iter_get_basic(&dbus_struct, &time_usec);
+        sample->time_usec = time_usec;
+
+        if (sample_count == CLIENT_BATCH_CHUNK)
+        {
+            self->callbacks.batch_cb(self, samples, sample_count, self->user_data);
+            sample_count = 0;
+        }
+        dbus_message_iter_next(&dbus_array);
+    }
+
+    if (sample_count)
+        self->callbacks.batch_cb(self, samples, sample_count, self->user_data);
+}
+
+/* Reads an a{sv} of our interface's properties, both GetAll and PropertiesChanged carry one */
+static void kinesixd_client_priv_read_properties(KinesixdClient self, DBusMessageIter *dbus_iter)
+{
+    DBusMessageIter dbus_dict;
+    DBusMessageIter dbus_entry;
+    DBusMessageIter dbus_variant;
+    const char *name = 0;
+    int devices_changed = 0;
+    int active_device_changed = 0;
+
+    if (dbus_message_iter_get_arg_type(dbus_iter) != DBUS_TYPE_ARRAY)
+        return;
+
+    dbus_message_iter_recurse(dbus_iter, &dbus_dict);
+    while (dbus_message_iter_get_arg_type(&dbus_dict) == DBUS_TYPE_DICT_ENTRY)
+    {
+        dbus_message_iter_recurse(&dbus_dict, &dbus_entry);
+        dbus_message_iter_get_basic(&dbus_entry, &name);
+        if (dbus_message_iter_next(&dbus_entry) &&
+            (dbus_message_iter_get_arg_type(&dbus_entry) == DBUS_TYPE_VARIANT))
+        {
+            dbus_message_iter_recurse(&dbus_entry, &dbus_variant);
+            if (strcmp(name, "Devices") == 0)
+            {
+                kinesixd_client_priv_read_devices(self, &dbus_variant);
+                devices_changed = 1;
+            }
+            else if (strcmp(name, "ActiveDevice") == 0)
+            {
+                kinesixd_client_priv_read_active_device(self, &dbus_variant);
+                active_device_changed = 1;
+            }
+            else if (strcmp(name, "Thresholds") == 0)
+            {
+                kinesixd_client_priv_read_thresholds(self, &dbus_variant);
+            }
+        }
+        dbus_message_iter_next(&dbus_dict);
+    }
+
+    /* Before the initial state arrived there is nothing to compare against, ready_cb covers it */
+    if (!self->ready)
+        return;
+
+    if (devices_changed && self->callbacks.devices_changed_cb)
+        self->callbacks.devices_changed_cb(self, self->user_data);
+    if (active_device_changed && self->callbacks.active_device_changed_cb)
+        self->callbacks.active_device_changed_cb(self, self->user_data);
+}
+
+static DBusHandlerResult kinesixd_client_priv_filter(DBusConnection *connection,
+                                                     DBusMessage *message,
+                                                     void *kinesixd_client)
+{
+    KinesixdClient self = (KinesixdClient)kinesixd_client;
+    DBusMessageIter message_args;
+    const char *interface = 0;
+    dbus_int32_t value = 0;
+    dbus_int32_t finger_count = 0;
+    dbus_uint64_t duration_usec = 0;
+    struct KinesixdFling fling;
+    const char *name = 0;
+
+    UNUSED(connection)
+
+    /* Other users of the connection may want these as well, so never claim them */
+    if ((dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_SIGNAL) ||
+        !dbus_message_has_path(message, GESTURE_DAEMON_OBJECT_PATH))
+    {
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    if (dbus_message_is_signal(message, GESTURE_DAEMON_INTERFACE_NAME, "Swiped") ||
+        dbus_message_is_signal(message, GESTURE_DAEMON_INTERFACE_NAME, "Pinch"))
+    {
+        if (!dbus_message_get_args(message, 0,
+                                   DBUS_TYPE_INT32, &value,
+                                   DBUS_TYPE_INT32, &finger_count,
+                                   DBUS_TYPE_INVALID))
+        {
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+        }
+
+        if (dbus_message_has_member(message, "Swiped"))
+        {
+            if (self->callbacks.swiped_cb)
+                self->callbacks.swiped_cb(self, value, finger_count, self->user_data);
+        }
+        else if (self->callbacks.pinch_cb)
+        {
+            self->callbacks.pinch_cb(self, value, finger_count, self->user_data);
+        }
+    }
+    else if (dbus_message_is_signal(message, GESTURE_DAEMON_INTERFACE_NAME, "SwipeKinetics"))
+    {
+        if (!self->callbacks.fling_cb ||
+            !dbus_message_get_args(message, 0,
+                                   DBUS_TYPE_INT32, &value,
+                                   DBUS_TYPE_INT32, &finger_count,
+                                   DBUS_TYPE_DOUBLE, &fling.velocity_x,
+                                   DBUS_TYPE_DOUBLE, &fling.velocity_y,
+                                   DBUS_TYPE_DOUBLE, &fling.displacement_x,
+                                   DBUS_TYPE_DOUBLE, &fling.displacement_y,
+                                   DBUS_TYPE_UINT64, &duration_usec,
+                                   DBUS_TYPE_INVALID))
+        {
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+        }
+
+        fling.duration_usec = duration_usec;
+        self->callbacks.fling_cb(self, value, finger_count, &fling, self->user_data);
+    }
+    else if (dbus_message_is_signal(message, GESTURE_DAEMON_INTERFACE_NAME, "GestureBatch"))
+    {
+        if (self->callbacks.batch_cb && dbus_message_has_signature(message, "a(iiidddt)") &&
+            dbus_message_iter_init(message, &message_args))
+        {
+            kinesixd_client_priv_read_batch(self, &message_args);
+        }
+    }
+    else if (dbus_message_is_signal(message, GESTURE_DAEMON_INTERFACE_NAME, "SequenceRecognized"))
+    {
+        if (self->callbacks.sequence_cb &&
+            dbus_message_get_args(message, 0, DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID))
+        {
+            self->callbacks.sequence_cb(self, name, self->user_data);
+        }
+    }
+    else if (dbus_message_is_signal(message, DBUS_INTERFACE_PROPERTIES, "PropertiesChanged") &&
+             dbus_message_iter_init(message, &message_args) &&
+             (dbus_message_iter_get_arg_type(&message_args) == DBUS_TYPE_STRING))
+    {
+        dbus_message_iter_get_basic(&message_args, &interface);
+        if ((strcmp(interface, GESTURE_DAEMON_INTERFACE_NAME) == 0) && dbus_message_iter_next(&message_args))
+            kinesixd_client_priv_read_properties(self, &message_args);
+    }
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_config.h"
+#include "kinesixd_global.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+static const double GESTURE_DELTA_DEFAULT = 10;
+static const int    BATCH_WINDOW_MS_DEFAULT = 8;
+static const char   DEVICES_PATH_DEFAULT[] = "/dev/input/";
+
+static char *kinesixd_config_priv_strip(char *text);
+static int kinesixd_config_priv_parse_gestures(char *value, unsigned int *gestures_out);
+static int kinesixd_config_priv_set(struct KinesixdConfig *config, const char *key, char *value);
+
+void kinesixd_config_init(struct KinesixdConfig *config)
+{
+    config->gesture_delta = GESTURE_DELTA_DEFAULT;
+    config->enabled_gestures = CONFIG_GESTURE_ALL;
+    config->bus = CONFIG_BUS_SESSION;
+    config->backend = CONFIG_BACKEND_LIBINPUT;
+    config->suspend_when_idle = 0;
+    config->input_workers = 0;
+    config->batch_window_ms = BATCH_WINDOW_MS_DEFAULT;
+    strcpy(config->devices_path, DEVICES_PATH_DEFAULT);
+    config->sequence_count = 0;
+}
+
+int kinesixd_config_load(const char *file_path, struct KinesixdConfig *config)
+{
+    struct KinesixdConfig parsed;
+    char line[PATH_MAX + 64];
+    char *key = 0;
+    char *value = 0;
+    int line_number = 0;
+    int error_set = 0;
+    FILE *file = 0;
+
+    if (!(file = fopen(file_path, "re")))
+    {
+        /* Running without a config file is the normal case */
+        if (errno != ENOENT)
+            LOG_WARN("Could not open config file %s. %s", file_path, strerror(errno));
+        return 0;
+    }
+
+    /* Every load starts over from the defaults, a key removed from the file goes back to its default */
+    kinesixd_config_init(&parsed);
+
+    while (!error_set && fgets(line, sizeof(line), file))
+    {
+        ++line_number;
+
+        key = kinesixd_config_priv_strip(line);
+        if ((*key == '\0') || (*key == '#') || (*key == '['))
+            continue;
+
+        if (!(value = strchr(key, '=')))
+        {
+            LOG_WARN("%s:%d: expected key = value", file_path, line_number);
+            error_set = 1;
+            continue;
+        }
+        *value++ = '\0';
+        key = kinesixd_config_priv_strip(key);
+        value = kinesixd_config_priv_strip(value);
+
+        if (!kinesixd_config_priv_set(&parsed, key, value))
+        {
+            LOG_WARN("%s:%d: invalid value '%s' for %s", file_path, line_number, value, key);
+            error_set = 1;
+        }
+    }
+    fclose(file);
+
+    if (error_set)
+        return 0;
+
+    *config = parsed;
+
+    return 1;
+}
+
+static char *kinesixd_config_priv_strip(char *text)
+{
+    char *end = 0;
+
+    while (isspace((unsigned char)*text))
+        ++text;
+
+    end = text + strlen(text);
+    while ((end > text) && isspace((unsigned char)end[-1]))
+        --end;
+    *end = '\0';
+
+    return text;
+}
+
+static int kinesixd_config_priv_parse_gestures(char *value, unsigned int *gestures_out)
+{
+    unsigned int gestures = 0;
+    char *save_ptr = 0;
+    char *name = 0;
+
+    for (name = strtok_r(value, ",", &save_ptr); name; name = strtok_r(0, ",", &save_ptr))
+    {
+        name = kinesixd_config_priv_strip(name);
+        if (strcmp(name, "swipe") == 0)
+            gestures |= CONFIG_GESTURE_SWIPE;
+        else if (strcmp(name, "pinch") == 0)
+            gestures |= CONFIG_GESTURE_PINCH;
+        else if (*name != '\0')
+            return 0;
+    }
+
+    *gestures_out = gestures;
+
+    return 1;
+}
+
+static int kinesixd_config_priv_set(struct KinesixdConfig *config, const char *key, char *value)
+{
+    char *end = 0;
+    double number = 0;
+    size_t length = 0;
+
+    if (strcmp(key, "gesture_delta") == 0)
+    {
+        number = strtod(value, &end);
+        if ((end == value) || (*end != '\0') || (number <= 0))
+            return 0;
+        config->gesture_delta = number;
+    }
+    else if (strcmp(key, "gestures") == 0)
+    {
+        return kinesixd_config_priv_parse_gestures(value, &config->enabled_gestures);
+    }
+    else if (strcmp(key, "bus") == 0)
+    {
+        if (strcmp(value, "session") == 0)
+            config->bus = CONFIG_BUS_SESSION;
+        else if (strcmp(value, "system") == 0)
+            config->bus = CONFIG_BUS_SYSTEM;
+        else
+            return 0;
+    }
+    else if (strcmp(key, "backend") == 0)
+    {
+        if (strcmp(value, "libinput") == 0)
+            config->backend = CONFIG_BACKEND_LIBINPUT;
+        else if (strcmp(value, "evdev") == 0)
+            config->backend = CONFIG_BACKEND_EVDEV;
+        else
+            return 0;
+    }
+    else if (strcmp(key, "suspend_when_idle") == 0)
+    {
+        if (strcmp(value, "yes") == 0)
+            config->suspend_when_idle = 1;
+        else if (strcmp(value, "no") == 0)
+            config->suspend_when_idle = 0;
+        else
+            return 0;
+    }
+    else if (strcmp(key, "input_workers") == 0)
+    {
+        number = strtod(value, &end);
+        if ((end == value) || (*end != '\0') || (number < 0) || (number > CONFIG_MAX_INPUT_WORKERS) ||
+            (number != (int)number))
+            return 0;
+        config->input_workers = (int)number;
+    }
+    else if (strcmp(key, "batch_window_ms") == 0)
+    {
+        number = strtod(value, &end);
+        if ((end == value) || (*end != '\0') || (number < 1) || (number > CONFIG_MAX_BATCH_WINDOW_MS) ||
+            (number != (int)number))
+            return 0;
+        config->batch_window_ms = (int)number;
+    }
+    else if (strcmp(key, "sequence") == 0)
+    {
+        /* name: step, step, ... */
+        if (!(end = strchr(value, ':')) || (config->sequence_count == SEQUENCE_MAX_COUNT))
+            return 0;
+        *end++ = '\0';
+        if (!kinesixd_sequence_parse(kinesixd_config_priv_strip(value),
+                                     kinesixd_config_priv_strip(end),
+                                     &config->sequences[config->sequence_count]))
+            return 0;
+        ++config->sequence_count;
+    }
+    else if (strcmp(key, "devices_path") == 0)
+    {
+        /* Device paths are built by appending the node name, so keep the trailing separator */
+        length = strlen(value);
+        if ((length == 0) || (length + 2 > sizeof(config->devices_path)))
+            return 0;
+        strcpy(config->devices_path, value);
+        if (value[length - 1] != '/')
+            strcat(config->devices_path, "/");
+    }
+    else
+    {
+        LOG_WARN("Ignoring unknown config key %s", key);
+    }
+
+    return 1;
+}
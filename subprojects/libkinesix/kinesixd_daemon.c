@@ -18,6 +18,13 @@
  */
 
 #include <kinesixd_daemon.h>
+#include <kinesixd_device_p.h>
+#include <kinesixd_statistics.h>
+#include <kinesixd_probes.h>
+#include <kinesixd_timeline.h>
+#include <kinesixd_config.h>
+#include <kinesixd_mt_recognizer.h>
+#include <kinesixd_flight_recorder.h>
 
 #include <stdlib.h>
 #include <string.h>
@@ -31,45 +38,43 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <libgen.h>
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/ioctl.h>
 
 #include <libinput.h>
 #include <libudev.h>
 #include <pthread.h>
 
-static const char   DEVICES_PATH[] = "/dev/input/";
-static const int    GESTURE_DELTA = 10;
-
 struct _EventPollerThread
 {
     pthread_t thread_id;
     pthread_attr_t attr;
     int stop_issued;
+    int running;
     pthread_mutex_t stop_mutex;
 };
 
-struct _LibInput
+/* Tags for what became readable on event_fd */
+enum EventSource
 {
-    struct libinput_interface interface;
-    struct libinput *instance;
-    struct libinput_device *active_device;
-
-    /* The absolute maximum value for swipe velocity */
-    /* These help determine swipe direction */
-    double swipe_x_max;
-    double swipe_y_max;
+    EVENT_SOURCE_LIBINPUT,
+    EVENT_SOURCE_CONFIG,
+    EVENT_SOURCE_COMMAND,
+    EVENT_SOURCE_EVDEV,
+    EVENT_SOURCE_MERGE,
+    EVENT_SOURCE_MERGE_TIMER,
+    EVENT_SOURCE_COUNT
 };
 
-struct _KinesixDaemon
+typedef enum
 {
-    KinesixdDevice active_device;
-    KinesixdDevice *valid_device_list;
-    struct KinesixDaemonCallbacks callbacks;
-    void *user_data;
-
-    int gesture_type;
-    struct _LibInput libinput;
-    struct _EventPollerThread event_poller_thread;
-};
+    COMMAND_SET_ACTIVE_DEVICE,
+    COMMAND_SET_IDLE
+} CommandType;
 
 typedef enum
 {
@@ -86,6 +91,190 @@ typedef enum
     GestureUnknown
 } GestureType;
 
+struct _Command
+{
+    struct _Command *next;
+    CommandType type;
+    KinesixdDevice device;
+    int idle;
+    CommandCallback callback;
+    void *user_data;
+};
+
+/* Commands in flight at once before they have to be allocated. Each is one DBus method call
+ * waiting on its reply, so a handful covers normal use */
+#define COMMAND_POOL_SIZE 16
+
+/* Control operations for the thread that owns the libinput context, applied between event batches */
+struct _CommandQueue
+{
+    pthread_mutex_t mutex;
+    struct _Command *head;
+    struct _Command *tail;
+    struct _Command pool[COMMAND_POOL_SIZE];
+    struct _Command *free_list;
+    int wakeup_fd;
+};
+
+struct _ConfigWatch
+{
+    char *file_path;
+    /* Watching the directory also catches editors that replace the file instead of writing to it */
+    char *file_name;
+    int inotify_fd;
+};
+
+/* What a gesture is classified against, taken when it begins so a reload never changes it midway */
+struct _GestureConfig
+{
+    double gesture_delta;
+    unsigned int enabled_gestures;
+};
+
+/* Touchscreens get no gestures from libinput, their touch points are recognized here instead */
+#define TOUCH_SLOT_COUNT 10
+
+struct _Touch
+{
+    int active;
+    uint64_t last_time_usec;
+    struct KinesixdMtRecognizer recognizer;
+};
+
+/* Classification state of one device, so gestures on different devices never mix */
+struct _GestureState
+{
+    int gesture_type;
+    /* The absolute maximum value for swipe velocity */
+    /* These help determine swipe direction */
+    double swipe_x_max;
+    double swipe_y_max;
+    struct KinesixdKinetics swipe_kinetics;
+    uint64_t gesture_start_usec;
+    struct _GestureConfig gesture_config;
+    struct _Touch touch;
+    /* Registry entry of the device the events come from, gestures are routed by its seat */
+    KinesixdDevice source;
+};
+
+/* A classified gesture on its way to the callbacks */
+struct _Emission
+{
+    GestureType gesture_type;
+    int result;
+    int finger_count;
+    unsigned int enabled_gestures;
+    uint64_t start_usec;
+    uint64_t event_time_usec;
+    int has_fling;
+    struct KinesixdFling fling;
+    KinesixdDevice source;
+    /* When an input worker handed it over */
+    uint64_t queued_ns;
+};
+
+/* The evdev backend, only the active device is opened */
+struct _Evdev
+{
+    int fd;
+    struct KinesixdMtRecognizer recognizer;
+};
+
+struct _LibInput
+{
+    struct libinput_interface interface;
+    struct libinput *instance;
+    struct libinput_device *active_device;
+};
+
+/* One input worker, owning a libinput context with its share of the valid devices */
+struct _InputShard
+{
+    KinesixDaemon daemon;
+    int index;
+    struct libinput *instance;
+    /* Each one 0 while suspended, devices that fail to open again are dropped on resume */
+    struct libinput_device **devices;
+    /* The valid device each of them was opened from, reopened on resume */
+    KinesixdDevice *sources;
+    /* Handed to libinput as the user data of the device at the same index */
+    struct _GestureState *gesture_states;
+    int device_count;
+    int libinput_fd;
+    int event_fd;
+    /* Wakes the worker up to look at suspend_requested or stop_issued */
+    int control_fd;
+    int suspend_requested;
+    int suspended;
+    /* Set while the worker handles a batch. Every gesture that ended before watermark_usec, the
+     * start of the last completed batch, has been handed to the merge queue */
+    int busy;
+    uint64_t watermark_usec;
+    struct _EventPollerThread thread;
+};
+
+#define MERGE_QUEUE_CAPACITY 256
+/* Longest a gesture waits for a slower worker before it is emitted anyway */
+#define MERGE_HOLD_NS 4000000ull
+
+/* Gestures from the input workers, emitted from the event thread in event time order as far as
+ * kinesixd_daemon_priv_merge_watermark can tell, which is best effort */
+struct _MergeQueue
+{
+    pthread_mutex_t mutex;
+    struct _Emission queued[MERGE_QUEUE_CAPACITY];
+    int queued_count;
+    int wakeup_fd;
+    /* Fires once the oldest held gesture stops waiting for slower workers */
+    int timer_fd;
+    /* Set while gestures are held, so workers report every finished batch */
+    int waiting;
+    /* Only touched by the event thread, ordered by event time */
+    struct _Emission held[MERGE_QUEUE_CAPACITY];
+    int held_count;
+};
+
+struct _KinesixDaemon
+{
+    /* Written by the thread dispatching events, always points into valid_device_list */
+    KinesixdDevice active_device;
+    KinesixdDevice *valid_device_list;
+    /* Bumped every time valid_device_list is replaced */
+    unsigned int device_list_generation;
+    struct KinesixDaemonCallbacks callbacks;
+    void *user_data;
+
+    /* Only ever touched by the thread dispatching events, which is also the one that reloads it */
+    struct KinesixdConfig config;
+    struct _ConfigWatch config_watch;
+    struct KinesixdSequenceMatcher sequence_matcher;
+    /* Copies of config.gesture_delta, config.enabled_gestures and config.batch_window_ms for
+     * other threads */
+    double gesture_delta;
+    unsigned int enabled_gestures;
+    unsigned int batch_window_ms;
+    /* Whether anybody listens, and whether input is suspended because of it */
+    int idle;
+    int suspended;
+    /* Becomes readable whenever kinesixd_daemon_dispatch has work to do */
+    int event_fd;
+    struct _CommandQueue command_queue;
+    struct _LibInput libinput;
+    /* The active device, for either backend */
+    struct _GestureState gesture_state;
+    struct _Evdev evdev;
+    /* With input_workers set every valid device is read by one of these instead */
+    struct _InputShard *shards;
+    int shard_count;
+    struct _MergeQueue merge_queue;
+    struct _EventPollerThread event_poller_thread;
+    /* Wakes the event poller up to look at stop_issued, so it never has to poll on a timeout */
+    int poller_wakeup_fd;
+};
+
+/* Per thread, since input workers report samples while the event thread reports gestures */
+static __thread KinesixdDevice current_source = 0;
+
 static void kinesixd_daemon_priv_sanitize_device_name(const char *device_name,
                                                       char *buffer,
                                                       size_t buffer_size);
@@ -96,18 +285,75 @@ static void kinesixd_daemon_priv_add_device(const KinesixDaemon self,
 static KinesixdDevice *kinesixd_daemon_priv_device_list_duplicate(
                                             const KinesixdDevice *device_list,
                                             int size);
-static int kinesixd_daemon_priv_handle_swipe_update(KinesixDaemon self,
+static int kinesixd_daemon_priv_handle_swipe_update(struct _GestureState *state,
                                 struct libinput_event_gesture *gesture_event);
-static int kinesixd_daemon_priv_handle_pinch_update(KinesixDaemon self,
+static int kinesixd_daemon_priv_handle_pinch_update(struct _GestureState *state,
                                 struct libinput_event_gesture *gesture_event);
-static GestureEventState kinesixd_daemon_priv_handle_swipe(KinesixDaemon self,
+static GestureEventState kinesixd_daemon_priv_handle_swipe(struct _GestureState *state,
                                                    struct libinput_event *event,
                                                    int *swipe_finger_count_out);
-static GestureEventState kinesixd_daemon_priv_handle_pinch(KinesixDaemon self,
+static GestureEventState kinesixd_daemon_priv_handle_pinch(struct _GestureState *state,
                                                    struct libinput_event *event,
                                                    int *pinch_finger_count_out);
+#ifdef HAVE_USDT
+static uint64_t kinesixd_daemon_priv_event_time_usec(struct libinput_event *event);
+#endif
+static void kinesixd_daemon_priv_handle_event(KinesixDaemon self,
+                                              struct _InputShard *shard,
+                                              struct _GestureState *state,
+                                              struct libinput_event *event);
 static void kinesixd_daemon_priv_handle_gesture(KinesixDaemon self,
+                                                struct _InputShard *shard,
+                                                struct _GestureState *state,
                                                 struct libinput_event *event);
+static void kinesixd_daemon_priv_handle_touch(KinesixDaemon self,
+                                              struct _InputShard *shard,
+                                              struct _GestureState *state,
+                                              struct libinput_event *event);
+static void kinesixd_daemon_priv_handle_mt_frame(KinesixDaemon self,
+                                                 struct _InputShard *shard,
+                                                 struct _GestureState *state,
+                                                 int frame_result,
+                                                 const struct KinesixdMtGesture *gesture);
+static void kinesixd_daemon_priv_record_gesture_event(struct _GestureState *state,
+                                                     struct libinput_event *event,
+                                                     GestureType gesture_type);
+static void kinesixd_daemon_priv_report_sample(KinesixDaemon self,
+                                               struct libinput_event *event,
+                                               GestureType gesture_type,
+                                               GestureEventState gesture_state);
+static void kinesixd_daemon_priv_begin_gesture(KinesixDaemon self, struct _GestureState *state);
+static void kinesixd_daemon_priv_finish_gesture(KinesixDaemon self,
+                                                struct _InputShard *shard,
+                                                const struct _Emission *emission);
+static void kinesixd_daemon_priv_emit_gesture(KinesixDaemon self, const struct _Emission *emission);
+static void kinesixd_daemon_priv_watch_config(KinesixDaemon self, const char *config_path);
+static void kinesixd_daemon_priv_reload_config(KinesixDaemon self);
+static void kinesixd_daemon_priv_setup_event_fd(KinesixDaemon self);
+static void kinesixd_daemon_priv_dispatch_libinput(KinesixDaemon self);
+static struct _Command *kinesixd_daemon_priv_new_command(KinesixDaemon self);
+static void kinesixd_daemon_priv_release_command(KinesixDaemon self, struct _Command *command);
+static void kinesixd_daemon_priv_enqueue_command(KinesixDaemon self, struct _Command *command);
+static void kinesixd_daemon_priv_dispatch_commands(KinesixDaemon self);
+static int kinesixd_daemon_priv_apply_active_device(KinesixDaemon self, KinesixdDevice device);
+static int kinesixd_daemon_priv_open_device(KinesixDaemon self, KinesixdDevice device);
+static int kinesixd_daemon_priv_update_suspension(KinesixDaemon self);
+static void kinesixd_daemon_priv_init_gesture_state(struct _GestureState *state);
+static void kinesixd_daemon_priv_setup_touch(struct _GestureState *state, struct libinput_device *device);
+static void kinesixd_daemon_priv_reset_gesture_state(struct _GestureState *state);
+static void kinesixd_daemon_priv_reset_gesture(KinesixDaemon self);
+static int kinesixd_daemon_priv_open_evdev(KinesixDaemon self, KinesixdDevice device);
+static void kinesixd_daemon_priv_close_evdev(KinesixDaemon self);
+static void kinesixd_daemon_priv_dispatch_evdev(KinesixDaemon self);
+static void kinesixd_daemon_priv_start_shards(KinesixDaemon self);
+static void kinesixd_daemon_priv_stop_shards(KinesixDaemon self);
+static void kinesixd_daemon_priv_wake_shard(struct _InputShard *shard);
+static void kinesixd_daemon_priv_apply_shard_suspension(struct _InputShard *shard);
+static void kinesixd_daemon_priv_dispatch_shard(struct _InputShard *shard);
+static void *kinesixd_daemon_priv_run_shard(void *input_shard);
+static void kinesixd_daemon_priv_merge_push(KinesixDaemon self, const struct _Emission *emission);
+static uint64_t kinesixd_daemon_priv_merge_watermark(KinesixDaemon self);
+static void kinesixd_daemon_priv_dispatch_merge(KinesixDaemon self);
 static void *kinesixd_daemon_priv_poll_events(void *kinesixd_daemon);
 static int kinesixd_daemon_priv_libinput_open_restricted(const char *path,
                                                          int flags,
@@ -116,48 +362,155 @@ static void kinesixd_daemon_priv_libinput_close_restricted(int fd,
                                                            void *user_data);
 
 KinesixDaemon kinesixd_daemon_new(SwipedCallback swipe_cb, void *swipe_cb_target, PinchCallback pinch_cb, void *pinch_cb_target)
+{
+    return kinesixd_daemon_new_with_config(0, swipe_cb, swipe_cb_target, pinch_cb, pinch_cb_target);
+}
+
+KinesixDaemon kinesixd_daemon_new_with_config(const char *config_path,
+                                              SwipedCallback swipe_cb,
+                                              void *swipe_cb_target,
+                                              PinchCallback pinch_cb,
+                                              void *pinch_cb_target)
 {
     if (swipe_cb_target != pinch_cb_target) LOG_FATAL("Pinch and Swipe callbacks should belong to the same class!!");
 
     KinesixDaemon self = (KinesixDaemon)malloc(sizeof(struct _KinesixDaemon));
+    int i = 0;
+
     self->active_device = 0;
     self->valid_device_list = 0;
+    self->device_list_generation = 0;
     self->callbacks.swiped_cb = swipe_cb;
     self->callbacks.pinch_cb = pinch_cb;
+    self->callbacks.fling_cb = 0;
+    self->callbacks.sequence_cb = 0;
+    self->callbacks.sample_cb = 0;
     self->user_data = swipe_cb_target;
 
-    self->gesture_type = UNKNOWN_GESTURE;
+    kinesixd_config_init(&self->config);
+    if (config_path)
+        kinesixd_config_load(config_path, &self->config);
+    self->gesture_delta = self->config.gesture_delta;
+    self->enabled_gestures = self->config.enabled_gestures;
+    self->batch_window_ms = self->config.batch_window_ms;
+    kinesixd_daemon_priv_init_gesture_state(&self->gesture_state);
+    kinesixd_daemon_priv_begin_gesture(self, &self->gesture_state);
+    self->idle = 0;
+    self->suspended = 0;
+    kinesixd_sequence_matcher_init(&self->sequence_matcher);
+    kinesixd_sequence_matcher_compile(&self->sequence_matcher, self->config.sequences, self->config.sequence_count);
+    kinesixd_daemon_priv_watch_config(self, config_path);
+    kinesixd_statistics_input_suspended(0);
 
     self->libinput.interface.open_restricted = &kinesixd_daemon_priv_libinput_open_restricted;
     self->libinput.interface.close_restricted = &kinesixd_daemon_priv_libinput_close_restricted;
     self->libinput.instance = libinput_path_create_context(&self->libinput.interface, 0);
-    self->libinput.swipe_x_max = 0;
-    self->libinput.swipe_y_max = 0;
+    self->libinput.active_device = 0;
+    self->evdev.fd = -1;
+    self->shards = 0;
+    self->shard_count = 0;
 
     pthread_attr_init(&self->event_poller_thread.attr);
     pthread_attr_setdetachstate(&self->event_poller_thread.attr, PTHREAD_CREATE_JOINABLE);
     pthread_mutex_init(&self->event_poller_thread.stop_mutex, 0);
     self->event_poller_thread.stop_issued = 0;
+    self->event_poller_thread.running = 0;
+    if ((self->poller_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+        LOG_FATAL("Failed to create the event poller wakeup fd. %s", strerror(errno));
+
+    pthread_mutex_init(&self->command_queue.mutex, 0);
+    self->command_queue.head = 0;
+    self->command_queue.tail = 0;
+    self->command_queue.free_list = 0;
+    for (i = COMMAND_POOL_SIZE - 1; i >= 0; --i)
+    {
+        self->command_queue.pool[i].next = self->command_queue.free_list;
+        self->command_queue.free_list = &self->command_queue.pool[i];
+    }
+    self->command_queue.wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (self->command_queue.wakeup_fd == -1)
+        LOG_FATAL("Failed to create command queue wakeup fd. %s", strerror(errno));
+
+    pthread_mutex_init(&self->merge_queue.mutex, 0);
+    self->merge_queue.queued_count = 0;
+    self->merge_queue.held_count = 0;
+    self->merge_queue.waiting = 0;
+    self->merge_queue.wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (self->merge_queue.wakeup_fd == -1)
+        LOG_FATAL("Failed to create merge queue wakeup fd. %s", strerror(errno));
+    self->merge_queue.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (self->merge_queue.timer_fd == -1)
+        LOG_FATAL("Failed to create merge queue timer. %s", strerror(errno));
+
+    kinesixd_daemon_priv_setup_event_fd(self);
 
     /* TODO:                                                                                      */
     /* It might be usefull to set up inotify for /dev/input in order to detect new devices        */
     /* For now we stick to a static list initialized at the same time as the GestureDeamon itself */
     int device_count = 0;
     self->valid_device_list = kinesixd_daemon_get_valid_device_list(self, &device_count);
+    ++self->device_list_generation;
+
+    if (self->config.input_workers > 0)
+        kinesixd_daemon_priv_start_shards(self);
 
     return self;
 }
 
+void kinesixd_daemon_set_fling_callback(KinesixDaemon self, FlingCallback fling_cb)
+{
+    self->callbacks.fling_cb = fling_cb;
+}
+
+void kinesixd_daemon_set_sequence_callback(KinesixDaemon self, SequenceCallback sequence_cb)
+{
+    self->callbacks.sequence_cb = sequence_cb;
+}
+
+void kinesixd_daemon_set_sample_callback(KinesixDaemon self, SampleCallback sample_cb)
+{
+    self->callbacks.sample_cb = sample_cb;
+}
+
 void kinesixd_daemon_free(KinesixDaemon self)
 {
+    struct _Command *command = 0;
+
     kinesixd_daemon_stop_polling(self);
     pthread_attr_destroy(&self->event_poller_thread.attr);
+    kinesixd_daemon_priv_stop_shards(self);
+
+    /* Whatever was never applied still gets its completion */
+    while ((command = self->command_queue.head))
+    {
+        self->command_queue.head = command->next;
+        if (command->callback)
+            command->callback(self, 0, command->user_data);
+        kinesixd_daemon_priv_release_command(self, command);
+    }
+    close(self->command_queue.wakeup_fd);
+    pthread_mutex_destroy(&self->command_queue.mutex);
+
+    /* Held gestures are dropped, nothing is left to receive them */
+    close(self->merge_queue.wakeup_fd);
+    close(self->merge_queue.timer_fd);
+    pthread_mutex_destroy(&self->merge_queue.mutex);
 
     if (self->libinput.active_device)
         libinput_path_remove_device(self->libinput.active_device);
+    kinesixd_daemon_priv_close_evdev(self);
     libinput_unref(self->libinput.instance);
     kinesixd_device_list_free(self->valid_device_list);
 
+    if (self->event_fd != -1)
+        close(self->event_fd);
+    close(self->poller_wakeup_fd);
+    if (self->config_watch.inotify_fd != -1)
+        close(self->config_watch.inotify_fd);
+    free(self->config_watch.file_path);
+    free(self->config_watch.file_name);
+    kinesixd_sequence_matcher_free(&self->sequence_matcher);
+
     free(self);
 }
 
@@ -166,7 +519,11 @@ KinesixdDevice *kinesixd_daemon_get_valid_device_list(const KinesixDaemon self,
     KinesixdDevice *device_list_heap = self->valid_device_list;
     *length = 0;
 
-    if (!self->valid_device_list)
+    if (self->valid_device_list)
+    {
+        *length = kinesixd_device_list_get_length(self->valid_device_list);
+    }
+    else
     {
         int device_count = 0;
         KinesixdDevice device_list[255];
@@ -174,7 +531,7 @@ KinesixdDevice *kinesixd_daemon_get_valid_device_list(const KinesixDaemon self,
         struct dirent *file = 0;
         DIR *dir = 0;
 
-        if ((dir = opendir(DEVICES_PATH)) != 0)
+        if ((dir = opendir(self->config.devices_path)) != 0)
         {
             for (;;)
             {
@@ -202,48 +559,150 @@ KinesixdDevice *kinesixd_daemon_get_valid_device_list(const KinesixDaemon self,
     return device_list_heap;
 }
 
+unsigned int kinesixd_daemon_get_device_list_generation(const KinesixDaemon self)
+{
+    return self->device_list_generation;
+}
+
+KinesixdDevice kinesixd_daemon_get_gesture_source(const KinesixDaemon self)
+{
+    UNUSED(self)
+
+    return current_source;
+}
+
+KinesixdDevice kinesixd_daemon_get_active_device(const KinesixDaemon self)
+{
+    return __atomic_load_n(&self->active_device, __ATOMIC_ACQUIRE);
+}
+
+double kinesixd_daemon_get_gesture_delta(const KinesixDaemon self)
+{
+    double gesture_delta = 0;
+
+    __atomic_load(&self->gesture_delta, &gesture_delta, __ATOMIC_RELAXED);
+
+    return gesture_delta;
+}
+
+unsigned int kinesixd_daemon_get_batch_window_ms(const KinesixDaemon self)
+{
+    return __atomic_load_n(&self->batch_window_ms, __ATOMIC_RELAXED);
+}
+
 void kinesixd_daemon_set_active_device(KinesixDaemon self, KinesixdDevice device)
 {
-    if (!kinesixd_device_equals(self->active_device, device))
-    {
-        if (kinesixd_device_list_contains(self->valid_device_list, device))
-        {
-            if (self->libinput.active_device)
-                libinput_path_remove_device(self->libinput.active_device);
+    kinesixd_daemon_set_active_device_async(self, device, 0, 0);
+}
 
-            self->active_device = device;
-            self->libinput.active_device = libinput_path_add_device(
-                        self->libinput.instance,
-                        kinesixd_device_get_path(device));
-        }
-        else
-        {
-            LOG_ERROR("Device %s is not a valid device",
-                      kinesixd_device_get_path(device));
-        }
+void kinesixd_daemon_set_active_device_async(KinesixDaemon self,
+                                             KinesixdDevice device,
+                                             CommandCallback callback,
+                                             void *user_data)
+{
+    struct _Command *command = 0;
+    int i = 0;
+
+    /* The registry never changes after construction, so the lookup is safe from any thread and
+     * the caller's copy of the device does not have to outlive this call */
+    for (i = 0; self->valid_device_list && self->valid_device_list[i]; ++i)
+    {
+        if (kinesixd_device_equals(self->valid_device_list[i], device))
+            break;
     }
-    else
+
+    if (!self->valid_device_list || !self->valid_device_list[i])
     {
-        LOG_WARN("Device %s is already active", kinesixd_device_get_path(device));
+        LOG_ERROR("Device %s is not a valid device",
+                  device ? kinesixd_device_get_path(device) : "(null)");
+        if (callback)
+            callback(self, 0, user_data);
+        return;
     }
+
+    command = kinesixd_daemon_priv_new_command(self);
+    command->type = COMMAND_SET_ACTIVE_DEVICE;
+    command->device = self->valid_device_list[i];
+    command->idle = 0;
+    command->callback = callback;
+    command->user_data = user_data;
+    kinesixd_daemon_priv_enqueue_command(self, command);
+}
+
+void kinesixd_daemon_set_idle_async(KinesixDaemon self,
+                                    int idle,
+                                    CommandCallback callback,
+                                    void *user_data)
+{
+    struct _Command *command = kinesixd_daemon_priv_new_command(self);
+
+    command->type = COMMAND_SET_IDLE;
+    command->device = 0;
+    command->idle = idle;
+    command->callback = callback;
+    command->user_data = user_data;
+    kinesixd_daemon_priv_enqueue_command(self, command);
+}
+
+int kinesixd_daemon_is_suspended(const KinesixDaemon self)
+{
+    return __atomic_load_n(&self->suspended, __ATOMIC_RELAXED);
+}
+
+int kinesixd_daemon_get_fd(const KinesixDaemon self)
+{
+    return self->event_fd;
+}
+
+void kinesixd_daemon_dispatch(KinesixDaemon self)
+{
+    struct epoll_event events[EVENT_SOURCE_COUNT];
+    int ready[EVENT_SOURCE_COUNT] = { 0 };
+    int event_count = 0;
+    int i = 0;
+
+    event_count = epoll_wait(self->event_fd, events, EVENT_SOURCE_COUNT, 0);
+    for (i = 0; i < event_count; ++i)
+        ready[events[i].data.u32] = 1;
+
+    /* Commands go last, so a device switch never lands in the middle of a batch */
+    if (ready[EVENT_SOURCE_LIBINPUT])
+        kinesixd_daemon_priv_dispatch_libinput(self);
+    if (ready[EVENT_SOURCE_EVDEV])
+        kinesixd_daemon_priv_dispatch_evdev(self);
+    if (ready[EVENT_SOURCE_MERGE] || ready[EVENT_SOURCE_MERGE_TIMER])
+        kinesixd_daemon_priv_dispatch_merge(self);
+    if (ready[EVENT_SOURCE_CONFIG])
+        kinesixd_daemon_priv_reload_config(self);
+    if (ready[EVENT_SOURCE_COMMAND])
+        kinesixd_daemon_priv_dispatch_commands(self);
 }
 
 void kinesixd_daemon_start_polling(KinesixDaemon self)
 {
     self->event_poller_thread.stop_issued = 0;
-    pthread_create(&self->event_poller_thread.thread_id,
-                   &self->event_poller_thread.attr,
-                   &kinesixd_daemon_priv_poll_events,
-                   (void *)self
+    self->event_poller_thread.running = !pthread_create(&self->event_poller_thread.thread_id,
+                                                        &self->event_poller_thread.attr,
+                                                        &kinesixd_daemon_priv_poll_events,
+                                                        (void *)self
     );
 }
 
 void kinesixd_daemon_stop_polling(KinesixDaemon self)
 {
+    uint64_t wakeup = 1;
+
+    /* Callers driving the daemon through kinesixd_daemon_dispatch never start the thread */
+    if (!self->event_poller_thread.running)
+        return;
+
     pthread_mutex_lock(&self->event_poller_thread.stop_mutex);
     self->event_poller_thread.stop_issued = 1;
     pthread_mutex_unlock(&self->event_poller_thread.stop_mutex);
+    if (write(self->poller_wakeup_fd, &wakeup, sizeof(wakeup)) == -1)
+        LOG_WARN("Failed to wake up the event poller. %s", strerror(errno));
     pthread_join(self->event_poller_thread.thread_id, 0);
+    self->event_poller_thread.running = 0;
 }
 
 static void kinesixd_daemon_priv_sanitize_device_name(const char *device_name,
@@ -289,17 +748,19 @@ static void kinesixd_daemon_priv_add_device(const KinesixDaemon self,
 {
     KinesixdDevice new_device = 0;
     struct libinput_device *libinput_dev = 0;
-    char device_path[strlen(DEVICES_PATH) + strlen(device_name) + 1];
+    struct libinput_seat *libinput_seat = 0;
+    char device_path[strlen(self->config.devices_path) + strlen(device_name) + 1];
     struct udev_device *udev_dev = 0;
     const char *udev_name = 0;
     size_t buffer_size = 100;
     char udev_dev_sanatized_name[100];
 
-    sprintf(device_path,"%s%s", DEVICES_PATH, device_name);
+    sprintf(device_path,"%s%s", self->config.devices_path, device_name);
     libinput_dev = libinput_path_add_device(self->libinput.instance, device_path);
     if (libinput_dev)
     {
-        if (libinput_device_has_capability(libinput_dev, LIBINPUT_DEVICE_CAP_GESTURE))
+        if (libinput_device_has_capability(libinput_dev, LIBINPUT_DEVICE_CAP_GESTURE) ||
+            libinput_device_has_capability(libinput_dev, LIBINPUT_DEVICE_CAP_TOUCH))
         {
             if ((udev_dev = libinput_device_get_udev_device(libinput_dev)))
                 udev_name = udev_device_get_property_value(udev_dev, "ID_MODEL");
@@ -319,7 +780,12 @@ static void kinesixd_daemon_priv_add_device(const KinesixDaemon self,
                                              libinput_device_get_id_product(libinput_dev),
                                              libinput_device_get_id_vendor(libinput_dev));
             if (new_device)
-                *device_list_out[(*current_index_out)++] = new_device;
+            {
+                /* The path backend honors ID_SEAT, which is what multi-seat setups route on */
+                if ((libinput_seat = libinput_device_get_seat(libinput_dev)))
+                    device_priv_set_seat(new_device, libinput_seat_get_physical_name(libinput_seat));
+                (*device_list_out)[(*current_index_out)++] = new_device;
+            }
         }
         libinput_path_remove_device(libinput_dev);
     }
@@ -352,10 +818,9 @@ static int kinesixd_daemon_priv_libinput_open_restricted(const char *path,
 
     UNUSED(user_data)
 
+    /* libinput expects a negative errno, the callers log and go on without the device */
     if ((fd = open(path, flags)) == -1)
-    {
-        LOG_FATAL("Failed to open file descriptor at %s. %s", path, strerror(errno));
-    }
+        return -errno;
 
     return fd;
 }
@@ -368,13 +833,14 @@ static void kinesixd_daemon_priv_libinput_close_restricted(int fd,
     close(fd);
 }
 
-static int kinesixd_daemon_priv_handle_swipe_update(KinesixDaemon self,
+static int kinesixd_daemon_priv_handle_swipe_update(struct _GestureState *state,
                                 struct libinput_event_gesture *gesture_event)
 {
-    double x_max = self->libinput.swipe_x_max;
-    double y_max = self->libinput.swipe_y_max;
+    double x_max = state->swipe_x_max;
+    double y_max = state->swipe_y_max;
     double x_current = 0;
     double y_current = 0;
+    double gesture_delta = state->gesture_config.gesture_delta;
     int swipe_direction = UNKNOWN_GESTURE;
 
     if (!gesture_event)
@@ -388,37 +854,42 @@ static int kinesixd_daemon_priv_handle_swipe_update(KinesixDaemon self,
 
     if (fabs(y_max) > fabs(x_max))
     {
-        if (y_max < -GESTURE_DELTA)
+        if (y_max < -gesture_delta)
         {
             swipe_direction = SWIPE_UP;
         }
-        else if (y_max > GESTURE_DELTA)
+        else if (y_max > gesture_delta)
         {
             swipe_direction = SWIPE_DOWN;
         }
     }
     else if (fabs(x_max) > fabs(y_max))
     {
-        if (x_max < -GESTURE_DELTA)
+        if (x_max < -gesture_delta)
         {
            swipe_direction = SWIPE_LEFT;
         }
-        else if (x_max > GESTURE_DELTA)
+        else if (x_max > gesture_delta)
         {
             swipe_direction = SWIPE_RIGHT;
         }
     }
 
-    self->libinput.swipe_x_max = x_max;
-    self->libinput.swipe_y_max = y_max;
+    state->swipe_x_max = x_max;
+    state->swipe_y_max = y_max;
+
+    PROBE_CLASSIFY(STATISTICS_GESTURE_SWIPE,
+                   swipe_direction,
+                   libinput_event_gesture_get_finger_count(gesture_event),
+                   libinput_event_gesture_get_time_usec(gesture_event));
 
     return swipe_direction;
 }
 
-static int kinesixd_daemon_priv_handle_pinch_update(KinesixDaemon self,
+static int kinesixd_daemon_priv_handle_pinch_update(struct _GestureState *state,
                                 struct libinput_event_gesture *gesture_event)
 {
-    UNUSED(self)
+    UNUSED(state)
 
     double scale = 1;
     int pinch_type = UNKNOWN_GESTURE;
@@ -433,20 +904,25 @@ static int kinesixd_daemon_priv_handle_pinch_update(KinesixDaemon self,
     else if (scale < 1)
         pinch_type = PINCH_IN;
 
+    PROBE_CLASSIFY(STATISTICS_GESTURE_PINCH,
+                   pinch_type,
+                   libinput_event_gesture_get_finger_count(gesture_event),
+                   libinput_event_gesture_get_time_usec(gesture_event));
+
     return pinch_type;
 }
 
-static GestureEventState kinesixd_daemon_priv_handle_swipe(KinesixDaemon self,
+static GestureEventState kinesixd_daemon_priv_handle_swipe(struct _GestureState *state,
                                                    struct libinput_event *event,
                                                    int *swipe_finger_count_out)
 {
     struct libinput_event_gesture *gesture_event = 0;
     enum libinput_event_type gesture_event_type;
     int swipe_finger_count = 0;
-    GestureEventState state = GestureStateUnknown;
+    GestureEventState event_state = GestureStateUnknown;
 
     if (!event)
-        return state;
+        return event_state;
 
     gesture_event_type = libinput_event_get_type(event);
 
@@ -454,40 +930,46 @@ static GestureEventState kinesixd_daemon_priv_handle_swipe(KinesixDaemon self,
     {
         gesture_event = libinput_event_get_gesture_event(event);
         swipe_finger_count = libinput_event_gesture_get_finger_count(gesture_event);
-        state = GestureStarted;
+        kinesixd_kinetics_begin(&state->swipe_kinetics,
+                                libinput_event_gesture_get_time_usec(gesture_event));
+        event_state = GestureStarted;
     }
     else if (gesture_event_type == LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE)
     {
         gesture_event = libinput_event_get_gesture_event(event);
         swipe_finger_count = libinput_event_gesture_get_finger_count(gesture_event);
-        self->gesture_type = kinesixd_daemon_priv_handle_swipe_update(self, gesture_event);
-        state = GestureOngoing;
+        state->gesture_type = kinesixd_daemon_priv_handle_swipe_update(state, gesture_event);
+        kinesixd_kinetics_update(&state->swipe_kinetics,
+                                 libinput_event_gesture_get_dx_unaccelerated(gesture_event),
+                                 libinput_event_gesture_get_dy_unaccelerated(gesture_event),
+                                 libinput_event_gesture_get_time_usec(gesture_event));
+        event_state = GestureOngoing;
     }
     else if (gesture_event_type == LIBINPUT_EVENT_GESTURE_SWIPE_END)
     {
         gesture_event = libinput_event_get_gesture_event(event);
         swipe_finger_count = libinput_event_gesture_get_finger_count(gesture_event);
-        state = GestureFinished;
-        self->libinput.swipe_x_max = 0;
-        self->libinput.swipe_y_max = 0;
+        event_state = GestureFinished;
+        state->swipe_x_max = 0;
+        state->swipe_y_max = 0;
     }
 
     *swipe_finger_count_out = swipe_finger_count;
 
-    return state;
+    return event_state;
 }
 
-static GestureEventState kinesixd_daemon_priv_handle_pinch(KinesixDaemon self,
+static GestureEventState kinesixd_daemon_priv_handle_pinch(struct _GestureState *state,
                                                    struct libinput_event *event,
                                                    int *pinch_finger_count_out)
 {
     struct libinput_event_gesture *gesture_event = 0;
     enum libinput_event_type gesture_event_type;
     int pinch_finger_count = 0;
-    GestureEventState state = GestureStateUnknown;
+    GestureEventState event_state = GestureStateUnknown;
 
     if (!event)
-        return state;
+        return event_state;
 
     gesture_event_type = libinput_event_get_type(event);
 
@@ -495,37 +977,98 @@ static GestureEventState kinesixd_daemon_priv_handle_pinch(KinesixDaemon self,
     {
         gesture_event = libinput_event_get_gesture_event(event);
         pinch_finger_count = libinput_event_gesture_get_finger_count(gesture_event);
-        state = GestureStarted;
+        event_state = GestureStarted;
     }
     else if (gesture_event_type == LIBINPUT_EVENT_GESTURE_PINCH_UPDATE)
     {
         gesture_event = libinput_event_get_gesture_event(event);
         pinch_finger_count = libinput_event_gesture_get_finger_count(gesture_event);
-        self->gesture_type = kinesixd_daemon_priv_handle_pinch_update(self, gesture_event);
-        state = GestureOngoing;
+        state->gesture_type = kinesixd_daemon_priv_handle_pinch_update(state, gesture_event);
+        event_state = GestureOngoing;
     }
     else if (gesture_event_type == LIBINPUT_EVENT_GESTURE_PINCH_END)
     {
         gesture_event = libinput_event_get_gesture_event(event);
         pinch_finger_count = libinput_event_gesture_get_finger_count(gesture_event);
-        state = GestureFinished;
-        self->libinput.swipe_x_max = 0;
-        self->libinput.swipe_y_max = 0;
+        event_state = GestureFinished;
+        state->swipe_x_max = 0;
+        state->swipe_y_max = 0;
     }
 
     *pinch_finger_count_out = pinch_finger_count;
 
-    return state;
+    return event_state;
+}
+
+#ifdef HAVE_USDT
+/* Only gesture and touch events carry a time stamp, libinput logs a client bug for asking others */
+static uint64_t kinesixd_daemon_priv_event_time_usec(struct libinput_event *event)
+{
+    switch (libinput_event_get_type(event))
+    {
+    case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+    case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+    case LIBINPUT_EVENT_GESTURE_SWIPE_END:
+    case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+    case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+    case LIBINPUT_EVENT_GESTURE_PINCH_END:
+        return libinput_event_gesture_get_time_usec(libinput_event_get_gesture_event(event));
+    case LIBINPUT_EVENT_TOUCH_DOWN:
+    case LIBINPUT_EVENT_TOUCH_UP:
+    case LIBINPUT_EVENT_TOUCH_MOTION:
+    case LIBINPUT_EVENT_TOUCH_CANCEL:
+    case LIBINPUT_EVENT_TOUCH_FRAME:
+        return libinput_event_touch_get_time_usec(libinput_event_get_touch_event(event));
+    default:
+        return 0;
+    }
+}
+#endif
+
+static void kinesixd_daemon_priv_handle_event(KinesixDaemon self,
+                                              struct _InputShard *shard,
+                                              struct _GestureState *state,
+                                              struct libinput_event *event)
+{
+    current_source = state ? state->source : 0;
+    kinesixd_statistics_increment(STATISTICS_EVENTS_READ);
+    PROBE_EVENT_DEQUEUE(libinput_event_get_type(event), kinesixd_daemon_priv_event_time_usec(event));
+
+    /* Devices being added or removed carry no state of their own */
+    if (!state)
+    {
+        libinput_event_destroy(event);
+        return;
+    }
+
+    /* Asking libinput for the touch event of anything else gets logged as a client bug */
+    switch (libinput_event_get_type(event))
+    {
+    case LIBINPUT_EVENT_TOUCH_DOWN:
+    case LIBINPUT_EVENT_TOUCH_UP:
+    case LIBINPUT_EVENT_TOUCH_MOTION:
+    case LIBINPUT_EVENT_TOUCH_CANCEL:
+    case LIBINPUT_EVENT_TOUCH_FRAME:
+        kinesixd_daemon_priv_handle_touch(self, shard, state, event);
+        break;
+    default:
+        kinesixd_daemon_priv_handle_gesture(self, shard, state, event);
+        break;
+    }
 }
 
 static void kinesixd_daemon_priv_handle_gesture(KinesixDaemon self,
+                                                struct _InputShard *shard,
+                                                struct _GestureState *state,
                                                 struct libinput_event *event)
 {
     int finger_count = 0;
+    struct _Emission emission;
     GestureType gesture_type = GestureUnknown;
     GestureEventState gesture_state = GestureStateUnknown;
 
-    gesture_state = kinesixd_daemon_priv_handle_swipe(self,
+    kinesixd_timeline_begin("classify");
+    gesture_state = kinesixd_daemon_priv_handle_swipe(state,
                                                       event,
                                                       &finger_count);
     if (gesture_state != GestureStateUnknown)
@@ -534,59 +1077,1240 @@ static void kinesixd_daemon_priv_handle_gesture(KinesixDaemon self,
     }
     else
     {
-        gesture_state = kinesixd_daemon_priv_handle_pinch(self,
+        gesture_state = kinesixd_daemon_priv_handle_pinch(state,
                                                           event,
                                                           &finger_count);
         if (gesture_state != GestureStateUnknown)
                 gesture_type = GesturePinch;
     }
+    kinesixd_timeline_end("classify");
+
+    if (gesture_state != GestureStateUnknown)
+    {
+        kinesixd_daemon_priv_record_gesture_event(state, event, gesture_type);
+        if (self->callbacks.sample_cb)
+            kinesixd_daemon_priv_report_sample(self, event, gesture_type, gesture_state);
+    }
+
+    if (gesture_state == GestureStarted)
+    {
+        state->gesture_start_usec =
+                libinput_event_gesture_get_time_usec(libinput_event_get_gesture_event(event));
+        kinesixd_daemon_priv_begin_gesture(self, state);
+    }
+
+    if (gesture_state == GestureFinished)
+    {
+        emission.gesture_type = gesture_type;
+        emission.result = state->gesture_type;
+        emission.finger_count = finger_count;
+        emission.enabled_gestures = state->gesture_config.enabled_gestures;
+        emission.start_usec = state->gesture_start_usec;
+        emission.event_time_usec = libinput_event_gesture_get_time_usec(libinput_event_get_gesture_event(event));
+        emission.has_fling = 0;
+        emission.source = state->source;
+        kinesixd_flight_recorder_record(FLIGHT_RECORD_DECISION,
+                                        emission.event_time_usec,
+                                        gesture_type == GestureSwipe ? STATISTICS_GESTURE_SWIPE : STATISTICS_GESTURE_PINCH,
+                                        finger_count,
+                                        state->gesture_type,
+                                        libinput_event_gesture_get_cancelled(libinput_event_get_gesture_event(event)) ?
+                                            FLIGHT_RECORD_CANCELLED : 0,
+                                        0, 0);
+    }
 
     if ((gesture_state == GestureFinished) &&
-        (libinput_event_gesture_get_cancelled(
-             libinput_event_get_gesture_event(event)) == 0))
+        libinput_event_gesture_get_cancelled(libinput_event_get_gesture_event(event)))
     {
-        if ((gesture_type == GestureSwipe) && (self->callbacks.swiped_cb != 0))
-            self->callbacks.swiped_cb(self->gesture_type, finger_count, self->user_data);
-        if ((gesture_type == GesturePinch) && (self->callbacks.pinch_cb!= 0))
-            self->callbacks.pinch_cb(self->gesture_type, finger_count, self->user_data);
+        kinesixd_statistics_increment(STATISTICS_GESTURES_CANCELLED);
+    }
+    else if (gesture_state == GestureFinished)
+    {
+        if (gesture_type == GestureSwipe)
+        {
+            kinesixd_kinetics_finish(&state->swipe_kinetics, emission.event_time_usec, &emission.fling);
+            emission.has_fling = 1;
+        }
+        kinesixd_daemon_priv_finish_gesture(self, shard, &emission);
     }
 
     libinput_event_destroy(event);
 }
 
-static void *kinesixd_daemon_priv_poll_events(void *kinesixd_daemon)
+static void kinesixd_daemon_priv_handle_touch(KinesixDaemon self,
+                                              struct _InputShard *shard,
+                                              struct _GestureState *state,
+                                              struct libinput_event *event)
 {
-    KinesixDaemon self = (KinesixDaemon)kinesixd_daemon;
-    int stop_issued = 0;
+    struct libinput_event_touch *touch_event = libinput_event_get_touch_event(event);
+    struct KinesixdMtGesture gesture;
+    int frame_result = 0;
 
-    struct pollfd poller = {
-        .fd = libinput_get_fd(self->libinput.instance),
-        .events = POLLIN,
-        .revents = 0
-    };
+    if (!state->touch.active)
+    {
+        libinput_event_destroy(event);
+        return;
+    }
 
-    for (;;)
+    switch (libinput_event_get_type(event))
     {
-        pthread_mutex_lock(&self->event_poller_thread.stop_mutex);
-        stop_issued = self->event_poller_thread.stop_issued;
-        pthread_mutex_unlock(&self->event_poller_thread.stop_mutex);
+    case LIBINPUT_EVENT_TOUCH_DOWN:
+        kinesixd_flight_recorder_record(FLIGHT_RECORD_EVENT,
+                                        libinput_event_touch_get_time_usec(touch_event),
+                                        LIBINPUT_EVENT_TOUCH_DOWN,
+                                        libinput_event_touch_get_slot(touch_event),
+                                        UNKNOWN_GESTURE,
+                                        FLIGHT_RECORD_TOUCHSCREEN,
+                                        libinput_event_touch_get_x(touch_event),
+                                        libinput_event_touch_get_y(touch_event));
+        /* Fall through, a touch going down is also its first position */
+    case LIBINPUT_EVENT_TOUCH_MOTION:
+        kinesixd_mt_recognizer_touch(&state->touch.recognizer,
+                                     libinput_event_touch_get_slot(touch_event),
+                                     1,
+                                     libinput_event_touch_get_x(touch_event),
+                                     libinput_event_touch_get_y(touch_event));
+        state->touch.last_time_usec = libinput_event_touch_get_time_usec(touch_event);
+        break;
+    case LIBINPUT_EVENT_TOUCH_UP:
+        kinesixd_flight_recorder_record(FLIGHT_RECORD_EVENT,
+                                        libinput_event_touch_get_time_usec(touch_event),
+                                        LIBINPUT_EVENT_TOUCH_UP,
+                                        libinput_event_touch_get_slot(touch_event),
+                                        UNKNOWN_GESTURE,
+                                        FLIGHT_RECORD_TOUCHSCREEN,
+                                        0, 0);
+        kinesixd_mt_recognizer_touch(&state->touch.recognizer,
+                                     libinput_event_touch_get_slot(touch_event),
+                                     0, 0, 0);
+        state->touch.last_time_usec = libinput_event_touch_get_time_usec(touch_event);
+        break;
+    case LIBINPUT_EVENT_TOUCH_CANCEL:
+        kinesixd_flight_recorder_record(FLIGHT_RECORD_EVENT,
+                                        libinput_event_touch_get_time_usec(touch_event),
+                                        LIBINPUT_EVENT_TOUCH_CANCEL,
+                                        -1,
+                                        UNKNOWN_GESTURE,
+                                        FLIGHT_RECORD_TOUCHSCREEN | FLIGHT_RECORD_CANCELLED,
+                                        0, 0);
+        if (state->touch.recognizer.gesture_active)
+            kinesixd_statistics_increment(STATISTICS_GESTURES_CANCELLED);
+        kinesixd_mt_recognizer_cancel(&state->touch.recognizer);
+        break;
+    case LIBINPUT_EVENT_TOUCH_FRAME:
+        /* Frames carry no timestamp of their own, the last touch in them is as close as it gets */
+        kinesixd_timeline_begin("classify");
+        frame_result = kinesixd_mt_recognizer_frame(&state->touch.recognizer,
+                                                    state->gesture_config.gesture_delta,
+                                                    state->touch.last_time_usec,
+                                                    &gesture);
+        kinesixd_timeline_end("classify");
+        kinesixd_daemon_priv_handle_mt_frame(self, shard, state, frame_result, &gesture);
+        break;
+    default:
+        break;
+    }
 
-        if (stop_issued)
-            break;
+    libinput_event_destroy(event);
+}
 
-        /* Wait for an event to be ready by polling the internal libinput fd */
-        poll(&poller, 1, 500);
+static void kinesixd_daemon_priv_handle_mt_frame(KinesixDaemon self,
+                                                 struct _InputShard *shard,
+                                                 struct _GestureState *state,
+                                                 int frame_result,
+                                                 const struct KinesixdMtGesture *gesture)
+{
+    struct _Emission emission;
 
-        if (poller.revents == POLLIN)
-        {
-            /* Notify libinput that an event is ready and to add it (hopefully) to the event queue */
-            libinput_dispatch(self->libinput.instance);
+    if (frame_result & MT_FRAME_GESTURE_ENDED)
+    {
+        kinesixd_flight_recorder_record(FLIGHT_RECORD_DECISION,
+                                        gesture->time_usec,
+                                        gesture->kind == MT_GESTURE_SWIPE ? STATISTICS_GESTURE_SWIPE : STATISTICS_GESTURE_PINCH,
+                                        gesture->finger_count,
+                                        gesture->result,
+                                        FLIGHT_RECORD_TOUCHSCREEN,
+                                        0, 0);
+    }
+    if ((frame_result & MT_FRAME_GESTURE_ENDED) && (gesture->result != UNKNOWN_GESTURE))
+    {
+        PROBE_CLASSIFY(gesture->kind == MT_GESTURE_SWIPE ? STATISTICS_GESTURE_SWIPE : STATISTICS_GESTURE_PINCH,
+                       gesture->result,
+                       gesture->finger_count,
+                       gesture->time_usec);
+        emission.gesture_type = gesture->kind == MT_GESTURE_SWIPE ? GestureSwipe : GesturePinch;
+        emission.result = gesture->result;
+        emission.finger_count = gesture->finger_count;
+        emission.enabled_gestures = state->gesture_config.enabled_gestures;
+        emission.start_usec = gesture->start_usec;
+        emission.event_time_usec = gesture->time_usec;
+        emission.has_fling = gesture->kind == MT_GESTURE_SWIPE;
+        emission.fling = gesture->fling;
+        emission.source = state->source;
+        kinesixd_daemon_priv_finish_gesture(self, shard, &emission);
+    }
+    if (frame_result & MT_FRAME_GESTURE_BEGAN)
+        kinesixd_daemon_priv_begin_gesture(self, state);
+}
+
+static void kinesixd_daemon_priv_record_gesture_event(struct _GestureState *state,
+                                                     struct libinput_event *event,
+                                                     GestureType gesture_type)
+{
+    struct libinput_event_gesture *gesture_event = libinput_event_get_gesture_event(event);
+    enum libinput_event_type event_type = libinput_event_get_type(event);
+    int cancelled = 0;
+
+    if ((event_type == LIBINPUT_EVENT_GESTURE_SWIPE_END) || (event_type == LIBINPUT_EVENT_GESTURE_PINCH_END))
+        cancelled = libinput_event_gesture_get_cancelled(gesture_event);
+
+    /* Result is the classification so far, which is what tells a late direction change apart */
+    kinesixd_flight_recorder_record(FLIGHT_RECORD_EVENT,
+                                    libinput_event_gesture_get_time_usec(gesture_event),
+                                    event_type,
+                                    libinput_event_gesture_get_finger_count(gesture_event),
+                                    state->gesture_type,
+                                    cancelled ? FLIGHT_RECORD_CANCELLED : 0,
+                                    gesture_type == GestureSwipe ?
+                                        libinput_event_gesture_get_dx_unaccelerated(gesture_event) :
+                                        libinput_event_gesture_get_scale(gesture_event),
+                                    gesture_type == GestureSwipe ?
+                                        libinput_event_gesture_get_dy_unaccelerated(gesture_event) :
+                                        libinput_event_gesture_get_angle_delta(gesture_event));
+}
+
+static void kinesixd_daemon_priv_report_sample(KinesixDaemon self,
+                                               struct libinput_event *event,
+                                               GestureType gesture_type,
+                                               GestureEventState gesture_state)
+{
+    struct libinput_event_gesture *gesture_event = libinput_event_get_gesture_event(event);
+    struct KinesixdGestureSample sample;
+
+    sample.type = (gesture_type == GestureSwipe) ? GESTURE_SAMPLE_SWIPE : GESTURE_SAMPLE_PINCH;
+    if (gesture_state == GestureStarted)
+        sample.phase = GESTURE_SAMPLE_BEGIN;
+    else if (gesture_state == GestureOngoing)
+        sample.phase = GESTURE_SAMPLE_UPDATE;
+    else if (libinput_event_gesture_get_cancelled(gesture_event))
+        sample.phase = GESTURE_SAMPLE_CANCEL;
+    else
+        sample.phase = GESTURE_SAMPLE_END;
+    sample.finger_count = libinput_event_gesture_get_finger_count(gesture_event);
+    /* libinput only has motion and scale for updates, and scale only for pinches */
+    sample.dx = 0;
+    sample.dy = 0;
+    sample.scale = 1;
+    if (gesture_state == GestureOngoing)
+    {
+        sample.dx = libinput_event_gesture_get_dx_unaccelerated(gesture_event);
+        sample.dy = libinput_event_gesture_get_dy_unaccelerated(gesture_event);
+        if (gesture_type == GesturePinch)
+            sample.scale = libinput_event_gesture_get_scale(gesture_event);
+    }
+    sample.time_usec = libinput_event_gesture_get_time_usec(gesture_event);
+
+    self->callbacks.sample_cb(&sample, self->user_data);
+}
+
+static void kinesixd_daemon_priv_begin_gesture(KinesixDaemon self, struct _GestureState *state)
+{
+    /* Input workers never look at config, only at the copies published when it is reloaded */
+    __atomic_load(&self->gesture_delta, &state->gesture_config.gesture_delta, __ATOMIC_RELAXED);
+    state->gesture_config.enabled_gestures = __atomic_load_n(&self->enabled_gestures, __ATOMIC_RELAXED);
+}
+
+static void kinesixd_daemon_priv_finish_gesture(KinesixDaemon self,
+                                                struct _InputShard *shard,
+                                                const struct _Emission *emission)
+{
+    if (shard)
+        kinesixd_daemon_priv_merge_push(self, emission);
+    else
+        kinesixd_daemon_priv_emit_gesture(self, emission);
+}
+
+static void kinesixd_daemon_priv_emit_gesture(KinesixDaemon self, const struct _Emission *emission)
+{
+    const char *sequence = 0;
+    unsigned int flight_record_flags = 0;
+    GestureType gesture_type = emission->gesture_type;
+    int result = emission->result;
+    int finger_count = emission->finger_count;
+
+    /* Gestures from input workers are emitted here, on the event thread */
+    current_source = emission->source;
+    kinesixd_statistics_gesture_classified(emission->event_time_usec);
+
+    if (!(emission->enabled_gestures &
+          ((gesture_type == GestureSwipe) ? CONFIG_GESTURE_SWIPE : CONFIG_GESTURE_PINCH)))
+        flight_record_flags = FLIGHT_RECORD_DISABLED;
+    else if ((gesture_type == GestureSwipe) ? !self->callbacks.swiped_cb : !self->callbacks.pinch_cb)
+        flight_record_flags = FLIGHT_RECORD_FAILED;
+    kinesixd_flight_recorder_record(FLIGHT_RECORD_CALLBACK,
+                                    emission->event_time_usec,
+                                    gesture_type == GestureSwipe ? STATISTICS_GESTURE_SWIPE : STATISTICS_GESTURE_PINCH,
+                                    finger_count,
+                                    result,
+                                    flight_record_flags,
+                                    0, 0);
+
+    if ((gesture_type == GestureSwipe) && (self->callbacks.swiped_cb != 0) &&
+        (emission->enabled_gestures & CONFIG_GESTURE_SWIPE))
+    {
+        PROBE_CALLBACK(STATISTICS_GESTURE_SWIPE, result, finger_count, emission->event_time_usec);
+        kinesixd_timeline_begin("callback");
+        if ((self->callbacks.fling_cb != 0) && emission->has_fling)
+            self->callbacks.fling_cb(result, finger_count, &emission->fling, self->user_data);
+        self->callbacks.swiped_cb(result, finger_count, self->user_data);
+        kinesixd_timeline_end("callback");
+    }
+    if ((gesture_type == GesturePinch) && (self->callbacks.pinch_cb!= 0) &&
+        (emission->enabled_gestures & CONFIG_GESTURE_PINCH))
+    {
+        PROBE_CALLBACK(STATISTICS_GESTURE_PINCH, result, finger_count, emission->event_time_usec);
+        kinesixd_timeline_begin("callback");
+        self->callbacks.pinch_cb(result, finger_count, self->user_data);
+        kinesixd_timeline_end("callback");
+    }
+
+    /* Every recognized gesture counts towards sequences, even those not reported on their own */
+    sequence = kinesixd_sequence_matcher_step(&self->sequence_matcher,
+                                              gesture_type == GestureSwipe ? SEQUENCE_GESTURE_SWIPE : SEQUENCE_GESTURE_PINCH,
+                                              result,
+                                              finger_count,
+                                              emission->start_usec,
+                                              emission->event_time_usec);
+    if (sequence && self->callbacks.sequence_cb)
+    {
+        kinesixd_timeline_begin("callback");
+        self->callbacks.sequence_cb(sequence, self->user_data);
+        kinesixd_timeline_end("callback");
+    }
+}
+
+static void kinesixd_daemon_priv_watch_config(KinesixDaemon self, const char *config_path)
+{
+    char *path_copy = 0;
+
+    self->config_watch.file_path = 0;
+    self->config_watch.file_name = 0;
+    self->config_watch.inotify_fd = -1;
 
-            /* Get the actual event from the queue and send it for processing*/
-            kinesixd_daemon_priv_handle_gesture(self,
-                                 libinput_get_event(self->libinput.instance));
+    if (!config_path)
+        return;
+
+    self->config_watch.file_path = strdup(config_path);
+    path_copy = strdup(config_path);
+    self->config_watch.file_name = strdup(basename(path_copy));
+    strcpy(path_copy, config_path);
+
+    self->config_watch.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ((self->config_watch.inotify_fd == -1) ||
+        (inotify_add_watch(self->config_watch.inotify_fd,
+                           dirname(path_copy),
+                           IN_CLOSE_WRITE | IN_MOVED_TO) == -1))
+    {
+        LOG_WARN("Could not watch %s for changes, it will only be read at startup. %s",
+                 config_path,
+                 strerror(errno));
+        if (self->config_watch.inotify_fd != -1)
+            close(self->config_watch.inotify_fd);
+        self->config_watch.inotify_fd = -1;
+    }
+
+    free(path_copy);
+}
+
+static void kinesixd_daemon_priv_reload_config(KinesixDaemon self)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event = 0;
+    struct KinesixdConfig config;
+    ssize_t length = 0;
+    ssize_t offset = 0;
+    int changed = 0;
+
+    while ((length = read(self->config_watch.inotify_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (offset = 0; offset < length; offset += sizeof(struct inotify_event) + event->len)
+        {
+            event = (const struct inotify_event *)&buffer[offset];
+            if (event->len && (strcmp(event->name, self->config_watch.file_name) == 0))
+                changed = 1;
         }
     }
 
+    if (!changed)
+        return;
+
+    kinesixd_timeline_begin("config reload");
+    if (!kinesixd_config_load(self->config_watch.file_path, &config))
+    {
+        LOG_WARN("Keeping the current configuration, %s could not be applied", self->config_watch.file_path);
+        kinesixd_timeline_end("config reload");
+        return;
+    }
+
+    /* These only matter while setting up, applying them would mean reopening every device */
+    if (strcmp(config.devices_path, self->config.devices_path) != 0)
+        LOG_WARN("devices_path changes only apply after a restart");
+    if (config.bus != self->config.bus)
+        LOG_WARN("bus changes only apply after a restart");
+    if (config.backend != self->config.backend)
+        LOG_WARN("backend changes only apply after a restart");
+    if (config.input_workers != self->config.input_workers)
+        LOG_WARN("input_workers changes only apply after a restart");
+    strcpy(config.devices_path, self->config.devices_path);
+    config.bus = self->config.bus;
+    config.backend = self->config.backend;
+    config.input_workers = self->config.input_workers;
+
+    /* In-flight gestures keep their snapshot in gesture_config, the next one picks this up */
+    self->config = config;
+    __atomic_store(&self->gesture_delta, &config.gesture_delta, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->enabled_gestures, config.enabled_gestures, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->batch_window_ms, (unsigned int)config.batch_window_ms, __ATOMIC_RELAXED);
+    kinesixd_daemon_priv_update_suspension(self);
+    if (kinesixd_sequence_matcher_compile(&self->sequence_matcher, config.sequences, config.sequence_count))
+        kinesixd_sequence_matcher_reset(&self->sequence_matcher);
+
+    LOG("Reloaded %s", self->config_watch.file_path);
+    kinesixd_timeline_end("config reload");
+}
+
+static void kinesixd_daemon_priv_setup_event_fd(KinesixDaemon self)
+{
+    struct epoll_event libinput_event = { .events = EPOLLIN, .data.u32 = EVENT_SOURCE_LIBINPUT };
+    struct epoll_event config_event = { .events = EPOLLIN, .data.u32 = EVENT_SOURCE_CONFIG };
+    struct epoll_event command_event = { .events = EPOLLIN, .data.u32 = EVENT_SOURCE_COMMAND };
+    struct epoll_event merge_event = { .events = EPOLLIN, .data.u32 = EVENT_SOURCE_MERGE };
+    struct epoll_event merge_timer_event = { .events = EPOLLIN, .data.u32 = EVENT_SOURCE_MERGE_TIMER };
+
+    /* Everything the daemon waits on sits behind a single fd, so it can be handed to any main loop */
+    self->event_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (self->event_fd == -1)
+        LOG_FATAL("Failed to create event fd. %s", strerror(errno));
+
+    if (epoll_ctl(self->event_fd, EPOLL_CTL_ADD, libinput_get_fd(self->libinput.instance), &libinput_event) == -1)
+        LOG_FATAL("Failed to watch the libinput fd. %s", strerror(errno));
+
+    if (epoll_ctl(self->event_fd, EPOLL_CTL_ADD, self->command_queue.wakeup_fd, &command_event) == -1)
+        LOG_FATAL("Failed to watch the command queue. %s", strerror(errno));
+
+    if ((epoll_ctl(self->event_fd, EPOLL_CTL_ADD, self->merge_queue.wakeup_fd, &merge_event) == -1) ||
+        (epoll_ctl(self->event_fd, EPOLL_CTL_ADD, self->merge_queue.timer_fd, &merge_timer_event) == -1))
+        LOG_FATAL("Failed to watch the merge queue. %s", strerror(errno));
+
+    if ((self->config_watch.inotify_fd != -1) &&
+        (epoll_ctl(self->event_fd, EPOLL_CTL_ADD, self->config_watch.inotify_fd, &config_event) == -1))
+    {
+        LOG_WARN("Failed to watch the config file, it will only be read at startup. %s", strerror(errno));
+    }
+}
+
+static void kinesixd_daemon_priv_dispatch_libinput(KinesixDaemon self)
+{
+    struct libinput_event *event = 0;
+    uint64_t queue_depth = 0;
+
+    /* Notify libinput that an event is ready and to add it (hopefully) to the event queue */
+    PROBE_DISPATCH();
+    kinesixd_timeline_begin("dispatch");
+    libinput_dispatch(self->libinput.instance);
+    kinesixd_timeline_end("dispatch");
+
+    /* Drain the queue, a single dispatch can produce any number of events */
+    while ((event = libinput_get_event(self->libinput.instance)))
+    {
+        ++queue_depth;
+        kinesixd_daemon_priv_handle_event(self, 0, &self->gesture_state, event);
+    }
+    kinesixd_statistics_record(STATISTICS_LIBINPUT_QUEUE_DEPTH, queue_depth);
+}
+
+static struct _Command *kinesixd_daemon_priv_new_command(KinesixDaemon self)
+{
+    struct _Command *command = 0;
+
+    pthread_mutex_lock(&self->command_queue.mutex);
+    if ((command = self->command_queue.free_list))
+        self->command_queue.free_list = command->next;
+    pthread_mutex_unlock(&self->command_queue.mutex);
+
+    /* More waiting than the pool holds, rare enough not to bound */
+    if (!command)
+        command = (struct _Command *)malloc(sizeof(struct _Command));
+
+    command->next = 0;
+
+    return command;
+}
+
+static void kinesixd_daemon_priv_release_command(KinesixDaemon self, struct _Command *command)
+{
+    if ((command < self->command_queue.pool) || (command >= self->command_queue.pool + COMMAND_POOL_SIZE))
+    {
+        free(command);
+        return;
+    }
+
+    pthread_mutex_lock(&self->command_queue.mutex);
+    command->next = self->command_queue.free_list;
+    self->command_queue.free_list = command;
+    pthread_mutex_unlock(&self->command_queue.mutex);
+}
+
+static void kinesixd_daemon_priv_enqueue_command(KinesixDaemon self, struct _Command *command)
+{
+    uint64_t wakeup = 1;
+
+    pthread_mutex_lock(&self->command_queue.mutex);
+    if (self->command_queue.tail)
+        self->command_queue.tail->next = command;
+    else
+        self->command_queue.head = command;
+    self->command_queue.tail = command;
+    pthread_mutex_unlock(&self->command_queue.mutex);
+
+    if (write(self->command_queue.wakeup_fd, &wakeup, sizeof(wakeup)) == -1)
+        LOG_WARN("Failed to wake up the event loop. %s", strerror(errno));
+}
+
+static void kinesixd_daemon_priv_dispatch_commands(KinesixDaemon self)
+{
+    struct _Command *command = 0;
+    uint64_t wakeups = 0;
+    int success = 0;
+
+    if (read(self->command_queue.wakeup_fd, &wakeups, sizeof(wakeups)) == -1)
+        return;
+
+    /* Take the whole queue at once, the lock is never held while a command runs */
+    pthread_mutex_lock(&self->command_queue.mutex);
+    command = self->command_queue.head;
+    self->command_queue.head = 0;
+    self->command_queue.tail = 0;
+    pthread_mutex_unlock(&self->command_queue.mutex);
+
+    kinesixd_timeline_begin("commands");
+    while (command)
+    {
+        struct _Command *next = command->next;
+
+        switch (command->type)
+        {
+        case COMMAND_SET_ACTIVE_DEVICE:
+            success = kinesixd_daemon_priv_apply_active_device(self, command->device);
+            break;
+        case COMMAND_SET_IDLE:
+            self->idle = command->idle;
+            success = kinesixd_daemon_priv_update_suspension(self);
+            break;
+        default:
+            success = 0;
+            break;
+        }
+
+        if (command->callback)
+            command->callback(self, success, command->user_data);
+
+        kinesixd_daemon_priv_release_command(self, command);
+        command = next;
+    }
+    kinesixd_timeline_end("commands");
+}
+
+static int kinesixd_daemon_priv_apply_active_device(KinesixDaemon self, KinesixdDevice device)
+{
+    if (device == self->active_device)
+    {
+        LOG_WARN("Device %s is already active", kinesixd_device_get_path(device));
+        return 1;
+    }
+
+    /* Input workers read every valid device all along, which one is active is only reported */
+    if (self->shard_count)
+    {
+        __atomic_store_n(&self->active_device, device, __ATOMIC_RELEASE);
+        return 1;
+    }
+
+    if (self->libinput.active_device)
+        libinput_path_remove_device(self->libinput.active_device);
+    self->libinput.active_device = 0;
+    kinesixd_daemon_priv_close_evdev(self);
+    self->gesture_state.touch.active = 0;
+
+    /* Whatever the old device was in the middle of does not carry over */
+    kinesixd_daemon_priv_reset_gesture(self);
+
+    /* Opened once somebody listens again */
+    if (!self->suspended && !kinesixd_daemon_priv_open_device(self, device))
+    {
+        __atomic_store_n(&self->active_device, 0, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    self->gesture_state.source = device;
+    __atomic_store_n(&self->active_device, device, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+static int kinesixd_daemon_priv_open_device(KinesixDaemon self, KinesixdDevice device)
+{
+    if (self->config.backend == CONFIG_BACKEND_EVDEV)
+        return kinesixd_daemon_priv_open_evdev(self, device);
+
+    if (!(self->libinput.active_device = libinput_path_add_device(self->libinput.instance,
+                                                                  kinesixd_device_get_path(device))))
+    {
+        LOG_ERROR("Failed to open device %s", kinesixd_device_get_path(device));
+        return 0;
+    }
+
+    kinesixd_daemon_priv_setup_touch(&self->gesture_state, self->libinput.active_device);
+
+    return 1;
+}
+
+static int kinesixd_daemon_priv_update_suspension(KinesixDaemon self)
+{
+    KinesixdDevice active_device = self->active_device;
+    int suspend = self->idle && self->config.suspend_when_idle;
+    uint64_t resume_start = 0;
+    int success = 1;
+    int i = 0;
+
+    if (suspend == self->suspended)
+        return 1;
+
+    if (self->shard_count)
+    {
+        /* Every worker suspends its own context, libinput is not to be touched from here */
+        for (i = 0; i < self->shard_count; ++i)
+        {
+            __atomic_store_n(&self->shards[i].suspend_requested, suspend, __ATOMIC_RELAXED);
+            kinesixd_daemon_priv_wake_shard(&self->shards[i]);
+        }
+        if (suspend)
+        {
+            kinesixd_daemon_priv_reset_gesture(self);
+            LOG_DEBUG("Nobody is listening, input workers suspended");
+        }
+        else
+        {
+            LOG_DEBUG("Input workers resumed");
+        }
+    }
+    else if (suspend)
+    {
+        /* Closing the device fd means nothing wakes us up anymore. libinput_suspend is no use
+         * here, on resume it adds every device back under a new handle */
+        if (self->config.backend == CONFIG_BACKEND_EVDEV)
+            kinesixd_daemon_priv_close_evdev(self);
+        else if (self->libinput.active_device)
+            libinput_path_remove_device(self->libinput.active_device);
+        self->libinput.active_device = 0;
+
+        if (self->gesture_state.touch.active)
+            kinesixd_mt_recognizer_cancel(&self->gesture_state.touch.recognizer);
+        self->gesture_state.touch.active = 0;
+        kinesixd_daemon_priv_reset_gesture(self);
+
+        LOG_DEBUG("Nobody is listening, input suspended");
+    }
+    else
+    {
+        resume_start = kinesixd_statistics_now_ns();
+
+        /* Nothing is open while suspended, whichever device is active now gets opened */
+        if (active_device && (self->evdev.fd == -1) && !self->libinput.active_device &&
+            !kinesixd_daemon_priv_open_device(self, active_device))
+        {
+            __atomic_store_n(&self->active_device, 0, __ATOMIC_RELEASE);
+            success = 0;
+        }
+
+        LOG_DEBUG("Input resumed in %llu us",
+                  (unsigned long long)((kinesixd_statistics_now_ns() - resume_start) / 1000ull));
+    }
+
+    __atomic_store_n(&self->suspended, suspend, __ATOMIC_RELAXED);
+    kinesixd_statistics_input_suspended(suspend);
+
+    return success;
+}
+
+static void kinesixd_daemon_priv_init_gesture_state(struct _GestureState *state)
+{
+    state->gesture_type = UNKNOWN_GESTURE;
+    state->swipe_x_max = 0;
+    state->swipe_y_max = 0;
+    state->gesture_start_usec = 0;
+    state->gesture_config.gesture_delta = 0;
+    state->gesture_config.enabled_gestures = 0;
+    state->touch.active = 0;
+    state->touch.last_time_usec = 0;
+    state->source = 0;
+}
+
+static void kinesixd_daemon_priv_setup_touch(struct _GestureState *state, struct libinput_device *device)
+{
+    state->touch.active = device && libinput_device_has_capability(device, LIBINPUT_DEVICE_CAP_TOUCH);
+    if (state->touch.active)
+    {
+        /* libinput reports touch positions in mm already */
+        kinesixd_mt_recognizer_init(&state->touch.recognizer, TOUCH_SLOT_COUNT, 1, 1);
+        state->touch.last_time_usec = 0;
+    }
+}
+
+static void kinesixd_daemon_priv_reset_gesture_state(struct _GestureState *state)
+{
+    state->gesture_type = UNKNOWN_GESTURE;
+    state->swipe_x_max = 0;
+    state->swipe_y_max = 0;
+}
+
+static void kinesixd_daemon_priv_reset_gesture(KinesixDaemon self)
+{
+    kinesixd_daemon_priv_reset_gesture_state(&self->gesture_state);
+    kinesixd_sequence_matcher_reset(&self->sequence_matcher);
+}
+
+static int kinesixd_daemon_priv_open_evdev(KinesixDaemon self, KinesixdDevice device)
+{
+    struct epoll_event evdev_event = { .events = EPOLLIN, .data.u32 = EVENT_SOURCE_EVDEV };
+    struct input_absinfo slot_info = { 0 };
+    struct input_absinfo x_info = { 0 };
+    struct input_absinfo y_info = { 0 };
+    int clock_id = CLOCK_MONOTONIC;
+    int fd = -1;
+
+    fd = open(kinesixd_device_get_path(device), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1)
+    {
+        LOG_ERROR("Failed to open %s. %s", kinesixd_device_get_path(device), strerror(errno));
+        return 0;
+    }
+
+    /* Multitouch protocol B is all the recognizer understands */
+    if ((ioctl(fd, EVIOCGABS(ABS_MT_SLOT), &slot_info) == -1) ||
+        (ioctl(fd, EVIOCGABS(ABS_MT_POSITION_X), &x_info) == -1) ||
+        (ioctl(fd, EVIOCGABS(ABS_MT_POSITION_Y), &y_info) == -1))
+    {
+        LOG_ERROR("%s does not report multitouch slots", kinesixd_device_get_path(device));
+        close(fd);
+        return 0;
+    }
+
+    /* Same clock libinput stamps its events with, keeps the latency statistics comparable */
+    if (ioctl(fd, EVIOCSCLOCKID, &clock_id) == -1)
+        LOG_WARN("Could not switch %s to the monotonic clock", kinesixd_device_get_path(device));
+
+    kinesixd_mt_recognizer_init(&self->evdev.recognizer,
+                                slot_info.maximum + 1,
+                                x_info.resolution,
+                                y_info.resolution);
+    kinesixd_mt_recognizer_sync(&self->evdev.recognizer, fd);
+
+    if (epoll_ctl(self->event_fd, EPOLL_CTL_ADD, fd, &evdev_event) == -1)
+    {
+        LOG_ERROR("Failed to watch %s. %s", kinesixd_device_get_path(device), strerror(errno));
+        close(fd);
+        return 0;
+    }
+
+    self->evdev.fd = fd;
+
+    return 1;
+}
+
+static void kinesixd_daemon_priv_close_evdev(KinesixDaemon self)
+{
+    if (self->evdev.fd == -1)
+        return;
+
+    epoll_ctl(self->event_fd, EPOLL_CTL_DEL, self->evdev.fd, 0);
+    close(self->evdev.fd);
+    self->evdev.fd = -1;
+}
+
+static void kinesixd_daemon_priv_dispatch_evdev(KinesixDaemon self)
+{
+    struct input_event events[64];
+    struct KinesixdMtGesture gesture;
+    ssize_t length = 0;
+    size_t event_count = 0;
+    size_t i = 0;
+    uint64_t queue_depth = 0;
+    int frame_result = 0;
+
+    kinesixd_timeline_begin("dispatch");
+    while ((length = read(self->evdev.fd, events, sizeof(events))) > 0)
+    {
+        event_count = (size_t)length / sizeof(struct input_event);
+        queue_depth += event_count;
+        for (i = 0; i < event_count; ++i)
+        {
+            kinesixd_statistics_increment(STATISTICS_EVENTS_READ);
+            PROBE_EVENT_DEQUEUE(events[i].type, 0);
+
+            frame_result = kinesixd_mt_recognizer_feed(&self->evdev.recognizer,
+                                                       &events[i],
+                                                       self->gesture_state.gesture_config.gesture_delta,
+                                                       &gesture);
+            /* The kernel dropped events. What came up to this report was skipped, what follows it
+             * applies on top of the slots as they are now */
+            if (frame_result & MT_FRAME_SYNC_NEEDED)
+            {
+                kinesixd_mt_recognizer_sync(&self->evdev.recognizer, self->evdev.fd);
+                continue;
+            }
+
+            kinesixd_daemon_priv_handle_mt_frame(self, 0, &self->gesture_state, frame_result, &gesture);
+        }
+    }
+    kinesixd_timeline_end("dispatch");
+
+    kinesixd_statistics_record(STATISTICS_LIBINPUT_QUEUE_DEPTH, queue_depth);
+
+    if ((length == -1) && (errno == ENODEV))
+    {
+        LOG_WARN("Active device went away");
+        kinesixd_daemon_priv_close_evdev(self);
+        __atomic_store_n(&self->active_device, 0, __ATOMIC_RELEASE);
+    }
+}
+
+static void kinesixd_daemon_priv_start_shards(KinesixDaemon self)
+{
+    struct epoll_event libinput_event = { .events = EPOLLIN, .data.u32 = 0 };
+    struct epoll_event control_event = { .events = EPOLLIN, .data.u32 = 1 };
+    struct _InputShard *shard = 0;
+    struct libinput_device *libinput_device = 0;
+    int device_count = kinesixd_device_list_get_length(self->valid_device_list);
+    int shard_count = self->config.input_workers;
+    int shard_capacity = 0;
+    int i = 0;
+
+    if (self->config.backend == CONFIG_BACKEND_EVDEV)
+    {
+        LOG_WARN("input_workers needs the libinput backend, only the active device is read");
+        return;
+    }
+
+    if (shard_count > device_count)
+        shard_count = device_count;
+    if (shard_count == 0)
+        return;
+
+    shard_capacity = (device_count + shard_count - 1) / shard_count;
+    self->shards = (struct _InputShard *)calloc(shard_count, sizeof(struct _InputShard));
+    for (i = 0; i < shard_count; ++i)
+    {
+        shard = &self->shards[i];
+        shard->daemon = self;
+        shard->index = i;
+        shard->instance = libinput_path_create_context(&self->libinput.interface, 0);
+        shard->devices = (struct libinput_device **)calloc(shard_capacity, sizeof(struct libinput_device *));
+        shard->sources = (KinesixdDevice *)calloc(shard_capacity, sizeof(KinesixdDevice));
+        shard->gesture_states = (struct _GestureState *)calloc(shard_capacity, sizeof(struct _GestureState));
+        shard->device_count = 0;
+        shard->libinput_fd = libinput_get_fd(shard->instance);
+        shard->event_fd = epoll_create1(EPOLL_CLOEXEC);
+        shard->control_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if ((shard->event_fd == -1) || (shard->control_fd == -1) ||
+            (epoll_ctl(shard->event_fd, EPOLL_CTL_ADD, shard->libinput_fd, &libinput_event) == -1) ||
+            (epoll_ctl(shard->event_fd, EPOLL_CTL_ADD, shard->control_fd, &control_event) == -1))
+        {
+            LOG_FATAL("Failed to set up input worker %d. %s", i, strerror(errno));
+        }
+        shard->suspend_requested = 0;
+        shard->suspended = 0;
+        shard->busy = 0;
+        shard->watermark_usec = 0;
+        pthread_attr_init(&shard->thread.attr);
+        pthread_attr_setdetachstate(&shard->thread.attr, PTHREAD_CREATE_JOINABLE);
+        pthread_mutex_init(&shard->thread.stop_mutex, 0);
+        shard->thread.stop_issued = 0;
+        shard->thread.running = 0;
+    }
+
+    /* Round robin keeps the devices of a single host spread over as many cores as were asked for */
+    for (i = 0; i < device_count; ++i)
+    {
+        shard = &self->shards[i % shard_count];
+        libinput_device = libinput_path_add_device(shard->instance,
+                                                   kinesixd_device_get_path(self->valid_device_list[i]));
+        if (!libinput_device)
+        {
+            LOG_WARN("Failed to open device %s", kinesixd_device_get_path(self->valid_device_list[i]));
+            continue;
+        }
+
+        kinesixd_daemon_priv_init_gesture_state(&shard->gesture_states[shard->device_count]);
+        kinesixd_daemon_priv_begin_gesture(self, &shard->gesture_states[shard->device_count]);
+        kinesixd_daemon_priv_setup_touch(&shard->gesture_states[shard->device_count], libinput_device);
+        libinput_device_set_user_data(libinput_device, &shard->gesture_states[shard->device_count]);
+        shard->gesture_states[shard->device_count].source = self->valid_device_list[i];
+        shard->sources[shard->device_count] = self->valid_device_list[i];
+        shard->devices[shard->device_count++] = libinput_device;
+    }
+
+    self->shard_count = shard_count;
+    for (i = 0; i < shard_count; ++i)
+    {
+        shard = &self->shards[i];
+        shard->thread.running = !pthread_create(&shard->thread.thread_id,
+                                                &shard->thread.attr,
+                                                &kinesixd_daemon_priv_run_shard,
+                                                (void *)shard);
+        if (!shard->thread.running)
+            LOG_ERROR("Failed to start input worker %d", i);
+    }
+
+    LOG("Reading %d devices with %d input workers", device_count, shard_count);
+}
+
+static void kinesixd_daemon_priv_stop_shards(KinesixDaemon self)
+{
+    struct _InputShard *shard = 0;
+    int i = 0;
+    int j = 0;
+
+    for (i = 0; i < self->shard_count; ++i)
+    {
+        shard = &self->shards[i];
+        if (shard->thread.running)
+        {
+            pthread_mutex_lock(&shard->thread.stop_mutex);
+            shard->thread.stop_issued = 1;
+            pthread_mutex_unlock(&shard->thread.stop_mutex);
+            kinesixd_daemon_priv_wake_shard(shard);
+            pthread_join(shard->thread.thread_id, 0);
+            shard->thread.running = 0;
+        }
+        pthread_attr_destroy(&shard->thread.attr);
+        pthread_mutex_destroy(&shard->thread.stop_mutex);
+
+        for (j = 0; j < shard->device_count; ++j)
+        {
+            if (shard->devices[j])
+                libinput_path_remove_device(shard->devices[j]);
+        }
+        libinput_unref(shard->instance);
+        close(shard->event_fd);
+        close(shard->control_fd);
+        free(shard->devices);
+        free(shard->sources);
+        free(shard->gesture_states);
+    }
+
+    free(self->shards);
+    self->shards = 0;
+    self->shard_count = 0;
+}
+
+static void kinesixd_daemon_priv_wake_shard(struct _InputShard *shard)
+{
+    uint64_t wakeup = 1;
+
+    if (write(shard->control_fd, &wakeup, sizeof(wakeup)) == -1)
+        LOG_WARN("Failed to wake up input worker %d. %s", shard->index, strerror(errno));
+}
+
+static void kinesixd_daemon_priv_apply_shard_suspension(struct _InputShard *shard)
+{
+    struct _GestureState *state = 0;
+    int suspend = __atomic_load_n(&shard->suspend_requested, __ATOMIC_RELAXED);
+    int i = 0;
+
+    if (suspend == shard->suspended)
+        return;
+
+    /* Devices are removed and added back one by one. libinput_resume would add them back under
+     * new handles, without the gesture state attached to them */
+    for (i = 0; i < shard->device_count;)
+    {
+        state = &shard->gesture_states[i];
+        if (suspend)
+        {
+            if (shard->devices[i])
+                libinput_path_remove_device(shard->devices[i]);
+            shard->devices[i] = 0;
+
+            if (state->touch.active)
+                kinesixd_mt_recognizer_cancel(&state->touch.recognizer);
+            state->touch.active = 0;
+            kinesixd_daemon_priv_reset_gesture_state(state);
+            ++i;
+            continue;
+        }
+
+        shard->devices[i] = libinput_path_add_device(shard->instance, kinesixd_device_get_path(shard->sources[i]));
+        if (!shard->devices[i])
+        {
+            /* Gone while suspended most likely. The last one takes its place, it is not open yet
+             * either, so there is no user data pointing at the state that moves */
+            LOG_WARN("Input worker %d dropped %s, it failed to open again",
+                     shard->index,
+                     kinesixd_device_get_path(shard->sources[i]));
+            --shard->device_count;
+            shard->gesture_states[i] = shard->gesture_states[shard->device_count];
+            shard->sources[i] = shard->sources[shard->device_count];
+            continue;
+        }
+
+        kinesixd_daemon_priv_setup_touch(state, shard->devices[i]);
+        libinput_device_set_user_data(shard->devices[i], state);
+        ++i;
+    }
+
+    shard->suspended = suspend;
+}
+
+static void kinesixd_daemon_priv_dispatch_shard(struct _InputShard *shard)
+{
+    struct libinput_event *event = 0;
+    uint64_t batch_start_usec = kinesixd_statistics_now_ns() / 1000ull;
+    uint64_t queue_depth = 0;
+    uint64_t wakeup = 1;
+
+    /* Set before anything is read, see kinesixd_daemon_priv_merge_watermark */
+    __atomic_store_n(&shard->busy, 1, __ATOMIC_SEQ_CST);
+
+    PROBE_DISPATCH();
+    kinesixd_timeline_begin("dispatch");
+    libinput_dispatch(shard->instance);
+    kinesixd_timeline_end("dispatch");
+
+    while ((event = libinput_get_event(shard->instance)))
+    {
+        ++queue_depth;
+        kinesixd_daemon_priv_handle_event(shard->daemon,
+                                          shard,
+                                          (struct _GestureState *)libinput_device_get_user_data(
+                                              libinput_event_get_device(event)),
+                                          event);
+    }
+    kinesixd_statistics_record(STATISTICS_LIBINPUT_QUEUE_DEPTH, queue_depth);
+
+    __atomic_store_n(&shard->watermark_usec, batch_start_usec, __ATOMIC_RELEASE);
+    __atomic_store_n(&shard->busy, 0, __ATOMIC_SEQ_CST);
+
+    /* Held gestures may have been waiting on this batch only */
+    if (__atomic_load_n(&shard->daemon->merge_queue.waiting, __ATOMIC_SEQ_CST) &&
+        (write(shard->daemon->merge_queue.wakeup_fd, &wakeup, sizeof(wakeup)) == -1))
+    {
+        LOG_WARN("Failed to wake up the event loop. %s", strerror(errno));
+    }
+}
+
+static void *kinesixd_daemon_priv_run_shard(void *input_shard)
+{
+    struct _InputShard *shard = (struct _InputShard *)input_shard;
+    struct epoll_event events[2];
+    uint64_t wakeups = 0;
+    int stop_issued = 0;
+
+    kinesixd_timeline_set_thread_name("input worker");
+
+    for (;;)
+    {
+        if ((epoll_wait(shard->event_fd, events, 2, -1) == -1) && (errno != EINTR))
+        {
+            LOG_ERROR("Input worker %d stopped. %s", shard->index, strerror(errno));
+            break;
+        }
+
+        pthread_mutex_lock(&shard->thread.stop_mutex);
+        stop_issued = shard->thread.stop_issued;
+        pthread_mutex_unlock(&shard->thread.stop_mutex);
+
+        if (stop_issued)
+            break;
+
+        if (read(shard->control_fd, &wakeups, sizeof(wakeups)) > 0)
+            kinesixd_daemon_priv_apply_shard_suspension(shard);
+
+        kinesixd_daemon_priv_dispatch_shard(shard);
+    }
+
+    pthread_exit(0);
+}
+
+static void kinesixd_daemon_priv_merge_push(KinesixDaemon self, const struct _Emission *emission)
+{
+    struct _MergeQueue *queue = &self->merge_queue;
+    uint64_t wakeup = 1;
+    int dropped = 0;
+
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->queued_count == MERGE_QUEUE_CAPACITY)
+    {
+        dropped = 1;
+    }
+    else
+    {
+        queue->queued[queue->queued_count] = *emission;
+        queue->queued[queue->queued_count].queued_ns = kinesixd_statistics_now_ns();
+        ++queue->queued_count;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    if (dropped)
+    {
+        kinesixd_statistics_increment(STATISTICS_GESTURES_MERGE_DROPPED);
+        LOG_WARN("Merge queue is full, dropping a gesture from input worker");
+        return;
+    }
+
+    if (write(queue->wakeup_fd, &wakeup, sizeof(wakeup)) == -1)
+        LOG_WARN("Failed to wake up the event loop. %s", strerror(errno));
+}
+
+static uint64_t kinesixd_daemon_priv_merge_watermark(KinesixDaemon self)
+{
+    uint64_t watermark_usec = UINT64_MAX;
+    uint64_t shard_watermark_usec = 0;
+    int i = 0;
+
+    /* Ordering is best effort. Only a worker in the middle of a batch holds gestures back, up to
+     * the start of its last completed one, and only for MERGE_HOLD_NS at most. A worker that has
+     * input waiting but has not woken up for it yet is not waited for: its fd belongs to it, and
+     * a gesture it ends up reading a little late can still go out after a later one from another
+     * worker */
+    for (i = 0; i < self->shard_count; ++i)
+    {
+        if (!__atomic_load_n(&self->shards[i].busy, __ATOMIC_SEQ_CST))
+            continue;
+
+        shard_watermark_usec = __atomic_load_n(&self->shards[i].watermark_usec, __ATOMIC_ACQUIRE);
+        if (shard_watermark_usec < watermark_usec)
+            watermark_usec = shard_watermark_usec;
+    }
+
+    return watermark_usec;
+}
+
+static void kinesixd_daemon_priv_dispatch_merge(KinesixDaemon self)
+{
+    struct _MergeQueue *queue = &self->merge_queue;
+    struct _Emission emission;
+    struct itimerspec timer = { { 0, 0 }, { 0, 0 } };
+    uint64_t watermark_usec = 0;
+    uint64_t now_ns = 0;
+    uint64_t oldest_ns = 0;
+    uint64_t value = 0;
+    int remaining = 0;
+    int emitted = 0;
+    int taken = 0;
+    int i = 0;
+
+    if (read(queue->wakeup_fd, &value, sizeof(value)) == -1)
+        value = 0;
+    if (read(queue->timer_fd, &value, sizeof(value)) == -1)
+        value = 0;
+
+    /* Set first, a worker finishing after the watermark is taken wakes us up again */
+    __atomic_store_n(&queue->waiting, 1, __ATOMIC_SEQ_CST);
+
+    do
+    {
+        watermark_usec = kinesixd_daemon_priv_merge_watermark(self);
+
+        pthread_mutex_lock(&queue->mutex);
+        for (taken = 0; (taken < queue->queued_count) && (queue->held_count < MERGE_QUEUE_CAPACITY); ++taken)
+        {
+            emission = queue->queued[taken];
+            for (i = queue->held_count;
+                 (i > 0) && (queue->held[i - 1].event_time_usec > emission.event_time_usec);
+                 --i)
+            {
+                queue->held[i] = queue->held[i - 1];
+            }
+            queue->held[i] = emission;
+            ++queue->held_count;
+        }
+        remaining = queue->queued_count - taken;
+        memmove(queue->queued, &queue->queued[taken], remaining * sizeof(struct _Emission));
+        queue->queued_count = remaining;
+        pthread_mutex_unlock(&queue->mutex);
+
+        /* Whatever no worker can still come in ahead of goes out, as does anything held too long */
+        now_ns = kinesixd_statistics_now_ns();
+        for (emitted = 0; emitted < queue->held_count; ++emitted)
+        {
+            if ((queue->held[emitted].event_time_usec > watermark_usec) &&
+                (now_ns - queue->held[emitted].queued_ns < MERGE_HOLD_NS) &&
+                (queue->held_count - emitted < MERGE_QUEUE_CAPACITY))
+            {
+                break;
+            }
+
+            kinesixd_statistics_record(STATISTICS_MERGE_WAIT, now_ns - queue->held[emitted].queued_ns);
+            kinesixd_daemon_priv_emit_gesture(self, &queue->held[emitted]);
+        }
+        queue->held_count -= emitted;
+        memmove(queue->held, &queue->held[emitted], queue->held_count * sizeof(struct _Emission));
+    }
+    while (remaining);
+
+    if (queue->held_count)
+    {
+        oldest_ns = queue->held[0].queued_ns;
+        for (i = 1; i < queue->held_count; ++i)
+        {
+            if (queue->held[i].queued_ns < oldest_ns)
+                oldest_ns = queue->held[i].queued_ns;
+        }
+        value = (oldest_ns + MERGE_HOLD_NS > now_ns) ? (oldest_ns + MERGE_HOLD_NS - now_ns) : 1;
+        timer.it_value.tv_sec = value / 1000000000ull;
+        timer.it_value.tv_nsec = value % 1000000000ull;
+    }
+    else
+    {
+        __atomic_store_n(&queue->waiting, 0, __ATOMIC_SEQ_CST);
+    }
+
+    if (timerfd_settime(queue->timer_fd, 0, &timer, 0) == -1)
+        LOG_WARN("Failed to arm the merge queue timer. %s", strerror(errno));
+}
+
+static void *kinesixd_daemon_priv_poll_events(void *kinesixd_daemon)
+{
+    KinesixDaemon self = (KinesixDaemon)kinesixd_daemon;
+    int stop_issued = 0;
+
+    kinesixd_timeline_set_thread_name("event poller");
+
+    struct pollfd pollers[2] = {
+        { .fd = self->event_fd, .events = POLLIN, .revents = 0 },
+        { .fd = self->poller_wakeup_fd, .events = POLLIN, .revents = 0 }
+    };
+
+    for (;;)
+    {
+        pthread_mutex_lock(&self->event_poller_thread.stop_mutex);
+        stop_issued = self->event_poller_thread.stop_issued;
+        pthread_mutex_unlock(&self->event_poller_thread.stop_mutex);
+
+        if (stop_issued)
+            break;
+
+        /* Wait for libinput, the config watch or a stop request, however long that takes. While
+         * input is suspended only the config watch and commands are left to wake us up */
+        kinesixd_timeline_begin("poll");
+        poll(pollers, 2, -1);
+        kinesixd_timeline_end("poll");
+        kinesixd_statistics_wakeup();
+
+        if (pollers[0].revents == POLLIN)
+            kinesixd_daemon_dispatch(self);
+    }
+
     pthread_exit(0);
 }
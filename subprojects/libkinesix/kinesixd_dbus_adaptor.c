@@ -20,23 +20,53 @@
 #include "kinesixd_dbus_adaptor.h"
 
 #include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
 
 #include <unistd.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "kinesixd_daemon.h"
 #include "kinesixd_device_marshaler.h"
 #include "kinesixd_device_p.h"
+#include "kinesixd_session_router.h"
+#include "kinesixd_statistics.h"
+#include "kinesixd_probes.h"
+#include "kinesixd_timeline.h"
+#include "kinesixd_flight_recorder.h"
 
-#ifdef DEBUG_BUILD
 static const char *swipe_directions[] = { "Up", "Down", "Left", "Right" };
 static const char *pinch_types[]      = { "In", "Out" };
-#endif
 
 static const char GESTURE_DAEMON_DBUS_NAME[]        = "org.kicsyromy.kinesixd";
 static const char GESTURE_DAEMON_OBJECT_PATH[]      = "/org/kicsyromy/kinesixd";
 static const char GESTURE_DAEMON_INTERFACE_NAME[]   = "org.kicsyromy.kinesixd";
 
+/* Only departures matter, they are what removes subscribers that went away without unsubscribing */
+static const char NAME_OWNER_CHANGED_MATCH_RULE[]   = "type='signal',sender='org.freedesktop.DBus',"
+                                                      "interface='org.freedesktop.DBus',"
+                                                      "member='NameOwnerChanged',arg2=''";
+
+/* Past this much unwritten data only gestures are queued, state changes wait and get coalesced
+ * and gesture batches are dropped */
+static const long OUTGOING_LIMIT_BYTES              = 256 * 1024;
+
+/* Also bounds how long stopping the listener takes while idle */
+static const int IDLE_READ_WRITE_TIMEOUT_MS         = 500;
+
+/* A capture keeps every span in memory until it is written out, so it is not meant to run unattended */
+static const unsigned int TRACE_CAPTURE_MAX_MS      = 60 * 1000;
+/* Samples a GestureBatch carries at most, it is sent early once full. That keeps it under the
+ * 10 KiB up to which libdbus recycles a message once written */
+#define GESTURE_BATCH_CAPACITY 128
+/* Method calls that can take a while run here, so they never hold up cheap ones */
+#define METHOD_WORKER_COUNT 2
+/* Subscription changes wait on the bus for the caller's process id. A single worker keeps
+ * them in the order each client sent them, and in order with it leaving the bus */
+#define SUBSCRIPTION_WORKER_COUNT 1
+#define METHOD_QUEUE_CAPACITY 64
+
 static const char GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_ROOT[] = ""
 "<!DOCTYPE node PUBLIC \"-//freedesktop//DTD D-BUS Object Introspection 1.0//EN\" "
 "\"http://www.freedesktop.org/standards/dbus/1.0/introspect.dtd\">"
@@ -61,11 +91,50 @@ static const char GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_KINESIXD[] = ""
             "<arg type=\"s\" name=\"xml_data\" direction=\"out\"/>"
         "</method>"
     "</interface>"
+    "<interface name=\"org.freedesktop.DBus.Properties\">"
+        "<method name=\"Get\">"
+            "<arg name=\"interface_name\" type=\"s\" direction=\"in\"/>"
+            "<arg name=\"property_name\" type=\"s\" direction=\"in\"/>"
+            "<arg name=\"value\" type=\"v\" direction=\"out\"/>"
+        "</method>"
+        "<method name=\"GetAll\">"
+            "<arg name=\"interface_name\" type=\"s\" direction=\"in\"/>"
+            "<arg name=\"properties\" type=\"a{sv}\" direction=\"out\"/>"
+        "</method>"
+        "<method name=\"Set\">"
+            "<arg name=\"interface_name\" type=\"s\" direction=\"in\"/>"
+            "<arg name=\"property_name\" type=\"s\" direction=\"in\"/>"
+            "<arg name=\"value\" type=\"v\" direction=\"in\"/>"
+        "</method>"
+        "<signal name=\"PropertiesChanged\">"
+            "<arg name=\"interface_name\" type=\"s\"/>"
+            "<arg name=\"changed_properties\" type=\"a{sv}\"/>"
+            "<arg name=\"invalidated_properties\" type=\"as\"/>"
+        "</signal>"
+    "</interface>"
     "<interface name=\"org.kicsyromy.kinesixd\">"
+        "<property name=\"ActiveDevice\" type=\"(issuu)\" access=\"read\"/>"
+        "<property name=\"Devices\" type=\"a(issuu)\" access=\"read\"/>"
+        "<property name=\"Thresholds\" type=\"a{sd}\" access=\"read\"/>"
         "<signal name=\"Swiped\">"
             "<arg name=\"direction\" type=\"i\" direction=\"out\"/>"
             "<arg name=\"finger_count\" type=\"i\" direction=\"out\"/>"
         "</signal>"
+        "<signal name=\"SwipeKinetics\">"
+            "<arg name=\"direction\" type=\"i\" direction=\"out\"/>"
+            "<arg name=\"finger_count\" type=\"i\" direction=\"out\"/>"
+            "<arg name=\"velocity_x\" type=\"d\" direction=\"out\"/>"
+            "<arg name=\"velocity_y\" type=\"d\" direction=\"out\"/>"
+            "<arg name=\"displacement_x\" type=\"d\" direction=\"out\"/>"
+            "<arg name=\"displacement_y\" type=\"d\" direction=\"out\"/>"
+            "<arg name=\"duration_usec\" type=\"t\" direction=\"out\"/>"
+        "</signal>"
+        "<signal name=\"SequenceRecognized\">"
+            "<arg name=\"name\" type=\"s\" direction=\"out\"/>"
+        "</signal>"
+        "<signal name=\"GestureBatch\">"
+            "<arg name=\"samples\" type=\"a(iiidddt)\" direction=\"out\"/>"
+        "</signal>"
         "<signal name=\"Pinch\">"
             "<arg name=\"pinch_type\" type=\"i\" direction=\"out\"/>"
             "<arg name=\"finger_count\" type=\"i\" direction=\"out\"/>"
@@ -74,12 +143,68 @@ static const char GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_KINESIXD[] = ""
             "<arg type=\"a(issuu)\" direction=\"out\"/>"
         "</method>"
         "<method name=\"SetActiveDevice\">"
-            "<annotation name=\"org.freedesktop.DBus.Method.NoReply\" value=\"true\"/>"
             "<arg name=\"device\" type=\"(issuu)\" direction=\"in\"/>"
         "</method>"
+        "<method name=\"Subscribe\">"
+            "<arg name=\"gesture_mask\" type=\"u\" direction=\"in\"/>"
+        "</method>"
+        "<method name=\"Unsubscribe\"/>"
+        "<method name=\"SetSessionPolicy\">"
+            "<arg name=\"gesture_mask\" type=\"u\" direction=\"in\"/>"
+        "</method>"
+        "<method name=\"GetStatistics\">"
+            "<arg name=\"counters\" type=\"a{st}\" direction=\"out\"/>"
+            "<arg name=\"histograms\" type=\"a{s(ttta(tt))}\" direction=\"out\"/>"
+        "</method>"
+        "<method name=\"SetLogLevel\">"
+            "<arg name=\"level\" type=\"s\" direction=\"in\"/>"
+        "</method>"
+        "<method name=\"GetFlightRecord\">"
+            "<arg name=\"records\" type=\"a(ttuiiiudd)\" direction=\"out\"/>"
+        "</method>"
+        "<method name=\"CaptureTrace\">"
+            "<arg name=\"duration_ms\" type=\"u\" direction=\"in\"/>"
+            "<arg name=\"path\" type=\"s\" direction=\"out\"/>"
+        "</method>"
+    "</interface>"
+    "<interface name=\"org.kicsyromy.kinesixd.Statistics\">"
+        "<property name=\"SwipesEmitted\" type=\"t\" access=\"read\">"
+            "<annotation name=\"org.freedesktop.DBus.Property.EmitsChangedSignal\" value=\"false\"/>"
+        "</property>"
+        "<property name=\"PinchesEmitted\" type=\"t\" access=\"read\">"
+            "<annotation name=\"org.freedesktop.DBus.Property.EmitsChangedSignal\" value=\"false\"/>"
+        "</property>"
     "</interface>"
 "</node>";
 
+static const char GESTURE_DAEMON_STATISTICS_INTERFACE_NAME[] = "org.kicsyromy.kinesixd.Statistics";
+
+typedef enum
+{
+    PROP_ACTIVE_DEVICE = 0,
+    PROP_DEVICES,
+    PROP_THRESHOLDS,
+    PROP_SWIPES_EMITTED,
+    PROP_PINCHES_EMITTED,
+    PROP_COUNT
+} DaemonProperty;
+
+struct _PropertyInfo
+{
+    const char *interface;
+    const char *name;
+    const char *signature;
+};
+
+static const struct _PropertyInfo daemon_properties[] =
+{
+    { GESTURE_DAEMON_INTERFACE_NAME,            "ActiveDevice",     "(issuu)"   },
+    { GESTURE_DAEMON_INTERFACE_NAME,            "Devices",          "a(issuu)"  },
+    { GESTURE_DAEMON_INTERFACE_NAME,            "Thresholds",       "a{sd}"     },
+    { GESTURE_DAEMON_STATISTICS_INTERFACE_NAME, "SwipesEmitted",    "t"         },
+    { GESTURE_DAEMON_STATISTICS_INTERFACE_NAME, "PinchesEmitted",   "t"         }
+};
+
 struct _MessageListenerThread
 {
     pthread_t thread_id;
@@ -89,41 +214,299 @@ struct _MessageListenerThread
     pthread_mutex_t signal_mutex;
 };
 
+/* Calls the message listener handed over to a set of workers */
+struct _MethodQueue
+{
+    KinesixdDBusAdaptor dbus_adaptor;
+    void (*handle_call)(KinesixdDBusAdaptor kinesixd_dbus_adaptor, DBusMessage *message);
+    const char *thread_name;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    DBusMessage *messages[METHOD_QUEUE_CAPACITY];
+    uint64_t queued_ns[METHOD_QUEUE_CAPACITY];
+    int head;
+    int count;
+    /* Queued calls plus the ones a worker is still replying to */
+    int pending;
+    int stop_issued;
+    pthread_t workers[METHOD_WORKER_COUNT];
+    int worker_count;
+};
+
 struct _DBus
 {
     DBusError error;
     DBusConnection *connection;
+    /* Private connection the subscription worker asks the bus for process ids on. Waiting for
+     * a reply on the shared one would race the message listener popping it */
+    DBusConnection *lookup_connection;
     struct _MessageListenerThread message_listener;
+    struct _MethodQueue method_queue;
+    struct _MethodQueue subscription_queue;
+};
+
+/* Marshaled body of the GetValidDeviceList reply, rebuilt only when the device list changes */
+struct _DeviceListReplyCache
+{
+    /* Method workers may build the reply concurrently */
+    pthread_mutex_t mutex;
+    DBusMessage *message;
+    unsigned int generation;
+};
+
+/* Last published value of every property that emits PropertiesChanged */
+struct _PropertyCache
+{
+    DBusMessage *get_all_message;
+    unsigned int get_all_version;
+    unsigned int version;
+    int active_device_id;
+    unsigned int device_list_generation;
+    double gesture_delta;
+    /* Bit per DaemonProperty that changed while the outgoing queue was over its limit */
+    unsigned int coalesced;
+};
+
+/* Everything it takes to build a signal, so each receiver can get a message of its own */
+struct _Signal
+{
+    const char *member;
+    int (*append_args)(DBusMessage *message, const void *args);
+    const void *args;
+    /* Of the device the gesture came from, it goes to the session active there */
+    const char *seat;
+};
+
+/* Arguments of Swiped and Pinch */
+struct _GestureArgs
+{
+    dbus_int32_t result;
+    dbus_int32_t finger_count;
+};
+
+struct _FlingArgs
+{
+    dbus_int32_t direction;
+    dbus_int32_t finger_count;
+    const struct KinesixdFling *fling;
+};
+
+struct _BatchArgs
+{
+    const struct KinesixdGestureSample *samples;
+    int sample_count;
+};
+
+struct _RouteContext
+{
+    KinesixdDBusAdaptor dbus_adaptor;
+    const struct _Signal *signal;
+    int error_set;
+};
+
+struct _CounterContext
+{
+    DBusMessageIter *dbus_dict;
+    int error_set;
+};
+
+struct _RecordContext
+{
+    DBusMessageIter *dbus_array;
+    int error_set;
+};
+
+/* A SetActiveDevice call waiting for the daemon to open the device */
+struct _PendingReply
+{
+    KinesixdDBusAdaptor dbus_adaptor;
+    DBusMessage *message;
+};
+
+/* Gesture samples waiting to go out as one GestureBatch */
+struct _GestureBatch
+{
+    pthread_mutex_t mutex;
+    /* Whether any subscriber asked for batches, nothing is collected otherwise */
+    int enabled;
+    struct KinesixdGestureSample samples[GESTURE_BATCH_CAPACITY];
+    int sample_count;
+    /* Monotonic time the first sample of the batch arrived at */
+    uint64_t started_ns;
+    /* A batch only ever holds samples from devices on the same seat */
+    const char *seat;
 };
 
 struct _KinesixdDBusAdaptor
 {
     KinesixDaemon kinesixd_daemon;
+    DBusBusType bus_type;
+    KinesixdSessionRouter session_router;
+    /* Monotonic time, in seconds, of the last method call on the daemon's interface; read from the
+     * main thread */
+    int64_t last_activity;
+    /* Last idle state handed to the daemon, written by the subscription worker only */
+    int idle;
+    /* Monotonic time a capture started with CaptureTrace ends at, 0 while none is running */
+    uint64_t trace_deadline_ns;
+    char *state_file_path;
     struct _DBus d_bus;
+    struct _DeviceListReplyCache device_list_cache;
+    struct _PropertyCache property_cache;
+    struct _GestureBatch gesture_batch;
 };
 
 static void kinesixd_dbus_adaptor_priv_swiped(int direction, int finger_count, void *kinesixd_dbus_adaptor);
 static void kinesixd_dbus_adaptor_priv_pinch(int pinch_type, int finger_count, void *kinesixd_dbus_adaptor);
+static void kinesixd_dbus_adaptor_priv_fling(int direction,
+                                             int finger_count,
+                                             const struct KinesixdFling *fling,
+                                             void *kinesixd_dbus_adaptor);
+static void kinesixd_dbus_adaptor_priv_sequence(const char *name, void *kinesixd_dbus_adaptor);
+static int kinesixd_dbus_adaptor_priv_append_gesture_args(DBusMessage *message, const void *args);
+static int kinesixd_dbus_adaptor_priv_append_fling_args(DBusMessage *message, const void *args);
+static int kinesixd_dbus_adaptor_priv_append_sequence_args(DBusMessage *message, const void *args);
+static int kinesixd_dbus_adaptor_priv_append_batch_args(DBusMessage *message, const void *args);
+static void kinesixd_dbus_adaptor_priv_sample(const struct KinesixdGestureSample *sample,
+                                              void *kinesixd_dbus_adaptor);
+static void kinesixd_dbus_adaptor_priv_flush_batch(KinesixdDBusAdaptor kinesixd_dbus_adaptor, int force);
+static void kinesixd_dbus_adaptor_priv_send_batch(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                  const struct KinesixdGestureSample *samples,
+                                                  int sample_count,
+                                                  const char *seat);
+static const char *kinesixd_dbus_adaptor_priv_source_seat(KinesixdDBusAdaptor kinesixd_dbus_adaptor);
+static int kinesixd_dbus_adaptor_priv_same_seat(const char *seat, const char *other_seat);
+static void kinesixd_dbus_adaptor_priv_update_batching(KinesixdDBusAdaptor kinesixd_dbus_adaptor);
+static void kinesixd_dbus_adaptor_priv_lock_signal_mutex(KinesixdDBusAdaptor kinesixd_dbus_adaptor);
+static unsigned int kinesixd_dbus_adaptor_priv_send_to(const char *destination, void *route_context);
+static void kinesixd_dbus_adaptor_priv_write_pending(KinesixdDBusAdaptor kinesixd_dbus_adaptor);
+static int kinesixd_dbus_adaptor_priv_send_reply(KinesixdDBusAdaptor kinesixd_dbus_adaptor, DBusMessage *reply);
+static void kinesixd_dbus_adaptor_priv_append_subscriber(const char *bus_name,
+                                                         uint64_t signals_routed,
+                                                         uint64_t signals_rejected,
+                                                         void *counter_context);
+static int kinesixd_dbus_adaptor_priv_send(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                           const struct _Signal *signal,
+                                           unsigned int gesture_mask);
+static int kinesixd_dbus_adaptor_priv_emit(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                           const struct _Signal *signal,
+                                           StatisticsGesture gesture,
+                                           int result,
+                                           int finger_count);
+static int64_t kinesixd_dbus_adaptor_priv_monotonic_seconds(void);
+static void kinesixd_dbus_adaptor_priv_update_idle(KinesixdDBusAdaptor kinesixd_dbus_adaptor);
+static char *kinesixd_dbus_adaptor_priv_runtime_file_path(DBusBusType type, const char *file_name);
+static void kinesixd_dbus_adaptor_priv_finish_trace(KinesixdDBusAdaptor kinesixd_dbus_adaptor);
+static void kinesixd_dbus_adaptor_priv_restore_active_device(KinesixdDBusAdaptor kinesixd_dbus_adaptor);
+static void kinesixd_dbus_adaptor_priv_save_active_device(KinesixdDBusAdaptor kinesixd_dbus_adaptor);
+static pid_t kinesixd_dbus_adaptor_priv_get_sender_pid(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                       DBusMessage *message);
+static DBusMessage *kinesixd_dbus_adaptor_priv_reply_from_template(DBusMessage *reply_template,
+                                                                   DBusMessage *message);
+static int kinesixd_dbus_adaptor_priv_append_property(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                      DaemonProperty property,
+                                                      DBusMessageIter *dbus_iter);
+static int kinesixd_dbus_adaptor_priv_append_properties(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                        const char *interface,
+                                                        const int *properties,
+                                                        int property_count,
+                                                        DBusMessageIter *dbus_iter);
+static void kinesixd_dbus_adaptor_priv_sync_properties(KinesixdDBusAdaptor kinesixd_dbus_adaptor);
+static DBusMessage *kinesixd_dbus_adaptor_priv_device_list_reply(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                                 DBusMessage *message);
 static void kinesixd_dbus_adaptor_get_valid_device_list(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
                                                               DBusMessage *message);
 static void kinesixd_dbus_adaptor_set_active_device(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
                                                           DBusMessage *message);
+static void kinesixd_dbus_adaptor_priv_active_device_applied(KinesixDaemon kinesixd_daemon,
+                                                             int success,
+                                                             void *pending_reply);
+static void kinesixd_dbus_adaptor_handle_subscription(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                      DBusMessage *message);
+static void kinesixd_dbus_adaptor_handle_name_owner_changed(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                            DBusMessage *message);
+static void kinesixd_dbus_adaptor_handle_error(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                               DBusMessage *message);
+static void kinesixd_dbus_adaptor_get_statistics(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                 DBusMessage *message);
+static void kinesixd_dbus_adaptor_set_log_level(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                DBusMessage *message);
+static void kinesixd_dbus_adaptor_capture_trace(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                DBusMessage *message);
+static void kinesixd_dbus_adaptor_priv_append_flight_record(const struct KinesixdFlightRecord *record,
+                                                            void *record_context);
+static void kinesixd_dbus_adaptor_get_flight_record(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                    DBusMessage *message);
 static void kinesixd_dbus_adaptor_handle_introspection(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
                                                             DBusMessage *message);
+static void kinesixd_dbus_adaptor_handle_properties(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                    DBusMessage *message);
 static void kinesixd_dbus_adaptor_handle_unkown_message(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
                                                               DBusMessage *message);
+static void kinesixd_dbus_adaptor_priv_init_method_queue(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                        struct _MethodQueue *queue,
+                                                        void (*handle_call)(KinesixdDBusAdaptor, DBusMessage *),
+                                                        const char *thread_name);
+static void kinesixd_dbus_adaptor_priv_destroy_method_queue(struct _MethodQueue *queue);
+static void kinesixd_dbus_adaptor_priv_start_method_workers(struct _MethodQueue *queue, int worker_count);
+static void kinesixd_dbus_adaptor_priv_stop_method_workers(struct _MethodQueue *queue);
+static void kinesixd_dbus_adaptor_priv_queue_method_call(struct _MethodQueue *queue,
+                                                         DBusMessage *message);
+static int kinesixd_dbus_adaptor_priv_has_pending_calls(KinesixdDBusAdaptor kinesixd_dbus_adaptor);
+static void kinesixd_dbus_adaptor_priv_handle_method_call(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                          DBusMessage *message);
+static void kinesixd_dbus_adaptor_priv_handle_subscription_call(KinesixdDBusAdaptor kinesixd_dbus_adaptor,
+                                                                DBusMessage *message);
+static void *kinesixd_dbus_adaptor_priv_run_method_worker(void *method_queue);
 static void *kinesixd_dbus_adaptor_priv_listen_for_messages(void *kinesixd_dbus_adaptor);
 
-KinesixdDBusAdaptor kinesixd_dbus_adaptor_new(DBusBusType type)
+KinesixdDBusAdaptor kinesixd_dbus_adaptor_new(DBusBusType type, const char *config_path)
 {
     KinesixdDBusAdaptor self = (KinesixdDBusAdaptor)malloc(sizeof(struct _KinesixdDBusAdaptor));
-    struct KinesixDaemonCallbacks callbacks =
-    {
-        .swiped_cb = &kinesixd_dbus_adaptor_priv_swiped,
-        .pinch_cb  = &kinesixd_dbus_adaptor_priv_pinch
-    };
-
-    self->kinesixd_daemon = kinesixd_daemon_new(callbacks, self);
+    char *flight_recorder_path = 0;
+
+    /* The connection is shared between the event poller and the message listener */
+    dbus_threads_init_default();
+
+    self->bus_type = type;
+    /* On the system bus a single instance serves every session, so gestures follow the active one */
+    self->session_router = kinesixd_session_router_new(type == DBUS_BUS_SYSTEM);
+
+    self->kinesixd_daemon = kinesixd_daemon_new_with_config(config_path,
+                                                            &kinesixd_dbus_adaptor_priv_swiped, self,
+                                                            &kinesixd_dbus_adaptor_priv_pinch, self);
+    kinesixd_daemon_set_fling_callback(self->kinesixd_daemon, &kinesixd_dbus_adaptor_priv_fling);
+    kinesixd_daemon_set_sequence_callback(self->kinesixd_daemon, &kinesixd_dbus_adaptor_priv_sequence);
+    kinesixd_daemon_set_sample_callback(self->kinesixd_daemon, &kinesixd_dbus_adaptor_priv_sample);
+    pthread_mutex_init(&self->gesture_batch.mutex, 0);
+    self->gesture_batch.enabled = 0;
+    self->gesture_batch.sample_count = 0;
+    self->gesture_batch.started_ns = 0;
+    self->gesture_batch.seat = 0;
+    pthread_mutex_init(&self->device_list_cache.mutex, 0);
+    self->device_list_cache.message = 0;
+    self->device_list_cache.generation = 0;
+
+    /* Seed the cache with the current state so only real changes are ever signaled */
+    self->property_cache.get_all_message = 0;
+    self->property_cache.get_all_version = 0;
+    self->property_cache.version = 1;
+    self->property_cache.active_device_id = 0;
+    self->property_cache.device_list_generation =
+            kinesixd_daemon_get_device_list_generation(self->kinesixd_daemon);
+    self->property_cache.gesture_delta = kinesixd_daemon_get_gesture_delta(self->kinesixd_daemon);
+    self->property_cache.coalesced = 0;
+
+    self->last_activity = kinesixd_dbus_adaptor_priv_monotonic_seconds();
+    self->idle = 0;
+    self->trace_deadline_ns = 0;
+    self->state_file_path = kinesixd_dbus_adaptor_priv_runtime_file_path(type, "kinesixd-active-device");
+    if ((flight_recorder_path = kinesixd_dbus_adaptor_priv_runtime_file_path(type, "kinesixd-flight-recorder")))
+        kinesixd_flight_recorder_open(flight_recorder_path);
+    free(flight_recorder_path);
+    kinesixd_dbus_adaptor_priv_restore_active_device(self);
+    if (kinesixd_daemon_get_active_device(self->kinesixd_daemon))
+        self->property_cache.active_device_id = kinesixd_daemon_get_active_device(self->kinesixd_daemon)->id;
 
     dbus_error_init(&self->d_bus.error);
     self->d_bus.connection = dbus_bus_get(type, &self->d_bus.error);
@@ -133,15 +516,11 @@ KinesixdDBusAdaptor kinesixd_dbus_adaptor_new(DBusBusType type)
     }
     else if (self->d_bus.connection)
     {
-        dbus_bus_request_name(self->d_bus.connection,
-                              GESTURE_DAEMON_DBUS_NAME,
-                              DBUS_NAME_FLAG_REPLACE_EXISTING,
-                              &self->d_bus.error);
+        dbus_bus_add_match(self->d_bus.connection, NAME_OWNER_CHANGED_MATCH_RULE, &self->d_bus.error);
         if (dbus_error_is_set(&self->d_bus.error))
         {
+            LOG_WARN("Could not watch for clients leaving the bus. %s", self->d_bus.error.message);
             dbus_error_free(&self->d_bus.error);
-            dbus_connection_unref(self->d_bus.connection);
-            LOG_FATAL("Error acquiring DBus name. %s", self->d_bus.error.message);
         }
 
         pthread_attr_init(&self->d_bus.message_listener.attr);
@@ -151,6 +530,31 @@ KinesixdDBusAdaptor kinesixd_dbus_adaptor_new(DBusBusType type)
         self->d_bus.message_listener.stop_issued = 0;
     }
 
+    /* Process ids only matter when serving the whole system */
+    self->d_bus.lookup_connection = 0;
+    if (self->d_bus.connection && (type == DBUS_BUS_SYSTEM))
+    {
+        self->d_bus.lookup_connection = dbus_bus_get_private(type, &self->d_bus.error);
+        if (dbus_error_is_set(&self->d_bus.error))
+        {
+            LOG_WARN("Could not open a connection for process id lookups. %s", self->d_bus.error.message);
+            dbus_error_free(&self->d_bus.error);
+        }
+        else if (self->d_bus.lookup_connection)
+        {
+            dbus_connection_set_exit_on_disconnect(self->d_bus.lookup_connection, 0);
+        }
+    }
+
+    kinesixd_dbus_adaptor_priv_init_method_queue(self,
+                                                 &self->d_bus.method_queue,
+                                                 &kinesixd_dbus_adaptor_priv_handle_method_call,
+                                                 "dbus method worker");
+    kinesixd_dbus_adaptor_priv_init_method_queue(self,
+                                                 &self->d_bus.subscription_queue,
+                                                 &kinesixd_dbus_adaptor_priv_handle_subscription_call,
+                                                 "dbus subscription worker");
+
     return self;
 }
 
@@ -159,9 +563,34 @@ void kinesixd_dbus_adaptor_free(KinesixdDBusAdaptor self)
     kinesixd_dbus_adaptor_stop_listenting(self);
     pthread_attr_destroy(&self->d_bus.message_listener.attr);
 
+    /* Cut a capture short rather than lose it */
+    if (self->trace_deadline_ns)
+        kinesixd_timeline_stop();
+
+    /* Let the bus queue (or activate a new instance for) anything that arrives from now on */
+    if (self->d_bus.connection)
+        dbus_bus_release_name(self->d_bus.connection, GESTURE_DAEMON_DBUS_NAME, 0);
+
     kinesixd_daemon_free(self->kinesixd_daemon);
+    kinesixd_session_router_free(self->session_router);
+    pthread_mutex_destroy(&self->gesture_batch.mutex);
+    kinesixd_flight_recorder_close();
+
+    kinesixd_dbus_adaptor_priv_destroy_method_queue(&self->d_bus.method_queue);
+    kinesixd_dbus_adaptor_priv_destroy_method_queue(&self->d_bus.subscription_queue);
+    if (self->device_list_cache.message)
+        dbus_message_unref(self->device_list_cache.message);
+    pthread_mutex_destroy(&self->device_list_cache.mutex);
+    if (self->property_cache.get_all_message)
+        dbus_message_unref(self->property_cache.get_all_message);
+    free(self->state_file_path);
 
     dbus_error_free(&self->d_bus.error);
+    if (self->d_bus.lookup_connection)
+    {
+        dbus_connection_close(self->d_bus.lookup_connection);
+        dbus_connection_unref(self->d_bus.lookup_connection);
+    }
     if (self->d_bus.connection)
         dbus_connection_unref(self->d_bus.connection);
 
@@ -171,6 +600,23 @@ void kinesixd_dbus_adaptor_free(KinesixdDBusAdaptor self)
 void kinesixd_dbus_adaptor_start_listenting(KinesixdDBusAdaptor self)
 {
     kinesixd_daemon_start_polling(self->kinesixd_daemon);
+
+    /* Bus activation completes once the name is ours, so only claim it when gestures already flow */
+    dbus_bus_request_name(self->d_bus.connection,
+                          GESTURE_DAEMON_DBUS_NAME,
+                          DBUS_NAME_FLAG_REPLACE_EXISTING,
+                          &self->d_bus.error);
+    if (dbus_error_is_set(&self->d_bus.error))
+    {
+        LOG_FATAL("Error acquiring DBus name. %s", self->d_bus.error.message);
+    }
+
+    /* Nobody subscribed yet, with suspend_when_idle on input stays suspended until the first client shows up */
+    kinesixd_dbus_adaptor_priv_update_idle(self);
+
+    kinesixd_dbus_adaptor_priv_start_method_workers(&self->d_bus.method_queue, METHOD_WORKER_COUNT);
+    kinesixd_dbus_adaptor_priv_start_method_workers(&self->d_bus.subscription_queue, SUBSCRIPTION_WORKER_COUNT);
+
     self->d_bus.message_listener.stop_issued = 0;
     pthread_create(&self->d_bus.message_listener.thread_id,
                    &self->d_bus.message_listener.attr,
@@ -179,6 +625,18 @@ void kinesixd_dbus_adaptor_start_listenting(KinesixdDBusAdaptor self)
     );
 }
 
+int kinesixd_dbus_adaptor_get_idle_time(KinesixdDBusAdaptor self)
+{
+    int64_t last_activity = 0;
+
+    if (kinesixd_session_router_get_subscriber_count(self->session_router) > 0)
+        return 0;
+
+    last_activity = __atomic_load_n(&self->last_activity, __ATOMIC_RELAXED);
+
+    return (int)(kinesixd_dbus_adaptor_priv_monotonic_seconds() - last_activity);
+}
+
 void kinesixd_dbus_adaptor_stop_listenting(KinesixdDBusAdaptor self)
 {
     pthread_mutex_lock(&self->d_bus.message_listener.stop_mutex);
@@ -186,269 +644,1898 @@ void kinesixd_dbus_adaptor_stop_listenting(KinesixdDBusAdaptor self)
     pthread_mutex_unlock(&self->d_bus.message_listener.stop_mutex);
     kinesixd_daemon_stop_polling(self->kinesixd_daemon);
     pthread_join(self->d_bus.message_listener.thread_id, 0);
+
+    /* Nothing is queued anymore once the listener is gone */
+    kinesixd_dbus_adaptor_priv_stop_method_workers(&self->d_bus.method_queue);
+    kinesixd_dbus_adaptor_priv_stop_method_workers(&self->d_bus.subscription_queue);
 }
 
 static void kinesixd_dbus_adaptor_priv_swiped(int direction, int finger_count, void *kinesixd_dbus_adaptor)
 {
     KinesixdDBusAdaptor self = (KinesixdDBusAdaptor)kinesixd_dbus_adaptor;
-    dbus_uint32_t reply_id = 0;
-    DBusMessage *message = 0;
+    struct _GestureArgs args = { .result = direction, .finger_count = finger_count };
+    struct _Signal signal = { .member = "Swiped",
+                              .append_args = &kinesixd_dbus_adaptor_priv_append_gesture_args,
+                              .args = &args,
+                              .seat = kinesixd_dbus_adaptor_priv_source_seat(self) };
 
     LOG_DEBUG("Swiped with %d fingers in direction %s", finger_count, swipe_directions[direction]);
 
-    message = dbus_message_new_signal(GESTURE_DAEMON_OBJECT_PATH,
-                                      GESTURE_DAEMON_INTERFACE_NAME,
-                                      "Swiped");
-    if (!message)
-    {
-        LOG_ERROR("Could not create DBus message. Unable to send signal %s.Swiped(%d, %d)",
-                  GESTURE_DAEMON_INTERFACE_NAME,
-                  direction,
-                  finger_count);
-
-        return;
-    }
-
-    if (!dbus_message_append_args(message,
-                                  DBUS_TYPE_INT32, &direction,
-                                  DBUS_TYPE_INT32, &finger_count,
-                                  DBUS_TYPE_INVALID))
-    {
-        LOG_ERROR("Could not append agruments to signal. Probably out of memory.");
-        return;
-    }
-
-    pthread_mutex_lock(&self->d_bus.message_listener.signal_mutex);
-    if (!dbus_connection_send(self->d_bus.connection, message, &reply_id))
+    if (!kinesixd_dbus_adaptor_priv_emit(self, &signal, STATISTICS_GESTURE_SWIPE, direction, finger_count))
     {
         LOG_ERROR("Failed to send DBus signal %s.Swiped(%d, %d). Probably out of memory.",
                   GESTURE_DAEMON_INTERFACE_NAME,
                   direction,
                   finger_count);
     }
-    else
-        dbus_connection_flush(self->d_bus.connection);
-    pthread_mutex_unlock(&self->d_bus.message_listener.signal_mutex);
-
-    dbus_message_unref(message);
 }
 
 static void kinesixd_dbus_adaptor_priv_pinch(int pinch_type, int finger_count, void *kinesixd_dbus_adaptor)
 {
     KinesixdDBusAdaptor self = (KinesixdDBusAdaptor)kinesixd_dbus_adaptor;
-    dbus_uint32_t reply_id = 0;
-    DBusMessage *message = 0;
+    struct _GestureArgs args = { .result = pinch_type, .finger_count = finger_count };
+    struct _Signal signal = { .member = "Pinch",
+                              .append_args = &kinesixd_dbus_adaptor_priv_append_gesture_args,
+                              .args = &args,
+                              .seat = kinesixd_dbus_adaptor_priv_source_seat(self) };
 
     LOG_DEBUG("Pinch %s with %d fingers", pinch_types[pinch_type], finger_count);
 
-    message = dbus_message_new_signal(GESTURE_DAEMON_OBJECT_PATH,
-                                      GESTURE_DAEMON_INTERFACE_NAME,
-                                      "Pinch");
-    if (!message)
+    if (!kinesixd_dbus_adaptor_priv_emit(self, &signal, STATISTICS_GESTURE_PINCH, pinch_type, finger_count))
     {
-        LOG_ERROR("Could not create DBus message. Unable to send signal %s.Pinch(%d, %d)",
+        LOG_ERROR("Failed to send DBus signal %s.Pinch(%d, %d). Probably out of memory.",
                   GESTURE_DAEMON_INTERFACE_NAME,
                   pinch_type,
                   finger_count);
-
-        return;
     }
+}
 
-    if (!dbus_message_append_args(message,
-                                  DBUS_TYPE_INT32, &pinch_type,
-                                  DBUS_TYPE_INT32, &finger_count,
-                                  DBUS_TYPE_INVALID))
+static void kinesixd_dbus_adaptor_priv_fling(int direction,
+                                             int finger_count,
+                                             const struct KinesixdFling *fling,
+                                             void *kinesixd_dbus_adaptor)
+{
+    KinesixdDBusAdaptor self = (KinesixdDBusAdaptor)kinesixd_dbus_adaptor;
+    struct _FlingArgs args = { .direction = direction, .finger_count = finger_count, .fling = fling };
+    struct _Signal signal = { .member = "SwipeKinetics",
+                              .append_args = &kinesixd_dbus_adaptor_priv_append_fling_args,
+                              .args = &args,
+                              .seat = kinesixd_dbus_adaptor_priv_source_seat(self) };
+    int sent = 0;
+
+    LOG_DEBUG("Swipe released at %.1f, %.1f units/s after %llu us",
+              fling->velocity_x,
+              fling->velocity_y,
+              (unsigned long long)fling->duration_usec);
+
+    /* Swiped follows right away and its flush carries this one out as well */
+    kinesixd_dbus_adaptor_priv_lock_signal_mutex(self);
+    sent = kinesixd_dbus_adaptor_priv_send(self, &signal, GESTURE_MASK_SWIPE);
+    pthread_mutex_unlock(&self->d_bus.message_listener.signal_mutex);
+
+    if (!sent)
     {
-        LOG_ERROR("Could not append agruments to signal. Probably out of memory.");
-        return;
+        LOG_ERROR("Failed to send DBus signal %s.SwipeKinetics. Probably out of memory.",
+                  GESTURE_DAEMON_INTERFACE_NAME);
     }
+}
 
-    pthread_mutex_lock(&self->d_bus.message_listener.signal_mutex);
-    if (!dbus_connection_send(self->d_bus.connection, message, &reply_id))
+static void kinesixd_dbus_adaptor_priv_sequence(const char *name, void *kinesixd_dbus_adaptor)
+{
+    KinesixdDBusAdaptor self = (KinesixdDBusAdaptor)kinesixd_dbus_adaptor;
+    struct _Signal signal = { .member = "SequenceRecognized",
+                              .append_args = &kinesixd_dbus_adaptor_priv_append_sequence_args,
+                              .args = &name,
+                              .seat = kinesixd_dbus_adaptor_priv_source_seat(self) };
+    int sent = 0;
+
+    LOG_DEBUG("Recognized gesture sequence %s", name);
+
+    /* Sequences mix gestures, anybody subscribed to either kind gets them */
+    kinesixd_dbus_adaptor_priv_lock_signal_mutex(self);
+    if ((sent = kinesixd_dbus_adaptor_priv_send(self, &signal, GESTURE_MASK_ALL)))
+        kinesixd_dbus_adaptor_priv_write_pending(self);
+    pthread_mutex_unlock(&self->d_bus.message_listener.signal_mutex);
+
+    if (!sent)
     {
-        LOG_ERROR("Failed to send DBus signal %s.Pinch(%d, %d). Probably out of memory.",
+        LOG_ERROR("Failed to send DBus signal %s.SequenceRecognized(%s). Probably out of memory.",
                   GESTURE_DAEMON_INTERFACE_NAME,
-                  pinch_type,
-                  finger_count);
+                  name);
     }
-    else
-        dbus_connection_flush(self->d_bus.connection);
-    pthread_mutex_unlock(&self->d_bus.message_listener.signal_mutex);
-
-    dbus_message_unref(message);
 }
 
-static void kinesixd_dbus_adaptor_get_valid_device_list(KinesixdDBusAdaptor self,
-                                                              DBusMessage *message)
+static int kinesixd_dbus_adaptor_priv_append_gesture_args(DBusMessage *message, const void *args)
 {
-    DBusMessage* reply = 0;
-    DBusMessageIter reply_args;
+    const struct _GestureArgs *gesture = (const struct _GestureArgs *)args;
 
-    LOG_DEBUG("Called %s.%s on %s",
-              dbus_message_get_interface(message),
-              dbus_message_get_member(message),
-              dbus_message_get_path(message));
+    return dbus_message_append_args(message,
+                                    DBUS_TYPE_INT32, &gesture->result,
+                                    DBUS_TYPE_INT32, &gesture->finger_count,
+                                    DBUS_TYPE_INVALID);
+}
 
-    reply = dbus_message_new_method_return(message);
-    dbus_message_iter_init_append(reply, &reply_args);
+static int kinesixd_dbus_adaptor_priv_append_fling_args(DBusMessage *message, const void *args)
+{
+    const struct _FlingArgs *fling = (const struct _FlingArgs *)args;
+    dbus_uint64_t duration_usec = fling->fling->duration_usec;
+
+    return dbus_message_append_args(message,
+                                    DBUS_TYPE_INT32, &fling->direction,
+                                    DBUS_TYPE_INT32, &fling->finger_count,
+                                    DBUS_TYPE_DOUBLE, &fling->fling->velocity_x,
+                                    DBUS_TYPE_DOUBLE, &fling->fling->velocity_y,
+                                    DBUS_TYPE_DOUBLE, &fling->fling->displacement_x,
+                                    DBUS_TYPE_DOUBLE, &fling->fling->displacement_y,
+                                    DBUS_TYPE_UINT64, &duration_usec,
+                                    DBUS_TYPE_INVALID);
+}
 
-    KinesixdDevice *device_list = kinesixd_daemon_get_valid_device_list(self->kinesixd_daemon);
-    kinesixd_device_marshaler_append_device_list(device_list, &reply_args);
+static int kinesixd_dbus_adaptor_priv_append_sequence_args(DBusMessage *message, const void *args)
+{
+    return dbus_message_append_args(message,
+                                    DBUS_TYPE_STRING, (const char **)args,
+                                    DBUS_TYPE_INVALID);
+}
 
-    if (!dbus_connection_send(self->d_bus.connection, reply, 0))
-    {
-        LOG_ERROR("Failed send reply for %s.%s called by %s on %s",
-                  dbus_message_get_interface(message),
-                  dbus_message_get_member(message),
-                  dbus_message_get_sender(message),
-                  dbus_message_get_path(message));
-    }
-    else
+static int kinesixd_dbus_adaptor_priv_append_batch_args(DBusMessage *message, const void *args)
+{
+    const struct _BatchArgs *batch = (const struct _BatchArgs *)args;
+    const struct KinesixdGestureSample *sample = 0;
+    DBusMessageIter message_args;
+    DBusMessageIter dbus_array;
+    DBusMessageIter dbus_struct;
+    dbus_int32_t type = 0;
+    dbus_int32_t phase = 0;
+    dbus_int32_t finger_count = 0;
+    dbus_uint64_t time_usec = 0;
+    int error_set = 0;
+    int i = 0;
+
+    dbus_message_iter_init_append(message, &message_args);
+    error_set = !dbus_message_iter_open_container(&message_args, DBUS_TYPE_ARRAY, "(iiidddt)", &dbus_array);
+    for (i = 0; !error_set && (i < batch->sample_count); ++i)
     {
-        dbus_connection_flush(self->d_bus.connection);
+        sample = &batch->samples[i];
+        type = sample->type;
+        phase = sample->phase;
+        finger_count = sample->finger_count;
+        time_usec = sample->time_usec;
+
+        error_set = !dbus_message_iter_open_container(&dbus_array, DBUS_TYPE_STRUCT, 0, &dbus_struct) ||
+                    !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_INT32, &type) ||
+                    !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_INT32, &phase) ||
+                    !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_INT32, &finger_count) ||
+                    !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_DOUBLE, &sample->dx) ||
+                    !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_DOUBLE, &sample->dy) ||
+                    !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_DOUBLE, &sample->scale) ||
+                    !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_UINT64, &time_usec) ||
+                    !dbus_message_iter_close_container(&dbus_array, &dbus_struct);
     }
+    if (!error_set)
+        error_set = !dbus_message_iter_close_container(&message_args, &dbus_array);
 
-    dbus_message_unref(reply);
+    return !error_set;
 }
 
-static void kinesixd_dbus_adaptor_set_active_device(KinesixdDBusAdaptor self,
-                                                          DBusMessage *message)
+/* Called from the event thread, or from every input worker at once. The batch only changes under
+ * its mutex and a full one is taken out under that same lock, so no sample lands past the end.
+ * Sending goes through the signal mutex like every other signal. Samples of different workers
+ * share a batch in the order they arrived, each still carries its own event time */
+static void kinesixd_dbus_adaptor_priv_sample(const struct KinesixdGestureSample *sample,
+                                              void *kinesixd_dbus_adaptor)
 {
-    DBusMessage* reply = 0;
-    DBusMessageIter message_arg;
-    KinesixdDevice device = 0;
+    KinesixdDBusAdaptor self = (KinesixdDBusAdaptor)kinesixd_dbus_adaptor;
+    struct _GestureBatch *batch = &self->gesture_batch;
+    struct KinesixdGestureSample samples[GESTURE_BATCH_CAPACITY];
+    const char *seat = kinesixd_dbus_adaptor_priv_source_seat(self);
+    const char *batch_seat = 0;
+    int sample_count = 0;
 
-    LOG_DEBUG("Called %s.%s on %s",
-              dbus_message_get_interface(message),
-              dbus_message_get_member(message),
-              dbus_message_get_path(message));
+    if (!__atomic_load_n(&batch->enabled, __ATOMIC_RELAXED))
+        return;
 
+    /* Samples from another seat go to another session, whatever was collected so far leaves first */
+    pthread_mutex_lock(&batch->mutex);
+    if (batch->sample_count && !kinesixd_dbus_adaptor_priv_same_seat(batch->seat, seat))
+    {
+        sample_count = batch->sample_count;
+        batch_seat = batch->seat;
+        memcpy(samples, batch->samples, sample_count * sizeof(struct KinesixdGestureSample));
+        batch->sample_count = 0;
+    }
+    pthread_mutex_unlock(&batch->mutex);
 
-    /* Send back an empty reply */
-    reply = dbus_message_new_method_return(message);
-    if (!dbus_connection_send(self->d_bus.connection, reply, 0))
-        LOG_ERROR("Failed to send reply");
-    else
-        dbus_connection_flush(self->d_bus.connection);
+    if (sample_count)
+        kinesixd_dbus_adaptor_priv_send_batch(self, samples, sample_count, batch_seat);
+    sample_count = 0;
 
-    if (!dbus_message_iter_init(message, &message_arg))
+    pthread_mutex_lock(&batch->mutex);
+    if (batch->sample_count == 0)
     {
-        LOG_ERROR("No arguments available");
+        batch->started_ns = kinesixd_statistics_now_ns();
+        batch->seat = seat;
     }
-    else
+    batch->samples[batch->sample_count++] = *sample;
+    /* Once a gesture ends nothing else is coming to share the message with */
+    if ((batch->sample_count == GESTURE_BATCH_CAPACITY) ||
+        (sample->phase == GESTURE_SAMPLE_END) ||
+        (sample->phase == GESTURE_SAMPLE_CANCEL))
     {
-        device = kinesixd_device_marshaler_device_from_dbus_argument(&message_arg);
-        if (device)
-            kinesixd_daemon_set_active_device(self->kinesixd_daemon, device);
+        sample_count = batch->sample_count;
+        batch_seat = batch->seat;
+        memcpy(samples, batch->samples, sample_count * sizeof(struct KinesixdGestureSample));
+        batch->sample_count = 0;
     }
+    pthread_mutex_unlock(&batch->mutex);
 
-    dbus_message_unref(reply);
+    if (sample_count)
+        kinesixd_dbus_adaptor_priv_send_batch(self, samples, sample_count, batch_seat);
 }
 
-static void kinesixd_dbus_adaptor_handle_introspection(KinesixdDBusAdaptor self,
-                                                             DBusMessage *message)
+/* Sends the collected samples, unless force is 0 and the batch window has not passed yet */
+static void kinesixd_dbus_adaptor_priv_flush_batch(KinesixdDBusAdaptor self, int force)
 {
-    DBusMessage* reply = 0;
-    char *introspection_data = 0;
-    const char *object_path = dbus_message_get_path(message);
-
-    if (strcmp(object_path, "/") == 0)
-        introspection_data = strdup(GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_ROOT);
-    else if (strcmp(object_path, "/org") == 0)
-        introspection_data = strdup(GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_ORG);
-    else if (strcmp(object_path, "/org/kicsyromy") == 0)
-        introspection_data = strdup(GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_KICSYROMY);
-    else if (strcmp(object_path, GESTURE_DAEMON_OBJECT_PATH) == 0)
-        introspection_data = strdup(GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_KINESIXD);
-
-    reply = dbus_message_new_method_return(message);
-    if (!dbus_message_append_args(reply,
-                             DBUS_TYPE_STRING,
-                             &introspection_data,
-                             DBUS_TYPE_INVALID))
+    struct _GestureBatch *batch = &self->gesture_batch;
+    struct KinesixdGestureSample samples[GESTURE_BATCH_CAPACITY];
+    uint64_t window_ns = kinesixd_daemon_get_batch_window_ms(self->kinesixd_daemon) * 1000000ull;
+    const char *batch_seat = 0;
+    int sample_count = 0;
+
+    pthread_mutex_lock(&batch->mutex);
+    if (batch->sample_count &&
+        (force || (kinesixd_statistics_now_ns() - batch->started_ns >= window_ns)))
     {
-        LOG_ERROR("Failed create reply for %s.%s called by %s on %s",
-                  dbus_message_get_interface(message),
-                  dbus_message_get_member(message),
-                  dbus_message_get_sender(message),
-                  dbus_message_get_path(message));
+        sample_count = batch->sample_count;
+        batch_seat = batch->seat;
+        memcpy(samples, batch->samples, sample_count * sizeof(struct KinesixdGestureSample));
+        batch->sample_count = 0;
     }
-    else if (!dbus_connection_send(self->d_bus.connection, reply, 0))
+    pthread_mutex_unlock(&batch->mutex);
+
+    if (sample_count)
+        kinesixd_dbus_adaptor_priv_send_batch(self, samples, sample_count, batch_seat);
+}
+
+static void kinesixd_dbus_adaptor_priv_send_batch(KinesixdDBusAdaptor self,
+                                                  const struct KinesixdGestureSample *samples,
+                                                  int sample_count,
+                                                  const char *seat)
+{
+    struct _BatchArgs args = { .samples = samples, .sample_count = sample_count };
+    struct _Signal signal = { .member = "GestureBatch",
+                              .append_args = &kinesixd_dbus_adaptor_priv_append_batch_args,
+                              .args = &args,
+                              .seat = seat };
+    unsigned int gesture_mask = GESTURE_MASK_BATCH;
+    int sent = 0;
+    int i = 0;
+
+    /* Samples are a stream, the next batch is worth more to a slow receiver than this one. Only
+     * the gestures themselves keep going out past the limit */
+    if (dbus_connection_get_outgoing_size(self->d_bus.connection) > OUTGOING_LIMIT_BYTES)
     {
-        LOG_ERROR("Failed send reply for %s.%s called by %s on %s",
-                  dbus_message_get_interface(message),
-                  dbus_message_get_member(message),
-                  dbus_message_get_sender(message),
-                  dbus_message_get_path(message));
+        kinesixd_statistics_increment(STATISTICS_GESTURE_BATCHES_DROPPED);
+        return;
     }
-    else
+
+    for (i = 0; i < args.sample_count; ++i)
+        gesture_mask |= (samples[i].type == GESTURE_SAMPLE_SWIPE) ? GESTURE_MASK_SWIPE : GESTURE_MASK_PINCH;
+
+    kinesixd_dbus_adaptor_priv_lock_signal_mutex(self);
+    if ((sent = kinesixd_dbus_adaptor_priv_send(self, &signal, gesture_mask)))
+        kinesixd_dbus_adaptor_priv_write_pending(self);
+    pthread_mutex_unlock(&self->d_bus.message_listener.signal_mutex);
+
+    if (!sent)
     {
-        dbus_connection_flush(self->d_bus.connection);
+        LOG_ERROR("Failed to send DBus signal %s.GestureBatch with %d samples. Probably out of memory.",
+                  GESTURE_DAEMON_INTERFACE_NAME,
+                  args.sample_count);
     }
-    dbus_message_unref(reply);
-    free(introspection_data);
 }
 
-static void kinesixd_dbus_adaptor_handle_unkown_message(KinesixdDBusAdaptor self,
-                                                              DBusMessage *message)
+/* Registry entries never change, so the seat string lives as long as the daemon */
+static const char *kinesixd_dbus_adaptor_priv_source_seat(KinesixdDBusAdaptor self)
 {
-    DBusMessage* reply = 0;
+    KinesixdDevice source = kinesixd_daemon_get_gesture_source(self->kinesixd_daemon);
 
-    LOG_WARN("Unhadled method called");
+    return source ? kinesixd_device_get_seat(source) : 0;
+}
 
-    reply = dbus_message_new_method_return(message);
-    if (!dbus_connection_send(self->d_bus.connection, reply, 0))
+/* No seat is the default one */
+static int kinesixd_dbus_adaptor_priv_same_seat(const char *seat, const char *other_seat)
+{
+    return strcmp(seat ? seat : "seat0", other_seat ? other_seat : "seat0") == 0;
+}
+
+static void kinesixd_dbus_adaptor_priv_update_batching(KinesixdDBusAdaptor self)
+{
+    int enabled = kinesixd_session_router_count_subscribers(self->session_router, GESTURE_MASK_BATCH) > 0;
+
+    if (enabled == __atomic_load_n(&self->gesture_batch.enabled, __ATOMIC_RELAXED))
+        return;
+
+    __atomic_store_n(&self->gesture_batch.enabled, enabled, __ATOMIC_RELAXED);
+    if (enabled)
     {
-        LOG_ERROR("Failed to send reply for %s.%s called by %s on %s",
-                  dbus_message_get_interface(message),
-                  dbus_message_get_member(message),
-                  dbus_message_get_sender(message),
-                  dbus_message_get_path(message));
+        LOG_DEBUG("Collecting gesture batches");
     }
     else
     {
-        dbus_connection_flush(self->d_bus.connection);
+        LOG_DEBUG("Nobody wants gesture batches anymore");
     }
-    dbus_message_unref(reply);
 }
 
-static void *kinesixd_dbus_adaptor_priv_listen_for_messages(void *kinesixd_dbus_adaptor)
+static void kinesixd_dbus_adaptor_priv_lock_signal_mutex(KinesixdDBusAdaptor self)
 {
-    KinesixdDBusAdaptor self = (KinesixdDBusAdaptor)kinesixd_dbus_adaptor;
-    int stop_issued = 0;
-    DBusMessage *message = 0;
+    uint64_t wait_start = 0;
 
-    for (;;)
+    /* The uncontended case stays a single atomic operation */
+    if (pthread_mutex_trylock(&self->d_bus.message_listener.signal_mutex) == 0)
     {
-        pthread_mutex_lock(&self->d_bus.message_listener.stop_mutex);
-        stop_issued = self->d_bus.message_listener.stop_issued;
-        pthread_mutex_unlock(&self->d_bus.message_listener.stop_mutex);
+        kinesixd_statistics_record(STATISTICS_SIGNAL_MUTEX_WAIT, 0);
+        return;
+    }
 
-        if (stop_issued)
-            break;
+    wait_start = kinesixd_statistics_now_ns();
+    kinesixd_timeline_begin("signal_mutex wait");
+    pthread_mutex_lock(&self->d_bus.message_listener.signal_mutex);
+    kinesixd_timeline_end("signal_mutex wait");
+    kinesixd_statistics_record(STATISTICS_SIGNAL_MUTEX_WAIT, kinesixd_statistics_now_ns() - wait_start);
+}
+
+static unsigned int kinesixd_dbus_adaptor_priv_send_to(const char *destination, void *route_context)
+{
+    struct _RouteContext *context = (struct _RouteContext *)route_context;
+    const struct _Signal *signal = context->signal;
+    DBusMessage *message = 0;
+    dbus_uint32_t serial = 0;
+
+    /* Unicast messages are what keeps one session's gestures away from every other session.
+     * Each one is built from scratch rather than copied: a new message comes out of the five
+     * libdbus keeps around once written, so steady gesture traffic reuses their memory, while
+     * a copy is allocated anew every time. That is all it is, more receivers than the cache
+     * holds, or ones that read slowly, still allocate here */
+    kinesixd_timeline_begin("build message");
+    message = dbus_message_new_signal(GESTURE_DAEMON_OBJECT_PATH, GESTURE_DAEMON_INTERFACE_NAME, signal->member);
+    if (message &&
+        (!signal->append_args(message, signal->args) ||
+         (destination && !dbus_message_set_destination(message, destination))))
+    {
+        dbus_message_unref(message);
+        message = 0;
+    }
+    kinesixd_timeline_end("build message");
+
+    if (!message || !dbus_connection_send(context->dbus_adaptor->d_bus.connection, message, &serial))
+    {
+        LOG_WARN("Failed to send signal %s to %s", signal->member, destination ? destination : "the bus");
+        context->error_set = 1;
+        serial = 0;
+    }
+
+    if (message)
+        dbus_message_unref(message);
+
+    return serial;
+}
+
+/* Expects the signal mutex to be held */
+static void kinesixd_dbus_adaptor_priv_write_pending(KinesixdDBusAdaptor self)
+{
+    /* Writes whatever the socket takes right now and returns, unlike a flush it never waits
+     * for a bus that stopped reading. The message listener writes out the rest */
+    kinesixd_timeline_begin("write");
+    kinesixd_statistics_record(STATISTICS_OUTGOING_BYTES, dbus_connection_get_outgoing_size(self->d_bus.connection));
+    dbus_connection_read_write(self->d_bus.connection, 0);
+    kinesixd_timeline_end("write");
+}
+
+/* Every reply leaves through here like gestures do, under the signal mutex and without waiting for
+ * the bus to read it */
+static int kinesixd_dbus_adaptor_priv_send_reply(KinesixdDBusAdaptor self, DBusMessage *reply)
+{
+    int sent = 0;
+
+    kinesixd_dbus_adaptor_priv_lock_signal_mutex(self);
+    sent = dbus_connection_send(self->d_bus.connection, reply, 0);
+    if (sent)
+        kinesixd_dbus_adaptor_priv_write_pending(self);
+    pthread_mutex_unlock(&self->d_bus.message_listener.signal_mutex);
+
+    return sent;
+}
+
+/* Expects the signal mutex to be held */
+static int kinesixd_dbus_adaptor_priv_send(KinesixdDBusAdaptor self,
+                                           const struct _Signal *signal,
+                                           unsigned int gesture_mask)
+{
+    struct _RouteContext context = { .dbus_adaptor = self, .signal = signal, .error_set = 0 };
+
+    if (self->bus_type == DBUS_BUS_SYSTEM)
+    {
+        kinesixd_session_router_route(self->session_router,
+                                      signal->seat,
+                                      gesture_mask,
+                                      &kinesixd_dbus_adaptor_priv_send_to,
+                                      &context);
+    }
+    else
+    {
+        kinesixd_dbus_adaptor_priv_send_to(0, &context);
+    }
+
+    return !context.error_set;
+}
+
+static int kinesixd_dbus_adaptor_priv_emit(KinesixdDBusAdaptor self,
+                                           const struct _Signal *signal,
+                                           StatisticsGesture gesture,
+                                           int result,
+                                           int finger_count)
+{
+    int sent = 0;
+    uint64_t event_time_usec = kinesixd_statistics_get_current_event_time_usec();
+    unsigned int gesture_mask = (gesture == STATISTICS_GESTURE_SWIPE) ? GESTURE_MASK_SWIPE : GESTURE_MASK_PINCH;
+
+    kinesixd_dbus_adaptor_priv_lock_signal_mutex(self);
+    PROBE_DBUS_SEND(gesture, result, finger_count, event_time_usec);
+    kinesixd_timeline_begin("send");
+    sent = kinesixd_dbus_adaptor_priv_send(self, signal, gesture_mask);
+    kinesixd_timeline_end("send");
+
+    if (sent)
+    {
+        kinesixd_dbus_adaptor_priv_write_pending(self);
+        PROBE_DBUS_FLUSH(gesture, result, finger_count, event_time_usec);
+    }
+    pthread_mutex_unlock(&self->d_bus.message_listener.signal_mutex);
+
+    kinesixd_flight_recorder_record(FLIGHT_RECORD_SIGNAL,
+                                    event_time_usec,
+                                    gesture,
+                                    finger_count,
+                                    result,
+                                    sent ? 0 : FLIGHT_RECORD_FAILED,
+                                    0, 0);
+    if (sent)
+        kinesixd_statistics_gesture_emitted(gesture, finger_count);
+
+    return sent;
+}
+
+static void kinesixd_dbus_adaptor_priv_update_idle(KinesixdDBusAdaptor self)
+{
+    int idle = kinesixd_session_router_get_subscriber_count(self->session_router) == 0;
+
+    /* The message listener reads it to decide whether to sleep */
+    if (idle == __atomic_load_n(&self->idle, __ATOMIC_RELAXED))
+        return;
+
+    __atomic_store_n(&self->idle, idle, __ATOMIC_RELAXED);
+    kinesixd_daemon_set_idle_async(self->kinesixd_daemon, idle, 0, 0);
+}
+
+static int64_t kinesixd_dbus_adaptor_priv_monotonic_seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (int64_t)now.tv_sec;
+}
+
+static char *kinesixd_dbus_adaptor_priv_runtime_file_path(DBusBusType type, const char *file_name)
+{
+    const char *runtime_dir = 0;
+    char *path = 0;
+
+    /* Runtime directories live exactly as long as the boot, which is what everything kept there is valid for */
+    if (type == DBUS_BUS_SYSTEM)
+        runtime_dir = "/run";
+    else if (!(runtime_dir = getenv("XDG_RUNTIME_DIR")))
+        return 0;
+
+    path = (char *)malloc(strlen(runtime_dir) + strlen(file_name) + 2);
+    sprintf(path, "%s/%s", runtime_dir, file_name);
+
+    return path;
+}
+
+static void kinesixd_dbus_adaptor_priv_finish_trace(KinesixdDBusAdaptor self)
+{
+    if (!self->trace_deadline_ns || (kinesixd_statistics_now_ns() < self->trace_deadline_ns))
+        return;
+
+    kinesixd_timeline_stop();
+    self->trace_deadline_ns = 0;
+    LOG("Trace capture finished");
+}
+
+static void kinesixd_dbus_adaptor_priv_restore_active_device(KinesixdDBusAdaptor self)
+{
+    char device_path[PATH_MAX];
+    KinesixdDevice *device_list = 0;
+    KinesixdDevice device = 0;
+    int device_count = 0;
+    FILE *state_file = 0;
+
+    if (!self->state_file_path || !(state_file = fopen(self->state_file_path, "r")))
+        return;
+
+    if (fgets(device_path, sizeof(device_path), state_file))
+    {
+        device_path[strcspn(device_path, "\n")] = '\0';
+        device_list = kinesixd_daemon_get_valid_device_list(self->kinesixd_daemon, &device_count);
+        if ((device = kinesixd_device_list_find_by_path(device_list, device_path)))
+        {
+            LOG_DEBUG("Restoring active device %s", device_path);
+            kinesixd_daemon_set_active_device(self->kinesixd_daemon, device);
+        }
+    }
+
+    fclose(state_file);
+}
+
+static void kinesixd_dbus_adaptor_priv_save_active_device(KinesixdDBusAdaptor self)
+{
+    KinesixdDevice device = kinesixd_daemon_get_active_device(self->kinesixd_daemon);
+    FILE *state_file = 0;
+
+    if (!self->state_file_path || !device)
+        return;
+
+    if (!(state_file = fopen(self->state_file_path, "w")))
+    {
+        LOG_WARN("Could not save active device to %s. %s", self->state_file_path, strerror(errno));
+        return;
+    }
+
+    fprintf(state_file, "%s\n", kinesixd_device_get_path(device));
+    fclose(state_file);
+}
+
+static pid_t kinesixd_dbus_adaptor_priv_get_sender_pid(KinesixdDBusAdaptor self,
+                                                       DBusMessage *message)
+{
+    DBusMessage *request = 0;
+    DBusMessage *reply = 0;
+    DBusError error;
+    const char *sender = dbus_message_get_sender(message);
+    dbus_uint32_t pid = 0;
+
+    if (!sender || !self->d_bus.lookup_connection)
+        return 0;
+
+    request = dbus_message_new_method_call(DBUS_SERVICE_DBUS,
+                                           DBUS_PATH_DBUS,
+                                           DBUS_INTERFACE_DBUS,
+                                           "GetConnectionUnixProcessID");
+    if (!request)
+        return 0;
+
+    dbus_error_init(&error);
+    if (dbus_message_append_args(request, DBUS_TYPE_STRING, &sender, DBUS_TYPE_INVALID))
+    {
+        reply = dbus_connection_send_with_reply_and_block(self->d_bus.lookup_connection,
+                                                          request,
+                                                          DBUS_TIMEOUT_USE_DEFAULT,
+                                                          &error);
+        if (reply)
+        {
+            dbus_message_get_args(reply, &error, DBUS_TYPE_UINT32, &pid, DBUS_TYPE_INVALID);
+            dbus_message_unref(reply);
+        }
+    }
+
+    if (dbus_error_is_set(&error))
+    {
+        LOG_WARN("Could not get the process id of %s. %s", sender, error.message);
+        dbus_error_free(&error);
+    }
+    dbus_message_unref(request);
+
+    return (pid_t)pid;
+}
+
+static DBusMessage *kinesixd_dbus_adaptor_priv_reply_from_template(DBusMessage *reply_template,
+                                                                   DBusMessage *message)
+{
+    DBusMessage *reply = 0;
+
+    /* Copying a message duplicates the already marshaled body as is, we only patch up the header */
+    reply = dbus_message_copy(reply_template);
+    if (reply)
+    {
+        dbus_message_set_no_reply(reply, TRUE);
+        if (!dbus_message_set_reply_serial(reply, dbus_message_get_serial(message)) ||
+            (dbus_message_get_sender(message) &&
+             !dbus_message_set_destination(reply, dbus_message_get_sender(message))))
+        {
+            dbus_message_unref(reply);
+            reply = 0;
+        }
+    }
+
+    return reply;
+}
+
+static int kinesixd_dbus_adaptor_priv_append_property(KinesixdDBusAdaptor self,
+                                                      DaemonProperty property,
+                                                      DBusMessageIter *dbus_iter)
+{
+    DBusMessageIter dbus_variant;
+    DBusMessageIter dbus_dict;
+    DBusMessageIter dbus_entry;
+    KinesixdDevice *device_list = 0;
+    int device_count = 0;
+    const char *key = 0;
+    double value = 0;
+    uint64_t counter = 0;
+    int i = 0;
+    int error_set = 0;
+
+    if (!dbus_message_iter_open_container(dbus_iter,
+                                          DBUS_TYPE_VARIANT,
+                                          daemon_properties[property].signature,
+                                          &dbus_variant))
+    {
+        LOG_ERROR("Failed to open DBus container for property %s. Not enough memory",
+                  daemon_properties[property].name);
+        return 1;
+    }
+
+    switch (property)
+    {
+    case PROP_ACTIVE_DEVICE:
+        error_set = kinesixd_device_marshaler_append_device(
+                    kinesixd_daemon_get_active_device(self->kinesixd_daemon), &dbus_variant);
+        break;
+    case PROP_DEVICES:
+        device_list = kinesixd_daemon_get_valid_device_list(self->kinesixd_daemon, &device_count);
+        error_set = kinesixd_device_marshaler_append_device_list(device_list, &dbus_variant);
+        break;
+    case PROP_THRESHOLDS:
+        key = "gesture_delta";
+        value = self->property_cache.gesture_delta;
+        error_set = !dbus_message_iter_open_container(&dbus_variant, DBUS_TYPE_ARRAY, "{sd}", &dbus_dict);
+        if (!error_set)
+        {
+            error_set = !dbus_message_iter_open_container(&dbus_dict, DBUS_TYPE_DICT_ENTRY, 0, &dbus_entry) ||
+                        !dbus_message_iter_append_basic(&dbus_entry, DBUS_TYPE_STRING, &key) ||
+                        !dbus_message_iter_append_basic(&dbus_entry, DBUS_TYPE_DOUBLE, &value) ||
+                        !dbus_message_iter_close_container(&dbus_dict, &dbus_entry) ||
+                        !dbus_message_iter_close_container(&dbus_variant, &dbus_dict);
+        }
+        break;
+    case PROP_SWIPES_EMITTED:
+        for (i = 0; i <= STATISTICS_MAX_FINGER_COUNT; ++i)
+            counter += kinesixd_statistics_get_gestures_emitted(STATISTICS_GESTURE_SWIPE, i);
+        error_set = !dbus_message_iter_append_basic(&dbus_variant, DBUS_TYPE_UINT64, &counter);
+        break;
+    case PROP_PINCHES_EMITTED:
+        for (i = 0; i <= STATISTICS_MAX_FINGER_COUNT; ++i)
+            counter += kinesixd_statistics_get_gestures_emitted(STATISTICS_GESTURE_PINCH, i);
+        error_set = !dbus_message_iter_append_basic(&dbus_variant, DBUS_TYPE_UINT64, &counter);
+        break;
+    default:
+        error_set = 1;
+        break;
+    }
+
+    if (!error_set && (error_set = !dbus_message_iter_close_container(dbus_iter, &dbus_variant)))
+        LOG_ERROR("Failed to close DBus container for property %s. Not enough memory",
+                  daemon_properties[property].name);
+    if (error_set)
+        dbus_message_iter_abandon_container(dbus_iter, &dbus_variant);
+
+    return error_set;
+}
+
+static int kinesixd_dbus_adaptor_priv_append_properties(KinesixdDBusAdaptor self,
+                                                        const char *interface,
+                                                        const int *properties,
+                                                        int property_count,
+                                                        DBusMessageIter *dbus_iter)
+{
+    DBusMessageIter dbus_dict;
+    DBusMessageIter dbus_entry;
+    int i = 0;
+    int error_set = 0;
+
+    if ((error_set = !dbus_message_iter_open_container(dbus_iter, DBUS_TYPE_ARRAY, "{sv}", &dbus_dict)))
+    {
+        LOG_ERROR("Failed to open DBus container for properties. Not enough memory");
+        return error_set;
+    }
+
+    for (i = 0; (i < property_count) && !error_set; ++i)
+    {
+        if (strcmp(daemon_properties[properties[i]].interface, interface) != 0)
+            continue;
+
+        if (!(error_set = !dbus_message_iter_open_container(&dbus_dict, DBUS_TYPE_DICT_ENTRY, 0, &dbus_entry)))
+        {
+            if (!(error_set = !dbus_message_iter_append_basic(&dbus_entry,
+                                                              DBUS_TYPE_STRING,
+                                                              &daemon_properties[properties[i]].name)))
+                error_set = kinesixd_dbus_adaptor_priv_append_property(self, properties[i], &dbus_entry);
+
+            if (!error_set)
+                error_set = !dbus_message_iter_close_container(&dbus_dict, &dbus_entry);
+            else
+                dbus_message_iter_abandon_container(&dbus_dict, &dbus_entry);
+        }
+    }
+
+    if (!error_set && (error_set = !dbus_message_iter_close_container(dbus_iter, &dbus_dict)))
+        LOG_ERROR("Failed to close DBus container for properties. Not enough memory");
+    if (error_set)
+        dbus_message_iter_abandon_container(dbus_iter, &dbus_dict);
+
+    return error_set;
+}
+
+static void kinesixd_dbus_adaptor_priv_sync_properties(KinesixdDBusAdaptor self)
+{
+    int changed_properties[PROP_COUNT];
+    int changed_count = 0;
+    KinesixdDevice active_device = kinesixd_daemon_get_active_device(self->kinesixd_daemon);
+    int active_device_id = active_device ? active_device->id : 0;
+    unsigned int generation = kinesixd_daemon_get_device_list_generation(self->kinesixd_daemon);
+    double gesture_delta = kinesixd_daemon_get_gesture_delta(self->kinesixd_daemon);
+    const char *interface = GESTURE_DAEMON_INTERFACE_NAME;
+    DBusMessage *signal = 0;
+    DBusMessageIter signal_args;
+    DBusMessageIter dbus_invalidated;
+    int i = 0;
+
+    if (active_device_id != self->property_cache.active_device_id)
+        changed_properties[changed_count++] = PROP_ACTIVE_DEVICE;
+    if (generation != self->property_cache.device_list_generation)
+        changed_properties[changed_count++] = PROP_DEVICES;
+    if (gesture_delta != self->property_cache.gesture_delta)
+        changed_properties[changed_count++] = PROP_THRESHOLDS;
+
+    if (!changed_count)
+        return;
+
+    /* Leaving the cache alone means the next sync after the backlog cleared publishes only the
+     * latest values, however often they changed in between. Each property counts once for
+     * every time it gets held back, not for every pass spent waiting */
+    if (dbus_connection_get_outgoing_size(self->d_bus.connection) > OUTGOING_LIMIT_BYTES)
+    {
+        for (i = 0; i < changed_count; ++i)
+        {
+            if (self->property_cache.coalesced & (1u << changed_properties[i]))
+                continue;
+
+            self->property_cache.coalesced |= 1u << changed_properties[i];
+            kinesixd_statistics_increment(STATISTICS_SIGNALS_COALESCED);
+        }
+        return;
+    }
+
+    self->property_cache.coalesced = 0;
+    if (active_device_id != self->property_cache.active_device_id)
+    {
+        self->property_cache.active_device_id = active_device_id;
+        kinesixd_dbus_adaptor_priv_save_active_device(self);
+    }
+    self->property_cache.device_list_generation = generation;
+    self->property_cache.gesture_delta = gesture_delta;
+
+    ++self->property_cache.version;
+
+    signal = dbus_message_new_signal(GESTURE_DAEMON_OBJECT_PATH,
+                                     DBUS_INTERFACE_PROPERTIES,
+                                     "PropertiesChanged");
+    if (!signal)
+    {
+        LOG_ERROR("Could not create DBus message. Unable to send signal %s.PropertiesChanged",
+                  DBUS_INTERFACE_PROPERTIES);
+        return;
+    }
+
+    dbus_message_iter_init_append(signal, &signal_args);
+    if (!dbus_message_iter_append_basic(&signal_args, DBUS_TYPE_STRING, &interface) ||
+        kinesixd_dbus_adaptor_priv_append_properties(self, interface, changed_properties, changed_count, &signal_args) ||
+        !dbus_message_iter_open_container(&signal_args, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING_AS_STRING, &dbus_invalidated) ||
+        !dbus_message_iter_close_container(&signal_args, &dbus_invalidated))
+    {
+        LOG_ERROR("Could not append agruments to signal. Probably out of memory.");
+        dbus_message_unref(signal);
+        return;
+    }
+
+    kinesixd_dbus_adaptor_priv_lock_signal_mutex(self);
+    if (!dbus_connection_send(self->d_bus.connection, signal, 0))
+        LOG_ERROR("Failed to send DBus signal %s.PropertiesChanged. Probably out of memory.",
+                  DBUS_INTERFACE_PROPERTIES);
+    else
+        kinesixd_dbus_adaptor_priv_write_pending(self);
+    pthread_mutex_unlock(&self->d_bus.message_listener.signal_mutex);
+
+    dbus_message_unref(signal);
+}
+
+static DBusMessage *kinesixd_dbus_adaptor_priv_device_list_reply(KinesixdDBusAdaptor self,
+                                                                 DBusMessage *message)
+{
+    DBusMessage *reply = 0;
+    DBusMessageIter reply_args;
+    KinesixdDevice *device_list = 0;
+    int device_count = 0;
+    unsigned int generation = kinesixd_daemon_get_device_list_generation(self->kinesixd_daemon);
+
+    pthread_mutex_lock(&self->device_list_cache.mutex);
+    if (!self->device_list_cache.message || (self->device_list_cache.generation != generation))
+    {
+        if (self->device_list_cache.message)
+        {
+            dbus_message_unref(self->device_list_cache.message);
+            self->device_list_cache.message = 0;
+        }
+
+        /* The cached message only serves as storage for the marshaled device array */
+        reply = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+        if (!reply)
+        {
+            LOG_ERROR("Could not create DBus message. Not enough memory");
+            pthread_mutex_unlock(&self->device_list_cache.mutex);
+            return 0;
+        }
+
+        dbus_message_iter_init_append(reply, &reply_args);
+        device_list = kinesixd_daemon_get_valid_device_list(self->kinesixd_daemon, &device_count);
+        if (kinesixd_device_marshaler_append_device_list(device_list, &reply_args))
+        {
+            dbus_message_unref(reply);
+            pthread_mutex_unlock(&self->device_list_cache.mutex);
+            return 0;
+        }
+
+        self->device_list_cache.message = reply;
+        self->device_list_cache.generation = generation;
+        LOG_DEBUG("Rebuilt device list reply for generation %u with %d devices", generation, device_count);
+    }
+
+    reply = kinesixd_dbus_adaptor_priv_reply_from_template(self->device_list_cache.message, message);
+    pthread_mutex_unlock(&self->device_list_cache.mutex);
+
+    return reply;
+}
+
+static void kinesixd_dbus_adaptor_get_valid_device_list(KinesixdDBusAdaptor self,
+                                                              DBusMessage *message)
+{
+    DBusMessage* reply = 0;
+
+    LOG_DEBUG("Called %s.%s on %s",
+              dbus_message_get_interface(message),
+              dbus_message_get_member(message),
+              dbus_message_get_path(message));
+
+    reply = kinesixd_dbus_adaptor_priv_device_list_reply(self, message);
+    if (!reply)
+    {
+        LOG_ERROR("Failed create reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+        return;
+    }
+
+    if (!kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+    {
+        LOG_ERROR("Failed send reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+    }
+
+    dbus_message_unref(reply);
+}
+
+static void kinesixd_dbus_adaptor_set_active_device(KinesixdDBusAdaptor self,
+                                                          DBusMessage *message)
+{
+    DBusMessage* reply = 0;
+    DBusMessageIter message_arg;
+    KinesixdDevice *device_list = 0;
+    KinesixdDevice device = 0;
+    struct _PendingReply *pending = 0;
+    int device_count = 0;
+    pid_t pid = 0;
+
+    LOG_DEBUG("Called %s.%s on %s",
+              dbus_message_get_interface(message),
+              dbus_message_get_member(message),
+              dbus_message_get_path(message));
+
+    if (dbus_message_iter_init(message, &message_arg))
+    {
+        device_list = kinesixd_daemon_get_valid_device_list(self->kinesixd_daemon, &device_count);
+        device = kinesixd_device_marshaler_find_device(&message_arg, device_list);
+    }
+
+    /* The device is shared by every session, only the one in front of its seat gets to pick it */
+    if (device && (self->bus_type == DBUS_BUS_SYSTEM))
+        pid = kinesixd_dbus_adaptor_priv_get_sender_pid(self, message);
+
+    if (!device)
+    {
+        reply = dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, "Unknown device");
+    }
+    else if (!kinesixd_session_router_session_is_active(self->session_router, pid, kinesixd_device_get_seat(device)))
+    {
+        reply = dbus_message_new_error(message,
+                                       DBUS_ERROR_ACCESS_DENIED,
+                                       "Caller's session is not the active one on the device's seat");
+    }
+    else if (!(pending = (struct _PendingReply *)malloc(sizeof(struct _PendingReply))))
+    {
+        reply = dbus_message_new_error(message, DBUS_ERROR_NO_MEMORY, "Out of memory");
+    }
+    else
+    {
+        /* Only queued here, the caller gets its reply once the poller opened the device or failed
+         * to. The registry outlives the daemon's use of it, so the device is handed over as found */
+        pending->dbus_adaptor = self;
+        pending->message = dbus_message_ref(message);
+        kinesixd_daemon_set_active_device_async(self->kinesixd_daemon,
+                                                device,
+                                                &kinesixd_dbus_adaptor_priv_active_device_applied,
+                                                pending);
+        return;
+    }
+
+    if (!reply || !kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+        LOG_ERROR("Failed to send reply");
+
+    if (reply)
+        dbus_message_unref(reply);
+}
+
+static void kinesixd_dbus_adaptor_priv_active_device_applied(KinesixDaemon kinesixd_daemon,
+                                                             int success,
+                                                             void *pending_reply)
+{
+    struct _PendingReply *pending = (struct _PendingReply *)pending_reply;
+    DBusMessage* reply = 0;
+
+    UNUSED(kinesixd_daemon)
+
+    if (success)
+        reply = dbus_message_new_method_return(pending->message);
+    else
+        reply = dbus_message_new_error(pending->message, DBUS_ERROR_FAILED, "Could not open the device");
+
+    if (!reply || !kinesixd_dbus_adaptor_priv_send_reply(pending->dbus_adaptor, reply))
+        LOG_ERROR("Failed to send reply");
+
+    if (reply)
+        dbus_message_unref(reply);
+    dbus_message_unref(pending->message);
+    free(pending);
+}
+
+static void kinesixd_dbus_adaptor_handle_subscription(KinesixdDBusAdaptor self,
+                                                      DBusMessage *message)
+{
+    DBusMessage* reply = 0;
+    DBusError error;
+    dbus_uint32_t gesture_mask = GESTURE_MASK_ALL;
+    pid_t pid = 0;
+
+    LOG_DEBUG("Called %s.%s on %s",
+              dbus_message_get_interface(message),
+              dbus_message_get_member(message),
+              dbus_message_get_path(message));
+
+    dbus_error_init(&error);
+
+    if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "Unsubscribe"))
+    {
+        kinesixd_session_router_unsubscribe(self->session_router, dbus_message_get_sender(message));
+        reply = dbus_message_new_method_return(message);
+    }
+    else if (dbus_message_get_args(message, &error, DBUS_TYPE_UINT32, &gesture_mask, DBUS_TYPE_INVALID))
+    {
+        /* Sessions only matter when serving the whole system */
+        if (self->bus_type == DBUS_BUS_SYSTEM)
+            pid = kinesixd_dbus_adaptor_priv_get_sender_pid(self, message);
+
+        if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "Subscribe"))
+        {
+            kinesixd_session_router_subscribe(self->session_router,
+                                              dbus_message_get_sender(message),
+                                              pid,
+                                              gesture_mask);
+            reply = dbus_message_new_method_return(message);
+        }
+        else if (kinesixd_session_router_set_session_policy(self->session_router, pid, gesture_mask))
+        {
+            reply = dbus_message_new_method_return(message);
+        }
+        else
+        {
+            reply = dbus_message_new_error(message,
+                                           DBUS_ERROR_ACCESS_DENIED,
+                                           "Caller does not belong to a login session");
+        }
+    }
+    else
+    {
+        reply = dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, error.message);
+        dbus_error_free(&error);
+    }
+
+    if (!reply || !kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+    {
+        LOG_ERROR("Failed send reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+    }
+
+    if (reply)
+        dbus_message_unref(reply);
+}
+
+static void kinesixd_dbus_adaptor_handle_error(KinesixdDBusAdaptor self,
+                                               DBusMessage *message)
+{
+    /* Signals do not expect replies, so the bus only answers one when it refused to deliver it */
+    if (!dbus_message_is_error(message, DBUS_ERROR_LIMITS_EXCEEDED))
+    {
+        LOG_DEBUG("Ignoring error %s", dbus_message_get_error_name(message));
+        return;
+    }
+
+    kinesixd_statistics_increment(STATISTICS_SIGNALS_REJECTED);
+    if (!kinesixd_session_router_signal_rejected(self->session_router, dbus_message_get_reply_serial(message)))
+        LOG_DEBUG("The bus rejected a signal, its receiver is falling behind");
+}
+
+static void kinesixd_dbus_adaptor_priv_append_subscriber(const char *bus_name,
+                                                         uint64_t signals_routed,
+                                                         uint64_t signals_rejected,
+                                                         void *counter_context)
+{
+    struct _CounterContext *context = (struct _CounterContext *)counter_context;
+    DBusMessageIter dbus_entry;
+    char counter_name[320];
+    const char *name = counter_name;
+    const uint64_t values[] = { signals_routed, signals_rejected };
+    const char *value_names[] = { "signals_routed", "signals_rejected" };
+    int i = 0;
+
+    for (i = 0; !context->error_set && (i < 2); ++i)
+    {
+        snprintf(counter_name, sizeof(counter_name), "%s[%s]", value_names[i], bus_name);
+        context->error_set = !dbus_message_iter_open_container(context->dbus_dict, DBUS_TYPE_DICT_ENTRY, 0, &dbus_entry) ||
+                             !dbus_message_iter_append_basic(&dbus_entry, DBUS_TYPE_STRING, &name) ||
+                             !dbus_message_iter_append_basic(&dbus_entry, DBUS_TYPE_UINT64, &values[i]) ||
+                             !dbus_message_iter_close_container(context->dbus_dict, &dbus_entry);
+    }
+}
+
+static void kinesixd_dbus_adaptor_get_statistics(KinesixdDBusAdaptor self,
+                                                 DBusMessage *message)
+{
+    static const char *gesture_names[] = { "swipe", "pinch" };
+    struct KinesixdHistogramSnapshot snapshot;
+    DBusMessage* reply = 0;
+    DBusMessageIter reply_args;
+    DBusMessageIter dbus_dict;
+    DBusMessageIter dbus_entry;
+    DBusMessageIter dbus_struct;
+    DBusMessageIter dbus_buckets;
+    DBusMessageIter dbus_bucket;
+    char counter_name[64];
+    const char *name = counter_name;
+    struct _CounterContext counter_context = { .dbus_dict = &dbus_dict, .error_set = 0 };
+    uint64_t value = 0;
+    int gesture = 0;
+    int finger_count = 0;
+    int bucket = 0;
+    int i = 0;
+    int error_set = 0;
+
+    LOG_DEBUG("Called %s.%s on %s",
+              dbus_message_get_interface(message),
+              dbus_message_get_member(message),
+              dbus_message_get_path(message));
+
+    reply = dbus_message_new_method_return(message);
+    if (!reply)
+    {
+        LOG_ERROR("Could not create DBus message. Not enough memory");
+        return;
+    }
+    dbus_message_iter_init_append(reply, &reply_args);
+
+    /* Counters: a{st} */
+    error_set = !dbus_message_iter_open_container(&reply_args, DBUS_TYPE_ARRAY, "{st}", &dbus_dict);
+    for (i = 0; !error_set && (i < STATISTICS_COUNTER_COUNT); ++i)
+    {
+        name = kinesixd_statistics_get_counter_name(i);
+        value = kinesixd_statistics_get_counter(i);
+        error_set = !dbus_message_iter_open_container(&dbus_dict, DBUS_TYPE_DICT_ENTRY, 0, &dbus_entry) ||
+                    !dbus_message_iter_append_basic(&dbus_entry, DBUS_TYPE_STRING, &name) ||
+                    !dbus_message_iter_append_basic(&dbus_entry, DBUS_TYPE_UINT64, &value) ||
+                    !dbus_message_iter_close_container(&dbus_dict, &dbus_entry);
+    }
+    for (gesture = 0; !error_set && (gesture < STATISTICS_GESTURE_COUNT); ++gesture)
+    {
+        for (finger_count = 0; !error_set && (finger_count <= STATISTICS_MAX_FINGER_COUNT); ++finger_count)
+        {
+            if (!(value = kinesixd_statistics_get_gestures_emitted(gesture, finger_count)))
+                continue;
+
+            snprintf(counter_name, sizeof(counter_name), "%s_emitted_fingers_%d", gesture_names[gesture], finger_count);
+            name = counter_name;
+            error_set = !dbus_message_iter_open_container(&dbus_dict, DBUS_TYPE_DICT_ENTRY, 0, &dbus_entry) ||
+                        !dbus_message_iter_append_basic(&dbus_entry, DBUS_TYPE_STRING, &name) ||
+                        !dbus_message_iter_append_basic(&dbus_entry, DBUS_TYPE_UINT64, &value) ||
+                        !dbus_message_iter_close_container(&dbus_dict, &dbus_entry);
+        }
+    }
+    /* Per subscriber, as name[bus name]. Only unicast routing on the system bus fills these */
+    if (!error_set)
+    {
+        kinesixd_session_router_foreach_subscriber(self->session_router,
+                                                   &kinesixd_dbus_adaptor_priv_append_subscriber,
+                                                   &counter_context);
+        error_set = counter_context.error_set;
+    }
+    if (!error_set)
+        error_set = !dbus_message_iter_close_container(&reply_args, &dbus_dict);
+
+    /* Histograms: a{s(ttta(tt))}, name -> (count, sum, max, [(bucket upper bound, count)]) */
+    if (!error_set)
+        error_set = !dbus_message_iter_open_container(&reply_args, DBUS_TYPE_ARRAY, "{s(ttta(tt))}", &dbus_dict);
+    for (i = 0; !error_set && (i < STATISTICS_HISTOGRAM_COUNT); ++i)
+    {
+        kinesixd_statistics_get_histogram(i, &snapshot);
+        name = kinesixd_statistics_get_histogram_name(i);
+
+        error_set = !dbus_message_iter_open_container(&dbus_dict, DBUS_TYPE_DICT_ENTRY, 0, &dbus_entry) ||
+                    !dbus_message_iter_append_basic(&dbus_entry, DBUS_TYPE_STRING, &name) ||
+                    !dbus_message_iter_open_container(&dbus_entry, DBUS_TYPE_STRUCT, 0, &dbus_struct) ||
+                    !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_UINT64, &snapshot.count) ||
+                    !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_UINT64, &snapshot.sum) ||
+                    !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_UINT64, &snapshot.max) ||
+                    !dbus_message_iter_open_container(&dbus_struct, DBUS_TYPE_ARRAY, "(tt)", &dbus_buckets);
+
+        /* Only populated buckets go over the wire */
+        for (bucket = 0; !error_set && (bucket < STATISTICS_HISTOGRAM_BUCKET_COUNT); ++bucket)
+        {
+            if (!snapshot.buckets[bucket])
+                continue;
+
+            value = kinesixd_statistics_get_bucket_upper_bound(bucket);
+            error_set = !dbus_message_iter_open_container(&dbus_buckets, DBUS_TYPE_STRUCT, 0, &dbus_bucket) ||
+                        !dbus_message_iter_append_basic(&dbus_bucket, DBUS_TYPE_UINT64, &value) ||
+                        !dbus_message_iter_append_basic(&dbus_bucket, DBUS_TYPE_UINT64, &snapshot.buckets[bucket]) ||
+                        !dbus_message_iter_close_container(&dbus_buckets, &dbus_bucket);
+        }
+
+        if (!error_set)
+            error_set = !dbus_message_iter_close_container(&dbus_struct, &dbus_buckets) ||
+                        !dbus_message_iter_close_container(&dbus_entry, &dbus_struct) ||
+                        !dbus_message_iter_close_container(&dbus_dict, &dbus_entry);
+    }
+    if (!error_set)
+        error_set = !dbus_message_iter_close_container(&reply_args, &dbus_dict);
+
+    if (error_set)
+    {
+        LOG_ERROR("Failed while trying to marshal statistics. Not enough memory");
+        dbus_message_unref(reply);
+        return;
+    }
+
+    if (!kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+    {
+        LOG_ERROR("Failed send reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+    }
+
+    dbus_message_unref(reply);
+}
+
+static void kinesixd_dbus_adaptor_set_log_level(KinesixdDBusAdaptor self,
+                                                DBusMessage *message)
+{
+    DBusMessage* reply = 0;
+    DBusError error;
+    const char *level_name = 0;
+    LogLevel level = LOG_LEVEL_INFO;
+
+    dbus_error_init(&error);
+
+    if (!dbus_message_get_args(message, &error, DBUS_TYPE_STRING, &level_name, DBUS_TYPE_INVALID))
+    {
+        reply = dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, error.message);
+        dbus_error_free(&error);
+    }
+    else if (!kinesixd_log_level_from_string(level_name, &level))
+    {
+        reply = dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS,
+                                       "Expected one of debug, info, warning or error");
+    }
+    else
+    {
+        LOG("Log level changed to %s by %s", level_name, dbus_message_get_sender(message));
+        kinesixd_log_set_level(level);
+        reply = dbus_message_new_method_return(message);
+    }
+
+    if (!reply || !kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+    {
+        LOG_ERROR("Failed send reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+    }
+
+    if (reply)
+        dbus_message_unref(reply);
+}
+
+static void kinesixd_dbus_adaptor_capture_trace(KinesixdDBusAdaptor self,
+                                                DBusMessage *message)
+{
+    DBusMessage* reply = 0;
+    DBusError error;
+    dbus_uint32_t duration_ms = 0;
+    char trace_file_name[64];
+    char *path = 0;
+
+    dbus_error_init(&error);
+
+    /* The caller only picks the duration, a privileged instance must not write wherever it is told to */
+    snprintf(trace_file_name, sizeof(trace_file_name), "kinesixd-trace-%lld.json", (long long)time(0));
+
+    if (!dbus_message_get_args(message, &error, DBUS_TYPE_UINT32, &duration_ms, DBUS_TYPE_INVALID))
+    {
+        reply = dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, error.message);
+        dbus_error_free(&error);
+    }
+    else if ((duration_ms == 0) || (duration_ms > TRACE_CAPTURE_MAX_MS))
+    {
+        reply = dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS,
+                                       "Expected a duration between 1 and 60000 milliseconds");
+    }
+    else if (kinesixd_timeline_is_enabled())
+    {
+        /* Either an earlier capture or --trace-file, which runs until exit */
+        reply = dbus_message_new_error(message, DBUS_ERROR_FAILED, "A trace is already being recorded");
+    }
+    else if (!(path = kinesixd_dbus_adaptor_priv_runtime_file_path(self->bus_type, trace_file_name)) ||
+             !kinesixd_timeline_start(path))
+    {
+        reply = dbus_message_new_error(message, DBUS_ERROR_FAILED, "Could not open a trace file");
+    }
+    else
+    {
+        LOG("Capturing a %u ms trace to %s for %s", duration_ms, path, dbus_message_get_sender(message));
+        self->trace_deadline_ns = kinesixd_statistics_now_ns() + (uint64_t)duration_ms * 1000000ull;
+        reply = dbus_message_new_method_return(message);
+        if (reply)
+            dbus_message_append_args(reply, DBUS_TYPE_STRING, &path, DBUS_TYPE_INVALID);
+    }
+
+    if (!reply || !kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+    {
+        LOG_ERROR("Failed send reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+    }
+
+    if (reply)
+        dbus_message_unref(reply);
+    free(path);
+}
+
+static void kinesixd_dbus_adaptor_priv_append_flight_record(const struct KinesixdFlightRecord *record,
+                                                            void *record_context)
+{
+    struct _RecordContext *context = (struct _RecordContext *)record_context;
+    DBusMessageIter dbus_struct;
+    dbus_uint32_t kind = record->kind;
+    dbus_int32_t type = record->type;
+    dbus_int32_t finger_count = record->finger_count;
+    dbus_int32_t result = record->result;
+    dbus_uint32_t flags = record->flags;
+    double x = record->x;
+    double y = record->y;
+
+    if (context->error_set)
+        return;
+
+    context->error_set = !dbus_message_iter_open_container(context->dbus_array, DBUS_TYPE_STRUCT, 0, &dbus_struct) ||
+                         !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_UINT64, &record->sequence) ||
+                         !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_UINT64, &record->time_usec) ||
+                         !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_UINT32, &kind) ||
+                         !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_INT32, &type) ||
+                         !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_INT32, &finger_count) ||
+                         !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_INT32, &result) ||
+                         !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_UINT32, &flags) ||
+                         !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_DOUBLE, &x) ||
+                         !dbus_message_iter_append_basic(&dbus_struct, DBUS_TYPE_DOUBLE, &y) ||
+                         !dbus_message_iter_close_container(context->dbus_array, &dbus_struct);
+}
+
+static void kinesixd_dbus_adaptor_get_flight_record(KinesixdDBusAdaptor self,
+                                                    DBusMessage *message)
+{
+    DBusMessage* reply = 0;
+    DBusMessageIter reply_args;
+    DBusMessageIter dbus_array;
+    struct _RecordContext record_context = { .dbus_array = &dbus_array, .error_set = 0 };
+
+    LOG_DEBUG("Called %s.%s on %s",
+              dbus_message_get_interface(message),
+              dbus_message_get_member(message),
+              dbus_message_get_path(message));
+
+    reply = dbus_message_new_method_return(message);
+    if (!reply)
+    {
+        LOG_ERROR("Could not create DBus message. Not enough memory");
+        return;
+    }
+    dbus_message_iter_init_append(reply, &reply_args);
+
+    /* Without a runtime directory nothing is recorded, which is an empty array rather than an error */
+    record_context.error_set = !dbus_message_iter_open_container(&reply_args, DBUS_TYPE_ARRAY, "(ttuiiiudd)", &dbus_array);
+    if (!record_context.error_set)
+        kinesixd_flight_recorder_foreach(&kinesixd_dbus_adaptor_priv_append_flight_record, &record_context);
+    if (!record_context.error_set)
+        record_context.error_set = !dbus_message_iter_close_container(&reply_args, &dbus_array);
+
+    if (record_context.error_set)
+    {
+        LOG_ERROR("Could not create DBus message. Not enough memory");
+        dbus_message_unref(reply);
+        return;
+    }
+
+    if (!kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+    {
+        LOG_ERROR("Failed send reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+    }
+
+    dbus_message_unref(reply);
+}
+
+static void kinesixd_dbus_adaptor_handle_name_owner_changed(KinesixdDBusAdaptor self,
+                                                            DBusMessage *message)
+{
+    const char *name = 0;
+    const char *old_owner = 0;
+    const char *new_owner = 0;
+
+    if (!dbus_message_get_args(message, 0,
+                               DBUS_TYPE_STRING, &name,
+                               DBUS_TYPE_STRING, &old_owner,
+                               DBUS_TYPE_STRING, &new_owner,
+                               DBUS_TYPE_INVALID))
+        return;
+
+    if ((new_owner[0] == '\0') && kinesixd_session_router_unsubscribe(self->session_router, name))
+    {
+        LOG_DEBUG("Subscriber %s left the bus", name);
+        kinesixd_dbus_adaptor_priv_update_idle(self);
+        kinesixd_dbus_adaptor_priv_update_batching(self);
+    }
+}
+
+static void kinesixd_dbus_adaptor_handle_introspection(KinesixdDBusAdaptor self,
+                                                             DBusMessage *message)
+{
+    DBusMessage* reply = 0;
+    char *introspection_data = 0;
+    const char *object_path = dbus_message_get_path(message);
+
+    if (strcmp(object_path, "/") == 0)
+        introspection_data = strdup(GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_ROOT);
+    else if (strcmp(object_path, "/org") == 0)
+        introspection_data = strdup(GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_ORG);
+    else if (strcmp(object_path, "/org/kicsyromy") == 0)
+        introspection_data = strdup(GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_KICSYROMY);
+    else if (strcmp(object_path, GESTURE_DAEMON_OBJECT_PATH) == 0)
+        introspection_data = strdup(GESTURE_DAEMON_DBUS_INTROSPECTION_DATA_KINESIXD);
+
+    reply = dbus_message_new_method_return(message);
+    if (!dbus_message_append_args(reply,
+                             DBUS_TYPE_STRING,
+                             &introspection_data,
+                             DBUS_TYPE_INVALID))
+    {
+        LOG_ERROR("Failed create reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+    }
+    else if (!kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+    {
+        LOG_ERROR("Failed send reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+    }
+    dbus_message_unref(reply);
+    free(introspection_data);
+}
+
+static void kinesixd_dbus_adaptor_handle_properties(KinesixdDBusAdaptor self,
+                                                    DBusMessage *message)
+{
+    static const int all_properties[PROP_COUNT] =
+    {
+        PROP_ACTIVE_DEVICE, PROP_DEVICES, PROP_THRESHOLDS, PROP_SWIPES_EMITTED, PROP_PINCHES_EMITTED
+    };
+    DBusMessage *reply = 0;
+    DBusMessageIter reply_args;
+    DBusError error;
+    const char *interface = 0;
+    const char *property_name = 0;
+    int property = PROP_COUNT;
+    int i = 0;
+
+    dbus_error_init(&error);
+
+    if (dbus_message_is_method_call(message, DBUS_INTERFACE_PROPERTIES, "GetAll"))
+    {
+        if (dbus_message_get_args(message, &error, DBUS_TYPE_STRING, &interface, DBUS_TYPE_INVALID))
+        {
+            if (strcmp(interface, GESTURE_DAEMON_INTERFACE_NAME) == 0)
+            {
+                /* Everything on the main interface only changes together with the cache version */
+                if (!self->property_cache.get_all_message ||
+                    (self->property_cache.get_all_version != self->property_cache.version))
+                {
+                    if (self->property_cache.get_all_message)
+                        dbus_message_unref(self->property_cache.get_all_message);
+
+                    self->property_cache.get_all_message = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+                    if (self->property_cache.get_all_message)
+                    {
+                        dbus_message_iter_init_append(self->property_cache.get_all_message, &reply_args);
+                        if (kinesixd_dbus_adaptor_priv_append_properties(self, interface, all_properties,
+                                                                         PROP_COUNT, &reply_args))
+                        {
+                            dbus_message_unref(self->property_cache.get_all_message);
+                            self->property_cache.get_all_message = 0;
+                        }
+                        else
+                            self->property_cache.get_all_version = self->property_cache.version;
+                    }
+                }
+
+                if (self->property_cache.get_all_message)
+                    reply = kinesixd_dbus_adaptor_priv_reply_from_template(
+                                self->property_cache.get_all_message, message);
+            }
+            else if (strcmp(interface, GESTURE_DAEMON_STATISTICS_INTERFACE_NAME) == 0)
+            {
+                reply = dbus_message_new_method_return(message);
+                dbus_message_iter_init_append(reply, &reply_args);
+                if (kinesixd_dbus_adaptor_priv_append_properties(self, interface, all_properties,
+                                                                 PROP_COUNT, &reply_args))
+                {
+                    dbus_message_unref(reply);
+                    reply = 0;
+                }
+            }
+            else
+            {
+                reply = dbus_message_new_error(message, DBUS_ERROR_UNKNOWN_INTERFACE, interface);
+            }
+        }
+    }
+    else if (dbus_message_is_method_call(message, DBUS_INTERFACE_PROPERTIES, "Get") ||
+             dbus_message_is_method_call(message, DBUS_INTERFACE_PROPERTIES, "Set"))
+    {
+        /* Set carries an additional variant that we never get to look at */
+        dbus_message_iter_init(message, &reply_args);
+        if ((dbus_message_iter_get_arg_type(&reply_args) == DBUS_TYPE_STRING))
+        {
+            dbus_message_iter_get_basic(&reply_args, &interface);
+            dbus_message_iter_next(&reply_args);
+        }
+        if (interface && (dbus_message_iter_get_arg_type(&reply_args) == DBUS_TYPE_STRING))
+            dbus_message_iter_get_basic(&reply_args, &property_name);
+
+        for (i = 0; property_name && (i < PROP_COUNT); ++i)
+        {
+            if ((strcmp(daemon_properties[i].interface, interface) == 0) &&
+                (strcmp(daemon_properties[i].name, property_name) == 0))
+            {
+                property = i;
+                break;
+            }
+        }
+
+        if (!property_name)
+        {
+            reply = dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, "Expected interface and property name");
+        }
+        else if (property == PROP_COUNT)
+        {
+            reply = dbus_message_new_error(message, DBUS_ERROR_UNKNOWN_PROPERTY, property_name);
+        }
+        else if (dbus_message_is_method_call(message, DBUS_INTERFACE_PROPERTIES, "Set"))
+        {
+            reply = dbus_message_new_error(message, DBUS_ERROR_PROPERTY_READ_ONLY, property_name);
+        }
+        else
+        {
+            reply = dbus_message_new_method_return(message);
+            dbus_message_iter_init_append(reply, &reply_args);
+            if (kinesixd_dbus_adaptor_priv_append_property(self, property, &reply_args))
+            {
+                dbus_message_unref(reply);
+                reply = 0;
+            }
+        }
+    }
+
+    if (dbus_error_is_set(&error))
+    {
+        reply = dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, error.message);
+        dbus_error_free(&error);
+    }
+
+    if (!reply)
+    {
+        LOG_ERROR("Failed create reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+        return;
+    }
+
+    if (!kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+    {
+        LOG_ERROR("Failed send reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+    }
+
+    dbus_message_unref(reply);
+}
+
+static void kinesixd_dbus_adaptor_handle_unkown_message(KinesixdDBusAdaptor self,
+                                                              DBusMessage *message)
+{
+    DBusMessage* reply = 0;
+
+    LOG_WARN("Unhadled method called");
+
+    reply = dbus_message_new_method_return(message);
+    if (!kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+    {
+        LOG_ERROR("Failed to send reply for %s.%s called by %s on %s",
+                  dbus_message_get_interface(message),
+                  dbus_message_get_member(message),
+                  dbus_message_get_sender(message),
+                  dbus_message_get_path(message));
+    }
+    dbus_message_unref(reply);
+}
+
+static void kinesixd_dbus_adaptor_priv_init_method_queue(KinesixdDBusAdaptor self,
+                                                        struct _MethodQueue *queue,
+                                                        void (*handle_call)(KinesixdDBusAdaptor, DBusMessage *),
+                                                        const char *thread_name)
+{
+    queue->dbus_adaptor = self;
+    queue->handle_call = handle_call;
+    queue->thread_name = thread_name;
+    pthread_mutex_init(&queue->mutex, 0);
+    pthread_cond_init(&queue->cond, 0);
+    queue->head = 0;
+    queue->count = 0;
+    queue->pending = 0;
+    queue->stop_issued = 0;
+    queue->worker_count = 0;
+}
+
+static void kinesixd_dbus_adaptor_priv_destroy_method_queue(struct _MethodQueue *queue)
+{
+    pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->mutex);
+}
+
+static void kinesixd_dbus_adaptor_priv_start_method_workers(struct _MethodQueue *queue, int worker_count)
+{
+    int result = 0;
+    int i = 0;
+
+    queue->stop_issued = 0;
+    for (i = 0; (i < worker_count) && (i < METHOD_WORKER_COUNT); ++i)
+    {
+        result = pthread_create(&queue->workers[queue->worker_count],
+                                0,
+                                &kinesixd_dbus_adaptor_priv_run_method_worker,
+                                (void *)queue);
+        if (result != 0)
+        {
+            LOG_WARN("Could not start %s %d. %s", queue->thread_name, i, strerror(result));
+            continue;
+        }
+        ++queue->worker_count;
+    }
+
+    /* Without workers every call is still answered, just on the message listener */
+    if (!queue->worker_count)
+        LOG_WARN("No %s, slow calls will hold up the message listener", queue->thread_name);
+}
+
+static void kinesixd_dbus_adaptor_priv_stop_method_workers(struct _MethodQueue *queue)
+{
+    int i = 0;
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->stop_issued = 1;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+
+    for (i = 0; i < queue->worker_count; ++i)
+        pthread_join(queue->workers[i], 0);
+    queue->worker_count = 0;
+
+    /* The callers get no reply either way, the bus tells them once we leave it */
+    while (queue->count > 0)
+    {
+        dbus_message_unref(queue->messages[queue->head]);
+        queue->head = (queue->head + 1) % METHOD_QUEUE_CAPACITY;
+        --queue->count;
+    }
+    queue->pending = 0;
+}
+
+static void kinesixd_dbus_adaptor_priv_queue_method_call(struct _MethodQueue *queue,
+                                                         DBusMessage *message)
+{
+    KinesixdDBusAdaptor self = queue->dbus_adaptor;
+    DBusMessage *reply = 0;
+    int tail = 0;
+
+    if (!queue->worker_count)
+    {
+        queue->handle_call(self, message);
+        return;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->count < METHOD_QUEUE_CAPACITY)
+    {
+        tail = (queue->head + queue->count) % METHOD_QUEUE_CAPACITY;
+        queue->messages[tail] = dbus_message_ref(message);
+        queue->queued_ns[tail] = kinesixd_statistics_now_ns();
+        ++queue->count;
+        ++queue->pending;
+        pthread_cond_signal(&queue->cond);
+        pthread_mutex_unlock(&queue->mutex);
+        return;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    /* Turned away rather than answered inline, so a flood of slow calls never stalls cheap ones */
+    kinesixd_statistics_increment(STATISTICS_METHOD_CALLS_REJECTED);
+    LOG_WARN("Too many calls in flight, rejecting %s.%s from %s",
+             dbus_message_get_interface(message),
+             dbus_message_get_member(message),
+             dbus_message_get_sender(message));
+
+    /* A departure signal has nobody to answer, the subscriber stays until sending to it fails */
+    if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+        return;
+
+    reply = dbus_message_new_error(message, DBUS_ERROR_LIMITS_EXCEEDED, "Too many calls in flight");
+    if (!reply || !kinesixd_dbus_adaptor_priv_send_reply(self, reply))
+        LOG_ERROR("Failed to send reply");
+    if (reply)
+        dbus_message_unref(reply);
+}
+
+static int kinesixd_dbus_adaptor_priv_has_pending_calls(KinesixdDBusAdaptor self)
+{
+    struct _MethodQueue *queues[] = { &self->d_bus.method_queue, &self->d_bus.subscription_queue };
+    int pending = 0;
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(queues) / sizeof(queues[0]); ++i)
+    {
+        pthread_mutex_lock(&queues[i]->mutex);
+        pending += queues[i]->pending;
+        pthread_mutex_unlock(&queues[i]->mutex);
+    }
+
+    return pending > 0;
+}
+
+static void kinesixd_dbus_adaptor_priv_handle_method_call(KinesixdDBusAdaptor self,
+                                                          DBusMessage *message)
+{
+    if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "GetValidDeviceList"))
+        kinesixd_dbus_adaptor_get_valid_device_list(self, message);
+    else if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "SetActiveDevice"))
+        kinesixd_dbus_adaptor_set_active_device(self, message);
+    else if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "GetStatistics"))
+        kinesixd_dbus_adaptor_get_statistics(self, message);
+    else if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "GetFlightRecord"))
+        kinesixd_dbus_adaptor_get_flight_record(self, message);
+    else
+        kinesixd_dbus_adaptor_handle_unkown_message(self, message);
+}
+
+static void kinesixd_dbus_adaptor_priv_handle_subscription_call(KinesixdDBusAdaptor self,
+                                                                DBusMessage *message)
+{
+    if (dbus_message_is_signal(message, DBUS_INTERFACE_DBUS, "NameOwnerChanged"))
+    {
+        kinesixd_dbus_adaptor_handle_name_owner_changed(self, message);
+        return;
+    }
+
+    kinesixd_dbus_adaptor_handle_subscription(self, message);
+    kinesixd_dbus_adaptor_priv_update_idle(self);
+    kinesixd_dbus_adaptor_priv_update_batching(self);
+}
+
+static void *kinesixd_dbus_adaptor_priv_run_method_worker(void *method_queue)
+{
+    struct _MethodQueue *queue = (struct _MethodQueue *)method_queue;
+    DBusMessage *message = 0;
+    uint64_t queued_ns = 0;
+
+    kinesixd_timeline_set_thread_name(queue->thread_name);
+
+    pthread_mutex_lock(&queue->mutex);
+    for (;;)
+    {
+        while (!queue->count && !queue->stop_issued)
+            pthread_cond_wait(&queue->cond, &queue->mutex);
+
+        if (queue->stop_issued)
+            break;
+
+        message = queue->messages[queue->head];
+        queued_ns = queue->queued_ns[queue->head];
+        queue->head = (queue->head + 1) % METHOD_QUEUE_CAPACITY;
+        --queue->count;
+        pthread_mutex_unlock(&queue->mutex);
+
+        kinesixd_statistics_record(STATISTICS_METHOD_QUEUE_WAIT, kinesixd_statistics_now_ns() - queued_ns);
+        kinesixd_timeline_begin("method call");
+        queue->handle_call(queue->dbus_adaptor, message);
+        kinesixd_timeline_end("method call");
+        dbus_message_unref(message);
+        message = 0;
+
+        pthread_mutex_lock(&queue->mutex);
+        --queue->pending;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    return 0;
+}
+
+static void *kinesixd_dbus_adaptor_priv_listen_for_messages(void *kinesixd_dbus_adaptor)
+{
+    KinesixdDBusAdaptor self = (KinesixdDBusAdaptor)kinesixd_dbus_adaptor;
+    int stop_issued = 0;
+    int block = 0;
+    DBusMessage *message = 0;
+
+    kinesixd_timeline_set_thread_name("dbus listener");
+
+    for (;;)
+    {
+        pthread_mutex_lock(&self->d_bus.message_listener.stop_mutex);
+        stop_issued = self->d_bus.message_listener.stop_issued;
+        pthread_mutex_unlock(&self->d_bus.message_listener.stop_mutex);
+
+        if (stop_issued)
+            break;
+
+        /* With input suspended no gesture can be waiting on the signal mutex, so instead of
+         * polling the socket, sleep in it. Anything already queued still gets handled right away,
+         * and so does a reply a worker still owes. Only this thread queues calls, so none can
+         * show up while it sleeps, and a subscription is settled before it counts as handled */
+        block = __atomic_load_n(&self->idle, __ATOMIC_RELAXED) &&
+                kinesixd_daemon_is_suspended(self->kinesixd_daemon) &&
+                (dbus_connection_get_dispatch_status(self->d_bus.connection) != DBUS_DISPATCH_DATA_REMAINS) &&
+                !kinesixd_dbus_adaptor_priv_has_pending_calls(self);
 
         /* Avoid blocking in critical section */
-        usleep(500);
-        pthread_mutex_lock(&self->d_bus.message_listener.signal_mutex);
-        dbus_connection_read_write(self->d_bus.connection, 0);
+        if (!block)
+            usleep(500);
+        kinesixd_dbus_adaptor_priv_lock_signal_mutex(self);
+        kinesixd_timeline_begin("read_write");
+        dbus_connection_read_write(self->d_bus.connection, block ? IDLE_READ_WRITE_TIMEOUT_MS : 0);
         message = dbus_connection_pop_message(self->d_bus.connection);
+        kinesixd_timeline_end("read_write");
         pthread_mutex_unlock(&self->d_bus.message_listener.signal_mutex);
+        kinesixd_statistics_wakeup();
+
+        /* Publish whatever changed since the last iteration, this only compares a couple of integers */
+        kinesixd_dbus_adaptor_priv_sync_properties(self);
+        kinesixd_session_router_refresh(self->session_router);
+        kinesixd_dbus_adaptor_priv_finish_trace(self);
+        /* Samples stop while fingers rest mid gesture, what came before still goes out in time */
+        kinesixd_dbus_adaptor_priv_flush_batch(self, 0);
 
         if (!message)
             continue;
 
+        /* Bus signals, replies and calls on the standard interfaces keep nobody's session going */
+        if ((dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_METHOD_CALL) &&
+            dbus_message_has_interface(message, GESTURE_DAEMON_INTERFACE_NAME))
+            __atomic_store_n(&self->last_activity,
+                             kinesixd_dbus_adaptor_priv_monotonic_seconds(),
+                             __ATOMIC_RELAXED);
+
         LOG_DEBUG("Method %s.%s called by %s on %s",
                  dbus_message_get_interface(message),
                  dbus_message_get_member(message),
                  dbus_message_get_sender(message),
                  dbus_message_get_path(message));
 
-        if (dbus_message_is_method_call(message, DBUS_INTERFACE_INTROSPECTABLE, "Introspect"))
+        /* Replies are never flushed, a bus that stopped reading would stall every caller behind it.
+         * Handlers write what the socket takes right away, the next read_write above the rest */
+        if (dbus_message_is_signal(message, DBUS_INTERFACE_DBUS, "NameOwnerChanged"))
+            kinesixd_dbus_adaptor_priv_queue_method_call(&self->d_bus.subscription_queue, message);
+        else if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_ERROR)
+            kinesixd_dbus_adaptor_handle_error(self, message);
+        else if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+            LOG_DEBUG("Ignoring %s.%s, there is nothing to reply to",
+                      dbus_message_get_interface(message),
+                      dbus_message_get_member(message));
+        else if (dbus_message_is_method_call(message, DBUS_INTERFACE_INTROSPECTABLE, "Introspect"))
             kinesixd_dbus_adaptor_handle_introspection(self, message);
-        else if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "GetValidDeviceList"))
-            kinesixd_dbus_adaptor_get_valid_device_list(self, message);
-        else if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "SetActiveDevice"))
-            kinesixd_dbus_adaptor_set_active_device(self, message);
+        else if (dbus_message_has_interface(message, DBUS_INTERFACE_PROPERTIES))
+            kinesixd_dbus_adaptor_handle_properties(self, message);
+        else if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "GetValidDeviceList") ||
+                 dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "SetActiveDevice") ||
+                 dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "GetStatistics") ||
+                 dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "GetFlightRecord"))
+            kinesixd_dbus_adaptor_priv_queue_method_call(&self->d_bus.method_queue, message);
+        else if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "Subscribe") ||
+                 dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "Unsubscribe") ||
+                 dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "SetSessionPolicy"))
+            kinesixd_dbus_adaptor_priv_queue_method_call(&self->d_bus.subscription_queue, message);
+        else if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "SetLogLevel"))
+            kinesixd_dbus_adaptor_set_log_level(self, message);
+        else if (dbus_message_is_method_call(message, GESTURE_DAEMON_INTERFACE_NAME, "CaptureTrace"))
+            kinesixd_dbus_adaptor_capture_trace(self, message);
         else
             kinesixd_dbus_adaptor_handle_unkown_message(self, message);
 
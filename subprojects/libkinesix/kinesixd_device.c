@@ -59,33 +59,55 @@ struct _KinesixdDevice *device_priv_new_with_id(int id,
         {
             /* Check if the file is a character device */
             if ((sb.st_mode & S_IFMT) == S_IFCHR)
-            {
-                self = (KinesixdDevice)malloc(sizeof(struct _KinesixdDevice));
-                self->id = id;
-                self->path = (char *)malloc(strlen(path) + 1);
-                strcpy(self->path, path);
-                self->name = strdup(name);
-                self->product_id = product_id;
-                self->vendor_id = vendor_id;
-            }
+                self = device_priv_new_unchecked(id, path, name, product_id, vendor_id);
         }
     }
 
     return self;
 }
 
+struct _KinesixdDevice *device_priv_new_unchecked(int id,
+                                          const char *path,
+                                          const char *name,
+                                          uint32_t product_id,
+                                          uint32_t vendor_id)
+{
+    KinesixdDevice self = (KinesixdDevice)malloc(sizeof(struct _KinesixdDevice));
+
+    self->id = id;
+    self->path = strdup(path);
+    self->name = strdup(name);
+    self->seat = strdup("seat0");
+    self->product_id = product_id;
+    self->vendor_id = vendor_id;
+
+    return self;
+}
+
 void kinesixd_device_free(KinesixdDevice self)
 {
     free(self->path);
     free(self->name);
+    free(self->seat);
     free(self);
 }
 
+void device_priv_set_seat(struct _KinesixdDevice *self, const char *seat)
+{
+    free(self->seat);
+    self->seat = strdup(seat);
+}
+
 const char *kinesixd_device_get_path(KinesixdDevice self)
 {
     return self->path;
 }
 
+const char *kinesixd_device_get_seat(KinesixdDevice self)
+{
+    return self->seat;
+}
+
 int kinesixd_device_equals(KinesixdDevice device1, KinesixdDevice device2)
 {
     int retValue = 0;
@@ -130,6 +152,44 @@ int kinesixd_device_list_contains(KinesixdDevice *device_list, KinesixdDevice de
     return contains;
 }
 
+KinesixdDevice kinesixd_device_list_find_by_id(KinesixdDevice *device_list, int id)
+{
+    int device_count = 0;
+    KinesixdDevice current_device = 0;
+
+    if (device_list)
+    {
+        for (;;)
+        {
+            current_device = device_list[device_count];
+            if (!current_device || (current_device->id == id))
+                break;
+            ++device_count;
+        }
+    }
+
+    return current_device;
+}
+
+KinesixdDevice kinesixd_device_list_find_by_path(KinesixdDevice *device_list, const char *path)
+{
+    int device_count = 0;
+    KinesixdDevice current_device = 0;
+
+    if (device_list && path)
+    {
+        for (;;)
+        {
+            current_device = device_list[device_count];
+            if (!current_device || (strcmp(current_device->path, path) == 0))
+                break;
+            ++device_count;
+        }
+    }
+
+    return current_device;
+}
+
 void kinesixd_device_list_free(KinesixdDevice *device_list)
 {
     int device_count = 0;
@@ -21,6 +21,8 @@
 
 #include "kinesixd_device_p.h"
 
+#include <string.h>
+
 typedef enum
 {
     ARG_DEV_ID = 0,
@@ -31,6 +33,16 @@ typedef enum
     ARG_DEV_COUNT
 } DeviceField;
 
+/* Points into the message the fields were read from, valid for as long as it is */
+struct _DeviceFields
+{
+    int id;
+    const char *path;
+    const char *name;
+    uint32_t product_id;
+    uint32_t vendor_id;
+};
+
 static const char *device_dbus_type = "(issuu)";
 static const int device_argument_dbus_types[] =
 {
@@ -42,21 +54,36 @@ static const int device_argument_dbus_types[] =
     DBUS_TYPE_INVALID
 };
 
+static int kinesixd_device_marshaler_priv_read_fields(DBusMessageIter *dbus_iter,
+                                                      struct _DeviceFields *fields);
+
 int kinesixd_device_marshaler_append_device(const KinesixdDevice device, DBusMessageIter *dbus_iter)
 {
     DBusMessageIter dbus_struct;
     int device_id = 0;
-    char *device_path = 0;
-    char *device_name = 0;
+    const char *device_path = 0;
+    const char *device_name = 0;
     uint32_t device_product_id;
     uint32_t device_vendor_id;
     int error_set = 0;
 
-    device_id = device->id;
-    device_path = strdup(device->path);
-    device_name = strdup(device->name);
-    device_product_id = device->product_id;
-    device_vendor_id = device->vendor_id;
+    /* A missing device is marshaled as an all empty structure */
+    if (device)
+    {
+        /* libdbus copies the string arguments into the message body, no need for our own copies */
+        device_id = device->id;
+        device_path = device->path;
+        device_name = device->name;
+        device_product_id = device->product_id;
+        device_vendor_id = device->vendor_id;
+    }
+    else
+    {
+        device_path = "";
+        device_name = "";
+        device_product_id = 0;
+        device_vendor_id = 0;
+    }
 
     if ((error_set = !dbus_message_iter_open_container(dbus_iter,
                                      DBUS_TYPE_STRUCT,
@@ -79,9 +106,6 @@ int kinesixd_device_marshaler_append_device(const KinesixdDevice device, DBusMes
     if (!error_set && (error_set = !dbus_message_iter_close_container(dbus_iter, &dbus_struct)))
         LOG_ERROR("Failed to close DBus container for device %s. Not enough memory", device_path);
 
-    free(device_path);
-    free(device_name);
-
     if (error_set)
         dbus_message_iter_abandon_container(dbus_iter, &dbus_struct);
 
@@ -90,74 +114,37 @@ int kinesixd_device_marshaler_append_device(const KinesixdDevice device, DBusMes
 
 KinesixdDevice kinesixd_device_marshaler_device_from_dbus_argument(DBusMessageIter *dbus_iter)
 {
+    struct _DeviceFields fields;
     KinesixdDevice device = 0;
-    DBusMessageIter dbus_device;
-    int current_arg_type = DBUS_TYPE_INVALID;
-    int expected_arg_type = DBUS_TYPE_INVALID;
-    DeviceField dbus_arg_field = ARG_DEV_ID;
-    int device_id = 0;
-    const char *device_path = 0;
-    const char *device_name = 0;
-    uint32_t device_product_id = 0;
-    uint32_t device_vendor_id = 0;
 
-    if (dbus_message_iter_get_arg_type(dbus_iter) == DBUS_TYPE_STRUCT)
-    {
-        dbus_message_iter_recurse(dbus_iter, &dbus_device);
+    if (kinesixd_device_marshaler_priv_read_fields(dbus_iter, &fields))
+        device = device_priv_new_unchecked(fields.id,
+                                           fields.path,
+                                           fields.name,
+                                           fields.product_id,
+                                           fields.vendor_id);
 
-        while ((current_arg_type = dbus_message_iter_get_arg_type(&dbus_device)) != DBUS_TYPE_INVALID)
-        {
-            if (dbus_arg_field >= ARG_DEV_COUNT)
-            {
-                LOG_WARN("Too many arguments for Device structure."
-                         "Expected %d but received at least one more. "
-                         "All extra arguments ignored",
-                         ARG_DEV_COUNT);
-                break;
-            }
-            else if (current_arg_type == (expected_arg_type = device_argument_dbus_types[dbus_arg_field]))
-            {
-                switch(dbus_arg_field)
-                {
-                case ARG_DEV_ID:
-                    dbus_message_iter_get_basic(&dbus_device, &device_id);
-                    break;
-                case ARG_DEV_PATH:
-                    dbus_message_iter_get_basic(&dbus_device, &device_path);
-                    break;
-                case ARG_DEV_NAME:
-                    dbus_message_iter_get_basic(&dbus_device, &device_name);
-                    break;
-                case ARG_DEV_PRODUCT_ID:
-                    dbus_message_iter_get_basic(&dbus_device, &device_product_id);
-                    break;
-                case ARG_DEV_VENDOR_ID:
-                    dbus_message_iter_get_basic(&dbus_device, &device_vendor_id);
-                    break;
-                default:
-                    break;
-                }
-            }
-            else
-            {
-                LOG_ERROR("Invalid argument received. Expecting %d but received %d",
-                          current_arg_type, expected_arg_type);
-            }
+    return device;
+}
 
-            ++dbus_arg_field;
-            dbus_message_iter_next(&dbus_device);
-        }
+KinesixdDevice kinesixd_device_marshaler_find_device(DBusMessageIter *dbus_iter, KinesixdDevice *device_list)
+{
+    struct _DeviceFields fields;
+    KinesixdDevice device = 0;
 
-        if (dbus_arg_field == ARG_DEV_COUNT)
-            device = device_priv_new_with_id(device_id,
-                                             device_path,
-                                             device_name,
-                                             device_product_id,
-                                             device_vendor_id);
-        else
-            LOG_ERROR("To few arguments for Device structure."
-                      "Expected %d arguments but received %d",
-                      ARG_DEV_COUNT, dbus_arg_field);
+    if (!kinesixd_device_marshaler_priv_read_fields(dbus_iter, &fields))
+        return 0;
+
+    /* The registry already checked the node when it was built, the path only has to agree with it */
+    device = kinesixd_device_list_find_by_id(device_list, fields.id);
+    if (!device)
+    {
+        LOG_ERROR("Device %s is not a valid device", fields.path);
+    }
+    else if (strcmp(device->path, fields.path) != 0)
+    {
+        LOG_ERROR("Device %d is %s, not %s", fields.id, device->path, fields.path);
+        device = 0;
     }
 
     return device;
@@ -196,3 +183,77 @@ int kinesixd_device_marshaler_append_device_list(const KinesixdDevice *const dev
 
     return error_set;
 }
+
+static int kinesixd_device_marshaler_priv_read_fields(DBusMessageIter *dbus_iter,
+                                                      struct _DeviceFields *fields)
+{
+    DBusMessageIter dbus_device;
+    int current_arg_type = DBUS_TYPE_INVALID;
+    int expected_arg_type = DBUS_TYPE_INVALID;
+    DeviceField dbus_arg_field = ARG_DEV_ID;
+
+    fields->id = 0;
+    fields->path = 0;
+    fields->name = 0;
+    fields->product_id = 0;
+    fields->vendor_id = 0;
+
+    if (dbus_message_iter_get_arg_type(dbus_iter) != DBUS_TYPE_STRUCT)
+        return 0;
+
+    dbus_message_iter_recurse(dbus_iter, &dbus_device);
+
+    while ((current_arg_type = dbus_message_iter_get_arg_type(&dbus_device)) != DBUS_TYPE_INVALID)
+    {
+        if (dbus_arg_field >= ARG_DEV_COUNT)
+        {
+            LOG_WARN("Too many arguments for Device structure."
+                     "Expected %d but received at least one more. "
+                     "All extra arguments ignored",
+                     ARG_DEV_COUNT);
+            break;
+        }
+        else if (current_arg_type == (expected_arg_type = device_argument_dbus_types[dbus_arg_field]))
+        {
+            switch(dbus_arg_field)
+            {
+            case ARG_DEV_ID:
+                dbus_message_iter_get_basic(&dbus_device, &fields->id);
+                break;
+            case ARG_DEV_PATH:
+                dbus_message_iter_get_basic(&dbus_device, &fields->path);
+                break;
+            case ARG_DEV_NAME:
+                dbus_message_iter_get_basic(&dbus_device, &fields->name);
+                break;
+            case ARG_DEV_PRODUCT_ID:
+                dbus_message_iter_get_basic(&dbus_device, &fields->product_id);
+                break;
+            case ARG_DEV_VENDOR_ID:
+                dbus_message_iter_get_basic(&dbus_device, &fields->vendor_id);
+                break;
+            default:
+                break;
+            }
+        }
+        else
+        {
+            LOG_ERROR("Invalid argument received. Expecting %d but received %d",
+                      current_arg_type, expected_arg_type);
+        }
+
+        ++dbus_arg_field;
+        dbus_message_iter_next(&dbus_device);
+    }
+
+    if (dbus_arg_field != ARG_DEV_COUNT)
+    {
+        LOG_ERROR("To few arguments for Device structure."
+                  "Expected %d arguments but received %d",
+                  ARG_DEV_COUNT, dbus_arg_field);
+        return 0;
+    }
+
+    /* A mistyped field was left unset, there is nothing to build or look up from it */
+    return fields->path && fields->name;
+}
@@ -0,0 +1,366 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_flight_recorder.h"
+#include "kinesixd_global.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libinput.h>
+
+struct _FlightRecorder
+{
+    struct KinesixdFlightRecorderHeader *header;
+    struct KinesixdFlightRecord *records;
+    size_t mapping_size;
+    /* Writer side copy of header->head, the mapping is only ever stored to. Claimed atomically,
+     * input workers record alongside the event thread */
+    uint64_t next_sequence;
+};
+
+static struct _FlightRecorder flight_recorder = { 0 };
+
+static size_t kinesixd_flight_recorder_priv_mapping_size(void);
+static const char *kinesixd_flight_recorder_priv_event_name(int event_type);
+static const char *kinesixd_flight_recorder_priv_result_name(int gesture, int result);
+static int kinesixd_flight_recorder_priv_walk(const struct KinesixdFlightRecorderHeader *header,
+                                              size_t mapping_size,
+                                              FlightRecordCallback callback,
+                                              void *user_data);
+
+int kinesixd_flight_recorder_open(const char *file_path)
+{
+    char previous_path[PATH_MAX];
+    size_t mapping_size = kinesixd_flight_recorder_priv_mapping_size();
+    void *mapping = 0;
+    int fd = -1;
+
+    if (flight_recorder.header)
+        return 1;
+
+    /* Whatever the last instance left is exactly what a post-mortem needs, so it is moved out of the way */
+    snprintf(previous_path, sizeof(previous_path), "%s.previous", file_path);
+    if ((rename(file_path, previous_path) < 0) && (errno != ENOENT))
+        LOG_WARN("Could not keep the previous flight recording at %s. %s", previous_path, strerror(errno));
+
+    /* Other sessions' gestures are in there, only the owner gets to read them */
+    fd = open(file_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        LOG_WARN("Could not create flight recording %s. %s", file_path, strerror(errno));
+        return 0;
+    }
+
+    if (ftruncate(fd, (off_t)mapping_size) < 0)
+    {
+        LOG_WARN("Could not size flight recording %s. %s", file_path, strerror(errno));
+        close(fd);
+        return 0;
+    }
+
+    mapping = mmap(0, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        LOG_WARN("Could not map flight recording %s. %s", file_path, strerror(errno));
+        return 0;
+    }
+
+    /* The file starts out zeroed, which already marks every slot as empty */
+    flight_recorder.header = (struct KinesixdFlightRecorderHeader *)mapping;
+    flight_recorder.records = (struct KinesixdFlightRecord *)(flight_recorder.header + 1);
+    flight_recorder.mapping_size = mapping_size;
+    flight_recorder.next_sequence = 1;
+
+    flight_recorder.header->version = FLIGHT_RECORDER_VERSION;
+    flight_recorder.header->capacity = FLIGHT_RECORDER_CAPACITY;
+    flight_recorder.header->record_size = sizeof(struct KinesixdFlightRecord);
+    flight_recorder.header->process_id = (int32_t)getpid();
+    flight_recorder.header->head = flight_recorder.next_sequence;
+    /* Last, a reader that sees the magic sees a complete header */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(flight_recorder.header->magic, FLIGHT_RECORDER_MAGIC, sizeof(flight_recorder.header->magic));
+
+    return 1;
+}
+
+void kinesixd_flight_recorder_close(void)
+{
+    if (!flight_recorder.header)
+        return;
+
+    /* The file stays, it is only replaced by the next kinesixd_flight_recorder_open() */
+    munmap(flight_recorder.header, flight_recorder.mapping_size);
+    flight_recorder.header = 0;
+    flight_recorder.records = 0;
+}
+
+void kinesixd_flight_recorder_record(FlightRecordKind kind,
+                                     uint64_t time_usec,
+                                     int type,
+                                     int finger_count,
+                                     int result,
+                                     unsigned int flags,
+                                     double x,
+                                     double y)
+{
+    struct KinesixdFlightRecord *record = 0;
+    uint64_t sequence = 0;
+    uint64_t head = 0;
+
+    if (!flight_recorder.header)
+        return;
+
+    sequence = __atomic_fetch_add(&flight_recorder.next_sequence, 1, __ATOMIC_RELAXED);
+    record = &flight_recorder.records[sequence & (FLIGHT_RECORDER_CAPACITY - 1)];
+
+    /* A per slot seqlock. Every writer owns its slot until the ring wraps, so there is nothing to
+     * retry on this side */
+    __atomic_store_n(&record->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record->time_usec = time_usec;
+    record->kind = (uint16_t)kind;
+    record->type = (int16_t)type;
+    record->finger_count = (int16_t)finger_count;
+    record->result = (int16_t)result;
+    record->flags = flags;
+    record->x = (float)x;
+    record->y = (float)y;
+    __atomic_store_n(&record->sequence, sequence, __ATOMIC_RELEASE);
+
+    /* Writers finish out of order, head only ever moves forward. Slots below it still being
+     * written fail the sequence check on the reader side */
+    head = __atomic_load_n(&flight_recorder.header->head, __ATOMIC_RELAXED);
+    while ((head < sequence + 1) &&
+           !__atomic_compare_exchange_n(&flight_recorder.header->head, &head, sequence + 1, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+int kinesixd_flight_recorder_foreach(FlightRecordCallback callback, void *user_data)
+{
+    if (!flight_recorder.header)
+        return 0;
+
+    return kinesixd_flight_recorder_priv_walk(flight_recorder.header,
+                                              flight_recorder.mapping_size,
+                                              callback,
+                                              user_data);
+}
+
+int kinesixd_flight_recorder_read_file(const char *file_path, FlightRecordCallback callback, void *user_data)
+{
+    struct stat file_stat;
+    void *mapping = 0;
+    int fd = -1;
+    int result = 0;
+
+    fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_WARN("Could not open flight recording %s. %s", file_path, strerror(errno));
+        return 0;
+    }
+
+    if ((fstat(fd, &file_stat) < 0) || ((size_t)file_stat.st_size < sizeof(struct KinesixdFlightRecorderHeader)))
+    {
+        LOG_WARN("%s is not a flight recording", file_path);
+        close(fd);
+        return 0;
+    }
+
+    mapping = mmap(0, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        LOG_WARN("Could not map flight recording %s. %s", file_path, strerror(errno));
+        return 0;
+    }
+
+    result = kinesixd_flight_recorder_priv_walk((const struct KinesixdFlightRecorderHeader *)mapping,
+                                                (size_t)file_stat.st_size,
+                                                callback,
+                                                user_data);
+    if (!result)
+        LOG_WARN("%s is not a flight recording this version can read", file_path);
+    munmap(mapping, (size_t)file_stat.st_size);
+
+    return result;
+}
+
+const char *kinesixd_flight_recorder_get_kind_name(FlightRecordKind kind)
+{
+    switch (kind)
+    {
+    case FLIGHT_RECORD_EVENT:
+        return "event";
+    case FLIGHT_RECORD_DECISION:
+        return "decision";
+    case FLIGHT_RECORD_CALLBACK:
+        return "callback";
+    case FLIGHT_RECORD_SIGNAL:
+        return "signal";
+    default:
+        return "unknown";
+    }
+}
+
+void kinesixd_flight_recorder_describe(const struct KinesixdFlightRecord *record, char *buffer, size_t size)
+{
+    const char *gesture_name = (record->type == 0) ? "swipe" : "pinch";
+    int length = 0;
+
+    switch (record->kind)
+    {
+    case FLIGHT_RECORD_EVENT:
+        length = snprintf(buffer, size, "%s fingers=%d x=%.2f y=%.2f",
+                          kinesixd_flight_recorder_priv_event_name(record->type),
+                          record->finger_count,
+                          record->x,
+                          record->y);
+        break;
+    case FLIGHT_RECORD_DECISION:
+        length = snprintf(buffer, size, "%s %s fingers=%d",
+                          gesture_name,
+                          kinesixd_flight_recorder_priv_result_name(record->type, record->result),
+                          record->finger_count);
+        break;
+    case FLIGHT_RECORD_CALLBACK:
+        length = snprintf(buffer, size, "%s %s fingers=%d %s",
+                          gesture_name,
+                          kinesixd_flight_recorder_priv_result_name(record->type, record->result),
+                          record->finger_count,
+                          (record->flags & (FLIGHT_RECORD_DISABLED | FLIGHT_RECORD_FAILED)) ? "dropped" : "delivered");
+        break;
+    case FLIGHT_RECORD_SIGNAL:
+        length = snprintf(buffer, size, "%s %s fingers=%d %s",
+                          gesture_name,
+                          kinesixd_flight_recorder_priv_result_name(record->type, record->result),
+                          record->finger_count,
+                          (record->flags & FLIGHT_RECORD_FAILED) ? "not sent" : "queued");
+        break;
+    default:
+        length = snprintf(buffer, size, "kind %u", record->kind);
+        break;
+    }
+
+    if ((length < 0) || ((size_t)length >= size))
+        return;
+
+    snprintf(buffer + length, size - (size_t)length, "%s%s%s",
+             (record->flags & FLIGHT_RECORD_CANCELLED) ? " cancelled" : "",
+             (record->flags & FLIGHT_RECORD_DISABLED) ? " disabled" : "",
+             (record->flags & FLIGHT_RECORD_TOUCHSCREEN) ? " touchscreen" : "");
+}
+
+static size_t kinesixd_flight_recorder_priv_mapping_size(void)
+{
+    return sizeof(struct KinesixdFlightRecorderHeader) +
+           FLIGHT_RECORDER_CAPACITY * sizeof(struct KinesixdFlightRecord);
+}
+
+static const char *kinesixd_flight_recorder_priv_event_name(int event_type)
+{
+    switch (event_type)
+    {
+    case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+        return "swipe begin";
+    case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+        return "swipe update";
+    case LIBINPUT_EVENT_GESTURE_SWIPE_END:
+        return "swipe end";
+    case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+        return "pinch begin";
+    case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+        return "pinch update";
+    case LIBINPUT_EVENT_GESTURE_PINCH_END:
+        return "pinch end";
+    case LIBINPUT_EVENT_TOUCH_DOWN:
+        return "touch down";
+    case LIBINPUT_EVENT_TOUCH_UP:
+        return "touch up";
+    case LIBINPUT_EVENT_TOUCH_CANCEL:
+        return "touch cancel";
+    default:
+        return "other";
+    }
+}
+
+static const char *kinesixd_flight_recorder_priv_result_name(int gesture, int result)
+{
+    static const char *swipe_directions[] = { "up", "down", "left", "right" };
+    static const char *pinch_types[]      = { "in", "out" };
+
+    if ((gesture == 0) && (result >= 0) && (result < 4))
+        return swipe_directions[result];
+    if ((gesture == 1) && (result >= 0) && (result < 2))
+        return pinch_types[result];
+
+    return "unrecognized";
+}
+
+static int kinesixd_flight_recorder_priv_walk(const struct KinesixdFlightRecorderHeader *header,
+                                              size_t mapping_size,
+                                              FlightRecordCallback callback,
+                                              void *user_data)
+{
+    const struct KinesixdFlightRecord *records = (const struct KinesixdFlightRecord *)(header + 1);
+    struct KinesixdFlightRecord record;
+    uint64_t head = 0;
+    uint64_t sequence = 0;
+    uint64_t capacity = 0;
+
+    if ((memcmp(header->magic, FLIGHT_RECORDER_MAGIC, sizeof(header->magic)) != 0) ||
+        (header->version != FLIGHT_RECORDER_VERSION) ||
+        (header->record_size != sizeof(struct KinesixdFlightRecord)) ||
+        (header->capacity == 0) ||
+        (header->capacity & (header->capacity - 1)) ||
+        (mapping_size < sizeof(*header) + (size_t)header->capacity * sizeof(struct KinesixdFlightRecord)))
+    {
+        return 0;
+    }
+
+    capacity = header->capacity;
+    head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    for (sequence = (head > capacity) ? head - capacity : 1; sequence < head; ++sequence)
+    {
+        /* Anything but the expected sequence means the slot is being rewritten or already was */
+        if (__atomic_load_n(&records[sequence & (capacity - 1)].sequence, __ATOMIC_ACQUIRE) != sequence)
+            continue;
+        memcpy(&record, &records[sequence & (capacity - 1)], sizeof(record));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&records[sequence & (capacity - 1)].sequence, __ATOMIC_RELAXED) != sequence)
+            continue;
+
+        record.sequence = sequence;
+        callback(&record, user_data);
+    }
+
+    return 1;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_kinetics.h"
+
+#include <string.h>
+
+/* Fingers that rested this long before lifting have no momentum left to hand over */
+#define KINETICS_STOP_USEC 50000
+
+void kinesixd_kinetics_begin(struct KinesixdKinetics *self, uint64_t time_usec)
+{
+    memset(self, 0, sizeof(*self));
+    self->start_usec = time_usec;
+    self->last_usec = time_usec;
+}
+
+void kinesixd_kinetics_update(struct KinesixdKinetics *self, double dx, double dy, uint64_t time_usec)
+{
+    int slot = self->window_head;
+
+    self->displacement_x += dx;
+    self->displacement_y += dy;
+
+    /* Replace the oldest sample and keep the sums in step instead of summing the window again */
+    if (self->window_count == KINETICS_WINDOW_SIZE)
+    {
+        self->window_sum_dx -= self->window_dx[slot];
+        self->window_sum_dy -= self->window_dy[slot];
+        self->window_sum_dt -= self->window_dt[slot];
+    }
+    else
+    {
+        ++self->window_count;
+    }
+
+    self->window_dx[slot] = dx;
+    self->window_dy[slot] = dy;
+    self->window_dt[slot] = time_usec > self->last_usec ? time_usec - self->last_usec : 0;
+    self->window_sum_dx += dx;
+    self->window_sum_dy += dy;
+    self->window_sum_dt += self->window_dt[slot];
+
+    self->window_head = (slot + 1) % KINETICS_WINDOW_SIZE;
+    self->last_usec = time_usec;
+}
+
+void kinesixd_kinetics_finish(const struct KinesixdKinetics *self,
+                              uint64_t time_usec,
+                              struct KinesixdFling *fling_out)
+{
+    fling_out->displacement_x = self->displacement_x;
+    fling_out->displacement_y = self->displacement_y;
+    fling_out->duration_usec = time_usec > self->start_usec ? time_usec - self->start_usec : 0;
+    fling_out->velocity_x = 0;
+    fling_out->velocity_y = 0;
+
+    if ((self->window_sum_dt == 0) ||
+        ((time_usec > self->last_usec) && (time_usec - self->last_usec > KINETICS_STOP_USEC)))
+    {
+        return;
+    }
+
+    fling_out->velocity_x = self->window_sum_dx * 1000000.0 / self->window_sum_dt;
+    fling_out->velocity_y = self->window_sum_dy * 1000000.0 / self->window_sum_dt;
+}
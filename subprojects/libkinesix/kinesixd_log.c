@@ -0,0 +1,346 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_log.h"
+#include "kinesixd_global.h"
+#include "kinesixd_statistics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define LOG_RING_SIZE           256
+#define LOG_RECORD_MESSAGE_LEN  512
+
+#ifdef DEBUG_BUILD
+#define LOG_LEVEL_DEFAULT       LOG_LEVEL_DEBUG
+#else
+#define LOG_LEVEL_DEFAULT       LOG_LEVEL_INFO
+#endif
+
+static const char JOURNAL_SOCKET_PATH[] = "/run/systemd/journal/socket";
+
+/* Slot of a bounded multi-producer queue, sequence tells producers and the writer who owns it */
+struct _LogRecord
+{
+    uint64_t sequence;
+    LogLevel level;
+    int line;
+    /* Both always point to string literals, formatting them is left to the writer */
+    const char *file;
+    const char *function;
+    char message[LOG_RECORD_MESSAGE_LEN];
+};
+
+struct _LogWriterThread
+{
+    pthread_t thread_id;
+    int wakeup_fd;
+    int stop_issued;
+};
+
+struct _Log
+{
+    /* Producers only ever contend on this one */
+    uint64_t enqueue_position __attribute__((aligned(64)));
+    uint64_t dequeue_position __attribute__((aligned(64)));
+    uint64_t dropped_count;
+    struct _LogRecord *records;
+    LogLevel level;
+    LogTarget target;
+    int journal_fd;
+    int started;
+    struct _LogWriterThread writer_thread;
+};
+
+static const char *level_names[] = { "DEBUG", "INFO", "WARNING", "ERROR", "FATAL" };
+/* syslog(3) priorities, matching level_names */
+static const int journal_priorities[] = { 7, 6, 4, 3, 2 };
+
+static struct _Log log_ring = { .level = LOG_LEVEL_DEFAULT, .journal_fd = -1 };
+
+static void kinesixd_log_priv_output(LogLevel level,
+                                     const char *file,
+                                     const char *function,
+                                     int line,
+                                     const char *message);
+static int kinesixd_log_priv_drain(void);
+static void *kinesixd_log_priv_write_records(void *user_data);
+
+int kinesixd_log_start(LogTarget target)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    uint64_t i = 0;
+
+    if (log_ring.started)
+        return 1;
+
+    /* stderr being connected to the journal is the hint to use its native protocol instead */
+    if (target == LOG_TARGET_AUTO)
+        target = getenv("JOURNAL_STREAM") ? LOG_TARGET_JOURNAL : LOG_TARGET_STDERR;
+
+    if (target == LOG_TARGET_JOURNAL)
+    {
+        strcpy(address.sun_path, JOURNAL_SOCKET_PATH);
+        log_ring.journal_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if ((log_ring.journal_fd == -1) ||
+            (connect(log_ring.journal_fd, (struct sockaddr *)&address, sizeof(address)) == -1))
+        {
+            if (log_ring.journal_fd != -1)
+                close(log_ring.journal_fd);
+            log_ring.journal_fd = -1;
+            target = LOG_TARGET_STDERR;
+        }
+    }
+    log_ring.target = target;
+
+    log_ring.records = (struct _LogRecord *)calloc(LOG_RING_SIZE, sizeof(struct _LogRecord));
+    for (i = 0; i < LOG_RING_SIZE; ++i)
+        log_ring.records[i].sequence = i;
+    log_ring.enqueue_position = 0;
+    log_ring.dequeue_position = 0;
+
+    log_ring.writer_thread.stop_issued = 0;
+    log_ring.writer_thread.wakeup_fd = eventfd(0, EFD_CLOEXEC);
+    if ((log_ring.writer_thread.wakeup_fd == -1) ||
+        pthread_create(&log_ring.writer_thread.thread_id, 0, &kinesixd_log_priv_write_records, 0))
+    {
+        if (log_ring.writer_thread.wakeup_fd != -1)
+            close(log_ring.writer_thread.wakeup_fd);
+        free(log_ring.records);
+        log_ring.records = 0;
+        return 0;
+    }
+
+    __atomic_store_n(&log_ring.started, 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+void kinesixd_log_stop(void)
+{
+    uint64_t wakeup = 1;
+
+    if (!__atomic_load_n(&log_ring.started, __ATOMIC_ACQUIRE))
+        return;
+
+    __atomic_store_n(&log_ring.writer_thread.stop_issued, 1, __ATOMIC_RELEASE);
+    if (write(log_ring.writer_thread.wakeup_fd, &wakeup, sizeof(wakeup)) == sizeof(wakeup))
+        pthread_join(log_ring.writer_thread.thread_id, 0);
+
+    /* From here on everybody logs synchronously again */
+    __atomic_store_n(&log_ring.started, 0, __ATOMIC_RELEASE);
+    kinesixd_log_priv_drain();
+
+    close(log_ring.writer_thread.wakeup_fd);
+    if (log_ring.journal_fd != -1)
+        close(log_ring.journal_fd);
+    log_ring.journal_fd = -1;
+}
+
+void kinesixd_log_set_level(LogLevel level)
+{
+    __atomic_store_n(&log_ring.level, level, __ATOMIC_RELAXED);
+}
+
+LogLevel kinesixd_log_get_level(void)
+{
+    return __atomic_load_n(&log_ring.level, __ATOMIC_RELAXED);
+}
+
+int kinesixd_log_level_from_string(const char *level_name, LogLevel *level_out)
+{
+    int i = 0;
+
+    for (i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_FATAL; ++i)
+    {
+        if (strcasecmp(level_names[i], level_name) == 0)
+        {
+            *level_out = (LogLevel)i;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void kinesixd_log_write(LogLevel level,
+                        const char *file,
+                        const char *function,
+                        int line,
+                        const char *format, ...)
+{
+    struct _LogRecord *record = 0;
+    uint64_t position = 0;
+    uint64_t sequence = 0;
+    uint64_t wakeup = 1;
+    int64_t difference = 0;
+    char message[LOG_RECORD_MESSAGE_LEN];
+    va_list args;
+
+    if (level < __atomic_load_n(&log_ring.level, __ATOMIC_RELAXED))
+        return;
+
+    /* Fatal errors end the process right after, they can't wait for the writer */
+    if ((level == LOG_LEVEL_FATAL) || !__atomic_load_n(&log_ring.started, __ATOMIC_ACQUIRE))
+    {
+        va_start(args, format);
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+
+        if (level == LOG_LEVEL_FATAL)
+            kinesixd_log_stop();
+        kinesixd_log_priv_output(level, file, function, line, message);
+
+        return;
+    }
+
+    position = __atomic_load_n(&log_ring.enqueue_position, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        record = &log_ring.records[position % LOG_RING_SIZE];
+        sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+        difference = (int64_t)sequence - (int64_t)position;
+
+        if (difference == 0)
+        {
+            if (__atomic_compare_exchange_n(&log_ring.enqueue_position, &position, position + 1,
+                                            1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (difference < 0)
+        {
+            /* Ring is full, never make the caller wait for the writer */
+            __atomic_fetch_add(&log_ring.dropped_count, 1, __ATOMIC_RELAXED);
+            kinesixd_statistics_increment(STATISTICS_LOG_RECORDS_DROPPED);
+            return;
+        }
+        else
+        {
+            position = __atomic_load_n(&log_ring.enqueue_position, __ATOMIC_RELAXED);
+        }
+    }
+
+    record->level = level;
+    record->line = line;
+    record->file = file;
+    record->function = function;
+    va_start(args, format);
+    vsnprintf(record->message, LOG_RECORD_MESSAGE_LEN, format, args);
+    va_end(args);
+    __atomic_store_n(&record->sequence, position + 1, __ATOMIC_RELEASE);
+
+    /* Never blocks, the counter would need 2^64 unread wakeups to fill up */
+    if (write(log_ring.writer_thread.wakeup_fd, &wakeup, sizeof(wakeup)) != sizeof(wakeup))
+        return;
+}
+
+static void kinesixd_log_priv_output(LogLevel level,
+                                     const char *file,
+                                     const char *function,
+                                     int line,
+                                     const char *message)
+{
+    char entry[LOG_RECORD_MESSAGE_LEN + 512];
+    int entry_length = 0;
+
+    if (log_ring.journal_fd != -1)
+    {
+        entry_length = snprintf(entry, sizeof(entry),
+                                "PRIORITY=%d\nSYSLOG_IDENTIFIER=kinesixd\n"
+                                "CODE_FILE=%s\nCODE_LINE=%d\nCODE_FUNC=%s\nMESSAGE=%s\n",
+                                journal_priorities[level], file, line, function, message);
+        if (entry_length >= (int)sizeof(entry))
+            entry_length = sizeof(entry) - 1;
+        if ((entry_length > 0) && (send(log_ring.journal_fd, entry, entry_length, MSG_NOSIGNAL) != -1))
+            return;
+    }
+
+    fprintf(stderr,
+            "kinesixd: %s: %s: %s: %d: %s\n",
+            level_names[level],
+            file,
+            function,
+            line,
+            message);
+}
+
+/* Only ever called from a single thread at a time, either the writer or whoever stopped it */
+static int kinesixd_log_priv_drain(void)
+{
+    struct _LogRecord *record = 0;
+    uint64_t position = 0;
+    uint64_t dropped_count = 0;
+    char message[64];
+    int drained_count = 0;
+
+    if (!log_ring.records)
+        return 0;
+
+    for (;;)
+    {
+        position = log_ring.dequeue_position;
+        record = &log_ring.records[position % LOG_RING_SIZE];
+        if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != position + 1)
+            break;
+
+        kinesixd_log_priv_output(record->level, record->file, record->function, record->line, record->message);
+
+        __atomic_store_n(&record->sequence, position + LOG_RING_SIZE, __ATOMIC_RELEASE);
+        log_ring.dequeue_position = position + 1;
+        ++drained_count;
+    }
+
+    if ((dropped_count = __atomic_exchange_n(&log_ring.dropped_count, 0, __ATOMIC_RELAXED)))
+    {
+        snprintf(message, sizeof(message), "%llu log records dropped", (unsigned long long)dropped_count);
+        kinesixd_log_priv_output(LOG_LEVEL_WARNING, __FILE__, __func__, __LINE__, message);
+    }
+
+    return drained_count;
+}
+
+static void *kinesixd_log_priv_write_records(void *user_data)
+{
+    uint64_t wakeups = 0;
+
+    UNUSED(user_data)
+
+    for (;;)
+    {
+        if ((read(log_ring.writer_thread.wakeup_fd, &wakeups, sizeof(wakeups)) == -1) && (errno != EINTR))
+            break;
+
+        kinesixd_log_priv_drain();
+
+        if (__atomic_load_n(&log_ring.writer_thread.stop_issued, __ATOMIC_ACQUIRE))
+            break;
+    }
+
+    pthread_exit(0);
+}
@@ -0,0 +1,318 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_mt_recognizer.h"
+#include "kinesixd_daemon.h"
+
+#include <string.h>
+#include <math.h>
+
+#include <sys/ioctl.h>
+
+/* libinput's unaccelerated deltas are normalized to 1000 dpi */
+#define UNITS_PER_MM            (1000.0 / 25.4)
+/* How far the finger spread has to change before a gesture counts as a pinch */
+#define PINCH_SCALE_THRESHOLD   0.15
+#define MIN_FINGER_COUNT        2
+#define MIN_SWIPE_FINGER_COUNT  3
+
+static void kinesixd_mt_recognizer_priv_measure(const struct KinesixdMtRecognizer *self,
+                                                int *finger_count_out,
+                                                double *centroid_x_out,
+                                                double *centroid_y_out,
+                                                double *spread_out);
+static void kinesixd_mt_recognizer_priv_finish(struct KinesixdMtRecognizer *self,
+                                               double gesture_delta,
+                                               uint64_t time_usec,
+                                               struct KinesixdMtGesture *gesture_out);
+
+void kinesixd_mt_recognizer_init(struct KinesixdMtRecognizer *self,
+                                 int slot_count,
+                                 double x_resolution,
+                                 double y_resolution)
+{
+    int i = 0;
+
+    memset(self, 0, sizeof(*self));
+    self->slot_count = (slot_count > 0 && slot_count < MT_MAX_SLOTS) ? slot_count : MT_MAX_SLOTS;
+    for (i = 0; i < MT_MAX_SLOTS; ++i)
+        self->slot_tracking_id[i] = -1;
+
+    /* Resolution is in units per mm, devices that do not report it get treated as 1000 dpi */
+    self->x_scale = x_resolution > 0 ? UNITS_PER_MM / x_resolution : 1;
+    self->y_scale = y_resolution > 0 ? UNITS_PER_MM / y_resolution : 1;
+    self->scale = 1;
+}
+
+void kinesixd_mt_recognizer_sync(struct KinesixdMtRecognizer *self, int fd)
+{
+    struct
+    {
+        uint32_t code;
+        int32_t values[MT_MAX_SLOTS];
+    } slots;
+    const uint32_t codes[] = { ABS_MT_TRACKING_ID, ABS_MT_POSITION_X, ABS_MT_POSITION_Y };
+    struct input_absinfo slot_info;
+    size_t i = 0;
+    int slot = 0;
+
+    for (i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i)
+    {
+        memset(&slots, 0, sizeof(slots));
+        slots.code = codes[i];
+        if (ioctl(fd, EVIOCGMTSLOTS(sizeof(slots)), &slots) == -1)
+            continue;
+
+        for (slot = 0; slot < MT_MAX_SLOTS; ++slot)
+        {
+            if (codes[i] == ABS_MT_TRACKING_ID)
+                self->slot_tracking_id[slot] = slots.values[slot];
+            else if (codes[i] == ABS_MT_POSITION_X)
+                self->slot_x[slot] = slots.values[slot];
+            else
+                self->slot_y[slot] = slots.values[slot];
+        }
+    }
+    if (ioctl(fd, EVIOCGABS(ABS_MT_SLOT), &slot_info) == 0)
+        self->current_slot = slot_info.value;
+
+    /* Whatever was in progress lost frames, reporting it would be a guess */
+    self->gesture_active = 0;
+    self->wait_for_release = 1;
+    self->dropped = 0;
+}
+
+int kinesixd_mt_recognizer_feed(struct KinesixdMtRecognizer *self,
+                                const struct input_event *event,
+                                double gesture_delta,
+                                struct KinesixdMtGesture *gesture_out)
+{
+    if (event->type == EV_SYN)
+    {
+        if (event->code == SYN_DROPPED)
+        {
+            self->dropped = 1;
+        }
+        else if ((event->code == SYN_REPORT) && self->dropped)
+        {
+            /* The kernel queue is consistent again from here on, the slots are not */
+            return MT_FRAME_SYNC_NEEDED;
+        }
+        else if (event->code == SYN_REPORT)
+        {
+            return kinesixd_mt_recognizer_frame(self,
+                                                gesture_delta,
+                                                (uint64_t)event->input_event_sec * 1000000 + event->input_event_usec,
+                                                gesture_out);
+        }
+        return 0;
+    }
+
+    if ((event->type != EV_ABS) || self->dropped)
+        return 0;
+
+    switch (event->code)
+    {
+    case ABS_MT_SLOT:
+        self->current_slot = event->value;
+        break;
+    case ABS_MT_TRACKING_ID:
+        if ((self->current_slot >= 0) && (self->current_slot < self->slot_count))
+            self->slot_tracking_id[self->current_slot] = event->value;
+        break;
+    case ABS_MT_POSITION_X:
+        if ((self->current_slot >= 0) && (self->current_slot < self->slot_count))
+            self->slot_x[self->current_slot] = event->value;
+        break;
+    case ABS_MT_POSITION_Y:
+        if ((self->current_slot >= 0) && (self->current_slot < self->slot_count))
+            self->slot_y[self->current_slot] = event->value;
+        break;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+void kinesixd_mt_recognizer_touch(struct KinesixdMtRecognizer *self,
+                                  int slot,
+                                  int down,
+                                  double x,
+                                  double y)
+{
+    if ((slot < 0) || (slot >= self->slot_count))
+        return;
+
+    /* The recognizer only needs to know whether a slot is in use, not who is using it */
+    self->slot_tracking_id[slot] = down ? slot : -1;
+    if (down)
+    {
+        self->slot_x[slot] = x;
+        self->slot_y[slot] = y;
+    }
+}
+
+void kinesixd_mt_recognizer_cancel(struct KinesixdMtRecognizer *self)
+{
+    int i = 0;
+
+    for (i = 0; i < MT_MAX_SLOTS; ++i)
+        self->slot_tracking_id[i] = -1;
+    self->gesture_active = 0;
+    self->wait_for_release = 0;
+}
+
+static void kinesixd_mt_recognizer_priv_measure(const struct KinesixdMtRecognizer *self,
+                                                int *finger_count_out,
+                                                double *centroid_x_out,
+                                                double *centroid_y_out,
+                                                double *spread_out)
+{
+    double sum_x = 0;
+    double sum_y = 0;
+    double spread = 0;
+    int finger_count = 0;
+    int i = 0;
+
+    for (i = 0; i < self->slot_count; ++i)
+    {
+        if (self->slot_tracking_id[i] == -1)
+            continue;
+        sum_x += self->slot_x[i] * self->x_scale;
+        sum_y += self->slot_y[i] * self->y_scale;
+        ++finger_count;
+    }
+
+    *finger_count_out = finger_count;
+    if (!finger_count)
+        return;
+
+    *centroid_x_out = sum_x / finger_count;
+    *centroid_y_out = sum_y / finger_count;
+
+    /* Mean distance from the centroid, its ratio over time is the pinch scale */
+    for (i = 0; i < self->slot_count; ++i)
+    {
+        if (self->slot_tracking_id[i] == -1)
+            continue;
+        spread += hypot(self->slot_x[i] * self->x_scale - *centroid_x_out,
+                        self->slot_y[i] * self->y_scale - *centroid_y_out);
+    }
+    *spread_out = spread / finger_count;
+}
+
+static void kinesixd_mt_recognizer_priv_finish(struct KinesixdMtRecognizer *self,
+                                               double gesture_delta,
+                                               uint64_t time_usec,
+                                               struct KinesixdMtGesture *gesture_out)
+{
+    gesture_out->kind = MT_GESTURE_NONE;
+    gesture_out->result = UNKNOWN_GESTURE;
+    gesture_out->finger_count = self->gesture_finger_count;
+    gesture_out->start_usec = self->kinetics.start_usec;
+    gesture_out->time_usec = time_usec;
+    kinesixd_kinetics_finish(&self->kinetics, time_usec, &gesture_out->fling);
+    self->gesture_active = 0;
+
+    if (fabs(self->scale - 1) > PINCH_SCALE_THRESHOLD)
+    {
+        gesture_out->kind = MT_GESTURE_PINCH;
+        gesture_out->result = self->scale > 1 ? PINCH_OUT : PINCH_IN;
+    }
+    else if (self->gesture_finger_count >= MIN_SWIPE_FINGER_COUNT)
+    {
+        /* Same rule as the libinput path: the dominant axis of the largest single frame motion */
+        gesture_out->kind = MT_GESTURE_SWIPE;
+        if (fabs(self->y_max) > fabs(self->x_max))
+        {
+            if (self->y_max < -gesture_delta)
+                gesture_out->result = SWIPE_UP;
+            else if (self->y_max > gesture_delta)
+                gesture_out->result = SWIPE_DOWN;
+        }
+        else if (fabs(self->x_max) > fabs(self->y_max))
+        {
+            if (self->x_max < -gesture_delta)
+                gesture_out->result = SWIPE_LEFT;
+            else if (self->x_max > gesture_delta)
+                gesture_out->result = SWIPE_RIGHT;
+        }
+    }
+}
+
+int kinesixd_mt_recognizer_frame(struct KinesixdMtRecognizer *self,
+                                 double gesture_delta,
+                                 uint64_t time_usec,
+                                 struct KinesixdMtGesture *gesture_out)
+{
+    double centroid_x = 0;
+    double centroid_y = 0;
+    double spread = 0;
+    double dx = 0;
+    double dy = 0;
+    int finger_count = 0;
+    int result = 0;
+
+    kinesixd_mt_recognizer_priv_measure(self, &finger_count, &centroid_x, &centroid_y, &spread);
+
+    if (self->gesture_active && (finger_count == self->gesture_finger_count))
+    {
+        dx = centroid_x - self->last_centroid_x;
+        dy = centroid_y - self->last_centroid_y;
+        self->x_max = fabs(self->x_max) < fabs(dx) ? dx : self->x_max;
+        self->y_max = fabs(self->y_max) < fabs(dy) ? dy : self->y_max;
+        self->last_centroid_x = centroid_x;
+        self->last_centroid_y = centroid_y;
+        kinesixd_kinetics_update(&self->kinetics, dx, dy, time_usec);
+        if (self->start_spread > 0)
+            self->scale = spread / self->start_spread;
+        return 0;
+    }
+
+    /* Fingers rarely land in the same frame, so one more finger restarts the gesture silently */
+    if (self->gesture_active && (finger_count < self->gesture_finger_count))
+    {
+        /* Lifting them is how a gesture ends, one at a time, so wait for the last one to leave */
+        kinesixd_mt_recognizer_priv_finish(self, gesture_delta, time_usec, gesture_out);
+        self->wait_for_release = 1;
+        result |= MT_FRAME_GESTURE_ENDED;
+    }
+
+    if (finger_count == 0)
+        self->wait_for_release = 0;
+
+    if ((finger_count >= MIN_FINGER_COUNT) && !self->wait_for_release)
+    {
+        if (!self->gesture_active)
+            result |= MT_FRAME_GESTURE_BEGAN;
+
+        self->gesture_active = 1;
+        self->gesture_finger_count = finger_count;
+        self->last_centroid_x = centroid_x;
+        self->last_centroid_y = centroid_y;
+        self->start_spread = spread;
+        self->scale = 1;
+        self->x_max = 0;
+        self->y_max = 0;
+        kinesixd_kinetics_begin(&self->kinetics, time_usec);
+    }
+
+    return result;
+}
@@ -0,0 +1,461 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_sequence.h"
+#include "kinesixd_daemon.h"
+#include "kinesixd_global.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define RESULT_COUNT            4
+#define FINGER_CLASS_COUNT      (SEQUENCE_MAX_FINGERS - SEQUENCE_MIN_FINGERS + 1)
+#define GESTURE_SYMBOL_COUNT    (2 * RESULT_COUNT * FINGER_CLASS_COUNT)
+#define MAX_DFA_STATES          1024
+#define STATE_HASH_SIZE         (2 * MAX_DFA_STATES)
+#define SET_WORD_COUNT          ((SEQUENCE_MAX_COUNT * SEQUENCE_MAX_STEPS + 63) / 64)
+
+/* A DFA state during construction: bit (sequence * SEQUENCE_MAX_STEPS + matched - 1) is set for
+ * every sequence whose first `matched` steps were just seen. Starting a sequence is always
+ * possible, so that needs no bit of its own */
+struct _StateSet
+{
+    uint64_t bits[SET_WORD_COUNT];
+};
+
+struct _Builder
+{
+    const struct KinesixdSequence *sequences;
+    int sequence_count;
+    const struct KinesixdSequenceMatcher *matcher;
+    int gap_class_count;
+
+    struct _StateSet *sets;
+    uint16_t *transitions;
+    int16_t *accepted;
+    int state_count;
+    int state_capacity;
+    int16_t hash[STATE_HASH_SIZE];
+};
+
+static int kinesixd_sequence_priv_parse_step(char *text, struct KinesixdSequenceStep *step_out);
+static int kinesixd_sequence_priv_finger_class(int finger_count);
+static int kinesixd_sequence_priv_gap_class(const struct KinesixdSequenceMatcher *matcher, uint64_t gap_usec);
+static int kinesixd_sequence_priv_compare_thresholds(const void *left, const void *right);
+static int kinesixd_sequence_priv_step_matches(const struct _Builder *builder,
+                                               const struct KinesixdSequenceStep *step,
+                                               int first,
+                                               int gesture_symbol,
+                                               int gap_class);
+static void kinesixd_sequence_priv_advance(const struct _Builder *builder,
+                                           const struct _StateSet *from,
+                                           int symbol,
+                                           struct _StateSet *to_out);
+static int kinesixd_sequence_priv_find_or_add(struct _Builder *builder, const struct _StateSet *set);
+static int16_t kinesixd_sequence_priv_longest_accepted(const struct _Builder *builder, const struct _StateSet *set);
+
+int kinesixd_sequence_parse(const char *name, const char *text, struct KinesixdSequence *sequence_out)
+{
+    char buffer[256];
+    char *step_text = 0;
+    char *save_pointer = 0;
+    struct KinesixdSequence sequence;
+
+    if ((strlen(name) == 0) || (strlen(name) >= SEQUENCE_NAME_MAX) || (strlen(text) >= sizeof(buffer)))
+        return 0;
+
+    memset(&sequence, 0, sizeof(sequence));
+    strcpy(sequence.name, name);
+    strcpy(buffer, text);
+
+    for (step_text = strtok_r(buffer, ",", &save_pointer);
+         step_text;
+         step_text = strtok_r(0, ",", &save_pointer))
+    {
+        if ((sequence.step_count == SEQUENCE_MAX_STEPS) ||
+            !kinesixd_sequence_priv_parse_step(step_text, &sequence.steps[sequence.step_count]))
+        {
+            return 0;
+        }
+        ++sequence.step_count;
+    }
+
+    if (!sequence.step_count)
+        return 0;
+
+    *sequence_out = sequence;
+
+    return 1;
+}
+
+void kinesixd_sequence_matcher_init(struct KinesixdSequenceMatcher *self)
+{
+    memset(self, 0, sizeof(*self));
+}
+
+void kinesixd_sequence_matcher_free(struct KinesixdSequenceMatcher *self)
+{
+    free(self->transitions);
+    free(self->accepted);
+    kinesixd_sequence_matcher_init(self);
+}
+
+int kinesixd_sequence_matcher_compile(struct KinesixdSequenceMatcher *self,
+                                      const struct KinesixdSequence *sequences,
+                                      int sequence_count)
+{
+    struct KinesixdSequenceMatcher compiled;
+    struct _Builder *builder = 0;
+    struct _StateSet next;
+    int state = 0;
+    int symbol = 0;
+    int next_state = 0;
+    int i = 0;
+    int j = 0;
+
+    kinesixd_sequence_matcher_init(&compiled);
+    if (sequence_count > SEQUENCE_MAX_COUNT)
+        return 0;
+
+    /* Every distinct gap limit splits the time line, a gap class is one piece of it */
+    for (i = 0; i < sequence_count; ++i)
+    {
+        strcpy(compiled.names[i], sequences[i].name);
+        for (j = 1; j < sequences[i].step_count; ++j)
+        {
+            if (sequences[i].steps[j].max_gap_ms)
+                compiled.gap_thresholds_ms[compiled.gap_threshold_count++] = sequences[i].steps[j].max_gap_ms;
+        }
+    }
+    qsort(compiled.gap_thresholds_ms,
+          (size_t)compiled.gap_threshold_count,
+          sizeof(unsigned int),
+          &kinesixd_sequence_priv_compare_thresholds);
+    for (i = 0, j = 0; i < compiled.gap_threshold_count; ++i)
+    {
+        if ((j == 0) || (compiled.gap_thresholds_ms[j - 1] != compiled.gap_thresholds_ms[i]))
+            compiled.gap_thresholds_ms[j++] = compiled.gap_thresholds_ms[i];
+    }
+    compiled.gap_threshold_count = j;
+    compiled.symbol_count = GESTURE_SYMBOL_COUNT * (compiled.gap_threshold_count + 1);
+
+    if (!sequence_count)
+    {
+        kinesixd_sequence_matcher_free(self);
+        *self = compiled;
+        return 1;
+    }
+
+    builder = (struct _Builder *)calloc(1, sizeof(struct _Builder));
+    builder->sequences = sequences;
+    builder->sequence_count = sequence_count;
+    builder->matcher = &compiled;
+    builder->gap_class_count = compiled.gap_threshold_count + 1;
+    memset(builder->hash, 0xff, sizeof(builder->hash));
+
+    /* Subset construction, breadth first from the state where nothing matched yet */
+    memset(&next, 0, sizeof(next));
+    kinesixd_sequence_priv_find_or_add(builder, &next);
+    for (state = 0; state < builder->state_count; ++state)
+    {
+        for (symbol = 0; symbol < compiled.symbol_count; ++symbol)
+        {
+            kinesixd_sequence_priv_advance(builder, &builder->sets[state], symbol, &next);
+            if ((next_state = kinesixd_sequence_priv_find_or_add(builder, &next)) < 0)
+            {
+                LOG_WARN("Gesture sequences need more than %d states, keeping the previous ones", MAX_DFA_STATES);
+                free(builder->sets);
+                free(builder->transitions);
+                free(builder->accepted);
+                free(builder);
+                return 0;
+            }
+            builder->transitions[state * compiled.symbol_count + symbol] = (uint16_t)next_state;
+        }
+    }
+
+    compiled.state_count = builder->state_count;
+    compiled.transitions = builder->transitions;
+    compiled.accepted = builder->accepted;
+    LOG_DEBUG("Compiled %d gesture sequences into %d states over %d symbols",
+              sequence_count, compiled.state_count, compiled.symbol_count);
+
+    free(builder->sets);
+    free(builder);
+
+    kinesixd_sequence_matcher_free(self);
+    *self = compiled;
+
+    return 1;
+}
+
+void kinesixd_sequence_matcher_reset(struct KinesixdSequenceMatcher *self)
+{
+    self->state = 0;
+    self->last_end_usec = 0;
+}
+
+const char *kinesixd_sequence_matcher_step(struct KinesixdSequenceMatcher *self,
+                                           enum SequenceGesture gesture,
+                                           int result,
+                                           int finger_count,
+                                           uint64_t start_usec,
+                                           uint64_t end_usec)
+{
+    uint64_t gap_usec = (start_usec > self->last_end_usec) ? start_usec - self->last_end_usec : 0;
+    int gesture_symbol = 0;
+    int symbol = 0;
+
+    if (!self->state_count || (result < 0) || (result >= RESULT_COUNT))
+        return 0;
+
+    /* Nothing came before the first gesture, so it can only ever start a sequence */
+    if (!self->last_end_usec)
+        gap_usec = UINT64_MAX;
+    self->last_end_usec = end_usec;
+
+    gesture_symbol = ((int)gesture * RESULT_COUNT + result) * FINGER_CLASS_COUNT +
+                     kinesixd_sequence_priv_finger_class(finger_count);
+    symbol = gesture_symbol * (self->gap_threshold_count + 1) + kinesixd_sequence_priv_gap_class(self, gap_usec);
+
+    self->state = self->transitions[self->state * self->symbol_count + symbol];
+    if (self->accepted[self->state] < 0)
+        return 0;
+
+    return self->names[self->accepted[self->state]];
+}
+
+static int kinesixd_sequence_priv_parse_step(char *text, struct KinesixdSequenceStep *step_out)
+{
+    static const char *swipe_directions[] = { "up", "down", "left", "right" };
+    static const char *pinch_types[] = { "in", "out" };
+    char *save_pointer = 0;
+    char *word = 0;
+    char *end = 0;
+    long number = 0;
+    int i = 0;
+
+    memset(step_out, 0, sizeof(*step_out));
+
+    if (!(word = strtok_r(text, " \t", &save_pointer)))
+        return 0;
+    if (strcasecmp(word, "swipe") == 0)
+        step_out->gesture = SEQUENCE_GESTURE_SWIPE;
+    else if (strcasecmp(word, "pinch") == 0)
+        step_out->gesture = SEQUENCE_GESTURE_PINCH;
+    else
+        return 0;
+
+    if (!(word = strtok_r(0, " \t", &save_pointer)))
+        return 0;
+    step_out->result = UNKNOWN_GESTURE;
+    if (step_out->gesture == SEQUENCE_GESTURE_SWIPE)
+    {
+        for (i = 0; i < 4; ++i)
+            if (strcasecmp(word, swipe_directions[i]) == 0)
+                step_out->result = SWIPE_UP + i;
+    }
+    else
+    {
+        for (i = 0; i < 2; ++i)
+            if (strcasecmp(word, pinch_types[i]) == 0)
+                step_out->result = PINCH_IN + i;
+    }
+    if (step_out->result == UNKNOWN_GESTURE)
+        return 0;
+
+    while ((word = strtok_r(0, " \t", &save_pointer)))
+    {
+        if (strcasecmp(word, "within") == 0)
+        {
+            if (!(word = strtok_r(0, " \t", &save_pointer)))
+                return 0;
+            number = strtol(word, &end, 10);
+            if ((end == word) || (number <= 0) || (number > 60000) ||
+                ((*end != '\0') && (strcasecmp(end, "ms") != 0)))
+                return 0;
+            step_out->max_gap_ms = (unsigned int)number;
+        }
+        else
+        {
+            number = strtol(word, &end, 10);
+            if ((end == word) || (*end != '\0') ||
+                (number < SEQUENCE_MIN_FINGERS) || (number > SEQUENCE_MAX_FINGERS))
+                return 0;
+            step_out->finger_count = (int)number;
+        }
+    }
+
+    return 1;
+}
+
+static int kinesixd_sequence_priv_finger_class(int finger_count)
+{
+    if (finger_count < SEQUENCE_MIN_FINGERS)
+        finger_count = SEQUENCE_MIN_FINGERS;
+    if (finger_count > SEQUENCE_MAX_FINGERS)
+        finger_count = SEQUENCE_MAX_FINGERS;
+
+    return finger_count - SEQUENCE_MIN_FINGERS;
+}
+
+static int kinesixd_sequence_priv_gap_class(const struct KinesixdSequenceMatcher *self, uint64_t gap_usec)
+{
+    int low = 0;
+    int high = self->gap_threshold_count;
+    int middle = 0;
+
+    /* Index of the first threshold the gap fits in, the count of them if it fits in none */
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        if (gap_usec <= (uint64_t)self->gap_thresholds_ms[middle] * 1000ull)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+
+    return low;
+}
+
+static int kinesixd_sequence_priv_compare_thresholds(const void *left, const void *right)
+{
+    unsigned int left_value = *(const unsigned int *)left;
+    unsigned int right_value = *(const unsigned int *)right;
+
+    return (left_value > right_value) - (left_value < right_value);
+}
+
+static int kinesixd_sequence_priv_step_matches(const struct _Builder *builder,
+                                               const struct KinesixdSequenceStep *step,
+                                               int first,
+                                               int gesture_symbol,
+                                               int gap_class)
+{
+    int finger_class = gesture_symbol % FINGER_CLASS_COUNT;
+    int result = (gesture_symbol / FINGER_CLASS_COUNT) % RESULT_COUNT;
+    int gesture = gesture_symbol / (FINGER_CLASS_COUNT * RESULT_COUNT);
+    const struct KinesixdSequenceMatcher *matcher = builder->matcher;
+    int limit_class = 0;
+
+    if (((int)step->gesture != gesture) || (step->result != result))
+        return 0;
+    if (step->finger_count && (kinesixd_sequence_priv_finger_class(step->finger_count) != finger_class))
+        return 0;
+    if (first || !step->max_gap_ms)
+        return 1;
+
+    /* Classes up to and including the one ending at this step's own limit */
+    for (limit_class = 0; matcher->gap_thresholds_ms[limit_class] != step->max_gap_ms; ++limit_class);
+
+    return gap_class <= limit_class;
+}
+
+static void kinesixd_sequence_priv_advance(const struct _Builder *builder,
+                                           const struct _StateSet *from,
+                                           int symbol,
+                                           struct _StateSet *to_out)
+{
+    int gesture_symbol = symbol / builder->gap_class_count;
+    int gap_class = symbol % builder->gap_class_count;
+    const struct KinesixdSequence *sequence = 0;
+    int matched = 0;
+    int bit = 0;
+    int i = 0;
+
+    memset(to_out, 0, sizeof(*to_out));
+
+    for (i = 0; i < builder->sequence_count; ++i)
+    {
+        sequence = &builder->sequences[i];
+
+        if (kinesixd_sequence_priv_step_matches(builder, &sequence->steps[0], 1, gesture_symbol, gap_class))
+        {
+            bit = i * SEQUENCE_MAX_STEPS;
+            to_out->bits[bit / 64] |= 1ull << (bit % 64);
+        }
+
+        for (matched = 1; matched < sequence->step_count; ++matched)
+        {
+            bit = i * SEQUENCE_MAX_STEPS + matched - 1;
+            if (!(from->bits[bit / 64] & (1ull << (bit % 64))) ||
+                !kinesixd_sequence_priv_step_matches(builder, &sequence->steps[matched], 0, gesture_symbol, gap_class))
+                continue;
+
+            ++bit;
+            to_out->bits[bit / 64] |= 1ull << (bit % 64);
+        }
+    }
+}
+
+static int kinesixd_sequence_priv_find_or_add(struct _Builder *self, const struct _StateSet *set)
+{
+    uint64_t hash = 14695981039346656037ull;
+    int slot = 0;
+    int state = 0;
+    int i = 0;
+
+    for (i = 0; i < SET_WORD_COUNT; ++i)
+        hash = (hash ^ set->bits[i]) * 1099511628211ull;
+
+    for (slot = (int)(hash % STATE_HASH_SIZE); self->hash[slot] >= 0; slot = (slot + 1) % STATE_HASH_SIZE)
+    {
+        if (memcmp(&self->sets[self->hash[slot]], set, sizeof(*set)) == 0)
+            return self->hash[slot];
+    }
+
+    if (self->state_count == MAX_DFA_STATES)
+        return -1;
+
+    if (self->state_count == self->state_capacity)
+    {
+        self->state_capacity = self->state_capacity ? self->state_capacity * 2 : 16;
+        self->sets = (struct _StateSet *)realloc(self->sets, self->state_capacity * sizeof(struct _StateSet));
+        self->accepted = (int16_t *)realloc(self->accepted, self->state_capacity * sizeof(int16_t));
+        self->transitions = (uint16_t *)realloc(self->transitions,
+                                                self->state_capacity * self->matcher->symbol_count * sizeof(uint16_t));
+    }
+
+    state = self->state_count++;
+    self->sets[state] = *set;
+    self->accepted[state] = kinesixd_sequence_priv_longest_accepted(self, set);
+    self->hash[slot] = (int16_t)state;
+
+    return state;
+}
+
+static int16_t kinesixd_sequence_priv_longest_accepted(const struct _Builder *builder, const struct _StateSet *set)
+{
+    int16_t longest = -1;
+    int bit = 0;
+    int i = 0;
+
+    for (i = 0; i < builder->sequence_count; ++i)
+    {
+        bit = i * SEQUENCE_MAX_STEPS + builder->sequences[i].step_count - 1;
+        if (!(set->bits[bit / 64] & (1ull << (bit % 64))))
+            continue;
+
+        if ((longest < 0) || (builder->sequences[i].step_count > builder->sequences[longest].step_count))
+            longest = (int16_t)i;
+    }
+
+    return longest;
+}
@@ -0,0 +1,575 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_session_router.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <poll.h>
+#include <pthread.h>
+
+#ifdef HAVE_LIBSYSTEMD
+#include <systemd/sd-login.h>
+#endif
+
+#define MAX_SESSION_ID_LEN  64
+#define MAX_SEAT_ID_LEN     32
+#define MAX_SEAT_COUNT      8
+/* Rejections arrive a round trip through the bus later, a handful of copies covers that */
+#define RECENT_SERIAL_COUNT 16
+/* The bus caps unique and well-known names at 255 characters */
+#define MAX_BUS_NAME_LEN    256
+/* Destinations copied out per pass, routing never allocates and the stack stays small */
+#define ROUTE_CHUNK_SIZE    8
+
+struct _Subscriber
+{
+    char *bus_name;
+    char session[MAX_SESSION_ID_LEN];
+    unsigned int gesture_mask;
+
+    uint64_t signals_routed;
+    uint64_t signals_rejected;
+    unsigned int recent_serials[RECENT_SERIAL_COUNT];
+    int recent_serial_head;
+};
+
+struct _SessionPolicy
+{
+    char session[MAX_SESSION_ID_LEN];
+    unsigned int gesture_mask;
+};
+
+/* Looking up the active session means reading logind state files, so do it once per seat change */
+struct _SeatCache
+{
+    char seat[MAX_SEAT_ID_LEN];
+    char active_session[MAX_SESSION_ID_LEN];
+    int valid;
+};
+
+struct _KinesixdSessionRouter
+{
+    int route_by_session;
+    pthread_mutex_t mutex;
+
+    struct _Subscriber *subscribers;
+    int subscriber_count;
+    int subscriber_capacity;
+
+    struct _SessionPolicy *policies;
+    int policy_count;
+    int policy_capacity;
+
+    struct _SeatCache seats[MAX_SEAT_COUNT];
+#ifdef HAVE_LIBSYSTEMD
+    sd_login_monitor *login_monitor;
+#endif
+};
+
+static int kinesixd_session_router_priv_session_from_pid(pid_t pid, char *buffer, size_t buffer_size);
+static const char *kinesixd_session_router_priv_active_session(KinesixdSessionRouter self, const char *seat);
+static unsigned int kinesixd_session_router_priv_session_policy(KinesixdSessionRouter self, const char *session);
+static int kinesixd_session_router_priv_wants_gesture(KinesixdSessionRouter self,
+                                                      const struct _Subscriber *subscriber,
+                                                      const char *active_session,
+                                                      unsigned int gesture);
+static struct _Subscriber *kinesixd_session_router_priv_find_subscriber(KinesixdSessionRouter self,
+                                                                        const char *bus_name);
+
+KinesixdSessionRouter kinesixd_session_router_new(int route_by_session)
+{
+    KinesixdSessionRouter self = (KinesixdSessionRouter)malloc(sizeof(struct _KinesixdSessionRouter));
+
+    self->route_by_session = route_by_session;
+    pthread_mutex_init(&self->mutex, 0);
+    self->subscribers = 0;
+    self->subscriber_count = 0;
+    self->subscriber_capacity = 0;
+    self->policies = 0;
+    self->policy_count = 0;
+    self->policy_capacity = 0;
+    memset(self->seats, 0, sizeof(self->seats));
+
+#ifdef HAVE_LIBSYSTEMD
+    self->login_monitor = 0;
+    if (route_by_session && (sd_login_monitor_new("session", &self->login_monitor) < 0))
+    {
+        LOG_WARN("Could not monitor logind sessions. Session switches will go unnoticed");
+        self->login_monitor = 0;
+    }
+#else
+    if (route_by_session)
+        LOG_WARN("Built without logind support. Gestures will be delivered to every subscribed session");
+#endif
+
+    return self;
+}
+
+void kinesixd_session_router_free(KinesixdSessionRouter self)
+{
+    int i = 0;
+
+#ifdef HAVE_LIBSYSTEMD
+    if (self->login_monitor)
+        sd_login_monitor_unref(self->login_monitor);
+#endif
+
+    for (i = 0; i < self->subscriber_count; ++i)
+        free(self->subscribers[i].bus_name);
+    free(self->subscribers);
+    free(self->policies);
+    pthread_mutex_destroy(&self->mutex);
+
+    free(self);
+}
+
+int kinesixd_session_router_subscribe(KinesixdSessionRouter self,
+                                      const char *bus_name,
+                                      pid_t pid,
+                                      unsigned int gesture_mask)
+{
+    struct _Subscriber *subscriber = 0;
+    int i = 0;
+
+    pthread_mutex_lock(&self->mutex);
+
+    for (i = 0; i < self->subscriber_count; ++i)
+    {
+        if (strcmp(self->subscribers[i].bus_name, bus_name) == 0)
+        {
+            subscriber = &self->subscribers[i];
+            break;
+        }
+    }
+
+    if (!subscriber)
+    {
+        if (self->subscriber_count == self->subscriber_capacity)
+        {
+            self->subscriber_capacity = self->subscriber_capacity ? self->subscriber_capacity * 2 : 4;
+            self->subscribers = (struct _Subscriber *)realloc(self->subscribers,
+                                    self->subscriber_capacity * sizeof(struct _Subscriber));
+        }
+
+        subscriber = &self->subscribers[self->subscriber_count++];
+        subscriber->bus_name = strdup(bus_name);
+        subscriber->session[0] = '\0';
+        subscriber->signals_routed = 0;
+        subscriber->signals_rejected = 0;
+        memset(subscriber->recent_serials, 0, sizeof(subscriber->recent_serials));
+        subscriber->recent_serial_head = 0;
+        if (self->route_by_session &&
+            !kinesixd_session_router_priv_session_from_pid(pid, subscriber->session, MAX_SESSION_ID_LEN))
+            LOG_WARN("Could not determine the session of %s (pid %d)", bus_name, (int)pid);
+    }
+
+    subscriber->gesture_mask = gesture_mask & (GESTURE_MASK_ALL | GESTURE_MASK_BATCH);
+    LOG_DEBUG("%s subscribed to gestures 0x%x from session '%s'",
+              bus_name, subscriber->gesture_mask, subscriber->session);
+
+    pthread_mutex_unlock(&self->mutex);
+
+    return 1;
+}
+
+int kinesixd_session_router_unsubscribe(KinesixdSessionRouter self, const char *bus_name)
+{
+    int removed = 0;
+    int i = 0;
+
+    pthread_mutex_lock(&self->mutex);
+
+    for (i = 0; i < self->subscriber_count; ++i)
+    {
+        if (strcmp(self->subscribers[i].bus_name, bus_name) == 0)
+        {
+            free(self->subscribers[i].bus_name);
+            self->subscribers[i] = self->subscribers[--self->subscriber_count];
+            removed = 1;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+
+    return removed;
+}
+
+int kinesixd_session_router_set_session_policy(KinesixdSessionRouter self,
+                                               pid_t pid,
+                                               unsigned int gesture_mask)
+{
+    char session[MAX_SESSION_ID_LEN];
+    struct _SessionPolicy *policy = 0;
+    int i = 0;
+
+    if (!kinesixd_session_router_priv_session_from_pid(pid, session, MAX_SESSION_ID_LEN))
+        return 0;
+
+    pthread_mutex_lock(&self->mutex);
+
+    for (i = 0; i < self->policy_count; ++i)
+    {
+        if (strcmp(self->policies[i].session, session) == 0)
+        {
+            policy = &self->policies[i];
+            break;
+        }
+    }
+
+    if (!policy)
+    {
+        if (self->policy_count == self->policy_capacity)
+        {
+            self->policy_capacity = self->policy_capacity ? self->policy_capacity * 2 : 4;
+            self->policies = (struct _SessionPolicy *)realloc(self->policies,
+                                 self->policy_capacity * sizeof(struct _SessionPolicy));
+        }
+
+        policy = &self->policies[self->policy_count++];
+        strcpy(policy->session, session);
+    }
+
+    policy->gesture_mask = gesture_mask & GESTURE_MASK_ALL;
+
+    pthread_mutex_unlock(&self->mutex);
+
+    return 1;
+}
+
+int kinesixd_session_router_session_is_active(KinesixdSessionRouter self, pid_t pid, const char *seat)
+{
+    char session[MAX_SESSION_ID_LEN];
+    const char *active_session = 0;
+    int is_active = 0;
+
+    if (!self->route_by_session)
+        return 1;
+
+    if (!kinesixd_session_router_priv_session_from_pid(pid, session, MAX_SESSION_ID_LEN))
+        return 0;
+
+    pthread_mutex_lock(&self->mutex);
+    active_session = kinesixd_session_router_priv_active_session(self, seat ? seat : "seat0");
+    is_active = active_session && (strcmp(active_session, session) == 0);
+    pthread_mutex_unlock(&self->mutex);
+
+    return is_active;
+}
+
+int kinesixd_session_router_get_subscriber_count(KinesixdSessionRouter self)
+{
+    int subscriber_count = 0;
+
+    pthread_mutex_lock(&self->mutex);
+    subscriber_count = self->subscriber_count;
+    pthread_mutex_unlock(&self->mutex);
+
+    return subscriber_count;
+}
+
+int kinesixd_session_router_count_subscribers(KinesixdSessionRouter self, unsigned int gesture_mask)
+{
+    int subscriber_count = 0;
+    int i = 0;
+
+    pthread_mutex_lock(&self->mutex);
+    for (i = 0; i < self->subscriber_count; ++i)
+    {
+        if (self->subscribers[i].gesture_mask & gesture_mask)
+            ++subscriber_count;
+    }
+    pthread_mutex_unlock(&self->mutex);
+
+    return subscriber_count;
+}
+
+void kinesixd_session_router_refresh(KinesixdSessionRouter self)
+{
+#ifdef HAVE_LIBSYSTEMD
+    int i = 0;
+    struct pollfd poller = { .fd = -1, .events = POLLIN, .revents = 0 };
+
+    if (!self->login_monitor)
+        return;
+
+    poller.fd = sd_login_monitor_get_fd(self->login_monitor);
+    if ((poll(&poller, 1, 0) <= 0) || !(poller.revents & POLLIN))
+        return;
+
+    sd_login_monitor_flush(self->login_monitor);
+
+    pthread_mutex_lock(&self->mutex);
+    for (i = 0; i < MAX_SEAT_COUNT; ++i)
+        self->seats[i].valid = 0;
+    pthread_mutex_unlock(&self->mutex);
+
+    LOG_DEBUG("Session state changed, active sessions will be looked up again");
+#else
+    UNUSED(self)
+#endif
+}
+
+int kinesixd_session_router_route(KinesixdSessionRouter self,
+                                  const char *seat,
+                                  unsigned int gesture,
+                                  RouteCallback callback,
+                                  void *user_data)
+{
+    char destinations[ROUTE_CHUNK_SIZE][MAX_BUS_NAME_LEN];
+    unsigned int serials[ROUTE_CHUNK_SIZE];
+    struct _Subscriber *subscriber = 0;
+    const char *active_session = 0;
+    int destination_count = 0;
+    int routed_count = 0;
+    int next = 0;
+    int done = 0;
+    int i = 0;
+
+    /* The callback writes to the bus, which must not hold up subscribing or unsubscribing.
+     * So the matching names are copied out under the mutex and sent to without it. Someone
+     * leaving meanwhile moves the last subscriber into its slot, which then misses this one
+     * gesture, nobody ever gets it twice */
+    while (!done)
+    {
+        pthread_mutex_lock(&self->mutex);
+
+        active_session = 0;
+        if (self->route_by_session)
+        {
+            active_session = kinesixd_session_router_priv_active_session(self, seat ? seat : "seat0");
+            if (active_session &&
+                !(kinesixd_session_router_priv_session_policy(self, active_session) & gesture & GESTURE_MASK_ALL))
+                active_session = 0;
+        }
+
+        destination_count = 0;
+        for (; (next < self->subscriber_count) && (destination_count < ROUTE_CHUNK_SIZE); ++next)
+        {
+            if (!kinesixd_session_router_priv_wants_gesture(self, &self->subscribers[next], active_session, gesture))
+                continue;
+
+            strncpy(destinations[destination_count], self->subscribers[next].bus_name, MAX_BUS_NAME_LEN - 1);
+            destinations[destination_count][MAX_BUS_NAME_LEN - 1] = '\0';
+            ++destination_count;
+        }
+        done = next >= self->subscriber_count;
+
+        pthread_mutex_unlock(&self->mutex);
+
+        if (!destination_count)
+            continue;
+
+        for (i = 0; i < destination_count; ++i)
+            serials[i] = callback(destinations[i], user_data);
+
+        pthread_mutex_lock(&self->mutex);
+
+        for (i = 0; i < destination_count; ++i)
+        {
+            if (!serials[i])
+                continue;
+
+            ++routed_count;
+            if (!(subscriber = kinesixd_session_router_priv_find_subscriber(self, destinations[i])))
+                continue;
+
+            subscriber->recent_serials[subscriber->recent_serial_head] = serials[i];
+            subscriber->recent_serial_head = (subscriber->recent_serial_head + 1) % RECENT_SERIAL_COUNT;
+            ++subscriber->signals_routed;
+        }
+
+        pthread_mutex_unlock(&self->mutex);
+    }
+
+    return routed_count;
+}
+
+int kinesixd_session_router_signal_rejected(KinesixdSessionRouter self, unsigned int serial)
+{
+    int found = 0;
+    int i = 0;
+    int j = 0;
+
+    if (!serial)
+        return 0;
+
+    pthread_mutex_lock(&self->mutex);
+
+    for (i = 0; !found && (i < self->subscriber_count); ++i)
+    {
+        for (j = 0; j < RECENT_SERIAL_COUNT; ++j)
+        {
+            if (self->subscribers[i].recent_serials[j] == serial)
+            {
+                ++self->subscribers[i].signals_rejected;
+                found = 1;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+
+    return found;
+}
+
+void kinesixd_session_router_foreach_subscriber(KinesixdSessionRouter self,
+                                                SubscriberStatisticsCallback callback,
+                                                void *user_data)
+{
+    int i = 0;
+
+    pthread_mutex_lock(&self->mutex);
+
+    for (i = 0; i < self->subscriber_count; ++i)
+    {
+        callback(self->subscribers[i].bus_name,
+                 self->subscribers[i].signals_routed,
+                 self->subscribers[i].signals_rejected,
+                 user_data);
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+}
+
+static int kinesixd_session_router_priv_session_from_pid(pid_t pid, char *buffer, size_t buffer_size)
+{
+#ifdef HAVE_LIBSYSTEMD
+    char *session = 0;
+
+    if ((pid <= 0) || (sd_pid_get_session(pid, &session) < 0))
+        return 0;
+
+    strncpy(buffer, session, buffer_size - 1);
+    buffer[buffer_size - 1] = '\0';
+    free(session);
+
+    return 1;
+#else
+    UNUSED(pid)
+    UNUSED(buffer_size)
+
+    buffer[0] = '\0';
+
+    return 1;
+#endif
+}
+
+/* Must be called with the mutex held */
+static const char *kinesixd_session_router_priv_active_session(KinesixdSessionRouter self, const char *seat)
+{
+#ifdef HAVE_LIBSYSTEMD
+    struct _SeatCache *cache = 0;
+    char *session = 0;
+    int i = 0;
+
+    for (i = 0; i < MAX_SEAT_COUNT; ++i)
+    {
+        if ((self->seats[i].seat[0] == '\0') || (strcmp(self->seats[i].seat, seat) == 0))
+        {
+            cache = &self->seats[i];
+            break;
+        }
+    }
+
+    /* Out of cache slots, recycle the first one */
+    if (!cache)
+        cache = &self->seats[0];
+
+    if (!cache->valid || (strcmp(cache->seat, seat) != 0))
+    {
+        strncpy(cache->seat, seat, MAX_SEAT_ID_LEN - 1);
+        cache->seat[MAX_SEAT_ID_LEN - 1] = '\0';
+        cache->active_session[0] = '\0';
+
+        if (sd_seat_get_active(seat, &session, 0) >= 0)
+        {
+            strncpy(cache->active_session, session, MAX_SESSION_ID_LEN - 1);
+            cache->active_session[MAX_SESSION_ID_LEN - 1] = '\0';
+            free(session);
+        }
+
+        cache->valid = 1;
+    }
+
+    return cache->active_session[0] != '\0' ? cache->active_session : 0;
+#else
+    UNUSED(self)
+    UNUSED(seat)
+
+    return "";
+#endif
+}
+
+/* Must be called with the mutex held */
+static unsigned int kinesixd_session_router_priv_session_policy(KinesixdSessionRouter self, const char *session)
+{
+    int i = 0;
+
+    for (i = 0; i < self->policy_count; ++i)
+    {
+        if (strcmp(self->policies[i].session, session) == 0)
+            return self->policies[i].gesture_mask;
+    }
+
+    return GESTURE_MASK_ALL;
+}
+
+/* Must be called with the mutex held */
+static int kinesixd_session_router_priv_wants_gesture(KinesixdSessionRouter self,
+                                                      const struct _Subscriber *subscriber,
+                                                      const char *active_session,
+                                                      unsigned int gesture)
+{
+    if (!(subscriber->gesture_mask & gesture & GESTURE_MASK_ALL))
+        return 0;
+    /* Batches only go to those who asked for them */
+    if ((gesture & GESTURE_MASK_BATCH) && !(subscriber->gesture_mask & GESTURE_MASK_BATCH))
+        return 0;
+
+#ifdef HAVE_LIBSYSTEMD
+    /* Nobody gets the gesture unless their session owns the seat the device sits on */
+    if (self->route_by_session &&
+        (!active_session || (strcmp(subscriber->session, active_session) != 0)))
+        return 0;
+#else
+    UNUSED(self)
+    UNUSED(active_session)
+#endif
+
+    return 1;
+}
+
+/* Must be called with the mutex held */
+static struct _Subscriber *kinesixd_session_router_priv_find_subscriber(KinesixdSessionRouter self,
+                                                                        const char *bus_name)
+{
+    int i = 0;
+
+    for (i = 0; i < self->subscriber_count; ++i)
+    {
+        if (strcmp(self->subscribers[i].bus_name, bus_name) == 0)
+            return &self->subscribers[i];
+    }
+
+    return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_statistics.h"
+
+#include <time.h>
+
+/* Everything is updated with relaxed atomics from whichever thread observes it, no locks involved */
+struct _Histogram
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[STATISTICS_HISTOGRAM_BUCKET_COUNT];
+};
+
+/* Wall clock and CPU time are charged to the state they were spent in on every transition */
+struct _PowerState
+{
+    int suspended;
+    uint64_t since_usec;
+    uint64_t cpu_since_usec;
+};
+
+struct _Statistics
+{
+    uint64_t counters[STATISTICS_COUNTER_COUNT];
+    struct _PowerState power_state;
+    uint64_t gestures_emitted[STATISTICS_GESTURE_COUNT][STATISTICS_MAX_FINGER_COUNT + 1];
+    struct _Histogram histograms[STATISTICS_HISTOGRAM_COUNT];
+};
+
+/* Timestamps of the gesture currently travelling through the calling thread */
+struct _GestureTimestamps
+{
+    uint64_t event_ns;
+    uint64_t classified_ns;
+};
+
+static const char *counter_names[] =
+{
+    "events_read",
+    "gestures_cancelled",
+    "log_records_dropped",
+    "wakeups_active",
+    "wakeups_suspended",
+    "active_usec",
+    "suspended_usec",
+    "cpu_active_usec",
+    "cpu_suspended_usec",
+    "signals_coalesced",
+    "signals_rejected",
+    "gestures_merge_dropped",
+    "method_calls_rejected",
+    "gesture_batches_dropped"
+};
+
+static const char *histogram_names[] =
+{
+    "libinput_queue_depth",
+    "signal_mutex_wait_ns",
+    "event_to_classified_ns",
+    "classified_to_sent_ns",
+    "event_to_sent_ns",
+    "outgoing_queue_bytes",
+    "merge_wait_ns",
+    "method_queue_wait_ns"
+};
+
+static struct _Statistics statistics;
+static __thread struct _GestureTimestamps current_gesture;
+
+static int kinesixd_statistics_priv_bucket_index(uint64_t value);
+static uint64_t kinesixd_statistics_priv_cpu_usec(void);
+
+uint64_t kinesixd_statistics_now_ns(void)
+{
+    struct timespec now;
+
+    /* Same clock libinput stamps its events with */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+void kinesixd_statistics_increment(StatisticsCounter counter)
+{
+    __atomic_fetch_add(&statistics.counters[counter], 1, __ATOMIC_RELAXED);
+}
+
+void kinesixd_statistics_record(StatisticsHistogram histogram, uint64_t value)
+{
+    struct _Histogram *self = &statistics.histograms[histogram];
+    uint64_t max = __atomic_load_n(&self->max, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&self->buckets[kinesixd_statistics_priv_bucket_index(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&self->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&self->sum, value, __ATOMIC_RELAXED);
+
+    while ((value > max) &&
+           !__atomic_compare_exchange_n(&self->max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void kinesixd_statistics_gesture_classified(uint64_t event_time_usec)
+{
+    current_gesture.event_ns = event_time_usec * 1000ull;
+    current_gesture.classified_ns = kinesixd_statistics_now_ns();
+
+    if (current_gesture.classified_ns > current_gesture.event_ns)
+        kinesixd_statistics_record(STATISTICS_EVENT_TO_CLASSIFIED,
+                                   current_gesture.classified_ns - current_gesture.event_ns);
+}
+
+void kinesixd_statistics_gesture_emitted(StatisticsGesture gesture, int finger_count)
+{
+    uint64_t sent_ns = 0;
+
+    if (finger_count < 0 || finger_count > STATISTICS_MAX_FINGER_COUNT)
+        finger_count = STATISTICS_MAX_FINGER_COUNT;
+
+    __atomic_fetch_add(&statistics.gestures_emitted[gesture][finger_count], 1, __ATOMIC_RELAXED);
+
+    /* Only gestures classified on this very thread have timestamps to go by */
+    if (!current_gesture.classified_ns)
+        return;
+
+    sent_ns = kinesixd_statistics_now_ns();
+    kinesixd_statistics_record(STATISTICS_CLASSIFIED_TO_SENT, sent_ns - current_gesture.classified_ns);
+    if (sent_ns > current_gesture.event_ns)
+        kinesixd_statistics_record(STATISTICS_EVENT_TO_SENT, sent_ns - current_gesture.event_ns);
+
+    current_gesture.event_ns = 0;
+    current_gesture.classified_ns = 0;
+}
+
+uint64_t kinesixd_statistics_get_current_event_time_usec(void)
+{
+    return current_gesture.event_ns / 1000ull;
+}
+
+void kinesixd_statistics_wakeup(void)
+{
+    if (__atomic_load_n(&statistics.power_state.suspended, __ATOMIC_RELAXED))
+        kinesixd_statistics_increment(STATISTICS_WAKEUPS_SUSPENDED);
+    else
+        kinesixd_statistics_increment(STATISTICS_WAKEUPS_ACTIVE);
+}
+
+void kinesixd_statistics_input_suspended(int suspended)
+{
+    struct _PowerState *self = &statistics.power_state;
+    uint64_t now_usec = kinesixd_statistics_now_ns() / 1000ull;
+    uint64_t cpu_usec = kinesixd_statistics_priv_cpu_usec();
+    uint64_t since_usec = __atomic_load_n(&self->since_usec, __ATOMIC_RELAXED);
+
+    /* The very first call only starts the clock */
+    if (since_usec)
+    {
+        __atomic_fetch_add(&statistics.counters[self->suspended ? STATISTICS_SUSPENDED_USEC : STATISTICS_ACTIVE_USEC],
+                           now_usec - since_usec,
+                           __ATOMIC_RELAXED);
+        __atomic_fetch_add(&statistics.counters[self->suspended ? STATISTICS_CPU_SUSPENDED_USEC : STATISTICS_CPU_ACTIVE_USEC],
+                           cpu_usec - __atomic_load_n(&self->cpu_since_usec, __ATOMIC_RELAXED),
+                           __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&self->cpu_since_usec, cpu_usec, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->since_usec, now_usec, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->suspended, suspended, __ATOMIC_RELAXED);
+}
+
+const char *kinesixd_statistics_get_counter_name(StatisticsCounter counter)
+{
+    return counter_names[counter];
+}
+
+uint64_t kinesixd_statistics_get_counter(StatisticsCounter counter)
+{
+    struct _PowerState *self = &statistics.power_state;
+    uint64_t value = __atomic_load_n(&statistics.counters[counter], __ATOMIC_RELAXED);
+    uint64_t since_usec = __atomic_load_n(&self->since_usec, __ATOMIC_RELAXED);
+    int suspended = __atomic_load_n(&self->suspended, __ATOMIC_RELAXED);
+
+    /* Include the time spent in the current state so far. Off by at most one interval when this
+     * races with a transition, which is fine for rates averaged over seconds */
+    if (!since_usec)
+        return value;
+
+    if (counter == (suspended ? STATISTICS_SUSPENDED_USEC : STATISTICS_ACTIVE_USEC))
+        value += kinesixd_statistics_now_ns() / 1000ull - since_usec;
+    else if (counter == (suspended ? STATISTICS_CPU_SUSPENDED_USEC : STATISTICS_CPU_ACTIVE_USEC))
+        value += kinesixd_statistics_priv_cpu_usec() - __atomic_load_n(&self->cpu_since_usec, __ATOMIC_RELAXED);
+
+    return value;
+}
+
+uint64_t kinesixd_statistics_get_gestures_emitted(StatisticsGesture gesture, int finger_count)
+{
+    return __atomic_load_n(&statistics.gestures_emitted[gesture][finger_count], __ATOMIC_RELAXED);
+}
+
+const char *kinesixd_statistics_get_histogram_name(StatisticsHistogram histogram)
+{
+    return histogram_names[histogram];
+}
+
+void kinesixd_statistics_get_histogram(StatisticsHistogram histogram,
+                                       struct KinesixdHistogramSnapshot *snapshot_out)
+{
+    struct _Histogram *self = &statistics.histograms[histogram];
+    int i = 0;
+
+    /* Not an atomic snapshot as a whole, but every single value is consistent */
+    snapshot_out->count = __atomic_load_n(&self->count, __ATOMIC_RELAXED);
+    snapshot_out->sum = __atomic_load_n(&self->sum, __ATOMIC_RELAXED);
+    snapshot_out->max = __atomic_load_n(&self->max, __ATOMIC_RELAXED);
+    for (i = 0; i < STATISTICS_HISTOGRAM_BUCKET_COUNT; ++i)
+        snapshot_out->buckets[i] = __atomic_load_n(&self->buckets[i], __ATOMIC_RELAXED);
+}
+
+uint64_t kinesixd_statistics_get_bucket_upper_bound(int bucket)
+{
+    const int sub_bucket_count = 1 << STATISTICS_HISTOGRAM_SUB_BUCKET_BITS;
+    int exponent = 0;
+    uint64_t sub_bucket = 0;
+
+    if (bucket < sub_bucket_count)
+        return (uint64_t)bucket;
+
+    exponent = (bucket >> STATISTICS_HISTOGRAM_SUB_BUCKET_BITS) + STATISTICS_HISTOGRAM_SUB_BUCKET_BITS - 1;
+    sub_bucket = (uint64_t)(bucket & (sub_bucket_count - 1));
+
+    return (((uint64_t)sub_bucket_count + sub_bucket + 1) << (exponent - STATISTICS_HISTOGRAM_SUB_BUCKET_BITS)) - 1;
+}
+
+static int kinesixd_statistics_priv_bucket_index(uint64_t value)
+{
+    const int sub_bucket_count = 1 << STATISTICS_HISTOGRAM_SUB_BUCKET_BITS;
+    int exponent = 0;
+    int sub_bucket = 0;
+
+    if (value < (uint64_t)sub_bucket_count)
+        return (int)value;
+
+    exponent = 63 - __builtin_clzll(value);
+    if (exponent > STATISTICS_HISTOGRAM_MAX_EXPONENT)
+        return STATISTICS_HISTOGRAM_BUCKET_COUNT - 1;
+
+    /* The bits right below the leading one select the linear sub bucket */
+    sub_bucket = (int)(value >> (exponent - STATISTICS_HISTOGRAM_SUB_BUCKET_BITS)) & (sub_bucket_count - 1);
+
+    return ((exponent - STATISTICS_HISTOGRAM_SUB_BUCKET_BITS + 1) << STATISTICS_HISTOGRAM_SUB_BUCKET_BITS) + sub_bucket;
+}
+
+static uint64_t kinesixd_statistics_priv_cpu_usec(void)
+{
+    struct timespec now;
+
+    /* User and system time of every thread in the process */
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+
+    return (uint64_t)now.tv_sec * 1000000ull + (uint64_t)now.tv_nsec / 1000ull;
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_timeline.h"
+#include "kinesixd_global.h"
+#include "kinesixd_statistics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#define TIMELINE_THREAD_BUFFER_SIZE 4096
+
+struct _TimelineEvent
+{
+    const char *name;
+    uint64_t timestamp_ns;
+    char phase;
+};
+
+struct _TimelineThreadBuffer
+{
+    struct _TimelineThreadBuffer *next;
+    pid_t thread_id;
+    const char *thread_name;
+    int thread_name_written;
+    /* Set by the owning thread around every record, so a capture can be closed while the thread runs */
+    int recording;
+    size_t event_count;
+    struct _TimelineEvent events[TIMELINE_THREAD_BUFFER_SIZE];
+};
+
+struct _Timeline
+{
+    int enabled;
+    pid_t process_id;
+    /* Guards everything below, only taken when a thread registers or writes out its buffer */
+    pthread_mutex_t mutex;
+    FILE *file;
+    int record_written;
+    /* Buffers are only ever prepended and outlive the capture, the next one reuses them */
+    struct _TimelineThreadBuffer *thread_buffers;
+};
+
+static struct _Timeline timeline = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+static __thread struct _TimelineThreadBuffer *thread_buffer = 0;
+static __thread const char *thread_name = 0;
+
+static struct _TimelineThreadBuffer *kinesixd_timeline_priv_thread_buffer(void);
+static void kinesixd_timeline_priv_record(const char *span_name, char phase);
+static void kinesixd_timeline_priv_write_buffer(struct _TimelineThreadBuffer *buffer);
+
+int kinesixd_timeline_start(const char *file_path)
+{
+    FILE *file = 0;
+
+    pthread_mutex_lock(&timeline.mutex);
+    /* Still set while a stop is writing out, that capture has to finish first */
+    if (timeline.file)
+    {
+        pthread_mutex_unlock(&timeline.mutex);
+        return 1;
+    }
+
+    file = fopen(file_path, "we");
+    if (!file)
+    {
+        pthread_mutex_unlock(&timeline.mutex);
+        LOG_WARN("Could not open trace file %s", file_path);
+        return 0;
+    }
+
+    timeline.file = file;
+    timeline.process_id = getpid();
+    timeline.record_written = 0;
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", timeline.file);
+    pthread_mutex_unlock(&timeline.mutex);
+
+    __atomic_store_n(&timeline.enabled, 1, __ATOMIC_SEQ_CST);
+
+    return 1;
+}
+
+void kinesixd_timeline_stop(void)
+{
+    struct _TimelineThreadBuffer *buffer = 0;
+    struct _TimelineThreadBuffer *thread_buffers = 0;
+
+    if (!__atomic_exchange_n(&timeline.enabled, 0, __ATOMIC_SEQ_CST))
+        return;
+
+    pthread_mutex_lock(&timeline.mutex);
+    thread_buffers = timeline.thread_buffers;
+    pthread_mutex_unlock(&timeline.mutex);
+
+    /* A thread that saw the timeline enabled before the exchange may still be appending. Records are a
+     * handful of stores, so waiting them out is cheaper than making every record take a lock. This has
+     * to happen without the mutex held, a record that fills its buffer takes it */
+    for (buffer = thread_buffers; buffer; buffer = buffer->next)
+    {
+        while (__atomic_load_n(&buffer->recording, __ATOMIC_ACQUIRE))
+            sched_yield();
+    }
+
+    pthread_mutex_lock(&timeline.mutex);
+    for (buffer = timeline.thread_buffers; buffer; buffer = buffer->next)
+    {
+        kinesixd_timeline_priv_write_buffer(buffer);
+        buffer->thread_name_written = 0;
+    }
+    fputs("\n]}\n", timeline.file);
+    fclose(timeline.file);
+    timeline.file = 0;
+    pthread_mutex_unlock(&timeline.mutex);
+}
+
+int kinesixd_timeline_is_enabled(void)
+{
+    return __atomic_load_n(&timeline.enabled, __ATOMIC_ACQUIRE);
+}
+
+void kinesixd_timeline_set_thread_name(const char *name)
+{
+    /* Kept even while disabled, threads name themselves once at startup and a capture can begin later */
+    thread_name = name;
+
+    if (thread_buffer)
+        thread_buffer->thread_name = name;
+}
+
+void kinesixd_timeline_begin(const char *span_name)
+{
+    kinesixd_timeline_priv_record(span_name, 'B');
+}
+
+void kinesixd_timeline_end(const char *span_name)
+{
+    kinesixd_timeline_priv_record(span_name, 'E');
+}
+
+static struct _TimelineThreadBuffer *kinesixd_timeline_priv_thread_buffer(void)
+{
+    if (thread_buffer)
+        return thread_buffer;
+
+    thread_buffer = (struct _TimelineThreadBuffer *)calloc(1, sizeof(struct _TimelineThreadBuffer));
+    if (!thread_buffer)
+        return 0;
+
+    thread_buffer->thread_id = (pid_t)syscall(SYS_gettid);
+    thread_buffer->thread_name = thread_name;
+
+    pthread_mutex_lock(&timeline.mutex);
+    thread_buffer->next = timeline.thread_buffers;
+    timeline.thread_buffers = thread_buffer;
+    pthread_mutex_unlock(&timeline.mutex);
+
+    return thread_buffer;
+}
+
+static void kinesixd_timeline_priv_record(const char *span_name, char phase)
+{
+    struct _TimelineThreadBuffer *buffer = 0;
+    struct _TimelineEvent *event = 0;
+
+    if (!__atomic_load_n(&timeline.enabled, __ATOMIC_ACQUIRE))
+        return;
+
+    if (!(buffer = kinesixd_timeline_priv_thread_buffer()))
+        return;
+
+    /* Pairs with the exchange in kinesixd_timeline_stop(), either it sees this flag or this sees it disabled */
+    __atomic_store_n(&buffer->recording, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&timeline.enabled, __ATOMIC_SEQ_CST))
+    {
+        __atomic_store_n(&buffer->recording, 0, __ATOMIC_RELEASE);
+        return;
+    }
+
+    /* Writing out a full buffer is the one place recording perturbs the thread, so it shows up as a span too */
+    if (buffer->event_count == TIMELINE_THREAD_BUFFER_SIZE - 1)
+    {
+        buffer->events[buffer->event_count++] =
+            (struct _TimelineEvent){ "timeline write", kinesixd_statistics_now_ns(), 'B' };
+
+        pthread_mutex_lock(&timeline.mutex);
+        if (timeline.file)
+            kinesixd_timeline_priv_write_buffer(buffer);
+        pthread_mutex_unlock(&timeline.mutex);
+
+        buffer->events[buffer->event_count++] =
+            (struct _TimelineEvent){ "timeline write", kinesixd_statistics_now_ns(), 'E' };
+    }
+
+    event = &buffer->events[buffer->event_count++];
+    event->name = span_name;
+    event->phase = phase;
+    event->timestamp_ns = kinesixd_statistics_now_ns();
+
+    __atomic_store_n(&buffer->recording, 0, __ATOMIC_RELEASE);
+}
+
+static void kinesixd_timeline_priv_write_buffer(struct _TimelineThreadBuffer *buffer)
+{
+    const struct _TimelineEvent *event = 0;
+    size_t i = 0;
+
+    if (buffer->thread_name && !buffer->thread_name_written)
+    {
+        fprintf(timeline.file,
+                "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                timeline.record_written ? ",\n" : "",
+                timeline.process_id,
+                buffer->thread_id,
+                buffer->thread_name);
+        timeline.record_written = 1;
+        buffer->thread_name_written = 1;
+    }
+
+    for (i = 0; i < buffer->event_count; ++i)
+    {
+        event = &buffer->events[i];
+        fprintf(timeline.file,
+                "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%d}",
+                timeline.record_written ? ",\n" : "",
+                event->name,
+                event->phase,
+                (unsigned long long)(event->timestamp_ns / 1000),
+                (unsigned long long)(event->timestamp_ns % 1000),
+                timeline.process_id,
+                buffer->thread_id);
+        timeline.record_written = 1;
+    }
+
+    buffer->event_count = 0;
+}
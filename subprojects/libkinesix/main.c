@@ -18,39 +18,172 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
 
 #include <unistd.h>
 #include <signal.h>
+#include <getopt.h>
 
 #include "kinesixd_global.h"
 #include "kinesixd_dbus_adaptor.h"
+#include "kinesixd_timeline.h"
+#include "kinesixd_config.h"
 
-static KinesixdDBusAdaptor s_dbus_adaptor = 0;
+/* Only ever set from the signal handler, the main loop does the actual shutdown */
+static volatile sig_atomic_t s_terminate_requested = 0;
 
 static void terminate_handler(int signo)
 {
-    if (signo != SIGTERM)
-    {
-        LOG_WARN("Caught unexpected signal %d", signo);
-        return;
-    }
+    if (signo == SIGTERM)
+        s_terminate_requested = 1;
+}
+
+static int parse_seconds(const char *value, int *seconds)
+{
+    char *end = 0;
+    long result = 0;
 
-    kinesixd_dbus_adaptor_free(s_dbus_adaptor);
-    exit(EXIT_SUCCESS);
+    errno = 0;
+    result = strtol(value, &end, 10);
+    if ((errno != 0) || (end == value) || (*end != '\0') || (result < 0) || (result > INT_MAX))
+        return 0;
+
+    *seconds = (int)result;
+    return 1;
 }
 
+static void print_usage(const char *program_name)
+{
+    fprintf(stdout,
+            "Usage: %s [OPTION...]\n"
+            "  --session    Serve the current login session (default)\n"
+            "  --system     Serve every session from a single privileged instance\n"
+            "  --config=PATH\n"
+            "               Read settings from PATH and reload them on change (default %s)\n"
+            "  --idle-timeout=SECONDS\n"
+            "               Exit after SECONDS without subscribers or method calls (default 0, never)\n"
+            "  --log-level=LEVEL\n"
+            "               One of debug, info, warning or error (default info)\n"
+            "  --log-target=TARGET\n"
+            "               One of auto, stderr or journal (default auto)\n"
+            "  --trace-file=PATH\n"
+            "               Record pipeline stages per thread as Chrome Trace Event JSON\n"
+            "  -h, --help   Show this help\n",
+            program_name,
+            CONFIG_DEFAULT_PATH);
+}
 
 int main(int argc, char *argv[])
 {
+    static const struct option options[] =
+    {
+        { "session",    no_argument,    0, 'S' },
+        { "system",     no_argument,    0, 's' },
+        { "config",     required_argument, 0, 'c' },
+        { "idle-timeout", required_argument, 0, 'i' },
+        { "log-level",  required_argument, 0, 'l' },
+        { "log-target", required_argument, 0, 't' },
+        { "trace-file", required_argument, 0, 'T' },
+        { "help",       no_argument,    0, 'h' },
+        { 0,            0,              0, 0   }
+    };
+    struct KinesixdConfig config;
+    const char *config_path = CONFIG_DEFAULT_PATH;
+    int bus_type_set = 0;
+    DBusBusType bus_type = DBUS_BUS_SESSION;
+    int idle_timeout = 0;
+    LogLevel log_level = kinesixd_log_get_level();
+    LogTarget log_target = LOG_TARGET_AUTO;
+    const char *trace_file_path = 0;
+    int option = 0;
+
+    while ((option = getopt_long(argc, argv, "h", options, 0)) != -1)
+    {
+        switch (option)
+        {
+        case 'S':
+            bus_type = DBUS_BUS_SESSION;
+            bus_type_set = 1;
+            break;
+        case 's':
+            bus_type = DBUS_BUS_SYSTEM;
+            bus_type_set = 1;
+            break;
+        case 'c':
+            config_path = optarg;
+            break;
+        case 'i':
+            if (!parse_seconds(optarg, &idle_timeout))
+            {
+                fprintf(stderr, "Invalid idle timeout '%s', expected a number of seconds\n", optarg);
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'l':
+            if (!kinesixd_log_level_from_string(optarg, &log_level))
+            {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 't':
+            if (strcmp(optarg, "stderr") == 0)
+                log_target = LOG_TARGET_STDERR;
+            else if (strcmp(optarg, "journal") == 0)
+                log_target = LOG_TARGET_JOURNAL;
+            else
+                log_target = LOG_TARGET_AUTO;
+            break;
+        case 'T':
+            trace_file_path = optarg;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    kinesixd_log_set_level(log_level);
+    if (!kinesixd_log_start(log_target))
+        LOG_WARN("Could not start the log writer, logging synchronously");
+
+    if (trace_file_path && !kinesixd_timeline_start(trace_file_path))
+        LOG_WARN("Could not start recording a timeline to %s", trace_file_path);
+
     if (signal(SIGTERM, &terminate_handler) == SIG_ERR)
         LOG_ERROR("Could not set up signal handling. Closing application will end in incorrrect shutdown");
 
-    KinesixdDBusAdaptor dbus_adaptor = kinesixd_dbus_adaptor_new(DBUS_BUS_SESSION);
-    s_dbus_adaptor = dbus_adaptor;
+    /* The command line wins over the config file */
+    kinesixd_config_init(&config);
+    kinesixd_config_load(config_path, &config);
+    if (!bus_type_set)
+        bus_type = (config.bus == CONFIG_BUS_SYSTEM) ? DBUS_BUS_SYSTEM : DBUS_BUS_SESSION;
+
+    KinesixdDBusAdaptor dbus_adaptor = kinesixd_dbus_adaptor_new(bus_type, config_path);
     kinesixd_dbus_adaptor_start_listenting(dbus_adaptor);
 
-    for (;;)
+    /* SIGTERM is acted upon within a second, sooner when it lands on this thread and cuts the sleep short */
+    while (!s_terminate_requested)
+    {
         sleep(1);
 
-    return 0;
+        /* The bus activates a fresh instance on the next call, so there is no point in lingering */
+        if ((idle_timeout > 0) && (kinesixd_dbus_adaptor_get_idle_time(dbus_adaptor) >= idle_timeout))
+        {
+            LOG("Idle for %d seconds, exiting", idle_timeout);
+            break;
+        }
+    }
+
+    kinesixd_dbus_adaptor_free(dbus_adaptor);
+    kinesixd_timeline_stop();
+    kinesixd_log_stop();
+
+    return EXIT_SUCCESS;
 }
@@ -0,0 +1,327 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+/* Replays a touchpad recording through both backends and reports what each one spends per frame.
+ *
+ * Without arguments a synthetic recording of swipes and pinches is used, a raw one made with
+ * `cat /dev/input/eventN > recording` can be passed instead. The evdev recognizer always runs
+ * on it in process. When /dev/uinput is usable (and udev tags the device for libinput) the
+ * recording is also played back, at its own pace, on a virtual touchpad read by both backends at
+ * once, which compares them including the cost of reading the device */
+
+#include "kinesixd_test_recording.h"
+#include "kinesixd_mt_recognizer.h"
+#include "kinesixd_daemon.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <libinput.h>
+
+#define GESTURE_DELTA       10
+#define MAX_EVENTS          (64 * 1024)
+#define MAX_FRAMES          (8 * 1024)
+#define IN_PROCESS_ROUNDS   200
+
+struct FrameTimes
+{
+    const char *name;
+    uint64_t durations_ns[MAX_FRAMES];
+    int frame_count;
+    int gesture_count;
+};
+
+static struct input_event s_events[MAX_EVENTS];
+static struct FrameTimes s_evdev_times = { .name = "evdev" };
+static struct FrameTimes s_libinput_times = { .name = "libinput" };
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static int compare_durations(const void *left, const void *right)
+{
+    uint64_t left_value = *(const uint64_t *)left;
+    uint64_t right_value = *(const uint64_t *)right;
+
+    return (left_value > right_value) - (left_value < right_value);
+}
+
+static void print_frame_times(struct FrameTimes *times)
+{
+    uint64_t total_ns = 0;
+    int i = 0;
+
+    if (!times->frame_count)
+        return;
+
+    for (i = 0; i < times->frame_count; ++i)
+        total_ns += times->durations_ns[i];
+    qsort(times->durations_ns, (size_t)times->frame_count, sizeof(uint64_t), &compare_durations);
+
+    printf("%-9s frames=%d gestures=%d mean=%.2fus p50=%.2fus p99=%.2fus max=%.2fus\n",
+           times->name,
+           times->frame_count,
+           times->gesture_count,
+           total_ns / 1000.0 / times->frame_count,
+           times->durations_ns[times->frame_count / 2] / 1000.0,
+           times->durations_ns[times->frame_count * 99 / 100] / 1000.0,
+           times->durations_ns[times->frame_count - 1] / 1000.0);
+}
+
+static void record_synthetic(struct TestRecording *recording)
+{
+    int round = 0;
+
+    recording->events = s_events;
+    recording->count = 0;
+    recording->capacity = MAX_EVENTS;
+    recording->time_usec = 0;
+
+    for (round = 0; round < 4; ++round)
+    {
+        test_recording_gesture(recording, 3, 30, 0, -25, 0);
+        test_recording_gesture(recording, 3, 30, 25, 0, 0);
+        test_recording_gesture(recording, 4, 30, -25, 0, 0);
+        test_recording_gesture(recording, 2, 30, 0, 0, 12);
+        test_recording_gesture(recording, 2, 30, 0, 0, -8);
+    }
+}
+
+static int load_recording(const char *file_path, struct TestRecording *recording)
+{
+    FILE *file = fopen(file_path, "rb");
+
+    if (!file)
+    {
+        fprintf(stderr, "Could not open %s. %s\n", file_path, strerror(errno));
+        return 0;
+    }
+
+    recording->events = s_events;
+    recording->capacity = MAX_EVENTS;
+    recording->count = fread(s_events, sizeof(struct input_event), MAX_EVENTS, file);
+    recording->time_usec = 0;
+    fclose(file);
+
+    return recording->count > 0;
+}
+
+static uint64_t event_time_usec(const struct input_event *event)
+{
+    return (uint64_t)event->input_event_sec * 1000000ull + (uint64_t)event->input_event_usec;
+}
+
+/* The recognizer alone, without reading anything, so this is its floor */
+static void run_in_process(const struct TestRecording *recording)
+{
+    struct KinesixdMtRecognizer recognizer;
+    struct KinesixdMtGesture gesture;
+    uint64_t start_ns = 0;
+    uint64_t elapsed_ns = 0;
+    int frame_count = 0;
+    int gesture_count = 0;
+    int round = 0;
+    size_t i = 0;
+
+    kinesixd_mt_recognizer_init(&recognizer, TEST_RECORDING_SLOT_COUNT, TEST_RECORDING_RESOLUTION, TEST_RECORDING_RESOLUTION);
+    start_ns = now_ns();
+    for (round = 0; round < IN_PROCESS_ROUNDS; ++round)
+    {
+        for (i = 0; i < recording->count; ++i)
+        {
+            if ((recording->events[i].type == EV_SYN) && (recording->events[i].code == SYN_REPORT))
+                ++frame_count;
+            if ((kinesixd_mt_recognizer_feed(&recognizer, &recording->events[i], GESTURE_DELTA, &gesture) &
+                 MT_FRAME_GESTURE_ENDED) && (gesture.kind != MT_GESTURE_NONE))
+                ++gesture_count;
+        }
+    }
+    elapsed_ns = now_ns() - start_ns;
+
+    printf("in-process evdev recognizer: frames=%d gestures=%d mean=%.1fns per frame\n",
+           frame_count,
+           gesture_count,
+           frame_count ? (double)elapsed_ns / frame_count : 0.0);
+}
+
+static int open_restricted(const char *path, int flags, void *user_data)
+{
+    int fd = open(path, flags | O_CLOEXEC);
+
+    (void)user_data;
+
+    return fd < 0 ? -errno : fd;
+}
+
+static void close_restricted(int fd, void *user_data)
+{
+    (void)user_data;
+
+    close(fd);
+}
+
+static void read_evdev(int evdev_fd, struct KinesixdMtRecognizer *recognizer)
+{
+    struct input_event events[64];
+    struct KinesixdMtGesture gesture;
+    ssize_t length = 0;
+    size_t i = 0;
+
+    while ((length = read(evdev_fd, events, sizeof(events))) > 0)
+    {
+        for (i = 0; i < (size_t)length / sizeof(struct input_event); ++i)
+        {
+            if ((kinesixd_mt_recognizer_feed(recognizer, &events[i], GESTURE_DELTA, &gesture) &
+                 MT_FRAME_GESTURE_ENDED) && (gesture.kind != MT_GESTURE_NONE))
+                ++s_evdev_times.gesture_count;
+        }
+    }
+}
+
+static void read_libinput(struct libinput *instance)
+{
+    struct libinput_event *event = 0;
+    enum libinput_event_type type;
+
+    libinput_dispatch(instance);
+    while ((event = libinput_get_event(instance)))
+    {
+        type = libinput_event_get_type(event);
+        if (((type == LIBINPUT_EVENT_GESTURE_SWIPE_END) || (type == LIBINPUT_EVENT_GESTURE_PINCH_END)) &&
+            !libinput_event_gesture_get_cancelled(libinput_event_get_gesture_event(event)))
+            ++s_libinput_times.gesture_count;
+        libinput_event_destroy(event);
+    }
+}
+
+static int run_on_device(const struct TestRecording *recording)
+{
+    static const struct libinput_interface interface = { &open_restricted, &close_restricted };
+    struct KinesixdMtRecognizer recognizer;
+    struct libinput *instance = 0;
+    struct libinput_device *device = 0;
+    struct timespec deadline;
+    char device_path[64];
+    uint64_t first_usec = event_time_usec(&recording->events[0]);
+    uint64_t start_ns = 0;
+    uint64_t frame_start_ns = 0;
+    size_t frame_begin = 0;
+    size_t i = 0;
+    int evdev_fd = -1;
+    int uinput_fd = -1;
+    int attempt = 0;
+
+    if ((uinput_fd = test_recording_create_touchpad("kinesixd benchmark touchpad", device_path, sizeof(device_path))) < 0)
+    {
+        printf("libinput comparison skipped: could not create a touchpad through /dev/uinput\n");
+        return 0;
+    }
+
+    /* The node shows up, and gets tagged by udev, a moment after the device was created */
+    instance = libinput_path_create_context(&interface, 0);
+    for (attempt = 0; !device && (attempt < 50); ++attempt)
+    {
+        if (!(device = libinput_path_add_device(instance, device_path)))
+            usleep(20000);
+    }
+    evdev_fd = open(device_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (!device || (evdev_fd < 0))
+    {
+        printf("libinput comparison skipped: %s is not usable as a touchpad\n", device_path);
+        if (evdev_fd >= 0)
+            close(evdev_fd);
+        libinput_unref(instance);
+        ioctl(uinput_fd, UI_DEV_DESTROY);
+        close(uinput_fd);
+        return 0;
+    }
+
+    kinesixd_mt_recognizer_init(&recognizer, TEST_RECORDING_SLOT_COUNT, TEST_RECORDING_RESOLUTION, TEST_RECORDING_RESOLUTION);
+    read_libinput(instance);
+    read_evdev(evdev_fd, &recognizer);
+
+    /* Played back at the recorded pace, libinput's gesture detection runs on timeouts */
+    start_ns = now_ns();
+    for (i = 0; (i < recording->count) && (s_evdev_times.frame_count < MAX_FRAMES); ++i)
+    {
+        if ((recording->events[i].type != EV_SYN) || (recording->events[i].code != SYN_REPORT))
+            continue;
+
+        frame_start_ns = start_ns + (event_time_usec(&recording->events[i]) - first_usec) * 1000ull;
+        deadline.tv_sec = (time_t)(frame_start_ns / 1000000000ull);
+        deadline.tv_nsec = (long)(frame_start_ns % 1000000000ull);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, 0);
+
+        if (write(uinput_fd, &recording->events[frame_begin], (i + 1 - frame_begin) * sizeof(struct input_event)) < 0)
+            break;
+        frame_begin = i + 1;
+
+        frame_start_ns = now_ns();
+        read_evdev(evdev_fd, &recognizer);
+        s_evdev_times.durations_ns[s_evdev_times.frame_count++] = now_ns() - frame_start_ns;
+
+        frame_start_ns = now_ns();
+        read_libinput(instance);
+        s_libinput_times.durations_ns[s_libinput_times.frame_count++] = now_ns() - frame_start_ns;
+    }
+
+    print_frame_times(&s_evdev_times);
+    print_frame_times(&s_libinput_times);
+
+    close(evdev_fd);
+    libinput_path_remove_device(device);
+    libinput_unref(instance);
+    ioctl(uinput_fd, UI_DEV_DESTROY);
+    close(uinput_fd);
+
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    struct TestRecording recording;
+
+    if (argc > 1)
+    {
+        if (!load_recording(argv[1], &recording))
+            return EXIT_FAILURE;
+    }
+    else
+    {
+        record_synthetic(&recording);
+    }
+
+    run_in_process(&recording);
+    run_on_device(&recording);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef KINESIXD_TEST_H
+#define KINESIXD_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Every check runs, so one run reports all of what broke */
+static int test_failure_count = 0;
+
+#define CHECK(condition) \
+    do { \
+    if (!(condition)) \
+    { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        ++test_failure_count; \
+    } \
+    } while (0)
+
+#define TEST_RESULT() (test_failure_count ? EXIT_FAILURE : EXIT_SUCCESS)
+
+#endif // KINESIXD_TEST_H
@@ -0,0 +1,211 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#ifndef KINESIXD_TEST_RECORDING_H
+#define KINESIXD_TEST_RECORDING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+
+/* Resolution and size of the touchpad the synthetic recordings come from, in device units */
+#define TEST_RECORDING_RESOLUTION   40
+#define TEST_RECORDING_X_MAX        4000
+#define TEST_RECORDING_Y_MAX        3000
+#define TEST_RECORDING_SLOT_COUNT   5
+/* A touchpad reporting at 125 Hz */
+#define TEST_RECORDING_FRAME_USEC   8000
+
+/* The raw struct input_event stream a touchpad node produces, as `cat /dev/input/eventN` records it */
+struct TestRecording
+{
+    struct input_event *events;
+    size_t count;
+    size_t capacity;
+    uint64_t time_usec;
+};
+
+static inline void test_recording_emit(struct TestRecording *recording, int type, int code, int value)
+{
+    struct input_event *event = 0;
+
+    if (recording->count == recording->capacity)
+        return;
+
+    event = &recording->events[recording->count++];
+    event->input_event_sec = recording->time_usec / 1000000;
+    event->input_event_usec = recording->time_usec % 1000000;
+    event->type = (uint16_t)type;
+    event->code = (uint16_t)code;
+    event->value = value;
+}
+
+static inline void test_recording_frame(struct TestRecording *recording)
+{
+    test_recording_emit(recording, EV_SYN, SYN_REPORT, 0);
+    recording->time_usec += TEST_RECORDING_FRAME_USEC;
+}
+
+/* Puts finger_count fingers down on a circle, moves its center by (dx, dy) and its radius by
+ * spread_step every frame, then lifts them all at once */
+static inline void test_recording_gesture(struct TestRecording *recording,
+                                          int finger_count,
+                                          int frame_count,
+                                          double dx,
+                                          double dy,
+                                          double spread_step)
+{
+    static const int tool_codes[] = { BTN_TOOL_FINGER, BTN_TOOL_DOUBLETAP, BTN_TOOL_TRIPLETAP,
+                                      BTN_TOOL_QUADTAP, BTN_TOOL_QUINTTAP };
+    int tool_code = tool_codes[(finger_count < 1 ? 1 : finger_count > 5 ? 5 : finger_count) - 1];
+    double center_x = TEST_RECORDING_X_MAX / 2.0;
+    double center_y = TEST_RECORDING_Y_MAX / 2.0;
+    double radius = 400;
+    double angle = 0;
+    int frame = 0;
+    int slot = 0;
+
+    for (frame = 0; frame <= frame_count; ++frame)
+    {
+        for (slot = 0; slot < finger_count; ++slot)
+        {
+            angle = 2 * M_PI * slot / finger_count;
+            test_recording_emit(recording, EV_ABS, ABS_MT_SLOT, slot);
+            if (frame == 0)
+                test_recording_emit(recording, EV_ABS, ABS_MT_TRACKING_ID, slot + 1);
+            test_recording_emit(recording, EV_ABS, ABS_MT_POSITION_X, (int)lround(center_x + radius * cos(angle)));
+            test_recording_emit(recording, EV_ABS, ABS_MT_POSITION_Y, (int)lround(center_y + radius * sin(angle)));
+        }
+        /* What libinput counts fingers by, the recognizer only looks at the slots */
+        if (frame == 0)
+        {
+            test_recording_emit(recording, EV_KEY, BTN_TOUCH, 1);
+            test_recording_emit(recording, EV_KEY, tool_code, 1);
+        }
+        test_recording_frame(recording);
+
+        center_x += dx;
+        center_y += dy;
+        radius += spread_step;
+    }
+
+    for (slot = 0; slot < finger_count; ++slot)
+    {
+        test_recording_emit(recording, EV_ABS, ABS_MT_SLOT, slot);
+        test_recording_emit(recording, EV_ABS, ABS_MT_TRACKING_ID, -1);
+    }
+    test_recording_emit(recording, EV_KEY, BTN_TOUCH, 0);
+    test_recording_emit(recording, EV_KEY, tool_code, 0);
+    test_recording_frame(recording);
+
+    /* Fingers rest between gestures */
+    recording->time_usec += 20 * TEST_RECORDING_FRAME_USEC;
+}
+
+static inline int test_recording_setup_abs(int uinput_fd, int code, int minimum, int maximum, int resolution)
+{
+    struct uinput_abs_setup abs_setup;
+
+    memset(&abs_setup, 0, sizeof(abs_setup));
+    abs_setup.code = (uint16_t)code;
+    abs_setup.absinfo.minimum = minimum;
+    abs_setup.absinfo.maximum = maximum;
+    abs_setup.absinfo.resolution = resolution;
+
+    return (ioctl(uinput_fd, UI_SET_ABSBIT, code) == 0) && (ioctl(uinput_fd, UI_ABS_SETUP, &abs_setup) == 0);
+}
+
+/* A clickpad with five slots, the kind libinput makes gestures from, created through /dev/uinput.
+ * Returns the uinput fd that keeps it alive and the path of its event node, -1 if that is not allowed */
+static inline int test_recording_create_touchpad(const char *name, char *device_path, size_t device_path_size)
+{
+    static const int keys[] = { BTN_LEFT, BTN_TOUCH, BTN_TOOL_FINGER, BTN_TOOL_DOUBLETAP,
+                                BTN_TOOL_TRIPLETAP, BTN_TOOL_QUADTAP, BTN_TOOL_QUINTTAP };
+    struct uinput_setup setup;
+    char sysfs_path[128];
+    char sysname[64];
+    struct dirent *entry = 0;
+    DIR *directory = 0;
+    size_t i = 0;
+    int uinput_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+
+    if (uinput_fd < 0)
+        return -1;
+
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = 0x4b58;
+    setup.id.product = 0x0001;
+    snprintf(setup.name, sizeof(setup.name), "%s", name);
+
+    ioctl(uinput_fd, UI_SET_EVBIT, EV_KEY);
+    for (i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i)
+        ioctl(uinput_fd, UI_SET_KEYBIT, keys[i]);
+    ioctl(uinput_fd, UI_SET_EVBIT, EV_ABS);
+    ioctl(uinput_fd, UI_SET_PROPBIT, INPUT_PROP_POINTER);
+    ioctl(uinput_fd, UI_SET_PROPBIT, INPUT_PROP_BUTTONPAD);
+    if (!test_recording_setup_abs(uinput_fd, ABS_X, 0, TEST_RECORDING_X_MAX, TEST_RECORDING_RESOLUTION) ||
+        !test_recording_setup_abs(uinput_fd, ABS_Y, 0, TEST_RECORDING_Y_MAX, TEST_RECORDING_RESOLUTION) ||
+        !test_recording_setup_abs(uinput_fd, ABS_MT_SLOT, 0, TEST_RECORDING_SLOT_COUNT - 1, 0) ||
+        !test_recording_setup_abs(uinput_fd, ABS_MT_TRACKING_ID, 0, 65535, 0) ||
+        !test_recording_setup_abs(uinput_fd, ABS_MT_POSITION_X, 0, TEST_RECORDING_X_MAX, TEST_RECORDING_RESOLUTION) ||
+        !test_recording_setup_abs(uinput_fd, ABS_MT_POSITION_Y, 0, TEST_RECORDING_Y_MAX, TEST_RECORDING_RESOLUTION) ||
+        (ioctl(uinput_fd, UI_DEV_SETUP, &setup) < 0) ||
+        (ioctl(uinput_fd, UI_DEV_CREATE) < 0) ||
+        (ioctl(uinput_fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0))
+    {
+        close(uinput_fd);
+        return -1;
+    }
+
+    device_path[0] = '\0';
+    snprintf(sysfs_path, sizeof(sysfs_path), "/sys/devices/virtual/input/%s", sysname);
+    if ((directory = opendir(sysfs_path)))
+    {
+        while ((entry = readdir(directory)))
+        {
+            if (strncmp(entry->d_name, "event", 5) == 0)
+            {
+                snprintf(device_path, device_path_size, "/dev/input/%s", entry->d_name);
+                break;
+            }
+        }
+        closedir(directory);
+    }
+
+    if (device_path[0] == '\0')
+    {
+        ioctl(uinput_fd, UI_DEV_DESTROY);
+        close(uinput_fd);
+        return -1;
+    }
+
+    return uinput_fd;
+}
+
+#endif // KINESIXD_TEST_RECORDING_H
@@ -0,0 +1,427 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+/* dladdr and dl_iterate_phdr */
+#define _GNU_SOURCE
+
+#include "kinesixd_test.h"
+#include "kinesixd_test_recording.h"
+#include "kinesixd_flight_recorder.h"
+#include "kinesixd_mt_recognizer.h"
+#include "kinesixd_sequence.h"
+#include "kinesixd_statistics.h"
+#include "kinesixd_daemon.h"
+#include "kinesixd_device.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <dlfcn.h>
+#include <link.h>
+#include <poll.h>
+#include <unistd.h>
+
+/* Everything between a touchpad frame and the callbacks of the gesture it completes must run
+ * without allocating. malloc and friends are interposed here, the library resolves them to these
+ * too, and every allocation libkinesix itself asks for while a replay is armed is counted.
+ *
+ * The pure modules are replayed in process. The daemon is driven through kinesixd_daemon_dispatch
+ * on a virtual touchpad read by libinput, which needs /dev/uinput and is skipped without it.
+ *
+ * Not covered: libinput allocates every event it hands out, which is inside libinput and outside
+ * what this counts. The DBus adaptor is part of the daemon executable and needs a bus, and
+ * dbus_message_new_signal allocates whenever the libdbus cache of written messages is empty */
+
+#define GESTURE_DELTA     10
+#define MAX_EVENTS        8192
+#define WARM_UP_ROUNDS    2
+#define STEADY_ROUNDS     50
+#define DEVICE_ROUNDS     3
+/* How long libinput gets to finish a gesture on its timeouts after the last frame */
+#define SETTLE_NS         300000000ull
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+/* Where libkinesix is mapped, allocations from anywhere else are not its own */
+static uintptr_t s_library_start = 0;
+static uintptr_t s_library_end = UINTPTR_MAX;
+static int s_armed = 0;
+static int s_allocation_count = 0;
+static void *s_first_caller = 0;
+
+static void count_allocation(void *caller)
+{
+    if (!__atomic_load_n(&s_armed, __ATOMIC_RELAXED) ||
+        ((uintptr_t)caller < s_library_start) || ((uintptr_t)caller >= s_library_end))
+        return;
+
+    if (__atomic_add_fetch(&s_allocation_count, 1, __ATOMIC_RELAXED) == 1)
+        s_first_caller = caller;
+}
+
+void *malloc(size_t size)
+{
+    count_allocation(__builtin_return_address(0));
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    count_allocation(__builtin_return_address(0));
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    count_allocation(__builtin_return_address(0));
+    return __libc_realloc(pointer, size);
+}
+
+static int find_library(struct dl_phdr_info *info, size_t size, void *user_data)
+{
+    int *found = (int *)user_data;
+    uintptr_t start = 0;
+    uintptr_t end = 0;
+    int i = 0;
+
+    (void)size;
+
+    if (!info->dlpi_name || !strstr(info->dlpi_name, "libkinesix"))
+        return 0;
+
+    s_library_start = UINTPTR_MAX;
+    s_library_end = 0;
+    for (i = 0; i < info->dlpi_phnum; ++i)
+    {
+        if (info->dlpi_phdr[i].p_type != PT_LOAD)
+            continue;
+
+        start = info->dlpi_addr + info->dlpi_phdr[i].p_vaddr;
+        end = start + info->dlpi_phdr[i].p_memsz;
+        s_library_start = start < s_library_start ? start : s_library_start;
+        s_library_end = end > s_library_end ? end : s_library_end;
+    }
+    *found = 1;
+
+    return 1;
+}
+
+static void arm(void)
+{
+    s_allocation_count = 0;
+    s_first_caller = 0;
+    __atomic_store_n(&s_armed, 1, __ATOMIC_RELAXED);
+}
+
+static void disarm(const char *what)
+{
+    Dl_info caller;
+
+    __atomic_store_n(&s_armed, 0, __ATOMIC_RELAXED);
+    if (!s_allocation_count)
+        return;
+
+    fprintf(stderr, "%d allocations in %s", s_allocation_count, what);
+    if (dladdr(s_first_caller, &caller) && caller.dli_sname)
+        fprintf(stderr, ", the first from %s", caller.dli_sname);
+    fprintf(stderr, "\n");
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static struct input_event s_events[MAX_EVENTS];
+
+struct Pipeline
+{
+    struct KinesixdMtRecognizer recognizer;
+    struct KinesixdSequenceMatcher matcher;
+    int gesture_count;
+    int sequence_count;
+};
+
+static void record_gestures(struct TestRecording *recording)
+{
+    recording->events = s_events;
+    recording->count = 0;
+    recording->capacity = MAX_EVENTS;
+    recording->time_usec = 1000000;
+
+    test_recording_gesture(recording, 3, 20, 0, -40, 0);
+    test_recording_gesture(recording, 3, 20, 40, 0, 0);
+    test_recording_gesture(recording, 2, 20, 0, 0, 20);
+    test_recording_gesture(recording, 4, 20, 0, 40, 0);
+}
+
+static void pipeline_init(struct Pipeline *pipeline)
+{
+    struct KinesixdSequence sequence;
+
+    kinesixd_mt_recognizer_init(&pipeline->recognizer, 5, TEST_RECORDING_RESOLUTION, TEST_RECORDING_RESOLUTION);
+    kinesixd_sequence_matcher_init(&pipeline->matcher);
+    CHECK(kinesixd_sequence_parse("up-right", "swipe up 3, swipe right 3 within 1000", &sequence));
+    CHECK(kinesixd_sequence_matcher_compile(&pipeline->matcher, &sequence, 1));
+    pipeline->gesture_count = 0;
+    pipeline->sequence_count = 0;
+}
+
+/* What the event thread does with a frame of the evdev backend, minus reading the device */
+static void replay(struct Pipeline *pipeline, const struct TestRecording *recording)
+{
+    struct KinesixdMtGesture gesture;
+    StatisticsGesture statistics_gesture = STATISTICS_GESTURE_SWIPE;
+    int frame_result = 0;
+    size_t i = 0;
+
+    for (i = 0; i < recording->count; ++i)
+    {
+        frame_result = kinesixd_mt_recognizer_feed(&pipeline->recognizer, &recording->events[i], GESTURE_DELTA, &gesture);
+        if (recording->events[i].type == EV_SYN)
+            kinesixd_flight_recorder_record(FLIGHT_RECORD_EVENT, (uint64_t)i, 0, 0, 0, 0, 0, 0);
+        if (!(frame_result & MT_FRAME_GESTURE_ENDED) || (gesture.kind == MT_GESTURE_NONE))
+            continue;
+
+        statistics_gesture = (gesture.kind == MT_GESTURE_SWIPE) ? STATISTICS_GESTURE_SWIPE : STATISTICS_GESTURE_PINCH;
+        kinesixd_statistics_gesture_classified(gesture.time_usec);
+        kinesixd_flight_recorder_record(FLIGHT_RECORD_DECISION, gesture.time_usec, statistics_gesture,
+                                        gesture.finger_count, gesture.result, 0,
+                                        gesture.fling.velocity_x, gesture.fling.velocity_y);
+        kinesixd_statistics_gesture_emitted(statistics_gesture, gesture.finger_count);
+        kinesixd_statistics_record(STATISTICS_EVENT_TO_SENT, gesture.time_usec - gesture.start_usec);
+        ++pipeline->gesture_count;
+
+        if (kinesixd_sequence_matcher_step(&pipeline->matcher,
+                                           (gesture.kind == MT_GESTURE_SWIPE) ? SEQUENCE_GESTURE_SWIPE : SEQUENCE_GESTURE_PINCH,
+                                           gesture.result,
+                                           gesture.finger_count,
+                                           gesture.start_usec,
+                                           gesture.time_usec))
+            ++pipeline->sequence_count;
+    }
+}
+
+static void test_modules(const struct TestRecording *recording, const char *directory)
+{
+    char path[256];
+    char previous_path[256];
+    struct Pipeline pipeline;
+    int i = 0;
+
+    snprintf(path, sizeof(path), "%s/flight-recorder", directory);
+    snprintf(previous_path, sizeof(previous_path), "%s/flight-recorder.previous", directory);
+
+    pipeline_init(&pipeline);
+    CHECK(kinesixd_flight_recorder_open(path));
+
+    /* Anything set up lazily happens here */
+    for (i = 0; i < WARM_UP_ROUNDS; ++i)
+        replay(&pipeline, recording);
+    CHECK(pipeline.gesture_count == 4 * WARM_UP_ROUNDS);
+
+    pipeline.gesture_count = 0;
+    pipeline.sequence_count = 0;
+    arm();
+    for (i = 0; i < STEADY_ROUNDS; ++i)
+        replay(&pipeline, recording);
+    disarm("the module replay");
+
+    CHECK(pipeline.gesture_count == 4 * STEADY_ROUNDS);
+    CHECK(pipeline.sequence_count == STEADY_ROUNDS);
+    CHECK(s_allocation_count == 0);
+
+    kinesixd_flight_recorder_close();
+    kinesixd_sequence_matcher_free(&pipeline.matcher);
+    unlink(path);
+    unlink(previous_path);
+}
+
+static int s_callback_count = 0;
+
+static void count_gesture(int result, int finger_count, void *user_data)
+{
+    (void)result;
+    (void)finger_count;
+    (void)user_data;
+
+    ++s_callback_count;
+}
+
+static void command_applied(KinesixDaemon daemon, int success, void *user_data)
+{
+    (void)daemon;
+
+    *(int *)user_data = success ? 1 : -1;
+}
+
+static void dispatch_until(KinesixDaemon daemon, uint64_t deadline_ns)
+{
+    struct pollfd poller = { .fd = kinesixd_daemon_get_fd(daemon), .events = POLLIN, .revents = 0 };
+    uint64_t now = 0;
+
+    while ((now = now_ns()) < deadline_ns)
+    {
+        if (poll(&poller, 1, (int)((deadline_ns - now + 999999) / 1000000)) > 0)
+            kinesixd_daemon_dispatch(daemon);
+    }
+}
+
+/* Writes the recording to the touchpad at its own pace, libinput's gesture detection runs on
+ * timeouts, and dispatches whatever the daemon is woken up for in between */
+static void play_on_device(KinesixDaemon daemon, int uinput_fd, const struct TestRecording *recording)
+{
+    uint64_t first_usec = recording->events[0].input_event_sec * 1000000ull + recording->events[0].input_event_usec;
+    uint64_t start_ns = now_ns();
+    uint64_t frame_ns = 0;
+    size_t frame_begin = 0;
+    size_t i = 0;
+
+    for (i = 0; i < recording->count; ++i)
+    {
+        if ((recording->events[i].type != EV_SYN) || (recording->events[i].code != SYN_REPORT))
+            continue;
+
+        frame_ns = start_ns + (recording->events[i].input_event_sec * 1000000ull +
+                               recording->events[i].input_event_usec - first_usec) * 1000ull;
+        dispatch_until(daemon, frame_ns);
+        if (write(uinput_fd, &recording->events[frame_begin], (i + 1 - frame_begin) * sizeof(struct input_event)) < 0)
+            return;
+        frame_begin = i + 1;
+    }
+
+    dispatch_until(daemon, now_ns() + SETTLE_NS);
+}
+
+/* The node shows up, and gets tagged by udev, a moment after the device was created */
+static KinesixDaemon new_daemon_with(const char *config_path, const char *device_path, KinesixdDevice *device_out)
+{
+    KinesixDaemon daemon = 0;
+    KinesixdDevice *device_list = 0;
+    int device_count = 0;
+    int attempt = 0;
+    int i = 0;
+
+    for (attempt = 0; attempt < 50; ++attempt)
+    {
+        daemon = kinesixd_daemon_new_with_config(config_path, &count_gesture, 0, &count_gesture, 0);
+        device_list = kinesixd_daemon_get_valid_device_list(daemon, &device_count);
+        for (i = 0; i < device_count; ++i)
+        {
+            if (strcmp(kinesixd_device_get_path(device_list[i]), device_path) == 0)
+            {
+                *device_out = device_list[i];
+                return daemon;
+            }
+        }
+
+        kinesixd_daemon_free(daemon);
+        usleep(20000);
+    }
+
+    return 0;
+}
+
+static void test_daemon(const struct TestRecording *recording, const char *directory)
+{
+    char config_path[256];
+    char device_path[64];
+    KinesixDaemon daemon = 0;
+    KinesixdDevice device = 0;
+    FILE *config_file = 0;
+    int applied = 0;
+    int uinput_fd = -1;
+    int i = 0;
+
+    if ((uinput_fd = test_recording_create_touchpad("kinesixd allocation test touchpad", device_path, sizeof(device_path))) < 0)
+    {
+        printf("daemon replay skipped: could not create a touchpad through /dev/uinput\n");
+        return;
+    }
+
+    snprintf(config_path, sizeof(config_path), "%s/kinesixd.conf", directory);
+    if ((config_file = fopen(config_path, "we")))
+    {
+        fprintf(config_file, "devices_path = /dev/input/\nsuspend_when_idle = no\n");
+        fclose(config_file);
+    }
+
+    if (!(daemon = new_daemon_with(config_path, device_path, &device)))
+    {
+        printf("daemon replay skipped: %s is not usable as a touchpad\n", device_path);
+        unlink(config_path);
+        ioctl(uinput_fd, UI_DEV_DESTROY);
+        close(uinput_fd);
+        return;
+    }
+
+    kinesixd_daemon_set_active_device_async(daemon, device, &command_applied, &applied);
+    dispatch_until(daemon, now_ns() + SETTLE_NS);
+    CHECK(applied == 1);
+
+    /* Once through, for the first gesture of every kind and whatever libkinesix sets up lazily */
+    play_on_device(daemon, uinput_fd, recording);
+    CHECK(s_callback_count > 0);
+
+    s_callback_count = 0;
+    arm();
+    for (i = 0; i < DEVICE_ROUNDS; ++i)
+        play_on_device(daemon, uinput_fd, recording);
+    disarm("the daemon replay");
+
+    CHECK(s_callback_count > 0);
+    CHECK(s_allocation_count == 0);
+
+    kinesixd_daemon_free(daemon);
+    unlink(config_path);
+    ioctl(uinput_fd, UI_DEV_DESTROY);
+    close(uinput_fd);
+}
+
+int main(void)
+{
+    char directory[] = "/tmp/kinesixd-test-allocations-XXXXXX";
+    struct TestRecording recording;
+    int found = 0;
+
+    if (!mkdtemp(directory))
+        return EXIT_FAILURE;
+
+    /* Built into the test itself, everything the test links is counted */
+    dl_iterate_phdr(&find_library, &found);
+    if (!found)
+    {
+        s_library_start = 0;
+        s_library_end = UINTPTR_MAX;
+    }
+
+    record_gestures(&recording);
+    test_modules(&recording, directory);
+    test_daemon(&recording, directory);
+
+    rmdir(directory);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_test.h"
+#include "kinesixd_config.h"
+
+#include <string.h>
+
+#include <unistd.h>
+
+static char s_config_path[] = "/tmp/kinesixd-test-config-XXXXXX";
+
+static void write_config(const char *text)
+{
+    FILE *file = fopen(s_config_path, "w");
+
+    fputs(text, file);
+    fclose(file);
+}
+
+static void append_config(const char *text)
+{
+    FILE *file = fopen(s_config_path, "a");
+
+    fputs(text, file);
+    fclose(file);
+}
+
+static void test_defaults(void)
+{
+    struct KinesixdConfig config;
+
+    kinesixd_config_init(&config);
+    CHECK(config.gesture_delta == 10);
+    CHECK(config.enabled_gestures == CONFIG_GESTURE_ALL);
+    CHECK(config.bus == CONFIG_BUS_SESSION);
+    CHECK(config.backend == CONFIG_BACKEND_LIBINPUT);
+    CHECK(config.suspend_when_idle == 0);
+    CHECK(config.input_workers == 0);
+    CHECK(config.batch_window_ms == 8);
+    CHECK(strcmp(config.devices_path, "/dev/input/") == 0);
+    CHECK(config.sequence_count == 0);
+}
+
+static void test_every_key(void)
+{
+    struct KinesixdConfig config;
+
+    kinesixd_config_init(&config);
+    write_config("# comment\n"
+                 "[kinesixd]\n"
+                 "\n"
+                 "  gesture_delta = 12.5  \n"
+                 "gestures = pinch\n"
+                 "bus = system\n"
+                 "backend = evdev\n"
+                 "suspend_when_idle = yes\n"
+                 "input_workers = 4\n"
+                 "batch_window_ms = 16\n"
+                 "devices_path = /run/input\n"
+                 "sequence = overview: swipe up 3, pinch in within 300\n"
+                 "unknown_key = ignored\n");
+
+    CHECK(kinesixd_config_load(s_config_path, &config));
+    CHECK(config.gesture_delta == 12.5);
+    CHECK(config.enabled_gestures == CONFIG_GESTURE_PINCH);
+    CHECK(config.bus == CONFIG_BUS_SYSTEM);
+    CHECK(config.backend == CONFIG_BACKEND_EVDEV);
+    CHECK(config.suspend_when_idle == 1);
+    CHECK(config.input_workers == 4);
+    CHECK(config.batch_window_ms == 16);
+    /* Device paths get the node name appended */
+    CHECK(strcmp(config.devices_path, "/run/input/") == 0);
+    CHECK(config.sequence_count == 1);
+    CHECK(strcmp(config.sequences[0].name, "overview") == 0);
+    CHECK(config.sequences[0].step_count == 2);
+    CHECK(config.sequences[0].steps[1].max_gap_ms == 300);
+}
+
+static void test_invalid_values(void)
+{
+    static const char *invalid_lines[] =
+    {
+        "gesture_delta = 0\n",
+        "gesture_delta = ten\n",
+        "gestures = swipe, tap\n",
+        "bus = user\n",
+        "suspend_when_idle = true\n",
+        "input_workers = -1\n",
+        "input_workers = 1.5\n",
+        "input_workers = 17\n",
+        "batch_window_ms = 0\n",
+        "batch_window_ms = 1001\n",
+        "sequence = no steps\n",
+        "devices_path = \n",
+        "missing the separator\n"
+    };
+    struct KinesixdConfig config;
+    size_t i = 0;
+
+    /* A file with a mistake in it changes nothing at all, not even the lines before it */
+    for (i = 0; i < sizeof(invalid_lines) / sizeof(invalid_lines[0]); ++i)
+    {
+        kinesixd_config_init(&config);
+        write_config("gesture_delta = 20\n");
+        append_config(invalid_lines[i]);
+
+        CHECK(!kinesixd_config_load(s_config_path, &config));
+        CHECK(config.gesture_delta == 10);
+    }
+}
+
+static void test_reload(void)
+{
+    struct KinesixdConfig config;
+
+    kinesixd_config_init(&config);
+    write_config("sequence = first: swipe left\n"
+                 "sequence = second: swipe right\n");
+    CHECK(kinesixd_config_load(s_config_path, &config));
+    CHECK(config.sequence_count == 2);
+
+    /* Sequences are a list, a reload replaces it instead of adding to it */
+    write_config("sequence = third: pinch out\n");
+    CHECK(kinesixd_config_load(s_config_path, &config));
+    CHECK(config.sequence_count == 1);
+    CHECK(strcmp(config.sequences[0].name, "third") == 0);
+
+    /* Keys missing from the file go back to their defaults instead of keeping what they had */
+    write_config("gestures = swipe\n");
+    config.gesture_delta = 30;
+    config.batch_window_ms = 16;
+    CHECK(kinesixd_config_load(s_config_path, &config));
+    CHECK(config.gesture_delta == 10);
+    CHECK(config.batch_window_ms == 8);
+    CHECK(config.enabled_gestures == CONFIG_GESTURE_SWIPE);
+
+    /* Running without a config file is normal and leaves everything alone */
+    unlink(s_config_path);
+    CHECK(!kinesixd_config_load(s_config_path, &config));
+    CHECK(config.enabled_gestures == CONFIG_GESTURE_SWIPE);
+}
+
+int main(void)
+{
+    int fd = mkstemp(s_config_path);
+
+    if (fd < 0)
+        return EXIT_FAILURE;
+    close(fd);
+
+    test_defaults();
+    test_every_key();
+    test_invalid_values();
+    test_reload();
+
+    unlink(s_config_path);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_test.h"
+#include "kinesixd_flight_recorder.h"
+#include "kinesixd_statistics.h"
+#include "kinesixd_daemon.h"
+
+#include <string.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define WRITER_COUNT        4
+#define RECORDS_PER_WRITER  20000
+
+struct Collected
+{
+    uint64_t sequences[FLIGHT_RECORDER_CAPACITY];
+    uint64_t times[FLIGHT_RECORDER_CAPACITY];
+    int count;
+    int torn_count;
+};
+
+static char s_directory[] = "/tmp/kinesixd-test-flight-recorder-XXXXXX";
+static char s_path[256];
+static char s_previous_path[256];
+
+static void collect(const struct KinesixdFlightRecord *record, void *user_data)
+{
+    struct Collected *collected = (struct Collected *)user_data;
+
+    if (collected->count == FLIGHT_RECORDER_CAPACITY)
+        return;
+
+    collected->sequences[collected->count] = record->sequence;
+    collected->times[collected->count] = record->time_usec;
+    ++collected->count;
+
+    /* Writers store the same value in every field, a mix means a torn read */
+    if (((int)record->x != record->finger_count) || ((int)record->y != record->finger_count))
+        ++collected->torn_count;
+}
+
+static void test_records_in_order(void)
+{
+    struct Collected collected = { .count = 0 };
+    int i = 0;
+
+    CHECK(kinesixd_flight_recorder_open(s_path));
+    for (i = 0; i < 10; ++i)
+        kinesixd_flight_recorder_record(FLIGHT_RECORD_DECISION, 1000 + i, STATISTICS_GESTURE_SWIPE, 3, SWIPE_UP, 0, 3, 3);
+
+    CHECK(kinesixd_flight_recorder_foreach(&collect, &collected));
+    CHECK(collected.count == 10);
+    for (i = 0; i < collected.count; ++i)
+    {
+        CHECK(collected.sequences[i] == (uint64_t)i + 1);
+        CHECK(collected.times[i] == (uint64_t)1000 + i);
+    }
+}
+
+static void test_ring_wraps(void)
+{
+    struct Collected collected = { .count = 0 };
+    int i = 0;
+
+    /* Ten already in there from before, the oldest ones get overwritten */
+    for (i = 0; i < FLIGHT_RECORDER_CAPACITY; ++i)
+        kinesixd_flight_recorder_record(FLIGHT_RECORD_EVENT, 2000 + i, 0, 2, UNKNOWN_GESTURE, 0, 2, 2);
+
+    CHECK(kinesixd_flight_recorder_foreach(&collect, &collected));
+    CHECK(collected.count == FLIGHT_RECORDER_CAPACITY);
+    CHECK(collected.sequences[0] == 11);
+    CHECK(collected.times[collected.count - 1] == 2000 + FLIGHT_RECORDER_CAPACITY - 1);
+    for (i = 1; i < collected.count; ++i)
+        CHECK(collected.sequences[i] == collected.sequences[i - 1] + 1);
+}
+
+static void *write_records(void *writer_index)
+{
+    int finger_count = (int)(intptr_t)writer_index;
+    int i = 0;
+
+    for (i = 0; i < RECORDS_PER_WRITER; ++i)
+        kinesixd_flight_recorder_record(FLIGHT_RECORD_EVENT, (uint64_t)i, 0, finger_count, 0, 0, finger_count, finger_count);
+
+    return 0;
+}
+
+static void test_concurrent_writers(void)
+{
+    struct Collected collected = { .count = 0 };
+    pthread_t writers[WRITER_COUNT];
+    int i = 0;
+
+    for (i = 0; i < WRITER_COUNT; ++i)
+        pthread_create(&writers[i], 0, &write_records, (void *)(intptr_t)(i + 1));
+
+    /* Reading while they write only ever skips slots, it never returns half of one */
+    CHECK(kinesixd_flight_recorder_foreach(&collect, &collected));
+    CHECK(collected.torn_count == 0);
+
+    for (i = 0; i < WRITER_COUNT; ++i)
+        pthread_join(writers[i], 0);
+
+    collected.count = 0;
+    CHECK(kinesixd_flight_recorder_foreach(&collect, &collected));
+    CHECK(collected.count == FLIGHT_RECORDER_CAPACITY);
+    CHECK(collected.torn_count == 0);
+    for (i = 1; i < collected.count; ++i)
+        CHECK(collected.sequences[i] == collected.sequences[i - 1] + 1);
+}
+
+static void test_previous_recording(void)
+{
+    struct Collected collected = { .count = 0 };
+
+    kinesixd_flight_recorder_close();
+
+    /* What the last instance left is kept for a post-mortem, the new one starts empty */
+    CHECK(kinesixd_flight_recorder_open(s_path));
+    CHECK(kinesixd_flight_recorder_foreach(&collect, &collected));
+    CHECK(collected.count == 0);
+
+    CHECK(kinesixd_flight_recorder_read_file(s_previous_path, &collect, &collected));
+    CHECK(collected.count == FLIGHT_RECORDER_CAPACITY);
+    CHECK(collected.torn_count == 0);
+
+    kinesixd_flight_recorder_close();
+    /* Recording without a file is a no-op */
+    kinesixd_flight_recorder_record(FLIGHT_RECORD_EVENT, 1, 0, 0, 0, 0, 0, 0);
+    CHECK(!kinesixd_flight_recorder_foreach(&collect, &collected));
+}
+
+static void test_describe(void)
+{
+    struct KinesixdFlightRecord record;
+    char description[128];
+
+    memset(&record, 0, sizeof(record));
+    record.kind = FLIGHT_RECORD_SIGNAL;
+    record.type = STATISTICS_GESTURE_PINCH;
+    record.result = PINCH_OUT;
+    record.finger_count = 2;
+    kinesixd_flight_recorder_describe(&record, description, sizeof(description));
+    CHECK(strcmp(description, "pinch out fingers=2 queued") == 0);
+
+    record.kind = FLIGHT_RECORD_CALLBACK;
+    record.type = STATISTICS_GESTURE_SWIPE;
+    record.result = SWIPE_LEFT;
+    record.finger_count = 3;
+    record.flags = FLIGHT_RECORD_DISABLED;
+    kinesixd_flight_recorder_describe(&record, description, sizeof(description));
+    CHECK(strcmp(description, "swipe left fingers=3 dropped disabled") == 0);
+
+    /* Too small a buffer is cut short, never overrun */
+    kinesixd_flight_recorder_describe(&record, description, 8);
+    CHECK(strlen(description) == 7);
+
+    CHECK(strcmp(kinesixd_flight_recorder_get_kind_name(FLIGHT_RECORD_DECISION), "decision") == 0);
+}
+
+int main(void)
+{
+    if (!mkdtemp(s_directory))
+        return EXIT_FAILURE;
+    snprintf(s_path, sizeof(s_path), "%s/flight-recorder", s_directory);
+    snprintf(s_previous_path, sizeof(s_previous_path), "%s/flight-recorder.previous", s_directory);
+
+    test_records_in_order();
+    test_ring_wraps();
+    test_concurrent_writers();
+    test_previous_recording();
+    test_describe();
+
+    unlink(s_path);
+    unlink(s_previous_path);
+    rmdir(s_directory);
+
+    return TEST_RESULT();
+}
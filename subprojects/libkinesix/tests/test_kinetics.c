@@ -0,0 +1,134 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_test.h"
+#include "kinesixd_kinetics.h"
+
+#include <math.h>
+
+#define FRAME_USEC 10000
+
+static int close_to(double value, double expected)
+{
+    return fabs(value - expected) < 1e-6;
+}
+
+static void test_steady_motion(void)
+{
+    struct KinesixdKinetics kinetics;
+    struct KinesixdFling fling;
+    uint64_t time_usec = 1000000;
+    int i = 0;
+
+    kinesixd_kinetics_begin(&kinetics, time_usec);
+    for (i = 0; i < 20; ++i)
+    {
+        time_usec += FRAME_USEC;
+        kinesixd_kinetics_update(&kinetics, 5, -2, time_usec);
+    }
+    kinesixd_kinetics_finish(&kinetics, time_usec, &fling);
+
+    /* 5 and -2 units every 10 ms */
+    CHECK(close_to(fling.velocity_x, 500));
+    CHECK(close_to(fling.velocity_y, -200));
+    CHECK(close_to(fling.displacement_x, 100));
+    CHECK(close_to(fling.displacement_y, -40));
+    CHECK(fling.duration_usec == 20 * FRAME_USEC);
+}
+
+static void test_window_follows_the_release(void)
+{
+    struct KinesixdKinetics kinetics;
+    struct KinesixdFling fling;
+    uint64_t time_usec = 0;
+    int i = 0;
+
+    /* Slow to begin with, only the last KINETICS_WINDOW_SIZE frames decide the release velocity */
+    kinesixd_kinetics_begin(&kinetics, time_usec);
+    for (i = 0; i < 30; ++i)
+    {
+        time_usec += FRAME_USEC;
+        kinesixd_kinetics_update(&kinetics, 1, 0, time_usec);
+    }
+    for (i = 0; i < KINETICS_WINDOW_SIZE; ++i)
+    {
+        time_usec += FRAME_USEC;
+        kinesixd_kinetics_update(&kinetics, 10, 0, time_usec);
+    }
+    kinesixd_kinetics_finish(&kinetics, time_usec, &fling);
+
+    CHECK(close_to(fling.velocity_x, 1000));
+    CHECK(close_to(fling.displacement_x, 30 + 10 * KINETICS_WINDOW_SIZE));
+}
+
+static void test_resting_before_release(void)
+{
+    struct KinesixdKinetics kinetics;
+    struct KinesixdFling fling;
+    uint64_t time_usec = 0;
+    int i = 0;
+
+    kinesixd_kinetics_begin(&kinetics, time_usec);
+    for (i = 0; i < 10; ++i)
+    {
+        time_usec += FRAME_USEC;
+        kinesixd_kinetics_update(&kinetics, 10, 10, time_usec);
+    }
+
+    /* Fingers that rested a while have no momentum left, the motion still counts */
+    kinesixd_kinetics_finish(&kinetics, time_usec + 100000, &fling);
+    CHECK(fling.velocity_x == 0);
+    CHECK(fling.velocity_y == 0);
+    CHECK(close_to(fling.displacement_x, 100));
+    CHECK(fling.duration_usec == time_usec + 100000);
+
+    /* A short pause is still a fling */
+    kinesixd_kinetics_finish(&kinetics, time_usec + 20000, &fling);
+    CHECK(close_to(fling.velocity_x, 1000));
+}
+
+static void test_no_motion(void)
+{
+    struct KinesixdKinetics kinetics;
+    struct KinesixdFling fling;
+
+    kinesixd_kinetics_begin(&kinetics, 5000);
+    kinesixd_kinetics_finish(&kinetics, 5000, &fling);
+    CHECK(fling.velocity_x == 0);
+    CHECK(fling.velocity_y == 0);
+    CHECK(fling.displacement_x == 0);
+    CHECK(fling.duration_usec == 0);
+
+    /* Updates stamped with the same time carry no velocity either */
+    kinesixd_kinetics_begin(&kinetics, 5000);
+    kinesixd_kinetics_update(&kinetics, 10, 0, 5000);
+    kinesixd_kinetics_finish(&kinetics, 5000, &fling);
+    CHECK(fling.velocity_x == 0);
+    CHECK(close_to(fling.displacement_x, 10));
+}
+
+int main(void)
+{
+    test_steady_motion();
+    test_window_follows_the_release();
+    test_resting_before_release();
+    test_no_motion();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_test.h"
+#include "kinesixd_test_recording.h"
+#include "kinesixd_mt_recognizer.h"
+#include "kinesixd_daemon.h"
+
+#define GESTURE_DELTA 10
+#define MAX_EVENTS    4096
+
+struct Replay
+{
+    int began_count;
+    int ended_count;
+    struct KinesixdMtGesture last;
+};
+
+static struct input_event s_events[MAX_EVENTS];
+
+static void recording_init(struct TestRecording *recording)
+{
+    recording->events = s_events;
+    recording->count = 0;
+    recording->capacity = MAX_EVENTS;
+    recording->time_usec = 1000000;
+}
+
+static void recognizer_init(struct KinesixdMtRecognizer *recognizer)
+{
+    kinesixd_mt_recognizer_init(recognizer, 5, TEST_RECORDING_RESOLUTION, TEST_RECORDING_RESOLUTION);
+}
+
+static void replay(struct KinesixdMtRecognizer *recognizer,
+                   const struct TestRecording *recording,
+                   struct Replay *replay_out)
+{
+    struct KinesixdMtGesture gesture;
+    int frame_result = 0;
+    size_t i = 0;
+
+    replay_out->began_count = 0;
+    replay_out->ended_count = 0;
+    replay_out->last.kind = MT_GESTURE_NONE;
+    for (i = 0; i < recording->count; ++i)
+    {
+        frame_result = kinesixd_mt_recognizer_feed(recognizer, &recording->events[i], GESTURE_DELTA, &gesture);
+        if (frame_result & MT_FRAME_GESTURE_BEGAN)
+            ++replay_out->began_count;
+        if (frame_result & MT_FRAME_GESTURE_ENDED)
+        {
+            ++replay_out->ended_count;
+            replay_out->last = gesture;
+        }
+    }
+}
+
+static void test_swipes(void)
+{
+    static const struct
+    {
+        double dx;
+        double dy;
+        int result;
+    } swipes[] =
+    {
+        {   0, -40, SWIPE_UP },
+        {   0,  40, SWIPE_DOWN },
+        { -40,   0, SWIPE_LEFT },
+        {  40,   0, SWIPE_RIGHT }
+    };
+    struct KinesixdMtRecognizer recognizer;
+    struct TestRecording recording;
+    struct Replay result;
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(swipes) / sizeof(swipes[0]); ++i)
+    {
+        recording_init(&recording);
+        test_recording_gesture(&recording, 3, 10, swipes[i].dx, swipes[i].dy, 0);
+        recognizer_init(&recognizer);
+        replay(&recognizer, &recording, &result);
+
+        CHECK(result.began_count == 1);
+        CHECK(result.ended_count == 1);
+        CHECK(result.last.kind == MT_GESTURE_SWIPE);
+        CHECK(result.last.result == swipes[i].result);
+        CHECK(result.last.finger_count == 3);
+        CHECK(result.last.time_usec - result.last.start_usec == 11 * TEST_RECORDING_FRAME_USEC);
+    }
+}
+
+static void test_pinches(void)
+{
+    struct KinesixdMtRecognizer recognizer;
+    struct TestRecording recording;
+    struct Replay result;
+
+    recording_init(&recording);
+    test_recording_gesture(&recording, 2, 10, 0, 0, 20);
+    recognizer_init(&recognizer);
+    replay(&recognizer, &recording, &result);
+    CHECK(result.ended_count == 1);
+    CHECK(result.last.kind == MT_GESTURE_PINCH);
+    CHECK(result.last.result == PINCH_OUT);
+    CHECK(result.last.finger_count == 2);
+
+    recording_init(&recording);
+    test_recording_gesture(&recording, 2, 10, 0, 0, -20);
+    recognizer_init(&recognizer);
+    replay(&recognizer, &recording, &result);
+    CHECK(result.ended_count == 1);
+    CHECK(result.last.kind == MT_GESTURE_PINCH);
+    CHECK(result.last.result == PINCH_IN);
+}
+
+static void test_unrecognized(void)
+{
+    struct KinesixdMtRecognizer recognizer;
+    struct TestRecording recording;
+    struct Replay result;
+
+    /* Two fingers moving together are scrolling, not a gesture */
+    recording_init(&recording);
+    test_recording_gesture(&recording, 2, 10, 40, 0, 0);
+    recognizer_init(&recognizer);
+    replay(&recognizer, &recording, &result);
+    CHECK(result.ended_count == 1);
+    CHECK(result.last.kind == MT_GESTURE_NONE);
+
+    /* No single frame moves further than gesture_delta */
+    recording_init(&recording);
+    test_recording_gesture(&recording, 3, 10, 5, 0, 0);
+    recognizer_init(&recognizer);
+    replay(&recognizer, &recording, &result);
+    CHECK(result.ended_count == 1);
+    CHECK(result.last.kind == MT_GESTURE_SWIPE);
+    CHECK(result.last.result == UNKNOWN_GESTURE);
+
+    /* A single finger is the pointer */
+    recording_init(&recording);
+    test_recording_gesture(&recording, 1, 10, 40, 0, 0);
+    recognizer_init(&recognizer);
+    replay(&recognizer, &recording, &result);
+    CHECK(result.began_count == 0);
+    CHECK(result.ended_count == 0);
+}
+
+static void test_wait_for_release(void)
+{
+    struct KinesixdMtRecognizer recognizer;
+    struct KinesixdMtGesture gesture;
+    int frame_result = 0;
+    int i = 0;
+
+    recognizer_init(&recognizer);
+    for (i = 0; i < 3; ++i)
+        kinesixd_mt_recognizer_touch(&recognizer, i, 1, 1000 + 300 * i, 1000);
+    CHECK(kinesixd_mt_recognizer_frame(&recognizer, GESTURE_DELTA, 1000, &gesture) == MT_FRAME_GESTURE_BEGAN);
+
+    /* Lifting one finger ends the gesture, the two left behind start nothing new */
+    kinesixd_mt_recognizer_touch(&recognizer, 2, 0, 0, 0);
+    CHECK(kinesixd_mt_recognizer_frame(&recognizer, GESTURE_DELTA, 2000, &gesture) == MT_FRAME_GESTURE_ENDED);
+    CHECK(kinesixd_mt_recognizer_frame(&recognizer, GESTURE_DELTA, 3000, &gesture) == 0);
+
+    kinesixd_mt_recognizer_touch(&recognizer, 0, 0, 0, 0);
+    kinesixd_mt_recognizer_touch(&recognizer, 1, 0, 0, 0);
+    CHECK(kinesixd_mt_recognizer_frame(&recognizer, GESTURE_DELTA, 4000, &gesture) == 0);
+
+    /* Once every finger is up the next gesture may begin */
+    for (i = 0; i < 2; ++i)
+        kinesixd_mt_recognizer_touch(&recognizer, i, 1, 1000 + 300 * i, 1000);
+    frame_result = kinesixd_mt_recognizer_frame(&recognizer, GESTURE_DELTA, 5000, &gesture);
+    CHECK(frame_result == MT_FRAME_GESTURE_BEGAN);
+}
+
+static void test_dropped_frames(void)
+{
+    struct KinesixdMtRecognizer recognizer;
+    struct TestRecording recording;
+    struct Replay result;
+    struct input_event dropped = { .type = EV_SYN, .code = SYN_DROPPED, .value = 0 };
+    struct input_event report = { .type = EV_SYN, .code = SYN_REPORT, .value = 0 };
+    struct KinesixdMtGesture gesture;
+
+    recording_init(&recording);
+    test_recording_gesture(&recording, 3, 10, 40, 0, 0);
+    recognizer_init(&recognizer);
+
+    /* The report closing the dropped frames asks for a sync, and stays dropped until it happened */
+    CHECK(kinesixd_mt_recognizer_feed(&recognizer, &dropped, GESTURE_DELTA, &gesture) == 0);
+    CHECK(kinesixd_mt_recognizer_feed(&recognizer, &report, GESTURE_DELTA, &gesture) == MT_FRAME_SYNC_NEEDED);
+    CHECK(recognizer.dropped);
+
+    /* Nothing counts until the slots were synced again */
+    replay(&recognizer, &recording, &result);
+    CHECK(result.began_count == 0);
+    CHECK(result.ended_count == 0);
+
+    /* Fingers already down when the slots were synced are not trusted with a gesture */
+    kinesixd_mt_recognizer_sync(&recognizer, -1);
+    replay(&recognizer, &recording, &result);
+    CHECK(result.began_count == 0);
+    CHECK(result.ended_count == 0);
+
+    /* Once they were lifted it is business as usual */
+    replay(&recognizer, &recording, &result);
+    CHECK(result.began_count == 1);
+    CHECK(result.ended_count == 1);
+    CHECK(result.last.result == SWIPE_RIGHT);
+}
+
+static void test_cancel(void)
+{
+    struct KinesixdMtRecognizer recognizer;
+    struct KinesixdMtGesture gesture;
+    int i = 0;
+
+    recognizer_init(&recognizer);
+    for (i = 0; i < 3; ++i)
+        kinesixd_mt_recognizer_touch(&recognizer, i, 1, 1000 + 300 * i, 1000);
+    CHECK(kinesixd_mt_recognizer_frame(&recognizer, GESTURE_DELTA, 1000, &gesture) == MT_FRAME_GESTURE_BEGAN);
+
+    /* A cancelled gesture never ends */
+    kinesixd_mt_recognizer_cancel(&recognizer);
+    CHECK(kinesixd_mt_recognizer_frame(&recognizer, GESTURE_DELTA, 2000, &gesture) == 0);
+    CHECK(!recognizer.gesture_active);
+}
+
+int main(void)
+{
+    test_swipes();
+    test_pinches();
+    test_unrecognized();
+    test_wait_for_release();
+    test_dropped_frames();
+    test_cancel();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_test.h"
+#include "kinesixd_sequence.h"
+#include "kinesixd_daemon.h"
+
+#include <string.h>
+
+#define MS 1000ull
+
+struct Gesture
+{
+    enum SequenceGesture gesture;
+    int result;
+    int finger_count;
+    /* Pause since the previous gesture ended, every gesture takes 100 ms */
+    uint64_t gap_usec;
+};
+
+static void compile(struct KinesixdSequenceMatcher *matcher, const char *const *lines, int line_count)
+{
+    struct KinesixdSequence sequences[SEQUENCE_MAX_COUNT];
+    char name[SEQUENCE_NAME_MAX];
+    const char *separator = 0;
+    int i = 0;
+
+    for (i = 0; i < line_count; ++i)
+    {
+        separator = strchr(lines[i], ':');
+        memset(name, 0, sizeof(name));
+        memcpy(name, lines[i], (size_t)(separator - lines[i]));
+        CHECK(kinesixd_sequence_parse(name, separator + 1, &sequences[i]));
+    }
+
+    CHECK(kinesixd_sequence_matcher_compile(matcher, sequences, line_count));
+}
+
+/* Name of what the last gesture completed, 0 for nothing */
+static const char *play(struct KinesixdSequenceMatcher *matcher, const struct Gesture *gestures, int gesture_count)
+{
+    static uint64_t time_usec = 1000000;
+    const char *name = 0;
+    int i = 0;
+
+    for (i = 0; i < gesture_count; ++i)
+    {
+        time_usec += gestures[i].gap_usec;
+        name = kinesixd_sequence_matcher_step(matcher,
+                                              gestures[i].gesture,
+                                              gestures[i].result,
+                                              gestures[i].finger_count,
+                                              time_usec,
+                                              time_usec + 100 * MS);
+        time_usec += 100 * MS;
+    }
+
+    return name;
+}
+
+static int named(const char *name, const char *expected)
+{
+    return name && (strcmp(name, expected) == 0);
+}
+
+static void test_parse(void)
+{
+    static const char *invalid[] =
+    {
+        "",
+        "swipe",
+        "swipe sideways",
+        "pinch up",
+        "swipe up 1",
+        "swipe up 6",
+        "swipe up within",
+        "swipe up within 0",
+        "swipe up within 60001",
+        "swipe up within 10s",
+        "tap up",
+        "swipe up, swipe up, swipe up, swipe up, swipe up, swipe up, swipe up, swipe up, swipe up"
+    };
+    struct KinesixdSequence sequence;
+    size_t i = 0;
+
+    CHECK(kinesixd_sequence_parse("overview", "Swipe Up 3, pinch in within 300ms", &sequence));
+    CHECK(strcmp(sequence.name, "overview") == 0);
+    CHECK(sequence.step_count == 2);
+    CHECK(sequence.steps[0].gesture == SEQUENCE_GESTURE_SWIPE);
+    CHECK(sequence.steps[0].result == SWIPE_UP);
+    CHECK(sequence.steps[0].finger_count == 3);
+    CHECK(sequence.steps[0].max_gap_ms == 0);
+    CHECK(sequence.steps[1].gesture == SEQUENCE_GESTURE_PINCH);
+    CHECK(sequence.steps[1].result == PINCH_IN);
+    CHECK(sequence.steps[1].finger_count == 0);
+    CHECK(sequence.steps[1].max_gap_ms == 300);
+
+    for (i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+        CHECK(!kinesixd_sequence_parse("invalid", invalid[i], &sequence));
+    CHECK(!kinesixd_sequence_parse("", "swipe up", &sequence));
+}
+
+static void test_steps_and_gaps(void)
+{
+    static const char *lines[] = { "overview: swipe up 3, pinch in within 300" };
+    static const struct Gesture in_time[] =
+    {
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_UP, 3, 0 },
+        { SEQUENCE_GESTURE_PINCH, PINCH_IN, 2, 300 * MS }
+    };
+    static const struct Gesture too_late[] =
+    {
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_UP, 3, 0 },
+        { SEQUENCE_GESTURE_PINCH, PINCH_IN, 2, 301 * MS }
+    };
+    static const struct Gesture wrong_fingers[] =
+    {
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_UP, 4, 0 },
+        { SEQUENCE_GESTURE_PINCH, PINCH_IN, 2, 10 * MS }
+    };
+    static const struct Gesture interrupted[] =
+    {
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_UP, 3, 0 },
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_LEFT, 3, 10 * MS },
+        { SEQUENCE_GESTURE_PINCH, PINCH_IN, 2, 10 * MS }
+    };
+    struct KinesixdSequenceMatcher matcher;
+
+    kinesixd_sequence_matcher_init(&matcher);
+    compile(&matcher, lines, 1);
+
+    CHECK(!play(&matcher, in_time, 1));
+    CHECK(named(play(&matcher, &in_time[1], 1), "overview"));
+    kinesixd_sequence_matcher_reset(&matcher);
+    CHECK(!play(&matcher, too_late, 2));
+    kinesixd_sequence_matcher_reset(&matcher);
+    CHECK(!play(&matcher, wrong_fingers, 2));
+    kinesixd_sequence_matcher_reset(&matcher);
+    CHECK(!play(&matcher, interrupted, 3));
+
+    /* A completed sequence can be the start of the next one right away */
+    kinesixd_sequence_matcher_reset(&matcher);
+    CHECK(named(play(&matcher, in_time, 2), "overview"));
+    CHECK(named(play(&matcher, in_time, 2), "overview"));
+
+    kinesixd_sequence_matcher_free(&matcher);
+}
+
+static void test_overlapping_sequences(void)
+{
+    static const char *lines[] =
+    {
+        "left: swipe left",
+        "right-left: swipe right, swipe left within 500",
+        "double-right: swipe right 3, swipe right 3 within 250"
+    };
+    static const struct Gesture rights[] =
+    {
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_RIGHT, 3, 0 },
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_RIGHT, 3, 100 * MS },
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_RIGHT, 3, 100 * MS }
+    };
+    static const struct Gesture right_left[] =
+    {
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_RIGHT, 4, 0 },
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_LEFT, 4, 400 * MS }
+    };
+    static const struct Gesture slow_right_left[] =
+    {
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_RIGHT, 4, 0 },
+        { SEQUENCE_GESTURE_SWIPE, SWIPE_LEFT, 4, 600 * MS }
+    };
+    struct KinesixdSequenceMatcher matcher;
+
+    kinesixd_sequence_matcher_init(&matcher);
+    compile(&matcher, lines, 3);
+
+    CHECK(!play(&matcher, rights, 1));
+    CHECK(named(play(&matcher, &rights[1], 1), "double-right"));
+    /* The second swipe also starts the next pair */
+    CHECK(named(play(&matcher, &rights[2], 1), "double-right"));
+
+    /* The longest sequence completed wins over the single swipe it ends with */
+    kinesixd_sequence_matcher_reset(&matcher);
+    CHECK(named(play(&matcher, right_left, 2), "right-left"));
+    kinesixd_sequence_matcher_reset(&matcher);
+    CHECK(named(play(&matcher, slow_right_left, 2), "left"));
+
+    kinesixd_sequence_matcher_free(&matcher);
+}
+
+static void test_empty_and_invalid(void)
+{
+    static const char *lines[] = { "up: swipe up" };
+    struct KinesixdSequenceMatcher matcher;
+
+    kinesixd_sequence_matcher_init(&matcher);
+    CHECK(kinesixd_sequence_matcher_compile(&matcher, 0, 0));
+    CHECK(!kinesixd_sequence_matcher_step(&matcher, SEQUENCE_GESTURE_SWIPE, SWIPE_UP, 3, 1, 2));
+
+    compile(&matcher, lines, 1);
+    CHECK(named(kinesixd_sequence_matcher_step(&matcher, SEQUENCE_GESTURE_SWIPE, SWIPE_UP, 3, 1, 2), "up"));
+    /* Unrecognized gestures never match anything */
+    CHECK(!kinesixd_sequence_matcher_step(&matcher, SEQUENCE_GESTURE_SWIPE, UNKNOWN_GESTURE, 3, 3, 4));
+
+    /* Recompiling without sequences drops the old ones */
+    CHECK(kinesixd_sequence_matcher_compile(&matcher, 0, 0));
+    CHECK(!kinesixd_sequence_matcher_step(&matcher, SEQUENCE_GESTURE_SWIPE, SWIPE_UP, 3, 5, 6));
+
+    kinesixd_sequence_matcher_free(&matcher);
+}
+
+int main(void)
+{
+    test_parse();
+    test_steps_and_gaps();
+    test_overlapping_sequences();
+    test_empty_and_invalid();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright © 2015 Romeo Calota
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the licence, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Romeo Calota
+ */
+
+#include "kinesixd_test.h"
+#include "kinesixd_session_router.h"
+
+#include <string.h>
+
+#define MAX_DESTINATIONS 32
+
+struct Delivery
+{
+    KinesixdSessionRouter router;
+    char destinations[MAX_DESTINATIONS][64];
+    int destination_count;
+    unsigned int next_serial;
+    /* Refuse to send to this one, as the bus would with a full queue */
+    const char *refused;
+    /* Leave or join from inside the callback, the router must not be holding its lock */
+    const char *unsubscribe;
+    const char *subscribe;
+};
+
+struct Statistics
+{
+    const char *bus_name;
+    uint64_t signals_routed;
+    uint64_t signals_rejected;
+};
+
+static unsigned int deliver(const char *destination, void *user_data)
+{
+    struct Delivery *delivery = (struct Delivery *)user_data;
+
+    if (delivery->unsubscribe)
+        kinesixd_session_router_unsubscribe(delivery->router, delivery->unsubscribe);
+    if (delivery->subscribe)
+        kinesixd_session_router_subscribe(delivery->router, delivery->subscribe, 1, GESTURE_MASK_ALL);
+    delivery->unsubscribe = 0;
+    delivery->subscribe = 0;
+
+    if (delivery->refused && (strcmp(destination, delivery->refused) == 0))
+        return 0;
+
+    if (delivery->destination_count < MAX_DESTINATIONS)
+        snprintf(delivery->destinations[delivery->destination_count++], 64, "%s", destination);
+
+    return ++delivery->next_serial;
+}
+
+static int was_delivered_to(const struct Delivery *delivery, const char *bus_name)
+{
+    int i = 0;
+
+    for (i = 0; i < delivery->destination_count; ++i)
+    {
+        if (strcmp(delivery->destinations[i], bus_name) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+static void find_statistics(const char *bus_name, uint64_t signals_routed, uint64_t signals_rejected, void *user_data)
+{
+    struct Statistics *statistics = (struct Statistics *)user_data;
+
+    if (strcmp(bus_name, statistics->bus_name) != 0)
+        return;
+
+    statistics->signals_routed = signals_routed;
+    statistics->signals_rejected = signals_rejected;
+}
+
+static void test_subscriptions(void)
+{
+    KinesixdSessionRouter router = kinesixd_session_router_new(0);
+
+    kinesixd_session_router_subscribe(router, ":1.10", 1, GESTURE_MASK_SWIPE);
+    kinesixd_session_router_subscribe(router, ":1.11", 1, GESTURE_MASK_ALL | GESTURE_MASK_BATCH);
+    kinesixd_session_router_subscribe(router, ":1.12", 1, GESTURE_MASK_PINCH);
+    CHECK(kinesixd_session_router_get_subscriber_count(router) == 3);
+    CHECK(kinesixd_session_router_count_subscribers(router, GESTURE_MASK_SWIPE) == 2);
+    CHECK(kinesixd_session_router_count_subscribers(router, GESTURE_MASK_BATCH) == 1);
+
+    /* Subscribing again replaces the mask, it does not add a second entry */
+    kinesixd_session_router_subscribe(router, ":1.10", 1, GESTURE_MASK_PINCH);
+    CHECK(kinesixd_session_router_get_subscriber_count(router) == 3);
+    CHECK(kinesixd_session_router_count_subscribers(router, GESTURE_MASK_SWIPE) == 1);
+    CHECK(kinesixd_session_router_count_subscribers(router, GESTURE_MASK_PINCH) == 3);
+
+    CHECK(kinesixd_session_router_unsubscribe(router, ":1.11"));
+    CHECK(!kinesixd_session_router_unsubscribe(router, ":1.11"));
+    CHECK(kinesixd_session_router_get_subscriber_count(router) == 2);
+
+    kinesixd_session_router_free(router);
+}
+
+static void test_routing_by_mask(void)
+{
+    KinesixdSessionRouter router = kinesixd_session_router_new(0);
+    struct Delivery delivery = { .router = router };
+
+    kinesixd_session_router_subscribe(router, ":1.10", 1, GESTURE_MASK_SWIPE);
+    kinesixd_session_router_subscribe(router, ":1.11", 1, GESTURE_MASK_ALL | GESTURE_MASK_BATCH);
+    kinesixd_session_router_subscribe(router, ":1.12", 1, GESTURE_MASK_PINCH);
+
+    CHECK(kinesixd_session_router_route(router, "seat0", GESTURE_MASK_SWIPE, &deliver, &delivery) == 2);
+    CHECK(was_delivered_to(&delivery, ":1.10"));
+    CHECK(was_delivered_to(&delivery, ":1.11"));
+    CHECK(!was_delivered_to(&delivery, ":1.12"));
+
+    /* Batches only go to whoever opted in */
+    delivery.destination_count = 0;
+    CHECK(kinesixd_session_router_route(router, "seat0", GESTURE_MASK_PINCH | GESTURE_MASK_BATCH, &deliver, &delivery) == 1);
+    CHECK(was_delivered_to(&delivery, ":1.11"));
+
+    /* A copy the bus would not take is not counted as routed */
+    delivery.destination_count = 0;
+    delivery.refused = ":1.10";
+    CHECK(kinesixd_session_router_route(router, "seat0", GESTURE_MASK_SWIPE, &deliver, &delivery) == 1);
+    CHECK(!was_delivered_to(&delivery, ":1.10"));
+
+    kinesixd_session_router_free(router);
+}
+
+static void test_routing_many_subscribers(void)
+{
+    KinesixdSessionRouter router = kinesixd_session_router_new(0);
+    struct Delivery delivery = { .router = router };
+    char bus_name[64];
+    int i = 0;
+
+    /* More than fit in one pass of copied out destinations */
+    for (i = 0; i < 20; ++i)
+    {
+        snprintf(bus_name, sizeof(bus_name), ":1.%d", 100 + i);
+        kinesixd_session_router_subscribe(router, bus_name, 1, GESTURE_MASK_ALL);
+    }
+
+    CHECK(kinesixd_session_router_route(router, 0, GESTURE_MASK_SWIPE, &deliver, &delivery) == 20);
+    CHECK(delivery.destination_count == 20);
+    for (i = 0; i < 20; ++i)
+    {
+        snprintf(bus_name, sizeof(bus_name), ":1.%d", 100 + i);
+        CHECK(was_delivered_to(&delivery, bus_name));
+    }
+
+    kinesixd_session_router_free(router);
+}
+
+static void test_subscribing_while_routing(void)
+{
+    KinesixdSessionRouter router = kinesixd_session_router_new(0);
+    struct Delivery delivery = { .router = router };
+
+    kinesixd_session_router_subscribe(router, ":1.10", 1, GESTURE_MASK_ALL);
+    kinesixd_session_router_subscribe(router, ":1.11", 1, GESTURE_MASK_ALL);
+
+    /* Would deadlock if the callback ran under the router's lock */
+    delivery.unsubscribe = ":1.11";
+    delivery.subscribe = ":1.12";
+    kinesixd_session_router_route(router, "seat0", GESTURE_MASK_SWIPE, &deliver, &delivery);
+    CHECK(kinesixd_session_router_get_subscriber_count(router) == 2);
+
+    /* Nobody gets a gesture twice, whatever changed while it was being sent */
+    CHECK(delivery.destination_count <= 2);
+    CHECK(!(delivery.destination_count == 2 &&
+            (strcmp(delivery.destinations[0], delivery.destinations[1]) == 0)));
+
+    kinesixd_session_router_free(router);
+}
+
+static void test_rejections(void)
+{
+    KinesixdSessionRouter router = kinesixd_session_router_new(0);
+    struct Delivery delivery = { .router = router };
+    struct Statistics statistics = { .bus_name = ":1.10" };
+
+    kinesixd_session_router_subscribe(router, ":1.10", 1, GESTURE_MASK_ALL);
+    kinesixd_session_router_route(router, "seat0", GESTURE_MASK_SWIPE, &deliver, &delivery);
+    kinesixd_session_router_route(router, "seat0", GESTURE_MASK_PINCH, &deliver, &delivery);
+
+    CHECK(kinesixd_session_router_signal_rejected(router, 2));
+    CHECK(!kinesixd_session_router_signal_rejected(router, 42));
+    CHECK(!kinesixd_session_router_signal_rejected(router, 0));
+
+    kinesixd_session_router_foreach_subscriber(router, &find_statistics, &statistics);
+    CHECK(statistics.signals_routed == 2);
+    CHECK(statistics.signals_rejected == 1);
+
+    kinesixd_session_router_free(router);
+}
+
+static void test_without_logind(void)
+{
+    KinesixdSessionRouter router = kinesixd_session_router_new(1);
+    struct Delivery delivery = { .router = router };
+
+    kinesixd_session_router_subscribe(router, ":1.10", 1, GESTURE_MASK_ALL);
+
+    /* Without logind there are no sessions to tell apart, so routing by session falls back to
+     * delivering to everyone subscribed */
+    CHECK(kinesixd_session_router_set_session_policy(router, 1, GESTURE_MASK_PINCH));
+    CHECK(kinesixd_session_router_route(router, "seat0", GESTURE_MASK_SWIPE, &deliver, &delivery) == 1);
+    CHECK(kinesixd_session_router_route(router, "seat0", GESTURE_MASK_PINCH, &deliver, &delivery) == 1);
+    CHECK(kinesixd_session_router_session_is_active(router, 1, "seat1"));
+
+    kinesixd_session_router_free(router);
+}
+
+int main(void)
+{
+    test_subscriptions();
+    test_routing_by_mask();
+    test_routing_many_subscribers();
+    test_subscribing_while_routing();
+    test_rejections();
+    test_without_logind();
+
+    return TEST_RESULT();
+}